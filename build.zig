@@ -1980,8 +1980,11 @@ pub fn build(b: *std.Build) void {
                     plugin_path ++ "/preset_server/preset_server.cpp",
                     plugin_path ++ "/processing_utils/midi.cpp",
                     plugin_path ++ "/processing_utils/volume_fade.cpp",
+                    plugin_path ++ "/processor/disk_streaming.cpp",
+                    plugin_path ++ "/processor/effect_convo.cpp",
                     plugin_path ++ "/processor/layer_processor.cpp",
                     plugin_path ++ "/processor/processor.cpp",
+                    plugin_path ++ "/processor/sample_processing.cpp",
                     plugin_path ++ "/processor/voices.cpp",
                     plugin_path ++ "/sample_lib_server/sample_library_server.cpp",
                     plugin_path ++ "/state/state_coding.cpp",
@@ -3130,6 +3133,27 @@ pub fn build(b: *std.Build) void {
             build_context.test_step.dependOn(&run_tests.step);
         }
 
+        if (build_context.build_mode != .production) {
+            const bench = b.addExecutable(.{
+                .name = "floe-bench",
+                .target = target,
+                .optimize = build_context.optimise,
+            });
+            bench.addCSourceFiles(.{ .files = &.{
+                "src/bench_tool/floe_bench.cpp",
+                "src/plugin/plugin/plugin_entry.cpp",
+                "src/common_infrastructure/final_binary_type.cpp",
+            }, .flags = cpp_floe_flags });
+            bench.defineCMacro("FINAL_BINARY_TYPE", "Bench");
+            bench.addConfigHeader(build_config_step);
+            bench.addIncludePath(b.path("src"));
+            bench.addIncludePath(b.path("src/plugin"));
+            bench.linkLibrary(plugin);
+            b.getInstallStep().dependOn(&b.addInstallArtifact(bench, .{ .dest_dir = install_subfolder }).step);
+            applyUniversalSettings(&build_context, bench);
+            join_compile_commands.step.dependOn(&bench.step);
+        }
+
         build_context.master_step.dependOn(&join_compile_commands.step);
     }
 
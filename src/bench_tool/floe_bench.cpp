@@ -0,0 +1,624 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <clap/entry.h>
+#include <clap/events.h>
+#include <clap/ext/params.h>
+#include <clap/ext/state.h>
+#include <clap/ext/thread-check.h>
+#include <clap/factory/plugin-factory.h>
+#include <clap/host.h>
+#include <clap/plugin.h>
+#include <clap/process.h>
+
+#include "foundation/foundation.hpp"
+#include "os/filesystem.hpp"
+#include "os/misc.hpp"
+#include "os/threading.hpp"
+#include "utils/cli_arg_parse.hpp"
+#include "utils/reader.hpp"
+
+#include "common_infrastructure/common_errors.hpp"
+#include "common_infrastructure/global.hpp"
+
+#include "FFTConvolver/wrapper.hpp"
+#include "plugin/plugin.hpp"
+#include "processing_utils/midi.hpp"
+#include "state/state_coding.hpp"
+
+// Headless benchmark: loads a preset and a MIDI file into an in-process Floe and renders them as fast as
+// possible, reporting how long each block took and where the time went. Optionally writes the render to a
+// WAV file so that changes to the audio code can be checked for differences in output as well as speed.
+// Alternatively, --fft-backends times the convolver's FFT backends against each other.
+
+enum class BenchCliArgId : u32 {
+    Preset,
+    Midi,
+    OutputWav,
+    SampleRate,
+    BlockSize,
+    Tail,
+    FftBackends,
+    Count,
+};
+
+auto constexpr k_bench_command_line_args_defs = MakeCommandLineArgDefs<BenchCliArgId>({
+    {
+        .id = (u32)BenchCliArgId::Preset,
+        .key = "preset",
+        .description = "Floe preset file to load, required unless --fft-backends",
+        .value_type = "path",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::Midi,
+        .key = "midi",
+        .description = "Standard MIDI file (format 0 or 1) to play, required unless --fft-backends",
+        .value_type = "path",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::OutputWav,
+        .key = "output-wav",
+        .description = "Write the render to this 32-bit float WAV file",
+        .value_type = "path",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::SampleRate,
+        .key = "sample-rate",
+        .description = "Sample rate in Hz, default 44100",
+        .value_type = "num",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::BlockSize,
+        .key = "block-size",
+        .description = "Frames per process call, default 512",
+        .value_type = "num",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::Tail,
+        .key = "tail",
+        .description = "Seconds to keep rendering after the last MIDI event, default 2",
+        .value_type = "seconds",
+        .required = false,
+        .num_values = 1,
+    },
+    {
+        .id = (u32)BenchCliArgId::FftBackends,
+        .key = "fft-backends",
+        .description = "Time the convolver's FFT backends for typical IR lengths instead of rendering",
+        .value_type = "",
+        .required = false,
+        .num_values = 0,
+    },
+});
+
+constexpr String k_bench_description =
+    "Renders a preset playing a MIDI file faster than real time and reports per-block timing\n"
+    "percentiles, active voice counts and the time spent in each stage of processing. Or compares the\n"
+    "speed of the convolver's FFT backends.";
+
+// Host
+// ==========================================================================================================
+
+struct BenchHost {
+    clap_host_params const host_params {
+        .rescan = [](clap_host_t const*, clap_param_rescan_flags) {},
+        .clear = [](clap_host_t const*, clap_id, clap_param_clear_flags) {},
+        .request_flush = [](clap_host_t const*) {},
+    };
+
+    clap_host_thread_check const host_thread_check {
+        .is_main_thread =
+            [](clap_host const* h) {
+                auto& bench_host = *(BenchHost*)h->host_data;
+                return CurrentThreadId() == bench_host.main_thread_id;
+            },
+        .is_audio_thread =
+            [](clap_host const* h) {
+                auto& bench_host = *(BenchHost*)h->host_data;
+                return CurrentThreadId() == bench_host.audio_thread_id.Load(LoadMemoryOrder::Relaxed);
+            },
+    };
+
+    clap_host_t const host {
+        .clap_version = CLAP_VERSION,
+        .host_data = this,
+        .name = "Floe Bench",
+        .vendor = FLOE_VENDOR,
+        .url = FLOE_HOMEPAGE_URL,
+        .version = "1",
+
+        .get_extension = [](clap_host_t const* ch, char const* extension_id) -> void const* {
+            auto& bench_host = *(BenchHost*)ch->host_data;
+            if (NullTermStringsEqual(extension_id, CLAP_EXT_PARAMS))
+                return &bench_host.host_params;
+            else if (NullTermStringsEqual(extension_id, CLAP_EXT_THREAD_CHECK))
+                return &bench_host.host_thread_check;
+            return nullptr;
+        },
+        .request_restart = [](clap_host_t const*) {},
+        .request_process = [](clap_host_t const*) {},
+        .request_callback =
+            [](clap_host_t const* h) {
+                auto& bench_host = *(BenchHost*)h->host_data;
+                bench_host.callback_requested.Store(true, StoreMemoryOrder::Relaxed);
+            },
+    };
+
+    u64 main_thread_id {CurrentThreadId()};
+    Atomic<u64> audio_thread_id {};
+    Atomic<bool> callback_requested {false};
+};
+
+static ErrorCodeOr<void> LoadPreset(clap_plugin const& plugin, String preset_path, ArenaAllocator& arena) {
+    auto state = TRY(LoadPresetFile(preset_path, arena, false));
+
+    DynamicArray<u8> buffer {arena};
+    TRY(CodeState(state,
+                  CodeStateArguments {
+                      .mode = CodeStateArguments::Mode::Encode,
+                      .read_or_write_data = [&buffer](void* data, usize bytes) -> ErrorCodeOr<void> {
+                          dyn::AppendSpan(buffer, Span {(u8 const*)data, bytes});
+                          return k_success;
+                      },
+                      .source = StateSource::Daw,
+                      .abbreviated_read = false,
+                  }));
+
+    auto const state_ext = (clap_plugin_state const*)plugin.get_extension(&plugin, CLAP_EXT_STATE);
+    if (!state_ext) return ErrorCode {CommonError::PluginHostError};
+
+    auto reader = Reader::FromMemory(buffer);
+    clap_istream const stream {
+        .ctx = (void*)&reader,
+        .read = [](clap_istream const* stream, void* data, uint64_t size) -> s64 {
+            auto& reader = *(Reader*)stream->ctx;
+            auto const read = reader.Read(Span<u8>((u8*)data, size));
+            if (read.HasError()) return -1;
+            return CheckedCast<s64>(read.Value());
+        },
+    };
+    if (!state_ext->load(&plugin, &stream)) return ErrorCode {CommonError::PluginHostError};
+    return k_success;
+}
+
+// Rendering
+// ==========================================================================================================
+
+struct RenderArgs {
+    Span<TimedMidiMessage const> midi;
+    u64 num_frames;
+    u32 block_size;
+    bool capture_output;
+};
+
+struct RenderResult {
+    u64 num_frames;
+    Span<f64> block_seconds;
+    Span<u32> block_active_voices;
+    ProcessStageTimings stage_totals;
+    Array<Span<f32>, 2> output;
+};
+
+// [audio-thread]
+static RenderResult Render(clap_plugin const& plugin,
+                           FloeClapTestingExtension const& floe_ext,
+                           RenderArgs args,
+                           ArenaAllocator& arena) {
+    auto const num_blocks = (usize)((args.num_frames + args.block_size - 1) / args.block_size);
+
+    RenderResult result {
+        .num_frames = args.num_frames,
+        .block_seconds = arena.AllocateExactSizeUninitialised<f64>(num_blocks),
+        .block_active_voices = arena.AllocateExactSizeUninitialised<u32>(num_blocks),
+        .stage_totals = {},
+        .output = {},
+    };
+    if (args.capture_output)
+        for (auto& channel : result.output)
+            channel = arena.AllocateExactSizeUninitialised<f32>((usize)args.num_frames);
+
+    auto const block_data = arena.AllocateExactSizeUninitialised<f32>(args.block_size * 2);
+    Array<f32*, 2> channels {block_data.data, block_data.data + args.block_size};
+
+    DynamicArray<clap_event_midi> block_events {arena};
+    block_events.Reserve(256);
+
+    usize next_midi_index = 0;
+    for (auto const block_index : Range(num_blocks)) {
+        auto const frame_pos = (u64)block_index * args.block_size;
+        auto const num_frames = (u32)Min<u64>(args.block_size, args.num_frames - frame_pos);
+
+        dyn::Clear(block_events);
+        while (next_midi_index != args.midi.size &&
+               args.midi[next_midi_index].frame < frame_pos + num_frames) {
+            auto const& m = args.midi[next_midi_index++];
+            dyn::Append(block_events,
+                        {
+                            .header =
+                                {
+                                    .size = sizeof(clap_event_midi),
+                                    .time = (u32)(Max(m.frame, frame_pos) - frame_pos),
+                                    .space_id = CLAP_CORE_EVENT_SPACE_ID,
+                                    .type = CLAP_EVENT_MIDI,
+                                    .flags = 0,
+                                },
+                            .port_index = 0,
+                            .data = {m.message.status, m.message.data1, m.message.data2},
+                        });
+        }
+
+        clap_input_events const in_events {
+            .ctx = &block_events,
+            .size = [](clap_input_events const* list) -> u32 {
+                return (u32)((DynamicArray<clap_event_midi> const*)list->ctx)->size;
+            },
+            .get = [](clap_input_events const* list, uint32_t index) -> clap_event_header_t const* {
+                return &(*(DynamicArray<clap_event_midi> const*)list->ctx)[index].header;
+            },
+        };
+
+        clap_output_events const out_events {
+            .ctx = nullptr,
+            .try_push = [](clap_output_events const*, clap_event_header const*) -> bool { return true; },
+        };
+
+        clap_audio_buffer out {
+            .data32 = channels.data,
+            .channel_count = 2,
+            .latency = 0,
+            .constant_mask = 0,
+        };
+
+        clap_process const process {
+            .steady_time = (s64)frame_pos,
+            .frames_count = num_frames,
+            .transport = nullptr,
+            .audio_inputs = nullptr,
+            .audio_outputs = &out,
+            .audio_inputs_count = 0,
+            .audio_outputs_count = 1,
+            .in_events = &in_events,
+            .out_events = &out_events,
+        };
+
+        Stopwatch const stopwatch;
+        plugin.process(&plugin, &process);
+        result.block_seconds[block_index] = stopwatch.SecondsElapsed();
+
+        ProcessStageTimings timings {};
+        floe_ext.last_process_stage_timings(&plugin, &timings);
+        result.block_active_voices[block_index] = timings.num_active_voices;
+        result.stage_totals.voices_seconds += timings.voices_seconds;
+        result.stage_totals.layers_seconds += timings.layers_seconds;
+        result.stage_totals.effects_seconds += timings.effects_seconds;
+        result.stage_totals.convolution_seconds += timings.convolution_seconds;
+
+        if (args.capture_output)
+            for (auto const chan : Range(2u))
+                CopyMemory(result.output[chan].data + frame_pos, channels[chan], num_frames * sizeof(f32));
+    }
+
+    return result;
+}
+
+static ErrorCodeOr<void> WriteFloatWaveFile(String path, f64 sample_rate, Array<Span<f32>, 2> channels) {
+    static_assert(k_endianness == Endianness::Little, "Wave file format is little-endian, we don't convert");
+    constexpr u16 k_num_channels = 2;
+    auto const num_frames = channels[0].size;
+    auto const data_size = (u32)(num_frames * k_num_channels * sizeof(f32));
+
+    auto file = TRY(OpenFile(path, FileMode::Write()));
+    TRY(file.Write("RIFF"));
+    TRY(file.WriteBinaryNumber<u32>(36 + data_size));
+    TRY(file.Write("WAVEfmt "));
+    TRY(file.WriteBinaryNumber<u32>(16)); // fmt chunk size
+    TRY(file.WriteBinaryNumber<u16>(3)); // IEEE float
+    TRY(file.WriteBinaryNumber<u16>(k_num_channels));
+    TRY(file.WriteBinaryNumber<u32>((u32)sample_rate));
+    TRY(file.WriteBinaryNumber<u32>((u32)(sample_rate * k_num_channels * sizeof(f32)))); // bytes per second
+    TRY(file.WriteBinaryNumber<u16>((u16)(k_num_channels * sizeof(f32)))); // bytes per frame
+    TRY(file.WriteBinaryNumber<u16>(32)); // bits per sample
+    TRY(file.Write("data"));
+    TRY(file.WriteBinaryNumber<u32>(data_size));
+
+    Array<f32, 1024 * k_num_channels> interleaved;
+    for (usize frame = 0; frame < num_frames; frame += 1024) {
+        auto const n = Min<usize>(1024, num_frames - frame);
+        for (auto const i : Range(n))
+            for (auto const chan : Range(k_num_channels))
+                interleaved[i * k_num_channels + chan] = channels[chan][frame + i];
+        TRY(file.Write(Span<f32 const> {interleaved.data, n * k_num_channels}.ToByteSpan()));
+    }
+    return k_success;
+}
+
+static void PrintReport(RenderResult const& result, f64 sample_rate, u32 block_size, ArenaAllocator& arena) {
+    auto const sorted_seconds = arena.Clone(result.block_seconds);
+    Sort(sorted_seconds);
+
+    f64 total_seconds = 0;
+    for (auto const s : sorted_seconds)
+        total_seconds += s;
+
+    auto const percentile_us = [&](f64 percentile) {
+        auto const index = Min(sorted_seconds.size - 1, (usize)(percentile * (f64)sorted_seconds.size));
+        return SecondsToMicroseconds(sorted_seconds[index]);
+    };
+
+    u64 total_voices = 0;
+    u32 max_voices = 0;
+    for (auto const v : result.block_active_voices) {
+        total_voices += v;
+        max_voices = Max(max_voices, v);
+    }
+
+    auto const audio_seconds = (f64)result.num_frames / sample_rate;
+
+    StdPrintF(StdStream::Out,
+              "Rendered {.2} s of audio in {.3} s ({.1}x real time)\n\n",
+              audio_seconds,
+              total_seconds,
+              audio_seconds / total_seconds);
+
+    StdPrintF(StdStream::Out,
+              "Block time, {} frames ({.0} us budget):\n",
+              block_size,
+              SecondsToMicroseconds(block_size / sample_rate));
+    StdPrintF(StdStream::Out, "  p50  {10.1} us\n", percentile_us(0.5));
+    StdPrintF(StdStream::Out, "  p90  {10.1} us\n", percentile_us(0.9));
+    StdPrintF(StdStream::Out, "  p99  {10.1} us\n", percentile_us(0.99));
+    StdPrintF(StdStream::Out, "  max  {10.1} us\n\n", SecondsToMicroseconds(Last(sorted_seconds)));
+
+    StdPrintF(StdStream::Out,
+              "Active voices: mean {.1}, max {}\n\n",
+              (f64)total_voices / (f64)result.block_active_voices.size,
+              max_voices);
+
+    auto const& t = result.stage_totals;
+    auto const other_seconds =
+        total_seconds - t.voices_seconds - t.layers_seconds - t.effects_seconds - t.convolution_seconds;
+    auto const print_stage = [&](String name, f64 seconds) {
+        StdPrintF(StdStream::Out,
+                  "  {}{10.1} ms {6.1}%\n",
+                  name,
+                  SecondsToMilliseconds(seconds),
+                  seconds / total_seconds * 100);
+    };
+    StdPrintF(StdStream::Out, "Stages:\n");
+    print_stage("voices      ", t.voices_seconds);
+    print_stage("layers      ", t.layers_seconds);
+    print_stage("effects     ", t.effects_seconds);
+    print_stage("convolution ", t.convolution_seconds);
+    print_stage("other       ", other_seconds);
+}
+
+// FFT backends
+// ==========================================================================================================
+
+// The IRs are decaying noise. The tail is processed inline so that all of the convolution is timed.
+static void BenchmarkConvolverFftBackends(f64 sample_rate, u32 block_size, ArenaAllocator& arena) {
+    constexpr f64 k_input_seconds = 10;
+    auto const num_input_frames = (u32)(k_input_seconds * sample_rate);
+    u64 seed = 0x1234;
+
+    auto const input = arena.AllocateExactSizeUninitialised<f32>(num_input_frames * 2);
+    for (auto& s : input)
+        s = RandomFloatInRange<f32>(seed, -1, 1);
+    auto const output = arena.AllocateExactSizeUninitialised<f32>(block_size * 2);
+
+    StdPrintF(StdStream::Out,
+              "Convolving {} s of audio in blocks of {} frames:\n",
+              k_input_seconds,
+              block_size);
+    StdPrintF(StdStream::Out, "  IR length     default       Ooura\n");
+
+    for (auto const ir_seconds : Array {0.25, 1.0, 3.0, 6.0}) {
+        auto const ir_frames = (u32)(ir_seconds * sample_rate);
+        auto const ir = arena.AllocateExactSizeUninitialised<f32>(ir_frames * 2);
+        auto const decay = Pow(0.001f, 1.0f / (f32)ir_frames);
+        f32 gain = 1;
+        for (auto const frame : Range(ir_frames)) {
+            ir[frame * 2 + 0] = RandomFloatInRange<f32>(seed, -1, 1) * gain;
+            ir[frame * 2 + 1] = RandomFloatInRange<f32>(seed, -1, 1) * gain;
+            gain *= decay;
+        }
+
+        Array<f64, 2> seconds {};
+        for (auto const backend_index : Range(2u)) {
+            auto const backend =
+                backend_index == 0 ? ConvolverFftBackend::Default : ConvolverFftBackend::Ooura;
+            auto convolver = CreateStereoConvolver();
+            DEFER { DestroyStereoConvolver(convolver); };
+            Init(*convolver, ir.data, (int)ir_frames, 2, backend, false);
+
+            Stopwatch const stopwatch;
+            for (u32 pos = 0; pos < num_input_frames; pos += block_size) {
+                auto const num_frames = Min(block_size, num_input_frames - pos);
+                Process(*convolver,
+                        input.data + pos,
+                        input.data + num_input_frames + pos,
+                        output.data,
+                        output.data + block_size,
+                        (int)num_frames,
+                        0);
+            }
+            seconds[backend_index] = stopwatch.SecondsElapsed();
+        }
+
+        StdPrintF(StdStream::Out,
+                  "  {5.2} s  {8.1} ms  {8.1} ms  ({.2}x)\n",
+                  ir_seconds,
+                  SecondsToMilliseconds(seconds[0]),
+                  SecondsToMilliseconds(seconds[1]),
+                  seconds[1] / seconds[0]);
+    }
+}
+
+// Main
+// ==========================================================================================================
+
+extern clap_plugin_entry const clap_entry;
+
+static ErrorCodeOr<int> Main(ArgsCstr args) {
+    ArenaAllocator arena {PageAllocator::Instance()};
+    auto const exe_path = TRY(CurrentBinaryPath(arena));
+
+    GlobalInit({
+        .current_binary_path = exe_path,
+        .init_error_reporting = false,
+        .set_main_thread = true,
+    });
+    DEFER { GlobalDeinit({.shutdown_error_reporting = false}); };
+
+    auto const cli_args = TRY(ParseCommandLineArgsStandard(arena,
+                                                           args,
+                                                           k_bench_command_line_args_defs,
+                                                           {
+                                                               .handle_help_option = true,
+                                                               .print_usage_on_error = true,
+                                                               .description = k_bench_description,
+                                                               .version = FLOE_VERSION_STRING,
+                                                           }));
+
+    auto const number_arg = [&](BenchCliArgId id, f64 default_value) -> Optional<f64> {
+        auto const value = cli_args[ToInt(id)].Value();
+        if (!value) return default_value;
+        auto const result = ParseFloat(*value);
+        if (!result || *result <= 0) {
+            StdPrintF(StdStream::Err,
+                      "Error: invalid value for --{}: {}\n",
+                      cli_args[ToInt(id)].info.key,
+                      *value);
+            return k_nullopt;
+        }
+        return result;
+    };
+    auto const sample_rate = number_arg(BenchCliArgId::SampleRate, 44100);
+    auto const block_size = number_arg(BenchCliArgId::BlockSize, 512);
+    auto const tail_seconds = number_arg(BenchCliArgId::Tail, 2);
+    if (!sample_rate || !block_size || !tail_seconds) return 1;
+
+    if (cli_args[ToInt(BenchCliArgId::FftBackends)].was_provided) {
+        BenchmarkConvolverFftBackends(*sample_rate, (u32)*block_size, arena);
+        return 0;
+    }
+
+    for (auto const id : Array {BenchCliArgId::Preset, BenchCliArgId::Midi}) {
+        if (!cli_args[ToInt(id)].was_provided) {
+            StdPrintF(StdStream::Err, "Error: --{} is required\n", cli_args[ToInt(id)].info.key);
+            return 1;
+        }
+    }
+
+    auto const midi_path = *cli_args[ToInt(BenchCliArgId::Midi)].Value();
+    auto const midi = ({
+        auto const o = [&]() -> ErrorCodeOr<Span<TimedMidiMessage>> {
+            auto const data = TRY(ReadEntireFile(midi_path, arena)).ToByteSpan();
+            return ParseMidiFile(data, *sample_rate, arena, arena);
+        }();
+        if (o.HasError()) {
+            StdPrintF(StdStream::Err, "Error: failed to read MIDI file {}: {}\n", midi_path, o.Error());
+            return 1;
+        }
+        o.Value();
+    });
+    if (!midi.size) {
+        StdPrintF(StdStream::Err, "Error: MIDI file {} has no events\n", midi_path);
+        return 1;
+    }
+
+    clap_entry.init(dyn::NullTerminated(exe_path));
+    DEFER { clap_entry.deinit(); };
+
+    BenchHost bench_host {};
+    auto const factory = (clap_plugin_factory const*)clap_entry.get_factory(CLAP_PLUGIN_FACTORY_ID);
+    auto const& plugin = *factory->create_plugin(factory, &bench_host.host, g_plugin_info.id);
+    if (!plugin.init(&plugin)) return ErrorCode {CommonError::PluginHostError};
+    DEFER { plugin.destroy(&plugin); };
+
+    auto const floe_ext =
+        (FloeClapTestingExtension const*)plugin.get_extension(&plugin, k_floe_clap_extension_id);
+    if (!floe_ext) return ErrorCode {CommonError::PluginHostError};
+
+    auto const preset_path = *cli_args[ToInt(BenchCliArgId::Preset)].Value();
+    if (auto const o = LoadPreset(plugin, preset_path, arena); o.HasError()) {
+        StdPrintF(StdStream::Err, "Error: failed to load preset {}: {}\n", preset_path, o.Error());
+        return 1;
+    }
+
+    // Sample libraries are loaded asynchronously; wait for them otherwise we'd be benchmarking silence. The
+    // reverb's convolver is built asynchronously after that, so we wait for it too, otherwise the first
+    // blocks would be rendered without the reverb.
+    {
+        Stopwatch const stopwatch;
+        while (true) {
+            if (bench_host.callback_requested.Exchange(false, RmwMemoryOrder::Relaxed))
+                plugin.on_main_thread(&plugin);
+            if (!floe_ext->state_change_is_pending(&plugin) && !floe_ext->convolver_build_is_pending(&plugin))
+                break;
+            if (stopwatch.SecondsElapsed() > 60) {
+                StdPrintF(StdStream::Err, "Error: timed out waiting for the preset's libraries to load\n");
+                return 1;
+            }
+            SleepThisThread(10);
+        }
+        StdPrintF(StdStream::Out, "Loaded preset in {.2} s\n", stopwatch.SecondsElapsed());
+    }
+
+    floe_ext->enable_stage_timings(&plugin);
+
+    if (!plugin.activate(&plugin, *sample_rate, (u32)*block_size, (u32)*block_size))
+        return ErrorCode {CommonError::PluginHostError};
+    DEFER { plugin.deactivate(&plugin); };
+
+    auto const output_wav = cli_args[ToInt(BenchCliArgId::OutputWav)].Value();
+    RenderArgs const render_args {
+        .midi = midi,
+        .num_frames = Last(midi).frame + (u64)(*tail_seconds * *sample_rate),
+        .block_size = (u32)*block_size,
+        .capture_output = output_wav.HasValue(),
+    };
+
+    // The main thread waits for the audio thread to finish so nothing runs concurrently with it.
+    RenderResult result {};
+    Thread audio_thread {};
+    audio_thread.Start(
+        [&] {
+            bench_host.audio_thread_id.Store(CurrentThreadId(), StoreMemoryOrder::Relaxed);
+            if (!plugin.start_processing(&plugin)) return;
+            DEFER { plugin.stop_processing(&plugin); };
+            result = Render(plugin, *floe_ext, render_args, arena);
+        },
+        "audio");
+    audio_thread.Join();
+
+    if (!result.block_seconds.size) return ErrorCode {CommonError::PluginHostError};
+
+    PrintReport(result, *sample_rate, render_args.block_size, arena);
+
+    if (output_wav) {
+        TRY(WriteFloatWaveFile(*output_wav, *sample_rate, result.output));
+        StdPrintF(StdStream::Out, "\nWrote {}\n", *output_wav);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    auto const result = Main({argc, argv});
+    if (result.HasError()) {
+        StdPrintF(StdStream::Err, "Error: {}\n", result.Error());
+        return 1;
+    }
+    return result.Value();
+}
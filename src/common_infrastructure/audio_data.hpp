@@ -3,13 +3,70 @@
 
 #pragma once
 #include "foundation/foundation.hpp"
+#include "utils/reader.hpp"
+
+// Samples are kept in the bit depth of the source file rather than always expanding them to f32. Most sample
+// libraries are 16 or 24 bit so this roughly halves the memory used. Samples are converted to f32 as they're
+// read.
+enum class AudioSampleFormat : u8 {
+    Float32,
+    Int16,
+    Int24, // packed, 3 bytes little-endian
+};
+
+constexpr usize BytesPerSample(AudioSampleFormat format) {
+    switch (format) {
+        case AudioSampleFormat::Float32: return 4;
+        case AudioSampleFormat::Int16: return 2;
+        case AudioSampleFormat::Int24: return 3;
+    }
+    return 0;
+}
+
+// Allows the file to be opened again so that frames that aren't resident can be decoded on demand.
+struct AudioDataStreamSource {
+    ErrorCodeOr<Reader> (*create_reader)(AudioDataStreamSource const&) {};
+    void const* user_data {};
+    String filepath_for_id {};
+};
 
 struct AudioData {
-    usize RamUsageBytes() const { return interleaved_samples.ToByteSpan().size; }
+    usize RamUsageBytes() const { return interleaved_samples.size; }
+
+    // When the audio is streamed from disk, only the first frames of the file are resident.
+    bool IsStreamed() const { return stream_source != nullptr; }
+    u32 NumResidentFrames() const {
+        return channels ? (u32)(interleaved_samples.size / (BytesPerSample(sample_format) * channels)) : 0;
+    }
 
     u64 hash {};
     u8 channels {};
+    AudioSampleFormat sample_format {AudioSampleFormat::Float32};
     f32 sample_rate {};
     u32 num_frames {};
-    Span<f32 const> interleaved_samples {};
+    Span<u8 const> interleaved_samples {}; // in sample_format
+    AudioDataStreamSource const* stream_source {};
 };
+
+PUBLIC_INLINE f32 SampleAsF32(AudioSampleFormat format, u8 const* samples, usize sample_index) {
+    switch (format) {
+        case AudioSampleFormat::Float32: return ((f32 const*)samples)[sample_index];
+        case AudioSampleFormat::Int16: return (f32)((s16 const*)samples)[sample_index] * (1.0f / 32768.0f);
+        case AudioSampleFormat::Int24: {
+            auto const p = samples + (sample_index * 3);
+            auto const value = (s32)(((u32)p[0] << 8) | ((u32)p[1] << 16) | ((u32)p[2] << 24)) >> 8;
+            return (f32)value * (1.0f / 8388608.0f);
+        }
+    }
+    return 0;
+}
+
+PUBLIC_INLINE f32 SampleAsF32(AudioData const& audio_data, usize sample_index) {
+    return SampleAsF32(audio_data.sample_format, audio_data.interleaved_samples.data, sample_index);
+}
+
+// Writes audio_data.channels samples.
+PUBLIC_INLINE void FrameAsF32(AudioData const& audio_data, usize frame, f32* out) {
+    for (auto const chan : Range<usize>(audio_data.channels))
+        out[chan] = SampleAsF32(audio_data, (frame * audio_data.channels) + chan);
+}
@@ -14,6 +14,7 @@ enum class FinalBinaryType {
     AuV2,
     Tests,
     DocsPreprocessor,
+    Bench,
 };
 
 constexpr String ToString(FinalBinaryType type) {
@@ -27,6 +28,7 @@ constexpr String ToString(FinalBinaryType type) {
         case FinalBinaryType::AuV2: return "au_v2"_s;
         case FinalBinaryType::Tests: return "tests"_s;
         case FinalBinaryType::DocsPreprocessor: return "docs_preprocessor"_s;
+        case FinalBinaryType::Bench: return "bench"_s;
     }
     PanicIfReached();
 }
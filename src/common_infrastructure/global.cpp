@@ -97,6 +97,7 @@ void GlobalInit(GlobalInitOptions options) {
                         case FinalBinaryType::WindowsInstaller:
                         case FinalBinaryType::WindowsUninstaller:
                         case FinalBinaryType::DocsPreprocessor:
+                        case FinalBinaryType::Bench:
                         case FinalBinaryType::Tests: d = LogConfig::Destination::Stderr; break;
                     }
                     d;
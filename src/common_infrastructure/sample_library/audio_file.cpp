@@ -9,6 +9,7 @@
 #include <xxhash.h>
 
 #include "foundation/foundation.hpp"
+#include "os/misc.hpp"
 #include "tests/framework.hpp"
 
 ErrorCodeCategory const audio_file_error_category {
@@ -24,6 +25,57 @@ ErrorCodeCategory const audio_file_error_category {
     },
 };
 
+static AudioSampleFormat SampleFormatForIntBitDepth(u32 bits_per_sample) {
+    if (bits_per_sample <= 16) return AudioSampleFormat::Int16;
+    if (bits_per_sample <= 24) return AudioSampleFormat::Int24;
+    return AudioSampleFormat::Float32;
+}
+
+static AudioSampleFormat SampleFormatForWav(drwav const& wav) {
+    if (wav.translatedFormatTag == DR_WAVE_FORMAT_PCM) return SampleFormatForIntBitDepth(wav.bitsPerSample);
+    return AudioSampleFormat::Float32;
+}
+
+// value is a signed integer sample with the given bit depth.
+static void
+StoreIntSample(AudioSampleFormat format, u8* samples, usize sample_index, s32 value, u32 bits_per_sample) {
+    switch (format) {
+        case AudioSampleFormat::Float32: {
+            ((f32*)samples)[sample_index] = (f32)value / (f32)(1ull << (bits_per_sample - 1));
+            break;
+        }
+        case AudioSampleFormat::Int16: {
+            ASSERT(bits_per_sample <= 16);
+            ((s16*)samples)[sample_index] = (s16)(value * (1 << (16 - bits_per_sample)));
+            break;
+        }
+        case AudioSampleFormat::Int24: {
+            ASSERT(bits_per_sample <= 24);
+            auto const v = (u32)(value * (1 << (24 - bits_per_sample)));
+            auto const p = samples + (sample_index * 3);
+            p[0] = (u8)v;
+            p[1] = (u8)(v >> 8);
+            p[2] = (u8)(v >> 16);
+            break;
+        }
+    }
+}
+
+// The f32 samples must have been decoded from integers that fit in the format so that this is lossless.
+static void StoreF32Samples(AudioSampleFormat format, Span<f32 const> samples, u8* out) {
+    switch (format) {
+        case AudioSampleFormat::Float32: CopyMemory(out, samples.data, samples.ToByteSpan().size); break;
+        case AudioSampleFormat::Int16:
+            for (auto const [i, s] : Enumerate(samples))
+                StoreIntSample(format, out, i, (s32)(s * 32768.0f), 16);
+            break;
+        case AudioSampleFormat::Int24:
+            for (auto const [i, s] : Enumerate(samples))
+                StoreIntSample(format, out, i, (s32)(s * 8388608.0f), 24);
+            break;
+    }
+}
+
 static ErrorCodeOr<AudioData> DecodeFlac(Reader& reader, Allocator& allocator) {
     auto decoder = FLAC__stream_decoder_new();
     if (decoder == nullptr) Panic("out of memory");
@@ -36,7 +88,8 @@ static ErrorCodeOr<AudioData> DecodeFlac(Reader& reader, Allocator& allocator) {
         u8 channels {};
         f32 sample_rate {};
         u32 num_frames {};
-        Span<f32> interleaved_samples {};
+        AudioSampleFormat sample_format {};
+        Span<u8> interleaved_samples {};
         u32 samples_pos {};
         u32 bits_per_sample {};
         Optional<FLAC__StreamDecoderErrorStatus> flac_error {};
@@ -114,13 +167,14 @@ static ErrorCodeOr<AudioData> DecodeFlac(Reader& reader, Allocator& allocator) {
             u64 bits_per_sample = frame->header.bits_per_sample;
             if (!bits_per_sample) bits_per_sample = context.bits_per_sample;
             if (!bits_per_sample) return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
-            auto const divisor = (f32)(1ull << (bits_per_sample - 1));
 
             for (unsigned int chan = 0; chan < frame->header.channels; ++chan) {
                 for (unsigned int sample = 0; sample < frame->header.blocksize; ++sample) {
-                    auto const val = buffer[chan][sample];
-                    context.interleaved_samples[start_pos + chan + sample * frame->header.channels] =
-                        (f32)val / divisor;
+                    StoreIntSample(context.sample_format,
+                                   context.interleaved_samples.data,
+                                   start_pos + chan + sample * frame->header.channels,
+                                   buffer[chan][sample],
+                                   (u32)bits_per_sample);
                 }
             }
             context.samples_pos += frame->header.blocksize * frame->header.channels;
@@ -148,8 +202,9 @@ static ErrorCodeOr<AudioData> DecodeFlac(Reader& reader, Allocator& allocator) {
             context.sample_rate = (f32)info.sample_rate;
             context.channels = CheckedCast<u8>(info.channels);
             context.num_frames = CheckedCast<u32>(info.total_samples);
-            context.interleaved_samples =
-                context.allocator.AllocateExactSizeUninitialised<f32>(info.total_samples * info.channels);
+            context.sample_format = SampleFormatForIntBitDepth(info.bits_per_sample);
+            context.interleaved_samples = context.allocator.AllocateExactSizeUninitialised<u8>(
+                info.total_samples * info.channels * BytesPerSample(context.sample_format));
         },
         [](FLAC__StreamDecoder const*, FLAC__StreamDecoderErrorStatus status, void* user_data) {
             // Error callback
@@ -187,12 +242,40 @@ static ErrorCodeOr<AudioData> DecodeFlac(Reader& reader, Allocator& allocator) {
     return AudioData {
         .hash = context.hash,
         .channels = context.channels,
+        .sample_format = context.sample_format,
         .sample_rate = context.sample_rate,
         .num_frames = context.num_frames,
         .interleaved_samples = context.interleaved_samples,
     };
 }
 
+// Unlike FLAC, which stores an MD5 of its audio, WAV and raw files have nothing we can use to identify the
+// audio. We hash the file's bytes rather than the decoded samples so that the hash is the same whether the
+// whole file is decoded or only its head is (for disk streaming). It's a plain sequential read so it's much
+// cheaper than decoding.
+static ErrorCodeOr<u64> HashFileBytes(Reader& reader) {
+    ZoneScoped;
+    auto const initial_pos = reader.pos;
+    DEFER { reader.pos = initial_pos; };
+
+    if (reader.memory) return XXH3_64bits(reader.memory, reader.size);
+
+    auto state = XXH3_createState();
+    if (!state) Panic("out of memory");
+    DEFER { XXH3_freeState(state); };
+    XXH3_64bits_reset(state);
+
+    DynamicArray<u8> buffer {Malloc::Instance()};
+    dyn::Resize(buffer, Kb(64));
+    reader.pos = 0;
+    while (true) {
+        auto const bytes_read = TRY(reader.Read(buffer.Items()));
+        XXH3_64bits_update(state, buffer.data, bytes_read);
+        if (bytes_read != buffer.size) break;
+    }
+    return XXH3_64bits_digest(state);
+}
+
 static ErrorCodeOr<AudioData> DecodeWav(Reader& reader, Allocator& allocator) {
     struct Context {
         Reader& reader;
@@ -238,23 +321,55 @@ static ErrorCodeOr<AudioData> DecodeWav(Reader& reader, Allocator& allocator) {
 
     if (wav.channels == 0 || wav.channels > 2) return ErrorCode {AudioFileError::NotMonoOrStereo};
 
+    auto const sample_format = SampleFormatForWav(wav);
+    auto const samples = allocator.AllocateExactSizeUninitialised<u8>(wav.totalPCMFrameCount * wav.channels *
+                                                                      BytesPerSample(sample_format));
     AudioData result {
         .channels = (u8)wav.channels,
+        .sample_format = sample_format,
         .sample_rate = (f32)wav.sampleRate,
         .num_frames = (u32)wav.totalPCMFrameCount,
-        .interleaved_samples =
-            allocator.AllocateExactSizeUninitialised<f32>(wav.totalPCMFrameCount * wav.channels),
+        .interleaved_samples = samples,
     };
 
-    auto const num_read =
-        drwav_read_pcm_frames_f32(&wav, wav.totalPCMFrameCount, (f32*)result.interleaved_samples.data);
+    drwav_uint64 num_read = 0;
+    switch (sample_format) {
+        case AudioSampleFormat::Float32:
+            num_read = drwav_read_pcm_frames_f32(&wav, wav.totalPCMFrameCount, (f32*)samples.data);
+            break;
+        case AudioSampleFormat::Int16:
+            num_read = drwav_read_pcm_frames_s16(&wav, wav.totalPCMFrameCount, (drwav_int16*)samples.data);
+            break;
+        case AudioSampleFormat::Int24: {
+            // dr_wav doesn't output packed 24-bit so we read blocks of 32-bit and pack them.
+            drwav_int32 buffer[2048];
+            auto const frames_per_block = ArraySize(buffer) / wav.channels;
+            while (num_read != wav.totalPCMFrameCount) {
+                auto const frames_read = drwav_read_pcm_frames_s32(
+                    &wav,
+                    Min<drwav_uint64>(frames_per_block, wav.totalPCMFrameCount - num_read),
+                    buffer);
+                if (!frames_read) break;
+                auto const first_sample = num_read * wav.channels;
+                for (auto const i : Range<usize>(frames_read * wav.channels))
+                    StoreIntSample(sample_format, samples.data, first_sample + i, buffer[i] >> 8, 24);
+                num_read += frames_read;
+            }
+            break;
+        }
+    }
     if (num_read != wav.totalPCMFrameCount) {
-        if (result.interleaved_samples.size) allocator.Free(result.interleaved_samples.ToByteSpan());
+        if (samples.size) allocator.Free(samples);
         if (context.error_code) return *context.error_code;
         return ErrorCode {AudioFileError::FileHasInvalidData};
     }
 
-    result.hash = XXH3_64bits(result.interleaved_samples.data, result.interleaved_samples.ToByteSpan().size);
+    auto const hash = HashFileBytes(reader);
+    if (hash.HasError()) {
+        if (samples.size) allocator.Free(samples);
+        return hash.Error();
+    }
+    result.hash = hash.Value();
     return result;
 }
 
@@ -265,27 +380,32 @@ ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, A
         return DecodeFlac(reader, allocator);
     } else if (file_extension == k_raw_16_bit_stereo_44100_format_ext) {
         ZoneScopedN("raw");
-        auto const num_samples = reader.size / sizeof(u16);
+        auto const num_frames = (u32)(reader.size / (sizeof(u16) * 2));
+        auto const samples = allocator.AllocateExactSizeUninitialised<u8>(num_frames * sizeof(u16) * 2);
         AudioData result {
             .channels = 2,
+            .sample_format = AudioSampleFormat::Int16,
             .sample_rate = 44100,
-            .num_frames = (u32)(num_samples / 2),
-            .interleaved_samples = allocator.AllocateExactSizeUninitialised<f32>(num_samples),
+            .num_frames = num_frames,
+            .interleaved_samples = samples,
         };
-        u32 sample_pos = 0;
-        drwav_int16 buffer[2000];
-        while (true) {
-            auto const bytes_read = TRY(reader.Read({(u8*)buffer, sizeof(buffer)}));
-            ASSERT((bytes_read % sizeof(u16)) == 0);
-            auto const sample_read = bytes_read / sizeof(u16);
-            drwav_s16_to_f32((f32*)result.interleaved_samples.data + sample_pos,
-                             (drwav_int16 const*)buffer,
-                             sample_read);
-            sample_pos += sample_read;
-            if (bytes_read != sizeof(buffer)) break;
+        // The file is already in our in-memory format.
+        auto const bytes_read = TRY(reader.Read(samples));
+        if (bytes_read != samples.size) {
+            allocator.Free(samples);
+            return ErrorCode {AudioFileError::FileHasInvalidData};
+        }
+        // The samples are usually the whole file, in which case we don't need to read it again.
+        if (samples.size == reader.size) {
+            result.hash = XXH3_64bits(samples.data, samples.size);
+        } else {
+            auto const hash = HashFileBytes(reader);
+            if (hash.HasError()) {
+                allocator.Free(samples);
+                return hash.Error();
+            }
+            result.hash = hash.Value();
         }
-        result.hash =
-            XXH3_64bits(result.interleaved_samples.data, result.interleaved_samples.ToByteSpan().size);
         return result;
     } else if (IsEqualToCaseInsensitiveAscii(file_extension, ".wav"_s)) {
         ZoneScopedN("wav");
@@ -295,6 +415,599 @@ ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, A
     return ErrorCode {AudioFileError::NotFlacOrWav};
 }
 
+// Streaming decode
+// ==========================================================================================================
+
+struct AudioFileStreamDecoder {
+    enum class Format { Flac, Wav, Raw16 };
+
+    Format format {};
+    Reader reader;
+    AudioFileInfo info {};
+    u32 frame_pos {};
+    Optional<ErrorCode> error_code {};
+
+    // FLAC decodes in blocks, we keep the remainder of the most recent block here
+    FLAC__StreamDecoder* flac {};
+    u32 flac_bits_per_sample {};
+    Optional<FLAC__StreamDecoderErrorStatus> flac_error {};
+    DynamicArray<f32> flac_pending {Malloc::Instance()};
+    usize flac_pending_pos {};
+
+    drwav wav {};
+    bool wav_initialised {};
+};
+
+static FLAC__StreamDecoderReadStatus
+StreamFlacRead(FLAC__StreamDecoder const*, FLAC__byte buffer[], usize* bytes, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    auto const requested_bytes = *bytes;
+    auto outcome = d.reader.Read({buffer, *bytes});
+    if (outcome.HasError()) {
+        d.error_code = outcome.Error();
+        return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+    }
+    *bytes = outcome.Value();
+    if (*bytes != requested_bytes) return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+    return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderSeekStatus
+StreamFlacSeek(FLAC__StreamDecoder const*, FLAC__uint64 absolute_byte_offset, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    if (absolute_byte_offset > d.reader.size) return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+    d.reader.pos = (usize)absolute_byte_offset;
+    return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+static FLAC__StreamDecoderTellStatus
+StreamFlacTell(FLAC__StreamDecoder const*, FLAC__uint64* absolute_byte_offset, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    *absolute_byte_offset = d.reader.pos;
+    return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+static FLAC__StreamDecoderLengthStatus
+StreamFlacLength(FLAC__StreamDecoder const*, FLAC__uint64* stream_length, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    *stream_length = d.reader.size;
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+static FLAC__bool StreamFlacEof(FLAC__StreamDecoder const*, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    return d.reader.pos == d.reader.size;
+}
+
+static FLAC__StreamDecoderWriteStatus StreamFlacWrite(FLAC__StreamDecoder const*,
+                                                      FLAC__Frame const* frame,
+                                                      FLAC__int32 const* const buffer[],
+                                                      void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+
+    if (frame->header.channels != d.info.channels) {
+        d.error_code = AudioFileError::NotMonoOrStereo;
+        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    }
+
+    u64 bits_per_sample = frame->header.bits_per_sample;
+    if (!bits_per_sample) bits_per_sample = d.flac_bits_per_sample;
+    if (!bits_per_sample) return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    auto const divisor = (f32)(1ull << (bits_per_sample - 1));
+
+    // We only get here when the previous block has been fully consumed.
+    ASSERT(d.flac_pending_pos == d.flac_pending.size);
+    dyn::Resize(d.flac_pending, frame->header.blocksize * frame->header.channels);
+    d.flac_pending_pos = 0;
+
+    for (unsigned int chan = 0; chan < frame->header.channels; ++chan)
+        for (unsigned int sample = 0; sample < frame->header.blocksize; ++sample)
+            d.flac_pending[chan + sample * frame->header.channels] = (f32)buffer[chan][sample] / divisor;
+
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void
+StreamFlacMetadata(FLAC__StreamDecoder const*, FLAC__StreamMetadata const* metadata, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) return;
+    auto const& info = metadata->data.stream_info;
+
+    if (info.channels == 0 || info.channels > 2) {
+        d.error_code = AudioFileError::NotMonoOrStereo;
+        return;
+    }
+
+    d.flac_bits_per_sample = info.bits_per_sample;
+    d.info = {
+        .hash = Hash(Span<u8 const> {info.md5sum, sizeof(info.md5sum)}),
+        .channels = CheckedCast<u8>(info.channels),
+        .sample_format = SampleFormatForIntBitDepth(info.bits_per_sample),
+        .sample_rate = (f32)info.sample_rate,
+        .num_frames = CheckedCast<u32>(info.total_samples),
+    };
+}
+
+static void
+StreamFlacError(FLAC__StreamDecoder const*, FLAC__StreamDecoderErrorStatus status, void* user_data) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    d.flac_error = status;
+}
+
+static ErrorCode FlacStreamError(AudioFileStreamDecoder const& d, char const* fallback_message) {
+    if (d.error_code) return *d.error_code;
+    if (d.flac_error)
+        return ErrorCode(AudioFileError::FileHasInvalidData,
+                         FLAC__StreamDecoderErrorStatusString[*d.flac_error]);
+    return ErrorCode(AudioFileError::FileHasInvalidData, fallback_message);
+}
+
+static usize StreamWavRead(void* user_data, void* buffer_out, size_t bytes_to_read) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    auto outcome = d.reader.Read({(u8*)buffer_out, bytes_to_read});
+    if (outcome.HasError()) {
+        d.error_code = outcome.Error();
+        return 0;
+    }
+    return outcome.Value();
+}
+
+static drwav_bool32 StreamWavSeek(void* user_data, int offset, drwav_seek_origin origin) {
+    auto& d = *(AudioFileStreamDecoder*)user_data;
+    switch (origin) {
+        case drwav_seek_origin_start: d.reader.pos = (usize)offset; break;
+        case drwav_seek_origin_current: d.reader.pos = (usize)((s64)d.reader.pos + offset); break;
+    }
+    return DRWAV_TRUE;
+}
+
+static ErrorCodeOr<void> InitStreamDecoder(AudioFileStreamDecoder& d, String filepath_for_id) {
+    auto const file_extension = path::Extension(filepath_for_id);
+    if (IsEqualToCaseInsensitiveAscii(file_extension, ".flac"_s)) {
+        d.format = AudioFileStreamDecoder::Format::Flac;
+        d.flac = FLAC__stream_decoder_new();
+        if (d.flac == nullptr) Panic("out of memory");
+        auto const init_status = FLAC__stream_decoder_init_stream(d.flac,
+                                                                  StreamFlacRead,
+                                                                  StreamFlacSeek,
+                                                                  StreamFlacTell,
+                                                                  StreamFlacLength,
+                                                                  StreamFlacEof,
+                                                                  StreamFlacWrite,
+                                                                  StreamFlacMetadata,
+                                                                  StreamFlacError,
+                                                                  &d);
+        if (init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+            return ErrorCode(AudioFileError::FileHasInvalidData,
+                             FLAC__StreamDecoderInitStatusString[init_status]);
+        if (!FLAC__stream_decoder_process_until_end_of_metadata(d.flac) || d.error_code || d.flac_error)
+            return FlacStreamError(d, "FLAC__stream_decoder_process_until_end_of_metadata");
+        if (!d.info.channels) return ErrorCode {AudioFileError::FileHasInvalidData};
+    } else if (file_extension == k_raw_16_bit_stereo_44100_format_ext) {
+        d.format = AudioFileStreamDecoder::Format::Raw16;
+        d.info = {
+            .hash = 0,
+            .channels = 2,
+            .sample_format = AudioSampleFormat::Int16,
+            .sample_rate = 44100,
+            .num_frames = (u32)(d.reader.size / (sizeof(u16) * 2)),
+        };
+    } else if (IsEqualToCaseInsensitiveAscii(file_extension, ".wav"_s)) {
+        d.format = AudioFileStreamDecoder::Format::Wav;
+        if (!drwav_init(&d.wav, StreamWavRead, StreamWavSeek, &d, nullptr)) {
+            if (d.error_code) return *d.error_code;
+            return ErrorCode {AudioFileError::FileHasInvalidData};
+        }
+        d.wav_initialised = true;
+        if (d.wav.channels == 0 || d.wav.channels > 2) return ErrorCode {AudioFileError::NotMonoOrStereo};
+        d.info = {
+            .hash = 0,
+            .channels = (u8)d.wav.channels,
+            .sample_format = SampleFormatForWav(d.wav),
+            .sample_rate = (f32)d.wav.sampleRate,
+            .num_frames = (u32)d.wav.totalPCMFrameCount,
+        };
+    } else {
+        return ErrorCode {AudioFileError::NotFlacOrWav};
+    }
+    return k_success;
+}
+
+ErrorCodeOr<AudioFileStreamDecoder*> CreateAudioFileStreamDecoder(Reader&& reader, String filepath_for_id) {
+    ZoneScoped;
+    auto decoder = Malloc::Instance().New<AudioFileStreamDecoder>(AudioFileStreamDecoder {
+        .reader = Move(reader),
+    });
+    auto const outcome = InitStreamDecoder(*decoder, filepath_for_id);
+    if (outcome.HasError()) {
+        DestroyAudioFileStreamDecoder(decoder);
+        return outcome.Error();
+    }
+    return decoder;
+}
+
+void DestroyAudioFileStreamDecoder(AudioFileStreamDecoder* decoder) {
+    if (!decoder) return;
+    if (decoder->flac) {
+        FLAC__stream_decoder_finish(decoder->flac);
+        FLAC__stream_decoder_delete(decoder->flac);
+    }
+    if (decoder->wav_initialised) drwav_uninit(&decoder->wav);
+    Malloc::Instance().Delete(decoder);
+}
+
+AudioFileInfo const& Info(AudioFileStreamDecoder const& decoder) { return decoder.info; }
+
+u32 CurrentFrame(AudioFileStreamDecoder const& decoder) { return decoder.frame_pos; }
+
+ErrorCodeOr<void> SeekToFrame(AudioFileStreamDecoder& d, u32 frame) {
+    ZoneScoped;
+    frame = Min(frame, d.info.num_frames);
+    if (frame == d.frame_pos) return k_success;
+
+    switch (d.format) {
+        case AudioFileStreamDecoder::Format::Flac: {
+            dyn::Clear(d.flac_pending);
+            d.flac_pending_pos = 0;
+            if (frame != d.info.num_frames) {
+                // libFLAC delivers the block containing the target frame to the write callback, already
+                // trimmed so that it starts at the target frame.
+                if (!FLAC__stream_decoder_seek_absolute(d.flac, frame)) {
+                    if (FLAC__stream_decoder_get_state(d.flac) == FLAC__STREAM_DECODER_SEEK_ERROR)
+                        FLAC__stream_decoder_flush(d.flac);
+                    d.frame_pos = LargestRepresentableValue<u32>();
+                    return FlacStreamError(d, "FLAC__stream_decoder_seek_absolute");
+                }
+            }
+            break;
+        }
+        case AudioFileStreamDecoder::Format::Wav: {
+            if (!drwav_seek_to_pcm_frame(&d.wav, frame)) {
+                d.frame_pos = LargestRepresentableValue<u32>();
+                if (d.error_code) return *d.error_code;
+                return ErrorCode {AudioFileError::FileHasInvalidData};
+            }
+            break;
+        }
+        case AudioFileStreamDecoder::Format::Raw16: {
+            d.reader.pos = (usize)frame * sizeof(u16) * 2;
+            break;
+        }
+    }
+
+    d.frame_pos = frame;
+    return k_success;
+}
+
+ErrorCodeOr<u32> ReadFrames(AudioFileStreamDecoder& d, Span<f32> interleaved_out) {
+    ZoneScoped;
+    ASSERT(d.frame_pos <= d.info.num_frames);
+    auto const channels = d.info.channels;
+    auto const frames_requested =
+        (u32)Min<usize>(interleaved_out.size / channels, d.info.num_frames - d.frame_pos);
+    u32 frames_read = 0;
+
+    switch (d.format) {
+        case AudioFileStreamDecoder::Format::Flac: {
+            while (frames_read != frames_requested) {
+                if (d.flac_pending_pos == d.flac_pending.size) {
+                    if (FLAC__stream_decoder_get_state(d.flac) == FLAC__STREAM_DECODER_END_OF_STREAM) break;
+                    if (!FLAC__stream_decoder_process_single(d.flac) || d.error_code)
+                        return FlacStreamError(d, "FLAC__stream_decoder_process_single");
+                    continue;
+                }
+                auto const samples_available = d.flac_pending.size - d.flac_pending_pos;
+                auto const samples_to_copy =
+                    Min(samples_available, (usize)(frames_requested - frames_read) * channels);
+                CopyMemory(interleaved_out.data + (usize)frames_read * channels,
+                           d.flac_pending.data + d.flac_pending_pos,
+                           samples_to_copy * sizeof(f32));
+                d.flac_pending_pos += samples_to_copy;
+                frames_read += (u32)(samples_to_copy / channels);
+            }
+            break;
+        }
+        case AudioFileStreamDecoder::Format::Wav: {
+            frames_read = (u32)drwav_read_pcm_frames_f32(&d.wav, frames_requested, interleaved_out.data);
+            if (frames_read != frames_requested && d.error_code) return *d.error_code;
+            break;
+        }
+        case AudioFileStreamDecoder::Format::Raw16: {
+            drwav_int16 buffer[2000];
+            while (frames_read != frames_requested) {
+                auto const bytes_wanted =
+                    Min(sizeof(buffer), (usize)(frames_requested - frames_read) * channels * sizeof(u16));
+                auto const bytes_read = TRY(d.reader.Read({(u8*)buffer, bytes_wanted}));
+                auto const samples_read = bytes_read / sizeof(u16);
+                drwav_s16_to_f32(interleaved_out.data + (usize)frames_read * channels, buffer, samples_read);
+                frames_read += (u32)(samples_read / channels);
+                if (bytes_read != bytes_wanted) break;
+            }
+            break;
+        }
+    }
+
+    d.frame_pos += frames_read;
+    return frames_read;
+}
+
+ErrorCodeOr<AudioData> DecodeAudioFileHead(Reader&& reader,
+                                           String filepath_for_id,
+                                           u32 max_resident_frames,
+                                           Allocator& allocator) {
+    ZoneScoped;
+    auto decoder = TRY(CreateAudioFileStreamDecoder(Move(reader), filepath_for_id));
+    DEFER { DestroyAudioFileStreamDecoder(decoder); };
+
+    auto const& info = Info(*decoder);
+    auto const num_resident_frames = Min(info.num_frames, max_resident_frames);
+    auto const num_samples = (usize)num_resident_frames * info.channels;
+
+    // The stream decoder gives us f32 so we convert to the storage format afterwards.
+    DynamicArray<f32> decoded {Malloc::Instance()};
+    dyn::Resize(decoded, num_samples);
+    auto const outcome = ReadFrames(*decoder, decoded.Items());
+    if (outcome.HasError()) return outcome.Error();
+    if (outcome.Value() != num_resident_frames) return ErrorCode {AudioFileError::FileHasInvalidData};
+
+    auto const samples =
+        allocator.AllocateExactSizeUninitialised<u8>(num_samples * BytesPerSample(info.sample_format));
+    StoreF32Samples(info.sample_format, decoded.Items(), samples.data);
+
+    // The same hash as DecodeAudioFile gives, even though we've only decoded the head.
+    auto hash = info.hash;
+    if (decoder->format != AudioFileStreamDecoder::Format::Flac) {
+        auto const outcome = HashFileBytes(decoder->reader);
+        if (outcome.HasError()) {
+            allocator.Free(samples);
+            return outcome.Error();
+        }
+        hash = outcome.Value();
+    }
+
+    return AudioData {
+        .hash = hash,
+        .channels = info.channels,
+        .sample_format = info.sample_format,
+        .sample_rate = info.sample_rate,
+        .num_frames = info.num_frames,
+        .interleaved_samples = samples,
+    };
+}
+
+ErrorCodeOr<AudioData> DecodeAudioFileParallel(Reader& reader,
+                                               String filepath_for_id,
+                                               ParallelDecodeOptions const& options,
+                                               Allocator& allocator) {
+    ZoneScoped;
+    ASSERT(options.min_frames_per_task);
+    if (options.max_tasks < 2 || !IsEqualToCaseInsensitiveAscii(path::Extension(filepath_for_id), ".flac"_s))
+        return DecodeAudioFile(reader, filepath_for_id, allocator);
+
+    // This decoder reads the stream info and then goes on to decode the first range.
+    auto first_decoder = TRY(CreateAudioFileStreamDecoder(TRY(options.create_reader()), filepath_for_id));
+    DEFER { DestroyAudioFileStreamDecoder(first_decoder); };
+    auto const info = Info(*first_decoder);
+
+    if (info.num_frames / options.min_frames_per_task < 2)
+        return DecodeAudioFile(reader, filepath_for_id, allocator);
+
+    // Ranges are a multiple of a common FLAC block size so that a block is rarely decoded by 2 ranges.
+    constexpr u32 k_range_alignment = 4096;
+    auto const max_tasks = Min(info.num_frames / options.min_frames_per_task, options.max_tasks);
+    auto const frames_per_task =
+        (u32)AlignForward((info.num_frames + max_tasks - 1) / max_tasks, k_range_alignment);
+    auto const num_tasks = (info.num_frames + frames_per_task - 1) / frames_per_task;
+
+    auto const bytes_per_frame = info.channels * BytesPerSample(info.sample_format);
+    auto const samples =
+        allocator.AllocateExactSizeUninitialised<u8>((usize)info.num_frames * bytes_per_frame);
+
+    auto const decode_range = [&](u32 task_index) -> ErrorCodeOr<void> {
+        ZoneScopedN("decode range");
+        auto const start_frame = task_index * frames_per_task;
+        auto const end_frame = Min(start_frame + frames_per_task, info.num_frames);
+
+        auto decoder = first_decoder;
+        if (task_index != 0)
+            decoder = TRY(CreateAudioFileStreamDecoder(TRY(options.create_reader()), filepath_for_id));
+        DEFER {
+            if (decoder != first_decoder) DestroyAudioFileStreamDecoder(decoder);
+        };
+
+        // The file could have changed since the first decoder opened it.
+        if (Info(*decoder).num_frames != info.num_frames || Info(*decoder).channels != info.channels)
+            return ErrorCode {AudioFileError::FileHasInvalidData};
+
+        TRY(SeekToFrame(*decoder, start_frame));
+
+        constexpr u32 k_chunk_frames = 16384;
+        DynamicArray<f32> buffer {Malloc::Instance()};
+        dyn::Resize(buffer, (usize)k_chunk_frames * info.channels);
+        for (auto frame = start_frame; frame != end_frame;) {
+            auto const chunk_frames = Min(k_chunk_frames, end_frame - frame);
+            auto const chunk = buffer.Items().SubSpan(0, (usize)chunk_frames * info.channels);
+            auto const frames_read = TRY(ReadFrames(*decoder, chunk));
+            if (frames_read != chunk_frames) return ErrorCode {AudioFileError::FileHasInvalidData};
+            StoreF32Samples(info.sample_format, chunk, samples.data + ((usize)frame * bytes_per_frame));
+            frame += frames_read;
+        }
+        return k_success;
+    };
+
+    DynamicArray<Optional<ErrorCode>> errors {Malloc::Instance()};
+    dyn::Resize(errors, num_tasks);
+    options.parallel_for(num_tasks, [&](u32 task_index) {
+        if (auto const o = decode_range(task_index); o.HasError()) errors[task_index] = o.Error();
+    });
+
+    for (auto const& e : errors) {
+        if (e) {
+            allocator.Free(samples);
+            return *e;
+        }
+    }
+
+    return AudioData {
+        .hash = info.hash,
+        .channels = info.channels,
+        .sample_format = info.sample_format,
+        .sample_rate = info.sample_rate,
+        .num_frames = info.num_frames,
+        .interleaved_samples = samples,
+    };
+}
+
+struct DecodedAudioCacheHeader {
+    static constexpr u32 k_magic = 0x43444c46; // "FLDC"
+    static constexpr u32 k_version = 2; // 2: WAV and raw hashes are of the file bytes
+
+    u32 magic;
+    u32 version;
+    u64 key;
+    u64 hash;
+    u64 num_sample_bytes;
+    f32 sample_rate;
+    u32 num_frames;
+    u8 channels;
+    AudioSampleFormat sample_format;
+    u8 padding[6];
+};
+static_assert(sizeof(DecodedAudioCacheHeader) == 48);
+
+static MutableString DecodedAudioCacheFilePath(Allocator& a, String cache_folder, u64 key) {
+    return path::Join(a, Array {cache_folder, (String)fmt::FormatInline<32>("{x}.decoded-audio", key)});
+}
+
+Optional<u64> DecodedAudioCacheKey(Reader& reader, String filepath_for_id) {
+    if (!reader.file) return k_nullopt;
+    auto const modified_time = TRY_OR(reader.file->LastModifiedTimeNsSinceEpoch(), return k_nullopt);
+
+    auto key = Hash(filepath_for_id);
+    HashUpdate(key, (u64)reader.size);
+    HashUpdate(key, (u64)reader.file_base_pos);
+    HashUpdate(key, (u64)modified_time);
+    HashUpdate(key, (u64)(modified_time >> 64));
+    HashUpdate(key, DecodedAudioCacheHeader::k_version);
+    return key;
+}
+
+ErrorCodeOr<AudioData> ReadDecodedAudioCache(String cache_folder, u64 key, Allocator& allocator) {
+    ZoneScoped;
+    PathArena arena {Malloc::Instance()};
+    auto const path = DecodedAudioCacheFilePath(arena, cache_folder, key);
+    auto file = TRY(OpenFile(path, FileMode::Read()));
+
+    DecodedAudioCacheHeader header;
+    if (TRY(file.Read(&header, sizeof(header))) != sizeof(header))
+        return ErrorCode {AudioFileError::FileHasInvalidData};
+    if (header.magic != DecodedAudioCacheHeader::k_magic ||
+        header.version != DecodedAudioCacheHeader::k_version || header.key != key ||
+        (header.channels != 1 && header.channels != 2) ||
+        header.num_sample_bytes !=
+            (u64)header.num_frames * header.channels * BytesPerSample(header.sample_format) ||
+        TRY(file.FileSize()) != sizeof(header) + header.num_sample_bytes)
+        return ErrorCode {AudioFileError::FileHasInvalidData};
+
+    auto const samples = allocator.AllocateExactSizeUninitialised<u8>(header.num_sample_bytes);
+    auto const num_read = TRY_OR(file.Read(samples.data, samples.size), {
+        allocator.Free(samples);
+        return error;
+    });
+    if (num_read != samples.size) {
+        allocator.Free(samples);
+        return ErrorCode {AudioFileError::FileHasInvalidData};
+    }
+
+    // The modified time is what PruneDecodedAudioCache uses to find the least-recently used files.
+    auto _ = SetLastModifiedTimeNsSinceEpoch(path, NanosecondsSinceEpoch());
+
+    return AudioData {
+        .hash = header.hash,
+        .channels = header.channels,
+        .sample_format = header.sample_format,
+        .sample_rate = header.sample_rate,
+        .num_frames = header.num_frames,
+        .interleaved_samples = samples,
+    };
+}
+
+ErrorCodeOr<void> WriteDecodedAudioCache(String cache_folder, u64 key, AudioData const& audio_data) {
+    ZoneScoped;
+    ASSERT(!audio_data.IsStreamed());
+    TRY(CreateDirectory(cache_folder, {.create_intermediate_directories = true}));
+
+    DecodedAudioCacheHeader const header {
+        .magic = DecodedAudioCacheHeader::k_magic,
+        .version = DecodedAudioCacheHeader::k_version,
+        .key = key,
+        .hash = audio_data.hash,
+        .num_sample_bytes = audio_data.interleaved_samples.size,
+        .sample_rate = audio_data.sample_rate,
+        .num_frames = audio_data.num_frames,
+        .channels = audio_data.channels,
+        .sample_format = audio_data.sample_format,
+        .padding = {},
+    };
+
+    // We write to a temporary file and then rename it so that no one can read a partially-written file.
+    PathArena arena {Malloc::Instance()};
+    auto seed = RandomSeed();
+    auto const temp_path =
+        path::Join(arena, Array {cache_folder, (String)UniqueFilename(".tmp-", ".decoded-audio", seed)});
+    auto const outcome = [&]() -> ErrorCodeOr<void> {
+        {
+            auto file = TRY(OpenFile(temp_path, FileMode::Write()));
+            TRY(file.Write(Span<u8 const> {(u8 const*)&header, sizeof(header)}));
+            TRY(file.Write(audio_data.interleaved_samples));
+        }
+        return Rename(temp_path, DecodedAudioCacheFilePath(arena, cache_folder, key));
+    }();
+    if (outcome.HasError())
+        auto _ = Delete(temp_path, {.type = DeleteOptions::Type::File, .fail_if_not_exists = false});
+    return outcome;
+}
+
+ErrorCodeOr<void> PruneDecodedAudioCache(String cache_folder, u64 max_bytes, ArenaAllocator& scratch_arena) {
+    ZoneScoped;
+    auto const entries = TRY_OR(FindEntriesInFolder(scratch_arena,
+                                                    cache_folder,
+                                                    {
+                                                        .options {
+                                                            .wildcard = "*.decoded-audio",
+                                                            .get_file_size = true,
+                                                            .get_modified_time = true,
+                                                        },
+                                                        .recursive = false,
+                                                        .only_file_type = FileType::File,
+                                                    }),
+                                {
+                                    if (error == FilesystemError::PathDoesNotExist) return k_success;
+                                    return error;
+                                });
+
+    u64 total_bytes = 0;
+    for (auto const& entry : entries)
+        total_bytes += entry.file_size;
+    if (total_bytes <= max_bytes) return k_success;
+
+    Sort(entries, [](dir_iterator::Entry const& a, dir_iterator::Entry const& b) {
+        return a.modified_time_ns_since_epoch < b.modified_time_ns_since_epoch;
+    });
+
+    for (auto const& entry : entries) {
+        if (total_bytes <= max_bytes) break;
+        auto const path = path::Join(scratch_arena, Array {cache_folder, (String)entry.subpath});
+        DEFER { scratch_arena.Free(path.ToByteSpan()); };
+        if (auto const o = Delete(path, {.type = DeleteOptions::Type::File, .fail_if_not_exists = false});
+            o.HasError())
+            continue;
+        total_bytes -= entry.file_size;
+    }
+
+    return k_success;
+}
+
 //=================================================
 //  _______        _
 // |__   __|      | |
@@ -309,22 +1022,29 @@ TEST_CASE(TestAudioFormats) {
     auto& a = tester.scratch_arena;
     auto const dir = String(path::Join(a, Array {TestFilesFolder(tester), "audio"}));
 
-    for (auto const name : Array {
-             "16bit-mono.flac"_s,
-             "16bit-stereo.flac"_s,
-             "20bit-mono.flac"_s,
-             "24bit-mono.wav"_s,
-             "24bit-stereo.wav"_s,
-             "raw-pcm-16bit-stereo-44100.r16"_s,
+    struct TestFile {
+        String name;
+        AudioSampleFormat expected_format;
+    };
+    for (auto const file : Array {
+             TestFile {"16bit-mono.flac"_s, AudioSampleFormat::Int16},
+             TestFile {"16bit-stereo.flac"_s, AudioSampleFormat::Int16},
+             TestFile {"20bit-mono.flac"_s, AudioSampleFormat::Int24},
+             TestFile {"24bit-mono.wav"_s, AudioSampleFormat::Int24},
+             TestFile {"24bit-stereo.wav"_s, AudioSampleFormat::Int24},
+             TestFile {"raw-pcm-16bit-stereo-44100.r16"_s, AudioSampleFormat::Int16},
          }) {
-        auto p = path::Join(a, Array {dir, name});
+        CAPTURE(file.name);
+        auto p = path::Join(a, Array {dir, file.name});
         auto reader = TRY(Reader::FromFile(p));
         auto audio = TRY(DecodeAudioFile(reader, p, a));
         CHECK(audio.channels);
         CHECK(audio.sample_rate != 0);
         CHECK(audio.num_frames != 0);
         CHECK(audio.interleaved_samples.size != 0);
-        CHECK(audio.interleaved_samples[20] >= -1 && audio.interleaved_samples[20] <= 1);
+        CHECK_EQ(audio.sample_format, file.expected_format);
+        CHECK_EQ(audio.NumResidentFrames(), audio.num_frames);
+        CHECK(SampleAsF32(audio, 20) >= -1 && SampleAsF32(audio, 20) <= 1);
     }
 
     for (auto const name : Array {
@@ -339,4 +1059,169 @@ TEST_CASE(TestAudioFormats) {
     return k_success;
 }
 
-TEST_REGISTRATION(RegisterAudioFileTests) { REGISTER_TEST(TestAudioFormats); }
+TEST_CASE(TestAudioStreamDecoding) {
+    auto& a = tester.scratch_arena;
+    auto const dir = String(path::Join(a, Array {TestFilesFolder(tester), "audio"}));
+
+    for (auto const name : Array {
+             "16bit-stereo.flac"_s,
+             "20bit-mono.flac"_s,
+             "24bit-stereo.wav"_s,
+             "raw-pcm-16bit-stereo-44100.r16"_s,
+         }) {
+        CAPTURE(name);
+        auto p = path::Join(a, Array {dir, name});
+        auto full_reader = TRY(Reader::FromFile(p));
+        auto const full = TRY(DecodeAudioFile(full_reader, p, a));
+        REQUIRE(full.num_frames > 64);
+
+        auto const head = TRY(DecodeAudioFileHead(TRY(Reader::FromFile(p)), p, 32, a));
+        CHECK_EQ(head.num_frames, full.num_frames);
+        CHECK_EQ(head.channels, full.channels);
+        CHECK_EQ(head.sample_format, full.sample_format);
+        CHECK_EQ(head.NumResidentFrames(), 32u);
+        CHECK_EQ(head.hash, full.hash);
+        CHECK(head.interleaved_samples == full.interleaved_samples.SubSpan(0, head.interleaved_samples.size));
+
+        auto const matches_full = [&](Span<f32 const> samples, u32 first_frame) {
+            for (auto const [i, s] : Enumerate(samples))
+                if (s != SampleAsF32(full, ((usize)first_frame * full.channels) + i)) return false;
+            return true;
+        };
+
+        auto decoder = TRY(CreateAudioFileStreamDecoder(TRY(Reader::FromFile(p)), p));
+        DEFER { DestroyAudioFileStreamDecoder(decoder); };
+
+        // read from the middle of the file
+        auto const start_frame = full.num_frames / 2;
+        TRY(SeekToFrame(*decoder, start_frame));
+        auto buffer = a.AllocateExactSizeUninitialised<f32>(40uz * full.channels);
+        CHECK_EQ(TRY(ReadFrames(*decoder, buffer)), 40u);
+        CHECK(matches_full(buffer, start_frame));
+        CHECK_EQ(CurrentFrame(*decoder), start_frame + 40);
+
+        // seek backwards, then read past the end
+        auto const near_end_frame = full.num_frames - 10;
+        TRY(SeekToFrame(*decoder, 4));
+        TRY(SeekToFrame(*decoder, near_end_frame));
+        CHECK_EQ(TRY(ReadFrames(*decoder, buffer)), 10u);
+        CHECK(matches_full(buffer.SubSpan(0, 10uz * full.channels), near_end_frame));
+        CHECK_EQ(TRY(ReadFrames(*decoder, buffer)), 0u);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestParallelAudioDecoding) {
+    auto& a = tester.scratch_arena;
+    auto const dir = String(path::Join(a, Array {TestFilesFolder(tester), "audio"}));
+
+    for (auto const name : Array {
+             "16bit-stereo.flac"_s,
+             "20bit-mono.flac"_s,
+             "24bit-stereo.wav"_s,
+         }) {
+        CAPTURE(name);
+        auto p = path::Join(a, Array {dir, name});
+        auto full_reader = TRY(Reader::FromFile(p));
+        auto const full = TRY(DecodeAudioFile(full_reader, p, a));
+
+        u32 num_tasks_run = 0;
+        auto reader = TRY(Reader::FromFile(p));
+        auto const parallel = TRY(DecodeAudioFileParallel(
+            reader,
+            p,
+            {
+                .create_reader = [&]() { return Reader::FromFile(p); },
+                // Run the ranges backwards to check they don't depend on each other.
+                .parallel_for =
+                    [&](u32 num_tasks, FunctionRef<void(u32)> task) {
+                        for (u32 i = num_tasks; i-- > 0;)
+                            task(i);
+                        num_tasks_run = num_tasks;
+                    },
+                .min_frames_per_task = Max(full.num_frames / 4, 1u),
+                .max_tasks = 4,
+            },
+            a));
+
+        if (path::Extension(p) == ".flac") CHECK(num_tasks_run != 0);
+        CHECK_EQ(parallel.hash, full.hash);
+        CHECK_EQ(parallel.channels, full.channels);
+        CHECK_EQ(parallel.sample_format, full.sample_format);
+        CHECK_EQ(parallel.num_frames, full.num_frames);
+        CHECK(parallel.interleaved_samples == full.interleaved_samples);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestDecodedAudioCache) {
+    auto& a = tester.scratch_arena;
+    auto const cache_folder = path::Join(a, Array {tests::TempFolder(tester), "decoded-audio-cache"});
+    auto const p = path::Join(a, Array {TestFilesFolder(tester), "audio", "24bit-stereo.wav"});
+
+    auto reader = TRY(Reader::FromFile(p));
+    auto const key = DecodedAudioCacheKey(reader, p);
+    REQUIRE(key.HasValue());
+    CHECK(DecodedAudioCacheKey(reader, "other-id") != key);
+    auto memory_reader = Reader::FromMemory(Span<u8 const> {});
+    CHECK(!DecodedAudioCacheKey(memory_reader, p).HasValue());
+
+    auto const not_cached = ReadDecodedAudioCache(cache_folder, *key, a);
+    REQUIRE(not_cached.HasError());
+    CHECK(not_cached.Error() == FilesystemError::PathDoesNotExist);
+
+    auto const decoded = TRY(DecodeAudioFile(reader, p, a));
+    TRY(WriteDecodedAudioCache(cache_folder, *key, decoded));
+
+    auto const cached = TRY(ReadDecodedAudioCache(cache_folder, *key, a));
+    CHECK_EQ(cached.hash, decoded.hash);
+    CHECK_EQ(cached.channels, decoded.channels);
+    CHECK_EQ(cached.sample_format, decoded.sample_format);
+    CHECK_EQ(cached.sample_rate, decoded.sample_rate);
+    CHECK_EQ(cached.num_frames, decoded.num_frames);
+    CHECK(cached.interleaved_samples == decoded.interleaved_samples);
+
+    SUBCASE("pruning removes the least-recently used files") {
+        auto const keys = Array {*key, *key + 1, *key + 2, *key + 3};
+        auto const file_size = sizeof(DecodedAudioCacheHeader) + decoded.interleaved_samples.size;
+        auto const is_cached = [&](u64 k) {
+            return GetFileType(DecodedAudioCacheFilePath(a, cache_folder, k)).HasValue();
+        };
+
+        // Oldest first.
+        s128 time = NanosecondsSinceEpoch() - 1'000'000'000'000;
+        for (auto const k : keys) {
+            TRY(WriteDecodedAudioCache(cache_folder, k, decoded));
+            TRY(SetLastModifiedTimeNsSinceEpoch(DecodedAudioCacheFilePath(a, cache_folder, k), time));
+            time += 1'000'000'000;
+        }
+
+        // Reading marks it as recently used, so now keys[0] and keys[2] are the oldest.
+        TRY(ReadDecodedAudioCache(cache_folder, keys[1], a));
+
+        TRY(PruneDecodedAudioCache(cache_folder, file_size * keys.size, a));
+        for (auto const k : keys)
+            CHECK(is_cached(k));
+
+        TRY(PruneDecodedAudioCache(cache_folder, file_size * 2, a));
+        CHECK(!is_cached(keys[0]));
+        CHECK(is_cached(keys[1]));
+        CHECK(!is_cached(keys[2]));
+        CHECK(is_cached(keys[3]));
+
+        TRY(PruneDecodedAudioCache(cache_folder, 0, a));
+        for (auto const k : keys)
+            CHECK(!is_cached(k));
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterAudioFileTests) {
+    REGISTER_TEST(TestAudioFormats);
+    REGISTER_TEST(TestAudioStreamDecoding);
+    REGISTER_TEST(TestParallelAudioDecoding);
+    REGISTER_TEST(TestDecodedAudioCache);
+}
@@ -19,3 +19,85 @@ inline ErrorCodeCategory const& ErrorCategoryForEnum(AudioFileError) { return au
 
 // reader is used to get the file data, not the path argument
 ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, Allocator& allocator);
+
+// Streaming decode
+// ==========================================================================================================
+// Decodes a file incrementally from any frame position rather than all at once. Used for disk-streaming
+// where only the start of a file is kept in memory.
+
+struct AudioFileStreamDecoder;
+
+struct AudioFileInfo {
+    u64 hash {};
+    u8 channels {};
+    AudioSampleFormat sample_format {}; // the format DecodeAudioFile would store the samples in
+    f32 sample_rate {};
+    u32 num_frames {};
+};
+
+// The decoder takes ownership of the reader. A decoder must only be used by one thread at a time.
+ErrorCodeOr<AudioFileStreamDecoder*> CreateAudioFileStreamDecoder(Reader&& reader, String filepath_for_id);
+void DestroyAudioFileStreamDecoder(AudioFileStreamDecoder* decoder);
+
+AudioFileInfo const& Info(AudioFileStreamDecoder const& decoder);
+u32 CurrentFrame(AudioFileStreamDecoder const& decoder);
+ErrorCodeOr<void> SeekToFrame(AudioFileStreamDecoder& decoder, u32 frame);
+
+// Reads interleaved f32 frames from the current position. Returns the number of frames read, which is
+// fewer than requested only at the end of the file.
+ErrorCodeOr<u32> ReadFrames(AudioFileStreamDecoder& decoder, Span<f32> interleaved_out);
+
+// Decodes at most max_resident_frames from the start of the file. num_frames of the result is the length
+// of the whole file so there can be fewer than num_frames resident frames.
+ErrorCodeOr<AudioData> DecodeAudioFileHead(Reader&& reader,
+                                           String filepath_for_id,
+                                           u32 max_resident_frames,
+                                           Allocator& allocator);
+
+// Parallel decode
+// ==========================================================================================================
+// Large FLAC files take seconds to decode on one thread. Instead, we split them into ranges of frames and
+// decode each range with its own reader and decoder, all writing into the same result buffer. The result is
+// identical to DecodeAudioFile.
+//
+// The result is only returned once every range is decoded; frames aren't made available as they're decoded.
+// That would need a partially-resident state that every user of a non-streamed AudioData checks. For
+// starting playback before a long file is decoded, use disk streaming (DecodeAudioFileHead): its resident
+// head is available straight away.
+
+struct ParallelDecodeOptions {
+    // Creates an independent reader of the same file. Called from whichever threads run the ranges.
+    FunctionRef<ErrorCodeOr<Reader>()> create_reader;
+
+    // Must call task(i) for every i in [0, num_tasks) and return once they've all completed, e.g.
+    // ThreadPool::ParallelFor.
+    FunctionRef<void(u32 num_tasks, FunctionRef<void(u32 task_index)> task)> parallel_for;
+
+    // Files with fewer frames than this (and all non-FLAC files) are decoded with DecodeAudioFile.
+    u32 min_frames_per_task;
+    u32 max_tasks;
+};
+
+ErrorCodeOr<AudioData> DecodeAudioFileParallel(Reader& reader,
+                                               String filepath_for_id,
+                                               ParallelDecodeOptions const& options,
+                                               Allocator& allocator);
+
+// Decoded audio cache
+// ==========================================================================================================
+// A folder of already-decoded audio so that loading a file again only needs to read it rather than decode
+// it. Each cache file is a small header followed by the samples in the AudioData's sample_format.
+
+// Identifies the exact file that the reader reads from; the key changes if the file is modified. Returns
+// k_nullopt for in-memory readers: they're not worth caching.
+Optional<u64> DecodedAudioCacheKey(Reader& reader, String filepath_for_id);
+
+// Returns FilesystemError::PathDoesNotExist if the key isn't in the cache. Marks the cache file as recently
+// used by updating its modified time.
+ErrorCodeOr<AudioData> ReadDecodedAudioCache(String cache_folder, u64 key, Allocator& allocator);
+
+// Creates cache_folder if needed. Safe to call from multiple threads/processes at the same time.
+ErrorCodeOr<void> WriteDecodedAudioCache(String cache_folder, u64 key, AudioData const& audio_data);
+
+// Deletes the least-recently used cache files until the folder's cache files total max_bytes or less.
+ErrorCodeOr<void> PruneDecodedAudioCache(String cache_folder, u64 max_bytes, ArenaAllocator& scratch_arena);
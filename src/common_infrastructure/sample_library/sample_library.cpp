@@ -52,6 +52,49 @@ LibraryPtrOrError Read(Reader& reader,
     PanicIfReached();
 }
 
+RegionLookupTable BuildRegionLookupTable(Instrument const& inst, Allocator& arena) {
+    RegionLookupTable result {};
+    for (auto const event_index : ::Range(ToInt(TriggerEvent::Count))) {
+        auto& regions_by_key = result.regions_by_key[event_index];
+        auto const region_matches = [&](u32 region_index, u8 key) {
+            auto const& trigger = inst.regions[region_index].trigger;
+            return ToInt(trigger.trigger_event) == event_index && trigger.key_range.Contains(key);
+        };
+
+        for (auto const key : ::Range<u8>(128)) {
+            u32 num_regions = 0;
+            for (auto const region_index : ::Range((u32)inst.regions.size))
+                if (region_matches(region_index, key)) ++num_regions;
+            if (!num_regions) continue;
+
+            // If the previous key has the same number of regions and they all match this key too, then it's
+            // the same set of regions.
+            if (key != 0) {
+                auto const prev = regions_by_key[key - 1];
+                if (prev.size == num_regions) {
+                    bool same = true;
+                    for (auto const region_index : prev)
+                        if (!region_matches(region_index, key)) {
+                            same = false;
+                            break;
+                        }
+                    if (same) {
+                        regions_by_key[key] = prev;
+                        continue;
+                    }
+                }
+            }
+
+            auto indices = arena.AllocateExactSizeUninitialised<u32>(num_regions);
+            usize pos = 0;
+            for (auto const region_index : ::Range((u32)inst.regions.size))
+                if (region_matches(region_index, key)) indices[pos++] = region_index;
+            regions_by_key[key] = indices;
+        }
+    }
+    return result;
+}
+
 namespace detail {
 
 void PostReadBookkeeping(Library& lib, Allocator& arena) {
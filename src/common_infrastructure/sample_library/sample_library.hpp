@@ -117,11 +117,26 @@ struct Instrument {
     u32 max_rr_pos {};
 };
 
+// For each trigger event and MIDI key, the indices of the regions whose key range contains that key, in
+// region order. This means finding the regions for a note doesn't need to look at every region.
+struct RegionLookupTable {
+    Span<u32 const> RegionsForKey(TriggerEvent event, u8 key) const {
+        ASSERT_HOT(key < 128);
+        return regions_by_key[ToInt(event)][key];
+    }
+
+    // Neighbouring keys that have the same set of regions share the same span.
+    Array<Array<Span<u32 const>, 128>, ToInt(TriggerEvent::Count)> regions_by_key {};
+};
+
+RegionLookupTable BuildRegionLookupTable(Instrument const& inst, Allocator& arena);
+
 // An instrument that has all its audio data loaded into memory.
 struct LoadedInstrument {
     Instrument const& instrument;
     Span<AudioData const*> audio_datas {}; // parallel to instrument.regions
     AudioData const* file_for_gui_waveform {};
+    RegionLookupTable region_lookup {};
 };
 
 struct ImpulseResponse {
@@ -308,6 +323,26 @@ LibraryPtrOrError Read(Reader& reader,
 ErrorCodeOr<void> WriteDocumentedLuaExample(Writer writer, bool include_comments = true);
 bool CheckAllReferencedFilesExist(Library const& lib, Writer error_writer);
 
+// Library cache
+// ==========================================================================================================
+// A folder of libraries that have already been read from Lua files, so that reading an unchanged library
+// again doesn't need to run its Lua. Each cache file is a small header followed by the library in a compact
+// binary form. Lua only.
+
+// Identifies the Lua file and its content; file_hash is from LuaHash.
+u64 LibraryCacheKey(String lua_filepath, u64 file_hash);
+
+// Returns FilesystemError::PathDoesNotExist if the key isn't in the cache.
+ErrorCodeOr<Library*>
+ReadLibraryCache(String cache_folder, u64 key, ArenaAllocator& result_arena, ArenaAllocator& scratch_arena);
+
+// Creates cache_folder if needed. Safe to call from multiple threads/processes at the same time.
+ErrorCodeOr<void> WriteLibraryCache(String cache_folder, u64 key, Library const& lib);
+
+// Deletes every cache file whose key isn't in keys_in_use.
+ErrorCodeOr<void>
+PruneLibraryCache(String cache_folder, Span<u64 const> keys_in_use, ArenaAllocator& scratch_arena);
+
 } // namespace sample_lib
 
 ErrorCodeOr<void> CustomValueToString(Writer writer, sample_lib::LibraryIdRef id, fmt::FormatOptions options);
@@ -13,6 +13,7 @@
 #include "os/misc.hpp"
 #include "tests/framework.hpp"
 
+#include "common_infrastructure/common_errors.hpp"
 #include "common_infrastructure/constants.hpp"
 
 #include "sample_library.hpp"
@@ -1537,6 +1538,12 @@ LibraryPtrOrError ReadLua(Reader& reader,
             luaL_requiref(ctx.lua, lib.name, lib.func, 1);
             lua_pop(ctx.lua, 1);
         }
+        // The base library can read other files. A library must only depend on its own Lua file: that's all
+        // that the library cache key covers.
+        for (auto const name : Array {"dofile", "loadfile"}) {
+            lua_pushnil(ctx.lua);
+            lua_setglobal(ctx.lua, name);
+        }
         TRY(OpenFloeLuaLibrary(ctx));
 
         // Set up the traceback function as the error handler
@@ -1965,6 +1972,380 @@ bool CheckAllReferencedFilesExist(Library const& lib, Writer error_writer) {
     return success;
 }
 
+struct LibraryCacheHeader {
+    static constexpr u32 k_magic = 0x434c4c46; // "FLLC"
+    static constexpr u32 k_version = 1;
+
+    u32 magic;
+    u32 version;
+    u64 key;
+    u64 file_hash;
+    u64 body_hash;
+    u64 body_size;
+};
+
+static MutableString LibraryCacheFilePath(Allocator& a, String cache_folder, u64 key) {
+    return path::Join(a, Array {cache_folder, (String)fmt::FormatInline<32>("{x}.library", key)});
+}
+
+u64 LibraryCacheKey(String lua_filepath, u64 file_hash) {
+    auto key = Hash(lua_filepath);
+    HashUpdate(key, file_hash);
+    HashUpdate(key, LibraryCacheHeader::k_version);
+    // The Lua API can change between versions, so the same file might not give the same library.
+    HashUpdate(key, String {FLOE_VERSION_STRING});
+    return key;
+}
+
+struct LibraryCacheWriter {
+    template <TriviallyCopyable Type>
+    void Write(Type const& value) {
+        dyn::AppendSpan(out, Span<u8 const> {(u8 const*)&value, sizeof(Type)});
+    }
+    void WriteString(String str) {
+        Write((u32)str.size);
+        dyn::AppendSpan(out, str.ToConstByteSpan());
+    }
+    void WriteOptionalString(Optional<String> const& str) {
+        Write((u8)str.HasValue());
+        if (str) WriteString(*str);
+    }
+    void WriteTags(Span<String const> tags) {
+        Write((u32)tags.size);
+        for (auto const& tag : tags)
+            WriteString(tag);
+    }
+
+    DynamicArray<u8>& out;
+};
+
+// Rather than checking every read, we set failed and return zeroed values; the caller checks failed before
+// using the result.
+struct LibraryCacheReader {
+    template <TriviallyCopyable Type>
+    Type Read() {
+        Type value {};
+        if (failed || sizeof(Type) > data.size - cursor) {
+            failed = true;
+            return value;
+        }
+        CopyMemory(&value, data.data + cursor, sizeof(Type));
+        cursor += sizeof(Type);
+        return value;
+    }
+    bool ReadBool() { return Read<u8>() != 0; }
+    // Counts are bounded by the remaining data so that bad data can't cause huge allocations.
+    u32 ReadCount() {
+        auto const count = Read<u32>();
+        if (count > data.size - cursor) failed = true;
+        return failed ? 0 : count;
+    }
+    String ReadString() {
+        auto const size = ReadCount();
+        if (failed) return {};
+        String const result {(char const*)data.data + cursor, size};
+        cursor += size;
+        return arena.Clone(result);
+    }
+    Optional<String> ReadOptionalString() {
+        if (!ReadBool()) return k_nullopt;
+        return ReadString();
+    }
+    Span<String> ReadTags() {
+        auto tags = arena.AllocateExactSizeUninitialised<String>(ReadCount());
+        for (auto& tag : tags)
+            tag = ReadString();
+        return tags;
+    }
+
+    Span<u8 const> data;
+    ArenaAllocator& arena;
+    usize cursor {};
+    bool failed {};
+};
+
+static void WriteLibraryCacheBody(LibraryCacheWriter& w, Library const& lib) {
+    w.WriteString(lib.path);
+    w.WriteString(lib.name);
+    w.WriteString(lib.tagline);
+    w.WriteOptionalString(lib.library_url);
+    w.WriteOptionalString(lib.description);
+    w.WriteString(lib.author);
+    w.WriteOptionalString(lib.author_url);
+    w.Write(lib.minor_version);
+    w.WriteOptionalString(lib.background_image_path.Transform([](LibraryPath p) { return p.str; }));
+    w.WriteOptionalString(lib.icon_image_path.Transform([](LibraryPath p) { return p.str; }));
+    w.Write(lib.num_instrument_samples);
+    w.Write(lib.num_regions);
+
+    w.Write((u32)lib.sorted_instruments.size);
+    for (auto const inst : lib.sorted_instruments) {
+        w.WriteString(inst->name);
+        w.WriteOptionalString(inst->folder);
+        w.WriteOptionalString(inst->description);
+        w.WriteTags(inst->tags);
+        w.WriteString(inst->audio_file_path_for_waveform.str);
+        w.Write(inst->max_rr_pos);
+
+        w.Write((u32)inst->regions.size);
+        for (auto const& region : inst->regions) {
+            w.WriteString(region.path.str);
+            w.Write(region.root_key);
+
+            w.Write((u8)region.loop.builtin_loop.HasValue());
+            if (auto const& l = region.loop.builtin_loop) {
+                w.Write(l->start_frame);
+                w.Write(l->end_frame);
+                w.Write(l->crossfade_frames);
+                w.Write((u8)l->mode);
+                w.Write((u8)l->lock_loop_points);
+                w.Write((u8)l->lock_mode);
+            }
+            w.Write((u8)region.loop.never_loop);
+            w.Write((u8)region.loop.always_loop);
+
+            auto const& trigger = region.trigger;
+            w.Write((u8)trigger.trigger_event);
+            w.Write(trigger.key_range);
+            w.Write(trigger.velocity_range);
+            w.Write((u8)trigger.round_robin_index.HasValue());
+            if (trigger.round_robin_index) w.Write(*trigger.round_robin_index);
+            w.Write((u8)trigger.feather_overlapping_velocity_layers);
+            w.WriteOptionalString(trigger.auto_map_key_range_group);
+
+            w.Write(region.audio_props.gain_db);
+
+            w.Write((u8)region.timbre_layering.layer_range.HasValue());
+            if (auto const& r = region.timbre_layering.layer_range) w.Write(*r);
+        }
+    }
+
+    w.Write((u32)lib.sorted_irs.size);
+    for (auto const ir : lib.sorted_irs) {
+        w.WriteString(ir->name);
+        w.WriteString(ir->path.str);
+        w.WriteOptionalString(ir->folder);
+        w.WriteTags(ir->tags);
+        w.WriteOptionalString(ir->description);
+    }
+
+    w.Write((u32)lib.files_requiring_attribution.size);
+    for (auto const [path, attribution] : lib.files_requiring_attribution) {
+        w.WriteString(path.str);
+        w.WriteString(attribution->title);
+        w.WriteString(attribution->license_name);
+        w.WriteString(attribution->license_url);
+        w.WriteString(attribution->attributed_to);
+        w.WriteOptionalString(attribution->attribution_url);
+    }
+}
+
+static Library* ReadLibraryCacheBody(LibraryCacheReader& r) {
+    auto& arena = r.arena;
+
+    auto lib = arena.NewUninitialised<Library>();
+    PLACEMENT_NEW(lib)
+    Library {
+        .create_file_reader = CreateLuaFileReader,
+        .file_format_specifics = LuaSpecifics {},
+    };
+    lib->path = r.ReadString();
+    lib->name = r.ReadString();
+    lib->tagline = r.ReadString();
+    lib->library_url = r.ReadOptionalString();
+    lib->description = r.ReadOptionalString();
+    lib->author = r.ReadString();
+    lib->author_url = r.ReadOptionalString();
+    lib->minor_version = r.Read<u32>();
+    if (auto const p = r.ReadOptionalString()) lib->background_image_path = LibraryPath {*p};
+    if (auto const p = r.ReadOptionalString()) lib->icon_image_path = LibraryPath {*p};
+    lib->num_instrument_samples = r.Read<u32>();
+    lib->num_regions = r.Read<u32>();
+
+    for (auto _ : ::Range(r.ReadCount())) {
+        if (r.failed) return nullptr;
+        auto inst = arena.NewUninitialised<Instrument>();
+        PLACEMENT_NEW(inst)
+        Instrument {
+            .library = *lib,
+        };
+        inst->name = r.ReadString();
+        inst->folder = r.ReadOptionalString();
+        inst->description = r.ReadOptionalString();
+        inst->tags = r.ReadTags();
+        inst->audio_file_path_for_waveform = {r.ReadString()};
+        inst->max_rr_pos = r.Read<u32>();
+
+        inst->regions = arena.AllocateExactSizeUninitialised<Region>(r.ReadCount());
+        inst->regions_allocated_capacity = inst->regions.size;
+        for (auto& region : inst->regions) {
+            PLACEMENT_NEW(&region) Region {};
+            region.path = {r.ReadString()};
+            region.root_key = r.Read<u8>();
+
+            if (r.ReadBool()) {
+                BuiltinLoop loop {};
+                loop.start_frame = r.Read<s64>();
+                loop.end_frame = r.Read<s64>();
+                loop.crossfade_frames = r.Read<u32>();
+                auto const mode = r.Read<u8>();
+                if (mode >= ToInt(LoopMode::Count)) r.failed = true;
+                loop.mode = (LoopMode)mode;
+                loop.lock_loop_points = r.ReadBool();
+                loop.lock_mode = r.ReadBool();
+                region.loop.builtin_loop = loop;
+            }
+            region.loop.never_loop = r.ReadBool();
+            region.loop.always_loop = r.ReadBool();
+
+            auto& trigger = region.trigger;
+            auto const trigger_event = r.Read<u8>();
+            if (trigger_event >= ToInt(TriggerEvent::Count)) r.failed = true;
+            trigger.trigger_event = (TriggerEvent)trigger_event;
+            trigger.key_range = r.Read<Range>();
+            trigger.velocity_range = r.Read<Range>();
+            if (r.ReadBool()) trigger.round_robin_index = r.Read<u32>();
+            trigger.feather_overlapping_velocity_layers = r.ReadBool();
+            trigger.auto_map_key_range_group = r.ReadOptionalString();
+
+            region.audio_props.gain_db = r.Read<f32>();
+
+            if (r.ReadBool()) region.timbre_layering.layer_range = r.Read<Range>();
+        }
+
+        if (r.failed) return nullptr;
+        if (!lib->insts_by_name.InsertGrowIfNeeded(arena, inst->name, inst)) return nullptr;
+    }
+
+    for (auto _ : ::Range(r.ReadCount())) {
+        if (r.failed) return nullptr;
+        auto ir = arena.NewUninitialised<ImpulseResponse>();
+        PLACEMENT_NEW(ir)
+        ImpulseResponse {
+            .library = *lib,
+        };
+        ir->name = r.ReadString();
+        ir->path = {r.ReadString()};
+        ir->folder = r.ReadOptionalString();
+        ir->tags = r.ReadTags();
+        ir->description = r.ReadOptionalString();
+
+        if (r.failed) return nullptr;
+        if (!lib->irs_by_name.InsertGrowIfNeeded(arena, ir->name, ir)) return nullptr;
+    }
+
+    for (auto _ : ::Range(r.ReadCount())) {
+        LibraryPath const path {r.ReadString()};
+        FileAttribution attribution {};
+        attribution.title = r.ReadString();
+        attribution.license_name = r.ReadString();
+        attribution.license_url = r.ReadString();
+        attribution.attributed_to = r.ReadString();
+        attribution.attribution_url = r.ReadOptionalString();
+
+        if (r.failed) return nullptr;
+        lib->files_requiring_attribution.InsertGrowIfNeeded(arena, path, attribution);
+    }
+
+    if (r.failed || r.cursor != r.data.size) return nullptr;
+
+    detail::PostReadBookkeeping(*lib, arena);
+
+    return lib;
+}
+
+ErrorCodeOr<Library*>
+ReadLibraryCache(String cache_folder, u64 key, ArenaAllocator& result_arena, ArenaAllocator& scratch_arena) {
+    auto const file_data =
+        TRY(ReadEntireFile(LibraryCacheFilePath(scratch_arena, cache_folder, key), scratch_arena))
+            .ToConstByteSpan();
+
+    LibraryCacheHeader header;
+    if (file_data.size < sizeof(header)) return ErrorCode {CommonError::InvalidFileFormat};
+    CopyMemory(&header, file_data.data, sizeof(header));
+    auto const body = file_data.SubSpan(sizeof(header));
+    if (header.magic != LibraryCacheHeader::k_magic || header.version != LibraryCacheHeader::k_version ||
+        header.key != key || header.body_size != body.size ||
+        header.body_hash != XXH3_64bits(body.data, body.size))
+        return ErrorCode {CommonError::InvalidFileFormat};
+
+    // If the data is bad we throw away everything we allocated.
+    auto const cursor_before = result_arena.TotalUsed();
+    LibraryCacheReader reader {.data = body, .arena = result_arena};
+    auto const lib = ReadLibraryCacheBody(reader);
+    if (!lib) {
+        result_arena.TryShrinkTotalUsed(cursor_before);
+        return ErrorCode {CommonError::InvalidFileFormat};
+    }
+
+    lib->file_hash = header.file_hash;
+    return lib;
+}
+
+ErrorCodeOr<void> WriteLibraryCache(String cache_folder, u64 key, Library const& lib) {
+    ASSERT(lib.file_format_specifics.tag == FileFormat::Lua);
+    TRY(CreateDirectory(cache_folder, {.create_intermediate_directories = true}));
+
+    DynamicArray<u8> data {Malloc::Instance()};
+    dyn::Resize(data, sizeof(LibraryCacheHeader));
+    LibraryCacheWriter writer {data};
+    WriteLibraryCacheBody(writer, lib);
+
+    auto const body = data.Items().SubSpan(sizeof(LibraryCacheHeader));
+    LibraryCacheHeader const header {
+        .magic = LibraryCacheHeader::k_magic,
+        .version = LibraryCacheHeader::k_version,
+        .key = key,
+        .file_hash = lib.file_hash,
+        .body_hash = XXH3_64bits(body.data, body.size),
+        .body_size = body.size,
+    };
+    CopyMemory(data.data, &header, sizeof(header));
+
+    // We write to a temporary file and then rename it so that no one can read a partially-written file.
+    PathArena arena {Malloc::Instance()};
+    auto seed = RandomSeed();
+    auto const temp_path =
+        path::Join(arena, Array {cache_folder, (String)UniqueFilename(".tmp-", ".library", seed)});
+    auto const outcome = [&]() -> ErrorCodeOr<void> {
+        TRY(WriteFile(temp_path, data.Items()));
+        return Rename(temp_path, LibraryCacheFilePath(arena, cache_folder, key));
+    }();
+    if (outcome.HasError())
+        auto _ = Delete(temp_path, {.type = DeleteOptions::Type::File, .fail_if_not_exists = false});
+    return outcome;
+}
+
+ErrorCodeOr<void>
+PruneLibraryCache(String cache_folder, Span<u64 const> keys_in_use, ArenaAllocator& scratch_arena) {
+    ZoneScoped;
+    auto const entries = TRY_OR(FindEntriesInFolder(scratch_arena,
+                                                    cache_folder,
+                                                    {
+                                                        .options {
+                                                            .wildcard = "*.library",
+                                                        },
+                                                        .recursive = false,
+                                                        .only_file_type = FileType::File,
+                                                    }),
+                                {
+                                    if (error == FilesystemError::PathDoesNotExist) return k_success;
+                                    return error;
+                                });
+
+    auto const filenames_in_use = scratch_arena.AllocateExactSizeUninitialised<String>(keys_in_use.size);
+    for (auto const [i, key] : Enumerate(keys_in_use))
+        filenames_in_use[i] = fmt::Format(scratch_arena, "{x}.library", key);
+
+    for (auto const& entry : entries) {
+        if (Contains(filenames_in_use, (String)entry.subpath)) continue;
+        auto const path = path::Join(scratch_arena, Array {cache_folder, (String)entry.subpath});
+        auto _ = Delete(path, {.type = DeleteOptions::Type::File, .fail_if_not_exists = false});
+    }
+
+    return k_success;
+}
+
 TEST_CASE(TestWordWrap) {
     DynamicArray<char> buffer {tester.scratch_arena};
     TRY(WordWrap(
@@ -2139,6 +2520,74 @@ TEST_CASE(TestAutoMapKeyRange) {
     return k_success;
 }
 
+TEST_CASE(TestRegionLookupTable) {
+    auto& arena = tester.scratch_arena;
+    ArenaAllocator result_arena {PageAllocator::Instance()};
+    auto r = ReadLua(R"aaa(
+    local library = floe.new_library({
+        name = "Lib",
+        tagline = "tagline",
+        author = "Sam",
+        background_image_path = "",
+        icon_image_path = "",
+    })
+    local instrument = floe.new_instrument(library, {
+        name = "Inst1",
+    })
+    floe.add_region(instrument, {
+        path = "a",
+        root_key = 60,
+        trigger_criteria = { key_range = { 0, 64 } },
+    })
+    floe.add_region(instrument, {
+        path = "b",
+        root_key = 60,
+        trigger_criteria = { key_range = { 60, 128 }, velocity_range = { 0, 50 } },
+    })
+    floe.add_region(instrument, {
+        path = "c",
+        root_key = 60,
+        trigger_criteria = { key_range = { 60, 128 }, trigger_event = "note-off" },
+    })
+    return library
+    )aaa",
+                     FAKE_ABSOLUTE_PATH_PREFIX "test.lua",
+                     result_arena,
+                     arena);
+    if (auto err = r.TryGet<Error>()) tester.log.Error("Error: {}, {}", err->code, err->message);
+    REQUIRE(!r.Is<Error>());
+
+    auto library = r.Get<Library*>();
+    REQUIRE(library->insts_by_name.size);
+    auto inst = *(*library->insts_by_name.begin()).value_ptr;
+    REQUIRE(inst->regions.size == 3);
+
+    auto const table = BuildRegionLookupTable(*inst, arena);
+
+    // The table should match a linear search of all regions.
+    for (auto const event : Array {TriggerEvent::NoteOn, TriggerEvent::NoteOff}) {
+        for (auto const key : ::Range<u8>(128)) {
+            CAPTURE(key);
+            DynamicArray<u32> expected {arena};
+            for (auto const i : ::Range((u32)inst->regions.size)) {
+                auto const& trigger = inst->regions[i].trigger;
+                if (trigger.trigger_event == event && trigger.key_range.Contains(key))
+                    dyn::Append(expected, i);
+            }
+            CHECK(table.RegionsForKey(event, key) == expected);
+        }
+    }
+
+    CHECK_EQ(table.RegionsForKey(TriggerEvent::NoteOn, 62).size, 2u);
+    CHECK_EQ(table.RegionsForKey(TriggerEvent::NoteOff, 10).size, 0u);
+
+    // Neighbouring keys with the same regions share their storage.
+    CHECK(table.RegionsForKey(TriggerEvent::NoteOn, 0).data ==
+          table.RegionsForKey(TriggerEvent::NoteOn, 59).data);
+
+    return k_success;
+}
+
 TEST_CASE(TestBasicFile) {
     auto& arena = tester.scratch_arena;
     ArenaAllocator result_arena {PageAllocator::Instance()};
@@ -2337,6 +2786,139 @@ TEST_CASE(TestErrorHandling) {
         }
     }
 
+    SUBCASE("can't read other files") {
+        // Only times out if the functions are missing; any other outcome is a runtime error.
+        String const lua = R"aaa(
+        if dofile == nil and loadfile == nil then
+            while 1 == 1 do end
+        end
+        return {})aaa";
+        check(ErrorCode {LuaErrorCode::Timeout}, lua, {.max_seconds_allowed = 0.005});
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestLibraryCache) {
+    auto& scratch_arena = tester.scratch_arena;
+    auto const cache_folder = path::Join(scratch_arena, Array {tests::TempFolder(tester), "library-cache"});
+    auto const lua_filepath = FAKE_ABSOLUTE_PATH_PREFIX "doc.lua"_s;
+
+    // The documented example uses every field.
+    DynamicArray<char> buf {scratch_arena};
+    TRY(WriteDocumentedLuaExample(dyn::WriterFor(buf)));
+
+    ArenaAllocator result_arena {PageAllocator::Instance()};
+    auto o = ReadLua(buf, lua_filepath, result_arena, scratch_arena);
+    if (auto err = o.TryGet<Error>()) tester.log.Error("Error: {}, {}", err->code, err->message);
+    REQUIRE(o.Is<Library*>());
+    auto& lib = *o.Get<Library*>();
+    lib.file_hash = 1234;
+
+    auto const key = LibraryCacheKey(lua_filepath, lib.file_hash);
+    CHECK_NEQ(LibraryCacheKey(lua_filepath, lib.file_hash + 1), key);
+    CHECK_NEQ(LibraryCacheKey(FAKE_ABSOLUTE_PATH_PREFIX "other.lua"_s, lib.file_hash), key);
+
+    auto const not_cached = ReadLibraryCache(cache_folder, key, result_arena, scratch_arena);
+    REQUIRE(not_cached.HasError());
+    CHECK(not_cached.Error() == FilesystemError::PathDoesNotExist);
+
+    TRY(WriteLibraryCache(cache_folder, key, lib));
+
+    auto const& cached = *TRY(ReadLibraryCache(cache_folder, key, result_arena, scratch_arena));
+    CHECK_EQ(cached.path, lib.path);
+    CHECK_EQ(cached.name, lib.name);
+    CHECK_EQ(cached.tagline, lib.tagline);
+    CHECK(cached.library_url == lib.library_url);
+    CHECK(cached.description == lib.description);
+    CHECK_EQ(cached.author, lib.author);
+    CHECK(cached.author_url == lib.author_url);
+    CHECK_EQ(cached.minor_version, lib.minor_version);
+    CHECK(cached.background_image_path == lib.background_image_path);
+    CHECK(cached.icon_image_path == lib.icon_image_path);
+    CHECK_EQ(cached.num_instrument_samples, lib.num_instrument_samples);
+    CHECK_EQ(cached.num_regions, lib.num_regions);
+    CHECK_EQ(cached.file_hash, lib.file_hash);
+    CHECK(cached.create_file_reader == lib.create_file_reader);
+
+    REQUIRE_EQ(cached.sorted_instruments.size, lib.sorted_instruments.size);
+    for (auto const i : ::Range(lib.sorted_instruments.size)) {
+        auto const& a = *cached.sorted_instruments[i];
+        auto const& b = *lib.sorted_instruments[i];
+        CHECK(&a.library == &cached);
+        CHECK_EQ(a.name, b.name);
+        CHECK(a.folder == b.folder);
+        CHECK(a.description == b.description);
+        CHECK(a.tags == b.tags);
+        CHECK(a.audio_file_path_for_waveform == b.audio_file_path_for_waveform);
+        CHECK_EQ(a.max_rr_pos, b.max_rr_pos);
+        CHECK_EQ(a.uses_timbre_layering, b.uses_timbre_layering);
+        CHECK(a.loop_overview.all_loops_mode == b.loop_overview.all_loops_mode);
+        REQUIRE_EQ(a.regions.size, b.regions.size);
+        for (auto const r : ::Range(b.regions.size)) {
+            auto const& ra = a.regions[r];
+            auto const& rb = b.regions[r];
+            CHECK(ra.path == rb.path);
+            CHECK_EQ(ra.root_key, rb.root_key);
+            REQUIRE_EQ(ra.loop.builtin_loop.HasValue(), rb.loop.builtin_loop.HasValue());
+            if (rb.loop.builtin_loop) {
+                CHECK_EQ(ra.loop.builtin_loop->start_frame, rb.loop.builtin_loop->start_frame);
+                CHECK_EQ(ra.loop.builtin_loop->end_frame, rb.loop.builtin_loop->end_frame);
+                CHECK_EQ(ra.loop.builtin_loop->crossfade_frames, rb.loop.builtin_loop->crossfade_frames);
+                CHECK(ra.loop.builtin_loop->mode == rb.loop.builtin_loop->mode);
+            }
+            CHECK(ra.trigger.trigger_event == rb.trigger.trigger_event);
+            CHECK(ra.trigger.key_range == rb.trigger.key_range);
+            CHECK(ra.trigger.velocity_range == rb.trigger.velocity_range);
+            CHECK(ra.trigger.round_robin_index == rb.trigger.round_robin_index);
+            CHECK_EQ(ra.audio_props.gain_db, rb.audio_props.gain_db);
+            CHECK(ra.timbre_layering.layer_range == rb.timbre_layering.layer_range);
+        }
+    }
+
+    REQUIRE_EQ(cached.sorted_irs.size, lib.sorted_irs.size);
+    for (auto const i : ::Range(lib.sorted_irs.size)) {
+        CHECK_EQ(cached.sorted_irs[i]->name, lib.sorted_irs[i]->name);
+        CHECK(cached.sorted_irs[i]->path == lib.sorted_irs[i]->path);
+        CHECK(cached.sorted_irs[i]->tags == lib.sorted_irs[i]->tags);
+    }
+
+    CHECK_EQ(cached.files_requiring_attribution.size, lib.files_requiring_attribution.size);
+    for (auto const [path, attribution] : lib.files_requiring_attribution) {
+        auto const cached_attribution = cached.files_requiring_attribution.Find(path);
+        REQUIRE(cached_attribution);
+        CHECK_EQ(cached_attribution->title, attribution->title);
+        CHECK_EQ(cached_attribution->attributed_to, attribution->attributed_to);
+    }
+
+    // A different key isn't found, and a corrupted file is rejected.
+    CHECK(ReadLibraryCache(cache_folder, key + 1, result_arena, scratch_arena).HasError());
+    {
+        auto const cache_path = path::Join(scratch_arena,
+                                           Array {(String)cache_folder,
+                                                  (String)fmt::FormatInline<32>("{x}.library", key)});
+        auto data = TRY(ReadEntireFile(cache_path, scratch_arena));
+        data[data.size - 1] ^= 0xff;
+        TRY(WriteFile(cache_path, data));
+        auto const corrupted = ReadLibraryCache(cache_folder, key, result_arena, scratch_arena);
+        REQUIRE(corrupted.HasError());
+        CHECK(corrupted.Error() == CommonError::InvalidFileFormat);
+    }
+
+    SUBCASE("pruning removes entries that aren't in use") {
+        TRY(WriteLibraryCache(cache_folder, key, lib));
+        TRY(WriteLibraryCache(cache_folder, key + 1, lib));
+
+        TRY(PruneLibraryCache(cache_folder, Array {key}, scratch_arena));
+        CHECK(ReadLibraryCache(cache_folder, key, result_arena, scratch_arena).HasValue());
+        auto const pruned = ReadLibraryCache(cache_folder, key + 1, result_arena, scratch_arena);
+        REQUIRE(pruned.HasError());
+        CHECK(pruned.Error() == FilesystemError::PathDoesNotExist);
+
+        TRY(PruneLibraryCache(cache_folder, {}, scratch_arena));
+        CHECK(ReadLibraryCache(cache_folder, key, result_arena, scratch_arena).HasError());
+    }
+
     return k_success;
 }
 
@@ -2349,4 +2931,6 @@ TEST_REGISTRATION(RegisterLibraryLuaTests) {
     REGISTER_TEST(sample_lib::TestIncorrectParameters);
     REGISTER_TEST(sample_lib::TestErrorHandling);
     REGISTER_TEST(sample_lib::TestAutoMapKeyRange);
+    REGISTER_TEST(sample_lib::TestRegionLookupTable);
+    REGISTER_TEST(sample_lib::TestLibraryCache);
 }
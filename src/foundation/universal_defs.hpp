@@ -64,18 +64,19 @@ using s4 = signed _BitInt(4);
 //   f32x4 v = {1, 2}; // v = {1, 2, 0, 0}
 // - The generated assembly is dependent on the target architecture. If the target architecture doesn't
 //   support SIMD operations of the width you're using, it won't generate particularly fast code. For now, we
-//   are assuming that the target supports SIMD of at least 128 bits (four 32-bit lanes): SSE2 or NEON. If we
-//   want to make use of wider SIMD operations we'll need to, at runtime, determine what the running system
-//   supports, and based on that select the appropriate codepath that uses the intrinsics for that
-//   architecture. For example for supporting AVX2 on x86_64, we'd use the <immintrin.h> header. NOTE: we
-//   might consider using __builtin_cpu_supports to detect CPU features on x86_64.
+//   are assuming that the target supports SIMD of at least 128 bits (four 32-bit lanes): SSE2 or NEON. Wider
+//   SIMD (f32x8) is only used inside functions marked TARGET_AVX2_FMA, which are selected at runtime using
+//   CpuSupportsAvx2Fma(). See simd.hpp.
 // - Comparison operators work for floats/ints. They return a vector of signed integers where each element is
 //   ~0 (all 1 bits) if the comparison is true, else 0. See the All() and Any() helpers for getting a scalar
-//   bool from the vector.
+//   bool from the vector, and Select() for picking between two vectors per element.
 
 using f32x2 = __attribute__((ext_vector_type(2))) f32;
 using f32x4 = __attribute__((ext_vector_type(4))) f32;
+using f32x8 = __attribute__((ext_vector_type(8))) f32;
 using s32x2 = __attribute__((ext_vector_type(2))) s32;
+using s32x4 = __attribute__((ext_vector_type(4))) s32;
+using u32x4 = __attribute__((ext_vector_type(4))) u32;
 using u8x4 = __attribute__((ext_vector_type(4))) u8;
 
 // ==========================================================================================================
@@ -230,6 +231,14 @@ __attribute__((always_inline)) inline bool Any(VecType x) {
     return false;
 }
 
+// For each element, picks a if the mask element is ~0, else b. The mask is the result of a comparison.
+template <Vector VecType, Vector MaskType>
+__attribute__((always_inline)) inline VecType Select(MaskType mask, VecType a, VecType b) {
+    static_assert(sizeof(MaskType) == sizeof(VecType));
+    auto const bits = (mask & __builtin_bit_cast(MaskType, a)) | (~mask & __builtin_bit_cast(MaskType, b));
+    return __builtin_bit_cast(VecType, bits);
+}
+
 // Template helpers
 // ================================================================================================
 // This section contains code from SerenityOS's file: serenity/AK/StdLibExtraDetails.h
@@ -16,6 +16,7 @@
 #if !defined(__SSE2__)
 #error "SSE2 is our baseline requirement"
 #endif
+#include <cpuid.h>
 #include <emmintrin.h> // SSE2
 #elif defined(__aarch64__)
 #include <arm_neon.h>
@@ -115,17 +116,112 @@ DEFINE_BUILTIN_SIMD_MATHS_FUNC(Exp2, exp2)
 DEFINE_BUILTIN_SIMD_MATHS_FUNC(Round, round)
 DEFINE_BUILTIN_SIMD_MATHS_FUNC(Trunc, trunc)
 
-// IMPROVE: we could do wider SIMD with these. e.g. AVX2
+// Runtime CPU dispatch
+// ==========================================================================================================
+// SSE2 is our x86_64 baseline. Functions marked with TARGET_AVX2_FMA are compiled for AVX2 and FMA instead,
+// and anything ALWAYS_INLINE that they call is too. They must only be called when CpuSupportsAvx2Fma() is
+// true. Don't pass f32x8 by value between functions that have different targets: the calling convention
+// differs.
+
+#if defined(__x86_64__)
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+
+PUBLIC bool CpuSupportsAvx2Fma() {
+    static bool const result = []() {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+        constexpr unsigned int k_fma = 1 << 12;
+        constexpr unsigned int k_osxsave = 1 << 27;
+        constexpr unsigned int k_avx = 1 << 28;
+        if ((ecx & (k_fma | k_osxsave | k_avx)) != (k_fma | k_osxsave | k_avx)) return false;
+
+        // The OS must save the YMM registers on context switches.
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        if ((xcr0_lo & 0b110) != 0b110) return false;
+
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        constexpr unsigned int k_avx2 = 1 << 5;
+        return (ebx & k_avx2) != 0;
+    }();
+    return result;
+}
+#else
+#define TARGET_AVX2_FMA
+PUBLIC constexpr bool CpuSupportsAvx2Fma() { return false; }
+#endif
+
+// ==========================================================================================================
+
+namespace detail {
+
+PUBLIC ALWAYS_INLINE void SimdAddAlignedBufferX4(f32* d, f32 const* s, usize num) {
+    auto* dest = CheckedPointerCast<f32x4*>(d);
+    auto const* source = CheckedPointerCast<f32x4 const*>(s);
+    for (unsigned i = 0; i < num; i += NumVectorElements<f32x4>())
+        *dest++ += *source++;
+}
+
+PUBLIC ALWAYS_INLINE void
+SimdMultiplyStereoFramesByGainsX4(f32* interleaved, f32 const* gains, usize num_frames) {
+    usize frame = 0;
+    for (; frame + 2 <= num_frames; frame += 2) {
+        auto v = LoadUnalignedToType<f32x4>(interleaved + (frame * 2));
+        v *= f32x4 {gains[frame], gains[frame], gains[frame + 1], gains[frame + 1]};
+        StoreToUnaligned(interleaved + (frame * 2), v);
+    }
+    for (; frame != num_frames; ++frame) {
+        interleaved[(frame * 2) + 0] *= gains[frame];
+        interleaved[(frame * 2) + 1] *= gains[frame];
+    }
+}
+
+#if defined(__x86_64__)
+TARGET_AVX2_FMA inline void SimdAddAlignedBufferAvx2(f32* d, f32 const* s, usize num) {
+    // The buffers are only guaranteed to be 16-byte aligned.
+    usize i = 0;
+    for (; i + 8 <= num; i += 8)
+        StoreToUnaligned(d + i, LoadUnalignedToType<f32x8>(d + i) + LoadUnalignedToType<f32x8>(s + i));
+    if (i != num) SimdAddAlignedBufferX4(d + i, s + i, num - i);
+}
+
+TARGET_AVX2_FMA inline void
+SimdMultiplyStereoFramesByGainsAvx2(f32* interleaved, f32 const* gains, usize num_frames) {
+    usize frame = 0;
+    for (; frame + 4 <= num_frames; frame += 4) {
+        auto const g = LoadUnalignedToType<f32x4>(gains + frame);
+        auto const g_per_sample = __builtin_shufflevector(g, g, 0, 0, 1, 1, 2, 2, 3, 3);
+        auto v = LoadUnalignedToType<f32x8>(interleaved + (frame * 2));
+        v *= g_per_sample;
+        StoreToUnaligned(interleaved + (frame * 2), v);
+    }
+    if (frame != num_frames)
+        SimdMultiplyStereoFramesByGainsX4(interleaved + (frame * 2), gains + frame, num_frames - frame);
+}
+#endif
+
+} // namespace detail
+
 PUBLIC inline void SimdAddAlignedBuffer(f32* d, f32 const* s, usize num) {
     ASSERT_HOT(num != 0);
     ASSERT_HOT((usize)&d[0] % 16 == 0);
     ASSERT_HOT((usize)&s[0] % 16 == 0);
     ASSERT_HOT(!(d >= s && d < (s + num)));
 
-    auto* dest = CheckedPointerCast<f32x4*>(d);
-    auto const* source = CheckedPointerCast<f32x4 const*>(s);
-    for (unsigned i = 0; i < num; i += NumVectorElements<f32x4>())
-        *dest++ += *source++;
+#if defined(__x86_64__)
+    if (CpuSupportsAvx2Fma()) return detail::SimdAddAlignedBufferAvx2(d, s, num);
+#endif
+    detail::SimdAddAlignedBufferX4(d, s, num);
+}
+
+// Multiplies both channels of each interleaved stereo frame by the gain for that frame. No alignment
+// requirements.
+PUBLIC inline void SimdMultiplyStereoFramesByGains(f32* interleaved, f32 const* gains, usize num_frames) {
+#if defined(__x86_64__)
+    if (CpuSupportsAvx2Fma())
+        return detail::SimdMultiplyStereoFramesByGainsAvx2(interleaved, gains, num_frames);
+#endif
+    detail::SimdMultiplyStereoFramesByGainsX4(interleaved, gains, num_frames);
 }
 
 PUBLIC inline void SimdZeroAlignedBuffer(f32* d, usize num) {
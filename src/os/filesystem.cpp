@@ -156,6 +156,12 @@ MutableString FloeKnownDirectory(Allocator& a,
             subdirectories = k_dirs;
             break;
         }
+        case FloeKnownDirectoryType::Cache: {
+            known_dir_type = KnownDirectoryType::GlobalData;
+            static constexpr auto k_dirs = Array {"Floe"_s, "Cache"};
+            subdirectories = k_dirs;
+            break;
+        }
         case FloeKnownDirectoryType::MirageDefaultLibraries: {
             known_dir_type = KnownDirectoryType::MirageGlobalData;
             static constexpr auto k_dirs = Array {"FrozenPlain"_s, "Mirage", "Libraries"};
@@ -314,6 +314,7 @@ enum class FloeKnownDirectoryType : u8 {
     Libraries,
     Presets,
     Autosaves,
+    Cache,
     MirageDefaultLibraries,
     MirageDefaultPresets,
 };
@@ -443,11 +444,13 @@ struct Options {
         return {
             .wildcard = a.Clone(wildcard),
             .get_file_size = get_file_size,
+            .get_modified_time = get_modified_time,
             .skip_dot_files = skip_dot_files,
         };
     }
     String wildcard = "*";
     bool get_file_size = false;
+    bool get_modified_time = false;
     bool skip_dot_files = true;
 };
 
@@ -455,6 +458,7 @@ struct Entry {
     MutableString subpath; // path relative to the base iterator path
     FileType type;
     u64 file_size; // ONLY valid if options.get_file_size == true
+    s128 modified_time_ns_since_epoch; // ONLY valid if options.get_modified_time == true
 };
 
 struct Iterator {
@@ -47,6 +47,15 @@ ErrorCodeOr<FileType> GetFileType(String path) {
     return FileType::File;
 }
 
+static s128 ModifiedTimeNsSinceEpoch(struct stat const& info) {
+#if IS_LINUX
+    auto const modified_time = info.st_mtim;
+#elif IS_MACOS
+    auto const modified_time = info.st_mtimespec;
+#endif
+    return (s128)modified_time.tv_sec * (s128)1'000'000'000 + (s128)modified_time.tv_nsec;
+}
+
 namespace dir_iterator {
 
 ErrorCodeOr<Iterator> Create(ArenaAllocator& arena, String path, Options options) {
@@ -84,24 +93,23 @@ ErrorCodeOr<Optional<Entry>> Next(Iterator& it, ArenaAllocator& result_arena) {
                 Entry result {
                     .subpath = result_arena.Clone(entry_name),
                     .type = entry->d_type == DT_DIR ? FileType::Directory : FileType::File,
-                    .file_size = ({
-                        u64 s = 0;
-                        if (it.options.get_file_size) {
-                            PathArena temp_path_allocator {Malloc::Instance()};
-                            auto const full_path = fmt::Join(temp_path_allocator,
-                                                             Array {
-                                                                 it.base_path,
-                                                                 "/"_s,
-                                                                 entry_name,
-                                                                 "\0"_s,
-                                                             });
-                            struct stat info;
-                            if (stat(full_path.data, &info) != 0) return FilesystemErrnoErrorCode(errno);
-                            s = (u64)info.st_size;
-                        }
-                        s;
-                    }),
+                    .file_size = 0,
+                    .modified_time_ns_since_epoch = 0,
                 };
+                if (it.options.get_file_size || it.options.get_modified_time) {
+                    PathArena temp_path_allocator {Malloc::Instance()};
+                    auto const full_path = fmt::Join(temp_path_allocator,
+                                                     Array {
+                                                         it.base_path,
+                                                         "/"_s,
+                                                         entry_name,
+                                                         "\0"_s,
+                                                     });
+                    struct stat info;
+                    if (stat(full_path.data, &info) != 0) return FilesystemErrnoErrorCode(errno);
+                    result.file_size = (u64)info.st_size;
+                    result.modified_time_ns_since_epoch = ModifiedTimeNsSinceEpoch(info);
+                }
                 return result;
             }
         } else {
@@ -142,12 +150,7 @@ ErrorCodeOr<void> File::Unlock() {
 ErrorCodeOr<s128> File::LastModifiedTimeNsSinceEpoch() {
     struct stat file_stat;
     if (fstat(handle, &file_stat) != 0) return FilesystemErrnoErrorCode(errno, "fstat");
-#if IS_LINUX
-    auto const modified_time = file_stat.st_mtim;
-#elif IS_MACOS
-    auto const modified_time = file_stat.st_mtimespec;
-#endif
-    return (s128)modified_time.tv_sec * (s128)1'000'000'000 + (s128)modified_time.tv_nsec;
+    return ModifiedTimeNsSinceEpoch(file_stat);
 }
 
 ErrorCodeOr<void> File::SetLastModifiedTimeNsSinceEpoch(s128 ns_since_epoch) {
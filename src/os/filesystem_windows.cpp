@@ -80,11 +80,7 @@ ErrorCodeOr<void> File::Truncate(u64 new_size) {
     return k_success;
 }
 
-ErrorCodeOr<s128> File::LastModifiedTimeNsSinceEpoch() {
-    FILETIME file_time;
-    if (!GetFileTime(handle, nullptr, nullptr, &file_time))
-        return FilesystemWin32ErrorCode(GetLastError(), "GetFileTime");
-
+static s128 FileTimeToNsSinceEpoch(FILETIME file_time) {
     ULARGE_INTEGER file_time_int;
     file_time_int.LowPart = file_time.dwLowDateTime;
     file_time_int.HighPart = file_time.dwHighDateTime;
@@ -94,6 +90,13 @@ ErrorCodeOr<s128> File::LastModifiedTimeNsSinceEpoch() {
     return (s128)file_time_int.QuadPart * (s128)100 - (s128)11644473600ull * (s128)1'000'000'000ull;
 }
 
+ErrorCodeOr<s128> File::LastModifiedTimeNsSinceEpoch() {
+    FILETIME file_time;
+    if (!GetFileTime(handle, nullptr, nullptr, &file_time))
+        return FilesystemWin32ErrorCode(GetLastError(), "GetFileTime");
+    return FileTimeToNsSinceEpoch(file_time);
+}
+
 ErrorCodeOr<void> File::SetLastModifiedTimeNsSinceEpoch(s128 time) {
     ULARGE_INTEGER file_time_int;
 
@@ -979,6 +982,7 @@ static Entry MakeEntry(WIN32_FIND_DATAW const& data, ArenaAllocator& arena) {
         .subpath = filename,
         .type = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? FileType::Directory : FileType::File,
         .file_size = (data.nFileSizeHigh * (MAXDWORD + 1)) + data.nFileSizeLow,
+        .modified_time_ns_since_epoch = FileTimeToNsSinceEpoch(data.ftLastWriteTime),
     };
 }
 
@@ -48,6 +48,10 @@ PUBLIC SystemStats CachedSystemStats() {
 
 int CurrentProcessId();
 
+// True if a process with this ID currently exists. IDs can be reused by the OS so a true result doesn't
+// guarantee it's the same process.
+bool ProcessIsRunning(int pid);
+
 void OpenFolderInFileBrowser(String path);
 void OpenUrlInBrowser(String url);
 
@@ -64,8 +68,8 @@ void AlignedFree(void* ptr);
 Optional<MutableString> GetEnvironmentVariable(char const* name, Allocator& a);
 Optional<MutableString> GetEnvironmentVariable(String name, Allocator& a);
 
-// LockableSharedMemory is never closed, we rely on the OS to clean it up which usually happens after reboot.
-// The memory is shared between processes.
+// LockableSharedMemory is usually never closed, we rely on the OS to clean it up which usually happens after
+// reboot. The memory is shared between processes.
 struct LockableSharedMemory {
     Span<u8> data; // initialised to 0
     OpaqueHandle<IS_WINDOWS ? 16 : 8> native;
@@ -76,6 +80,15 @@ ErrorCodeOr<LockableSharedMemory> CreateLockableSharedMemory(String name, usize
 void LockSharedMemory(LockableSharedMemory& memory);
 void UnlockSharedMemory(LockableSharedMemory& memory);
 
+// Unmaps the memory from this process. memory must not be used afterwards.
+void CloseLockableSharedMemory(LockableSharedMemory& memory);
+
+// Makes the name available for new shared memory: the next CreateLockableSharedMemory with this name will
+// create new memory rather than open the existing memory. The existing memory is freed by the OS once every
+// process has closed it. On Windows the OS already does this once every process has closed it so this does
+// nothing.
+void RemoveLockableSharedMemoryName(String name);
+
 enum class LibraryHandle : uintptr {};
 ErrorCodeOr<LibraryHandle> LoadLibrary(String path);
 ErrorCodeOr<void*> SymbolFromLibrary(LibraryHandle library, String symbol_name);
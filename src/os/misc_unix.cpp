@@ -185,6 +185,20 @@ void UnlockSharedMemory(LockableSharedMemory& memory) {
     sem_post(native.sema);
 }
 
+void CloseLockableSharedMemory(LockableSharedMemory& memory) {
+    auto& native = memory.native.As<LockableSharedMemoryNative>();
+    munmap(memory.data.data, memory.data.size);
+    sem_close(native.sema);
+    memory.data = {};
+}
+
+void RemoveLockableSharedMemoryName(String name) {
+    ASSERT(name.size <= 32);
+    auto const posix_name = fmt::FormatInline<40>("/{}\0", name);
+    shm_unlink(posix_name.data);
+    sem_unlink(posix_name.data);
+}
+
 ErrorCodeOr<String> ReadAllStdin(Allocator& allocator) {
     DynamicArray<char> result {allocator};
     char buffer[4096];
@@ -215,6 +229,12 @@ void UnloadLibrary(LibraryHandle library) { dlclose((void*)library); }
 
 int CurrentProcessId() { return getpid(); }
 
+bool ProcessIsRunning(int pid) {
+    if (pid <= 0) return false;
+    // Signal 0 only checks whether the process exists. EPERM means it exists but belongs to another user.
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
 void TryShrinkPages(void* ptr, usize old_size, usize new_size) {
     if constexpr (!PRODUCTION_BUILD) {
         if (RUNNING_ON_VALGRIND) return;
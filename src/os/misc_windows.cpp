@@ -220,6 +220,16 @@ void UnlockSharedMemory(LockableSharedMemory& memory) {
     ReleaseMutex(native.mutex);
 }
 
+void CloseLockableSharedMemory(LockableSharedMemory& memory) {
+    auto& native = memory.native.As<LockableSharedMemoryNative>();
+    UnmapViewOfFile(memory.data.data);
+    CloseHandle(native.mapping);
+    CloseHandle(native.mutex);
+    memory.data = {};
+}
+
+void RemoveLockableSharedMemoryName(String) {}
+
 ErrorCodeOr<LibraryHandle> LoadLibrary(String path) {
     PathArena temp_allocator {Malloc::Instance()};
     auto const w_path = TRY(path::MakePathForWin32(path, temp_allocator, true));
@@ -242,6 +252,14 @@ void UnloadLibrary(LibraryHandle library) {
 
 int CurrentProcessId() { return _getpid(); }
 
+bool ProcessIsRunning(int pid) {
+    if (pid <= 0) return false;
+    auto const process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+    DEFER { CloseHandle(process); };
+    return WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+}
+
 static String ExceptionCodeString(DWORD code) {
     switch (code) {
         case EXCEPTION_ACCESS_VIOLATION:
@@ -120,7 +120,7 @@ static void LoadNewState(Engine& engine, StateSnapshotWithName const& state, Sta
 
         ASSERT(!state.state.ir_id.HasValue());
         engine.processor.convo.ir_id = k_nullopt;
-        SetConvolutionIrAudioData(engine.processor, nullptr);
+        SetConvolutionIr(engine.processor, {});
 
         engine.state_metadata = state.state.metadata;
         ApplyNewState(engine.processor, state.state, source);
@@ -187,14 +187,15 @@ static Instrument InstrumentFromPendingState(Engine::PendingStateChange const& p
     return instrument;
 }
 
-static AudioData const* IrAudioDataFromPendingState(Engine::PendingStateChange const& pending_state_change) {
+static sample_lib_server::RefCounted<sample_lib::LoadedIr>
+IrFromPendingState(Engine::PendingStateChange const& pending_state_change) {
     auto const ir_id = pending_state_change.snapshot.state.ir_id;
-    if (!ir_id) return nullptr;
+    if (!ir_id) return {};
     for (auto const& r : pending_state_change.retained_results) {
         auto const loaded_ir = r.TryExtract<sample_lib_server::RefCounted<sample_lib::LoadedIr>>();
-        if (loaded_ir && *ir_id == **loaded_ir) return (*loaded_ir)->audio_data;
+        if (loaded_ir && *ir_id == **loaded_ir) return *loaded_ir;
     }
-    return nullptr;
+    return {};
 }
 
 static void ApplyNewStateFromPending(Engine& engine) {
@@ -207,7 +208,7 @@ static void ApplyNewStateFromPending(Engine& engine) {
         SetInstrument(engine.processor,
                       layer_index,
                       InstrumentFromPendingState(pending_state_change, layer_index));
-    SetConvolutionIrAudioData(engine.processor, IrAudioDataFromPendingState(pending_state_change));
+    SetConvolutionIr(engine.processor, IrFromPendingState(pending_state_change));
     engine.state_metadata = pending_state_change.snapshot.state.metadata;
     ApplyNewState(engine.processor, pending_state_change.snapshot.state, pending_state_change.source);
 
@@ -278,7 +279,7 @@ static void SampleLibraryResourceLoaded(Engine& engine, sample_lib_server::LoadR
                     auto const current_ir_id = engine.processor.convo.ir_id;
                     if (current_ir_id.HasValue()) {
                         if (*current_ir_id == *loaded_ir)
-                            SetConvolutionIrAudioData(engine.processor, loaded_ir->audio_data);
+                            SetConvolutionIr(engine.processor, loaded_ir);
                     }
                     break;
                 }
@@ -346,7 +347,7 @@ void LoadConvolutionIr(Engine& engine, Optional<sample_lib::IrId> ir_id) {
     else {
         MarkNeedsAttributionTextUpdate(engine.attribution_requirements);
         engine.host.request_callback(&engine.host);
-        SetConvolutionIrAudioData(engine.processor, nullptr);
+        SetConvolutionIr(engine.processor, {});
     }
 }
 
@@ -524,6 +525,7 @@ static void PluginOnPollThread(Engine& engine) {
 static void PluginOnPreferenceChanged(Engine& engine, prefs::Key key, prefs::Value const* value) {
     ASSERT(IsMainThread(engine.host));
     OnPreferenceChanged(engine.autosave_state, key, value);
+    OnPreferenceChanged(engine.processor, key, value);
 }
 
 usize MegabytesUsedBySamples(Engine const& engine) {
@@ -60,7 +60,11 @@ struct Engine : ProcessorListener {
     SharedEngineSystems& shared_engine_systems;
     ArenaAllocator error_arena {PageAllocator::Instance()};
     ThreadsafeErrorNotifications error_notifications {};
-    AudioProcessor processor {host, *this, shared_engine_systems.prefs};
+    AudioProcessor processor {host,
+                              *this,
+                              shared_engine_systems.prefs,
+                              shared_engine_systems.thread_pool,
+                              shared_engine_systems.convolver_ir_cache};
     PluginInstanceMessages& plugin_instance_messages;
 
     u64 random_seed = (u64)NanosecondsSinceEpoch();
@@ -45,7 +45,7 @@ SharedEngineSystems::SharedEngineSystems(Span<sentry::Tag const> tags)
     , sample_library_server(thread_pool,
                             paths.always_scanned_folder[ToInt(ScanFolderType::Libraries)],
                             error_notifications)
-    , preset_server {.error_notifications = error_notifications} {
+    , preset_server {.error_notifications = error_notifications, .thread_pool = thread_pool} {
     InitBackgroundErrorReporting(tags);
 
     prefs.on_change = [this](prefs::Key const& key, prefs::Value const* value) {
@@ -67,6 +67,7 @@ SharedEngineSystems::SharedEngineSystems(Span<sentry::Tag const> tags)
             SetExtraScanFolders(preset_server, extra_scan_folders);
         }
         ErrorReportingOnPreferenceChanged(key, value);
+        sample_lib_server::OnPreferenceChanged(sample_library_server, key, value);
 
         registered_floe_instances_mutex.Lock();
         DEFER { registered_floe_instances_mutex.Unlock(); };
@@ -110,6 +111,7 @@ SharedEngineSystems::SharedEngineSystems(Span<sentry::Tag const> tags)
 
     sample_lib_server::SetExtraScanFolders(sample_library_server,
                                            ExtraScanFolders(paths, prefs, ScanFolderType::Libraries));
+    sample_lib_server::ApplyPreferences(sample_library_server, prefs);
 
     InitPresetServer(preset_server, paths.always_scanned_folder[ToInt(ScanFolderType::Presets)]);
     SetExtraScanFolders(preset_server, ExtraScanFolders(paths, prefs, ScanFolderType::Presets));
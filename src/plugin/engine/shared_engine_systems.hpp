@@ -11,6 +11,7 @@
 
 #include "clap/plugin.h"
 #include "preset_server/preset_server.hpp"
+#include "processor/convolver_ir_cache.hpp"
 #include "sample_lib_server/sample_library_server.hpp"
 
 // Shared across plugin instances of the engine. This usually happens when the plugin is loaded multiple times
@@ -34,6 +35,7 @@ struct SharedEngineSystems {
     FloePaths paths;
     prefs::Preferences prefs;
     ThreadPool thread_pool;
+    ConvolverIrCache convolver_ir_cache;
     sample_lib_server::Server sample_library_server;
     Optional<LockableSharedMemory> shared_attributions_store {};
     PresetServer preset_server;
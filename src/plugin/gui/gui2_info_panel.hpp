@@ -220,6 +220,9 @@ static void MetricsInfoPanel(GuiBoxSystem& box_system, InfoPanelContext& context
     do_line(fmt::Assign(buffer,
                         "Active voices: {}",
                         context.voice_pool.num_active_voices.Load(LoadMemoryOrder::Relaxed)));
+    do_line(fmt::Assign(buffer,
+                        "Disk streaming underruns: {}",
+                        context.voice_pool.disk_streamer.num_underruns.Load(LoadMemoryOrder::Relaxed)));
 
     do_line(fmt::Assign(
         buffer,
@@ -676,6 +676,16 @@ static void GeneralPreferencesPanel(GuiBoxSystem& box_system, PreferencesPanelCo
                 context,
                 options_rhs_column,
                 SettingDescriptor(ProcessorSetting::DefaultCcParamMappings));
+        Setting(box_system,
+                context,
+                options_rhs_column,
+                SettingDescriptor(ProcessorSetting::VoiceWorkerThreads));
+        Setting(box_system,
+                context,
+                options_rhs_column,
+                SettingDescriptor(ProcessorSetting::InterpolationQuality));
+        for (auto const server_setting : EnumIterator<sample_lib_server::ServerSetting>())
+            Setting(box_system, context, options_rhs_column, SettingDescriptor(server_setting));
 
         for (auto const autosave_setting : EnumIterator<AutosaveSetting>())
             Setting(box_system, context, options_rhs_column, SettingDescriptor(autosave_setting));
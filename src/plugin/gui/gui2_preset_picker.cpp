@@ -8,11 +8,10 @@
 #include "gui_framework/gui_box_system.hpp"
 #include "preset_server/preset_server.hpp"
 
-struct PresetCursor {
-    bool operator==(PresetCursor const& o) const = default;
-    usize folder_index;
-    usize preset_index;
-};
+static bool CursorIsBefore(PresetCursor a, PresetCursor b) {
+    if (a.folder_index != b.folder_index) return a.folder_index < b.folder_index;
+    return a.preset_index < b.preset_index;
+}
 
 static Optional<PresetCursor> CurrentCursor(PresetPickerContext const& context, Optional<String> path) {
     if (!path) return k_nullopt;
@@ -25,106 +24,270 @@ static Optional<PresetCursor> CurrentCursor(PresetPickerContext const& context,
     return k_nullopt;
 }
 
-static Optional<PresetCursor> IteratePreset(PresetPickerContext const& context,
-                                            PresetPickerState const& state,
-                                            PresetCursor cursor,
-                                            SearchDirection direction,
-                                            bool first) {
-    if (context.presets_snapshot.folders.size == 0) return k_nullopt;
+static void SetBit(PresetFilterIndex& index, u32 bitset_offset, usize preset_index) {
+    index.bits[bitset_offset + (preset_index / 64)] |= (u64)1 << (preset_index % 64);
+}
 
-    if (cursor.folder_index >= context.presets_snapshot.folders.size) cursor.folder_index = 0;
+static u32 InternFilterValue(PresetFilterIndex& index, DynamicHashTable<u64, u32, NoHash>& values, u64 hash) {
+    if (auto const offset = values.Find(hash)) return *offset;
+    auto const offset = (u32)index.bits.size;
+    dyn::InsertRepeated(index.bits, index.bits.size, index.num_words, (u64)0);
+    values.Insert(hash, offset);
+    return offset;
+}
 
-    if (!first) {
-        switch (direction) {
-            case SearchDirection::Forward: ++cursor.preset_index; break;
-            case SearchDirection::Backward:
-                static_assert(UnsignedInt<decltype(cursor.preset_index)>);
-                --cursor.preset_index;
-                break;
+static u32 PresetTypeBitsetOffset(PresetFilterIndex const& index, PresetFormat format) {
+    return (u32)(ToInt(format) * index.num_words);
+}
+
+static void BuildFilterIndex(PresetFilterIndex& index, PresetsSnapshot const& snapshot) {
+    index.snapshot_version = snapshot.version;
+    dyn::Clear(index.presets);
+    dyn::Clear(index.folder_first_preset);
+    for (auto values : Array {&index.libraries, &index.library_authors, &index.tags, &index.authors})
+        values->DeleteAll();
+    dyn::Clear(index.bits);
+    index.has_trigrams = false;
+    index.trigrams.DeleteAll();
+    dyn::Clear(index.trigram_postings);
+
+    for (auto const [folder_index, folder] : Enumerate(snapshot.folders)) {
+        dyn::Append(index.folder_first_preset, (u32)index.presets.size);
+        for (auto const preset_index : Range(folder->presets.size))
+            dyn::Append(index.presets, PresetCursor {folder_index, preset_index});
+    }
+
+    index.num_words = (index.presets.size + 63) / 64;
+    dyn::InsertRepeated(index.bits, 0, ToInt(PresetFormat::Count) * index.num_words, (u64)0);
+
+    for (auto const [i, cursor] : Enumerate(index.presets)) {
+        auto const& preset = snapshot.folders[cursor.folder_index]->presets[cursor.preset_index];
+
+        SetBit(index, PresetTypeBitsetOffset(index, preset.file_format), i);
+        for (auto const& lib_id : preset.used_libraries) {
+            SetBit(index, InternFilterValue(index, index.libraries, lib_id.Hash()), i);
+            SetBit(index, InternFilterValue(index, index.library_authors, Hash(lib_id.author)), i);
         }
+        for (auto const& tag : preset.metadata.tags)
+            SetBit(index, InternFilterValue(index, index.tags, Hash(tag)), i);
+        if (preset.metadata.author.size)
+            SetBit(index, InternFilterValue(index, index.authors, Hash(preset.metadata.author)), i);
     }
+}
 
-    for (usize preset_step = 0; preset_step < context.presets_snapshot.folders.size + 1; (
-             {
-                 ++preset_step;
-                 switch (direction) {
-                     case SearchDirection::Forward:
-                         cursor.folder_index =
-                             (cursor.folder_index + 1) % context.presets_snapshot.folders.size;
-                         cursor.preset_index = 0;
-                         break;
-                     case SearchDirection::Backward:
-                         static_assert(UnsignedInt<decltype(cursor.folder_index)>);
-                         --cursor.folder_index;
-                         if (cursor.folder_index >= context.presets_snapshot.folders.size) // check wraparound
-                             cursor.folder_index = context.presets_snapshot.folders.size - 1;
-                         cursor.preset_index =
-                             context.presets_snapshot.folders[cursor.folder_index]->presets.size - 1;
-                         break;
-                 }
-             })) {
-        auto const& folder = *context.presets_snapshot.folders[cursor.folder_index];
-
-        for (; cursor.preset_index < folder.presets.size; (
-                 {
-                     switch (direction) {
-                         case SearchDirection::Forward: ++cursor.preset_index; break;
-                         case SearchDirection::Backward: --cursor.preset_index; break;
-                     }
-                 })) {
-            auto const& preset = folder.presets[cursor.preset_index];
-
-            if (state.search.size && (!ContainsCaseInsensitiveAscii(preset.name, state.search) &&
-                                      !ContainsCaseInsensitiveAscii(folder.folder, state.search)))
-                continue;
+// Trigrams are compared case-insensitively, the same as ContainsCaseInsensitiveAscii.
+static u64 TrigramHash(String str) {
+    ASSERT(str.size == 3);
+    Array<char, 3> lowercase;
+    for (auto const i : Range(3uz))
+        lowercase[i] = ToLowercaseAscii(str[i]);
+    return Hash(String {lowercase.data, lowercase.size});
+}
+
+static void BuildTrigrams(PresetFilterIndex& index, PresetsSnapshot const& snapshot, ArenaAllocator& arena) {
+    index.has_trigrams = true;
+
+    struct Posting {
+        u64 trigram;
+        u32 preset_index;
+    };
+    DynamicArray<Posting> postings {arena};
+    for (auto const [i, cursor] : Enumerate<u32>(index.presets)) {
+        auto const name = snapshot.folders[cursor.folder_index]->presets[cursor.preset_index].name;
+        if (name.size < 3) continue;
+        for (auto const pos : Range(name.size - 2))
+            dyn::Append(postings, {TrigramHash(name.SubSpan(pos, 3)), i});
+    }
 
-            // If multiple preset types exist, we offer a way to filter by them.
-            if (!Contains(context.presets_snapshot.has_preset_type, false) &&
-                Contains(state.selected_preset_types, true) &&
-                !state.selected_preset_types[ToInt(preset.file_format)])
+    Sort(postings, [](Posting const& a, Posting const& b) {
+        if (a.trigram != b.trigram) return a.trigram < b.trigram;
+        return a.preset_index < b.preset_index;
+    });
+
+    for (usize i = 0; i < postings.size;) {
+        auto const trigram = postings[i].trigram;
+        auto const begin = (u32)index.trigram_postings.size;
+        for (; i < postings.size && postings[i].trigram == trigram; ++i) {
+            // A name can contain the same trigram more than once.
+            if (index.trigram_postings.size != begin &&
+                Last(index.trigram_postings) == postings[i].preset_index)
                 continue;
+            dyn::Append(index.trigram_postings, postings[i].preset_index);
+        }
+        index.trigrams.Insert(trigram, {begin, (u32)index.trigram_postings.size});
+    }
+}
 
-            if (state.selected_library_hashes.size) {
-                bool found = false;
-                for (auto const lib_id : preset.used_libraries) {
-                    if (Contains(state.selected_library_hashes, lib_id.Hash())) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) continue;
-            }
+// Keeps only the presets that are in at least one of the given bitsets.
+static void IntersectWithAnyOf(PresetFilterIndex const& index,
+                               Span<u64> matching,
+                               Span<u32 const> bitset_offsets,
+                               ArenaAllocator& scratch_arena) {
+    auto any = scratch_arena.AllocateExactSizeUninitialised<u64>(index.num_words);
+    ZeroMemory(any.ToByteSpan());
+    for (auto const offset : bitset_offsets)
+        for (auto const word_index : Range(index.num_words))
+            any[word_index] |= index.bits[offset + word_index];
+    for (auto const word_index : Range(index.num_words))
+        matching[word_index] &= any[word_index];
+}
 
-            if (state.selected_library_author_hashes.size) {
-                bool found = false;
-                for (auto const lib_id : preset.used_libraries) {
-                    auto const author_hash = Hash(lib_id.author);
-                    if (Contains(state.selected_library_author_hashes, author_hash)) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) continue;
-            }
+static void IntersectWithAnyOf(PresetFilterIndex const& index,
+                               Span<u64> matching,
+                               DynamicHashTable<u64, u32, NoHash> const& values,
+                               Span<u64 const> selected_hashes,
+                               ArenaAllocator& scratch_arena) {
+    if (!selected_hashes.size) return;
+    DynamicArray<u32> offsets {scratch_arena};
+    for (auto const hash : selected_hashes)
+        if (auto const offset = values.Find(hash)) dyn::Append(offsets, *offset);
+    IntersectWithAnyOf(index, matching, offsets, scratch_arena);
+}
 
-            if (state.selected_author_hashes.size) {
-                auto const author_hash = Hash(preset.metadata.author);
-                if (!Contains(state.selected_author_hashes, author_hash)) continue;
+// The search matches either the preset's name or its folder.
+static void IntersectWithSearch(PresetFilterIndex& index,
+                                PresetsSnapshot const& snapshot,
+                                Span<u64> matching,
+                                String search,
+                                ArenaAllocator& scratch_arena) {
+    auto found = scratch_arena.AllocateExactSizeUninitialised<u64>(index.num_words);
+    ZeroMemory(found.ToByteSpan());
+
+    auto const check_name = [&](u32 i) {
+        if (!(matching[i / 64] & ((u64)1 << (i % 64)))) return;
+        auto const& cursor = index.presets[i];
+        auto const& name = snapshot.folders[cursor.folder_index]->presets[cursor.preset_index].name;
+        if (ContainsCaseInsensitiveAscii(name, search)) found[i / 64] |= (u64)1 << (i % 64);
+    };
+
+    if (search.size >= 3) {
+        if (!index.has_trigrams) BuildTrigrams(index, snapshot, scratch_arena);
+
+        // Every trigram of the search must be in the name, so the rarest one gives us the fewest
+        // candidates to check.
+        Optional<PresetFilterIndex::TrigramPostings> rarest {};
+        for (auto const pos : Range(search.size - 2)) {
+            auto const postings = index.trigrams.Find(TrigramHash(search.SubSpan(pos, 3)));
+            if (!postings) {
+                rarest = PresetFilterIndex::TrigramPostings {0, 0};
+                break;
             }
+            if (!rarest || (postings->end - postings->begin) < (rarest->end - rarest->begin))
+                rarest = *postings;
+        }
+        for (auto const i : Range(rarest->begin, rarest->end))
+            check_name(index.trigram_postings[i]);
+    } else {
+        for (auto const i : Range((u32)index.presets.size))
+            check_name(i);
+    }
 
-            if (state.selected_tags_hashes.size) {
-                bool found = false;
-                for (auto const tag : preset.metadata.tags) {
-                    auto const tag_hash = Hash(tag);
-                    if (Contains(state.selected_tags_hashes, tag_hash)) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) continue;
-            }
+    for (auto const [folder_index, folder] : Enumerate(snapshot.folders)) {
+        if (!ContainsCaseInsensitiveAscii(folder->folder, search)) continue;
+        auto const first = index.folder_first_preset[folder_index];
+        for (auto const i : Range(first, first + (u32)folder->presets.size))
+            found[i / 64] |= (u64)1 << (i % 64);
+    }
+
+    for (auto const word_index : Range(index.num_words))
+        matching[word_index] &= found[word_index];
+}
+
+static void UpdateFilterResults(PresetPickerContext const& context, PresetPickerState& state) {
+    auto const& snapshot = context.presets_snapshot;
+    auto& index = state.filter_index;
+    auto& results = state.filter_results;
+
+    if (index.snapshot_version != snapshot.version) BuildFilterIndex(index, snapshot);
+
+    // If multiple preset types exist, we offer a way to filter by them.
+    bool const filter_preset_types =
+        !Contains(snapshot.has_preset_type, false) && Contains(state.selected_preset_types, true);
+
+    auto const filters_hash = ({
+        auto h = HashInit();
+        for (auto const selected : Array {state.selected_library_hashes.Items(),
+                                          state.selected_library_author_hashes.Items(),
+                                          state.selected_tags_hashes.Items(),
+                                          state.selected_author_hashes.Items()}) {
+            HashUpdate(h, selected.size);
+            HashUpdate(h, selected.ToConstByteSpan());
+        }
+        HashUpdate(h, state.search.size);
+        HashUpdate(h, (String)state.search);
+        if (filter_preset_types)
+            for (auto const selected : state.selected_preset_types)
+                HashUpdate(h, (u8)selected);
+        h;
+    });
+
+    if (results.snapshot_version == snapshot.version && results.filters_hash == filters_hash) return;
+    results.snapshot_version = snapshot.version;
+    results.filters_hash = filters_hash;
+    dyn::Clear(results.visible);
+
+    if (!index.presets.size) return;
+
+    ArenaAllocator scratch_arena {PageAllocator::Instance()};
+
+    auto matching = scratch_arena.AllocateExactSizeUninitialised<u64>(index.num_words);
+    FillMemory(matching.ToByteSpan(), 0xff);
+    if (auto const remainder = index.presets.size % 64) Last(matching) = ((u64)1 << remainder) - 1;
+
+    if (filter_preset_types) {
+        DynamicArray<u32> offsets {scratch_arena};
+        for (auto const type_index : Range(ToInt(PresetFormat::Count)))
+            if (state.selected_preset_types[type_index])
+                dyn::Append(offsets, PresetTypeBitsetOffset(index, (PresetFormat)type_index));
+        IntersectWithAnyOf(index, matching, offsets, scratch_arena);
+    }
+
+    IntersectWithAnyOf(index, matching, index.libraries, state.selected_library_hashes, scratch_arena);
+    IntersectWithAnyOf(index,
+                       matching,
+                       index.library_authors,
+                       state.selected_library_author_hashes,
+                       scratch_arena);
+    IntersectWithAnyOf(index, matching, index.tags, state.selected_tags_hashes, scratch_arena);
+    IntersectWithAnyOf(index, matching, index.authors, state.selected_author_hashes, scratch_arena);
+
+    // Search last since it has to look at strings and we can skip presets that are already filtered out.
+    if (state.search.size) IntersectWithSearch(index, snapshot, matching, state.search, scratch_arena);
+
+    for (auto const word_index : Range(index.num_words)) {
+        for (auto word = matching[word_index]; word; word &= word - 1)
+            dyn::Append(results.visible, (u32)(word_index * 64 + (usize)__builtin_ctzll(word)));
+    }
+}
+
+static Optional<PresetCursor> IteratePreset(PresetPickerState const& state,
+                                            PresetCursor cursor,
+                                            SearchDirection direction,
+                                            bool first) {
+    auto const& visible = state.filter_results.visible;
+    auto const& presets = state.filter_index.presets;
+    if (visible.size == 0) return k_nullopt;
+
+    // Find the first visible preset that isn't before the cursor.
+    usize pos = 0;
+    for (usize end = visible.size; pos < end;) {
+        auto const mid = pos + ((end - pos) / 2);
+        if (CursorIsBefore(presets[visible[mid]], cursor))
+            pos = mid + 1;
+        else
+            end = mid;
+    }
+    bool const at_cursor = pos != visible.size && presets[visible[pos]] == cursor;
 
-            return cursor;
+    switch (direction) {
+        case SearchDirection::Forward: {
+            if (!first && at_cursor) ++pos;
+            if (pos == visible.size) pos = 0;
+            return presets[visible[pos]];
+        }
+        case SearchDirection::Backward: {
+            if (first && at_cursor) return presets[visible[pos]];
+            return presets[visible[pos ? pos - 1 : visible.size - 1]];
         }
     }
 
@@ -151,60 +314,45 @@ void LoadAdjacentPreset(PresetPickerContext const& context,
                         PresetPickerState& state,
                         SearchDirection direction) {
     ASSERT(context.init);
+    UpdateFilterResults(context, state);
     auto const current_path = CurrentPath(context.engine);
 
     if (current_path) {
         if (auto const current = CurrentCursor(context, *current_path)) {
-            if (auto const next = IteratePreset(context, state, *current, direction, false))
+            if (auto const next = IteratePreset(state, *current, direction, false))
                 LoadPreset(context, state, *next, true);
         }
     } else if (auto const first =
-                   IteratePreset(context, state, {.folder_index = 0, .preset_index = 0}, direction, true)) {
+                   IteratePreset(state, {.folder_index = 0, .preset_index = 0}, direction, true)) {
         LoadPreset(context, state, *first, true);
     }
 }
 
 void LoadRandomPreset(PresetPickerContext const& context, PresetPickerState& state) {
     ASSERT(context.init);
-    auto const first =
-        IteratePreset(context, state, {.folder_index = 0, .preset_index = 0}, SearchDirection::Forward, true);
-    if (!first) return;
-
-    auto cursor = *first;
-
-    usize num_presets = 1;
-    while (true) {
-        if (auto const next = IteratePreset(context, state, cursor, SearchDirection::Forward, false)) {
-            cursor = *next;
-            if (cursor == *first) break;
-            ++num_presets;
-        } else {
-            break;
-        }
-    }
+    UpdateFilterResults(context, state);
 
-    auto const random_pos = RandomIntInRange<usize>(context.engine.random_seed, 0, num_presets - 1);
+    auto const& visible = state.filter_results.visible;
+    if (!visible.size) return;
 
-    cursor = *first;
-    for (usize i = 0; i < random_pos; ++i)
-        cursor = *IteratePreset(context, state, cursor, SearchDirection::Forward, false);
+    auto const random_pos = RandomIntInRange<usize>(context.engine.random_seed, 0, visible.size - 1);
 
-    LoadPreset(context, state, cursor, true);
+    LoadPreset(context, state, state.filter_index.presets[visible[random_pos]], true);
 }
 
 void PresetPickerItems(GuiBoxSystem& box_system, PresetPickerContext& context, PresetPickerState& state) {
     auto const root = DoPickerItemsRoot(box_system);
 
-    auto const first =
-        IteratePreset(context, state, {.folder_index = 0, .preset_index = 0}, SearchDirection::Forward, true);
-    if (!first) return;
+    UpdateFilterResults(context, state);
+
+    auto const current = CurrentCursor(context, CurrentPath(context.engine));
 
     PresetFolder const* previous_folder = nullptr;
 
     Box folder_box;
 
-    auto cursor = *first;
-    while (true) {
+    for (auto const preset_index : state.filter_results.visible) {
+        auto const cursor = state.filter_index.presets[preset_index];
         auto const& preset_folder = *context.presets_snapshot.folders[cursor.folder_index];
         auto const& preset = preset_folder.presets[cursor.preset_index];
 
@@ -218,12 +366,7 @@ void PresetPickerItems(GuiBoxSystem& box_system, PresetPickerContext& context, P
                                                        });
         }
 
-        auto const is_current = ({
-            bool c {};
-            if (auto const current_path = CurrentPath(context.engine))
-                c = cursor.preset_index == preset_folder.MatchFullPresetPath(*current_path);
-            c;
-        });
+        auto const is_current = current == cursor;
 
         auto const item = DoPickerItem(box_system,
                                        {
@@ -240,13 +383,6 @@ void PresetPickerItems(GuiBoxSystem& box_system, PresetPickerContext& context, P
 
         if (item.is_hot) context.hovering_preset = &preset;
         if (item.button_fired) LoadPreset(context, state, cursor, false);
-
-        if (auto next = IteratePreset(context, state, cursor, SearchDirection::Forward, false)) {
-            cursor = *next;
-            if (cursor == *first) break;
-        } else {
-            break;
-        }
     }
 }
 
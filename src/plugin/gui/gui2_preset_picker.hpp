@@ -36,6 +36,46 @@ struct PresetPickerContext {
     PresetFolder::Preset const* hovering_preset = nullptr;
 };
 
+struct PresetCursor {
+    bool operator==(PresetCursor const& o) const = default;
+    usize folder_index;
+    usize preset_index;
+};
+
+// Derived from one version of the presets snapshot. Each filter value is interned and given a bitset of the
+// presets that have it, so applying filters is a matter of combining bitsets rather than looking at every
+// preset's strings.
+struct PresetFilterIndex {
+    struct TrigramPostings {
+        u32 begin;
+        u32 end;
+    };
+
+    u64 snapshot_version = PresetServer::k_no_version;
+    DynamicArray<PresetCursor> presets {Malloc::Instance()}; // Every preset, in listing order
+    DynamicArray<u32> folder_first_preset {Malloc::Instance()};
+    usize num_words {}; // Size of each bitset
+
+    // Filter value hash -> offset of its bitset in bits. The preset type bitsets are first.
+    DynamicHashTable<u64, u32, NoHash> libraries {Malloc::Instance()};
+    DynamicHashTable<u64, u32, NoHash> library_authors {Malloc::Instance()};
+    DynamicHashTable<u64, u32, NoHash> tags {Malloc::Instance()};
+    DynamicHashTable<u64, u32, NoHash> authors {Malloc::Instance()};
+    DynamicArray<u64> bits {Malloc::Instance()};
+
+    // Presets whose names contain each (lowercase) trigram. Only built once a search needs it.
+    bool has_trigrams {};
+    DynamicHashTable<u64, TrigramPostings, NoHash> trigrams {Malloc::Instance()};
+    DynamicArray<u32> trigram_postings {Malloc::Instance()};
+};
+
+// The presets that pass the current filters, only recomputed when the filters or the snapshot change.
+struct PresetFilterResults {
+    u64 snapshot_version = PresetServer::k_no_version;
+    u64 filters_hash {};
+    DynamicArray<u32> visible {Malloc::Instance()}; // Indices into PresetFilterIndex::presets
+};
+
 // Persistent
 struct PresetPickerState {
     void ClearAllFilters() {
@@ -53,6 +93,9 @@ struct PresetPickerState {
 
     // Only valid if we have both types of presets
     Array<bool, ToInt(PresetFormat::Count)> selected_preset_types {};
+
+    PresetFilterIndex filter_index {};
+    PresetFilterResults filter_results {};
 };
 
 void LoadAdjacentPreset(PresetPickerContext const& context,
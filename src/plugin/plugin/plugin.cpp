@@ -15,6 +15,7 @@
 #include "clap/ext/note-ports.h"
 #include "clap/ext/params.h"
 #include "clap/ext/posix-fd-support.h"
+#include "clap/ext/render.h"
 #include "clap/ext/state.h"
 #include "clap/ext/timer-support.h"
 #include "clap/host.h"
@@ -1076,6 +1077,37 @@ static clap_plugin_thread_pool const floe_thread_pool {
     .exec = ClapThreadPoolExec,
 };
 
+static bool ClapRenderHasHardRealtimeRequirement(clap_plugin_t const*) { return false; }
+
+static bool ClapRenderSet(clap_plugin_t const* plugin, clap_plugin_render_mode mode) {
+    ZoneScoped;
+    if (PanicOccurred()) return false;
+
+    try {
+        constexpr String k_func = "render.set";
+        auto& floe = *({
+            auto f = ExtractFloe(plugin);
+            if (!Check(f, k_func, "plugin ptr is invalid")) return false;
+            f;
+        });
+        LogClapFunction(floe, ClapFunctionType::Any, k_func, "mode: {}", mode);
+
+        if (!Check(floe, IsMainThread(floe.host), k_func, "not main thread")) return false;
+        if (!Check(floe, floe.initialised, k_func, "not initialised")) return false;
+
+        SetRenderingOffline(floe.engine->processor, mode == CLAP_RENDER_OFFLINE);
+        return true;
+    } catch (PanicException) {
+        return false;
+    }
+}
+
+// Offline renders trade CPU for the highest quality resampling.
+static clap_plugin_render const floe_render {
+    .has_hard_realtime_requirement = ClapRenderHasHardRealtimeRequirement,
+    .set = ClapRenderSet,
+};
+
 static void ClapTimerSupportOnTimer(clap_plugin_t const* plugin, clap_id timer_id) {
     ZoneScoped;
     if (PanicOccurred()) return;
@@ -1148,6 +1180,54 @@ static FloeClapTestingExtension const floe_custom_ext {
             return false;
         }
     },
+    .convolver_build_is_pending = [](clap_plugin_t const* plugin) -> bool {
+        ZoneScoped;
+        if (PanicOccurred()) return false;
+
+        try {
+            auto& floe = *({
+                auto f = ExtractFloe(plugin);
+                if (!Check(f, "convolver_build_is_pending", "plugin ptr is invalid")) return false;
+                f;
+            });
+            return floe.engine->processor.convo.ConvolverBuildIsPending();
+        } catch (PanicException) {
+            return false;
+        }
+    },
+    .enable_stage_timings = [](clap_plugin_t const* plugin) {
+        ZoneScoped;
+        if (PanicOccurred()) return;
+
+        try {
+            auto& floe = *({
+                auto f = ExtractFloe(plugin);
+                if (!Check(f, "enable_stage_timings", "plugin ptr is invalid")) return;
+                f;
+            });
+            if (!Check(floe, floe.initialised, "enable_stage_timings", "not initialised")) return;
+            if (!Check(floe, !floe.active, "enable_stage_timings", "plugin is active")) return;
+            floe.engine->processor.measure_stage_timings = true;
+        } catch (PanicException) {
+        }
+    },
+    .last_process_stage_timings = [](clap_plugin_t const* plugin, ProcessStageTimings* out) -> bool {
+        if (PanicOccurred()) return false;
+
+        try {
+            auto& floe = *({
+                auto f = ExtractFloe(plugin);
+                if (!Check(f, "last_process_stage_timings", "plugin ptr is invalid")) return false;
+                f;
+            });
+            auto const& processor = floe.engine->processor;
+            if (!processor.measure_stage_timings) return false;
+            *out = processor.stage_timings;
+            return true;
+        } catch (PanicException) {
+            return false;
+        }
+    },
 };
 
 static bool ClapInit(const struct clap_plugin* plugin) {
@@ -1440,6 +1520,7 @@ static void const* ClapGetExtension(const struct clap_plugin* plugin, char const
         if (NullTermStringsEqual(id, CLAP_EXT_THREAD_POOL)) return &floe_thread_pool;
         if (NullTermStringsEqual(id, CLAP_EXT_TIMER_SUPPORT)) return &floe_timer;
         if (NullTermStringsEqual(id, CLAP_EXT_POSIX_FD_SUPPORT)) return &floe_posix_fd;
+        if (NullTermStringsEqual(id, CLAP_EXT_RENDER)) return &floe_render;
         if (NullTermStringsEqual(id, k_floe_clap_extension_id)) return &floe_custom_ext;
     } catch (PanicException) {
     }
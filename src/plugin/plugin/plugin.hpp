@@ -141,8 +141,28 @@ struct FloeClapExtensionHost {
     void* pugl_world;
 };
 
+// Time spent in each stage of the most recent process() call, for benchmarking.
+struct ProcessStageTimings {
+    f64 voices_seconds;
+    f64 layers_seconds;
+    f64 effects_seconds; // excluding convolution
+    f64 convolution_seconds;
+    u32 num_active_voices;
+};
+
 struct FloeClapTestingExtension {
     bool (*state_change_is_pending)(clap_plugin const* plugin) = nullptr;
+
+    // [main-thread] The convolution reverb's convolver is built on the thread pool after its IR has loaded.
+    // Once this returns false, the processor uses the new convolver from activate() or its next reset.
+    bool (*convolver_build_is_pending)(clap_plugin const* plugin) = nullptr;
+
+    // [main-thread & !active_state] Reading the clock isn't free so stage timings are only measured once
+    // this has been called.
+    void (*enable_stage_timings)(clap_plugin const* plugin) = nullptr;
+
+    // [audio-thread] Returns false if stage timings aren't enabled.
+    bool (*last_process_stage_timings)(clap_plugin const* plugin, ProcessStageTimings* out) = nullptr;
 };
 
 inline bool IsMainThread(clap_host const& host) {
@@ -111,7 +111,8 @@ static bool ClapEntryInit(char const* plugin_path_c_str) {
                 String p = plugin_path;
                 // the CLAP spec says that the path is to the bundle on macOS, so we need to append
                 // the subpaths to get the binary path
-                if (IS_MACOS && g_final_binary_type != FinalBinaryType::Standalone) {
+                if (IS_MACOS && g_final_binary_type != FinalBinaryType::Standalone &&
+                    g_final_binary_type != FinalBinaryType::Bench) {
                     constexpr String k_subpath = "/Contents/MacOS/Floe"_s;
                     if (p.size + k_subpath.size > k_plugin_path_max_len) return false;
                     dyn::AppendSpanAssumeCapacity(modified_plugin_path, p);
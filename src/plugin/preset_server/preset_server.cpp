@@ -6,6 +6,7 @@
 #include <xxhash.h>
 
 #include "state/state_coding.hpp"
+#include "tests/framework.hpp"
 
 static String ExtensionForPreset(PresetFolder::Preset const& preset) {
     switch (preset.file_format) {
@@ -71,6 +72,7 @@ PresetsSnapshot BeginReadFolders(PresetServer& server, ArenaAllocator& arena) {
     DEFER { server.mutex.Unlock(); };
     auto const folders = arena.Clone(server.folders);
     return {
+        .version = server.published_version.Load(LoadMemoryOrder::Relaxed),
         .folders = {(PresetFolder const**)folders.data, folders.size},
         .used_tags = {server.used_tags.table.Clone(arena, CloneType::Deep)},
         .used_libraries = {server.used_libraries.table.Clone(arena, CloneType::Deep)},
@@ -122,150 +124,490 @@ static void DeleteUnusedFolders(PresetServer& server) {
     });
 }
 
-static void AddPresetToFolder(PresetFolder& folder,
-                              dir_iterator::Entry const& entry,
-                              StateSnapshot const& state,
-                              u64 file_hash,
-                              PresetFormat file_format) {
+static PresetFolder::Preset PresetFromState(String filename,
+                                            StateSnapshot const& state,
+                                            u64 file_hash,
+                                            PresetFormat file_format,
+                                            Allocator& a) {
+    return {
+        .name = a.Clone(path::FilenameWithoutExtension(filename)),
+        .metadata {
+            .tags = ({
+                auto tags = a.AllocateExactSizeUninitialised<String>(state.metadata.tags.size);
+                for (auto const i : Range(tags.size))
+                    tags[i] = a.Clone(state.metadata.tags[i]);
+                tags;
+            }),
+            .author = a.Clone(state.metadata.author),
+            .description = a.Clone(state.metadata.description),
+        },
+        .used_libraries = ({
+            decltype(PresetFolder::Preset::used_libraries) used_libraries {};
+
+            for (auto const& inst_id : state.inst_ids) {
+                if (auto const& sampled_inst = inst_id.TryGet<sample_lib::InstrumentId>()) {
+                    auto const lib_id = (sample_lib::LibraryIdRef)sampled_inst->library;
+                    if (!Contains(used_libraries, lib_id)) dyn::Append(used_libraries, lib_id.Clone(a));
+                }
+            }
+
+            if (state.ir_id) {
+                auto const lib_id = (sample_lib::LibraryIdRef)state.ir_id->library;
+                if (!Contains(used_libraries, lib_id)) dyn::Append(used_libraries, lib_id.Clone(a));
+            }
+
+            used_libraries;
+        }),
+        .file_hash = file_hash,
+        .file_extension =
+            file_format == PresetFormat::Mirage ? (String)a.Clone(path::Extension(filename)) : ""_s,
+        .file_format = file_format,
+    };
+}
+
+static PresetFolder::Preset ClonePreset(PresetFolder::Preset const& preset, Allocator& a) {
+    auto result = preset;
+    result.name = a.Clone(preset.name);
+    result.metadata.tags = a.Clone(preset.metadata.tags, CloneType::Deep);
+    result.metadata.author = a.Clone(preset.metadata.author);
+    result.metadata.description = a.Clone(preset.metadata.description);
+    for (auto& lib_id : result.used_libraries)
+        lib_id = lib_id.Clone(a);
+    result.file_extension = a.Clone(preset.file_extension);
+    return result;
+}
+
+static void AddPresetToFolder(PresetFolder& folder, PresetFolder::Preset const& preset) {
     auto presets = DynamicArray<PresetFolder::Preset>::FromOwnedSpan(folder.presets,
                                                                      folder.preset_array_capacity,
                                                                      folder.arena);
 
-    dyn::Append(presets,
-                PresetFolder::Preset {
-                    .name = folder.arena.Clone(path::FilenameWithoutExtension(entry.subpath)),
-                    .metadata {
-                        .tags = ({
-                            auto tags =
-                                folder.arena.AllocateExactSizeUninitialised<String>(state.metadata.tags.size);
-                            for (auto const i : Range(tags.size))
-                                tags[i] = folder.arena.Clone(state.metadata.tags[i]);
-                            tags;
-                        }),
-                        .author = folder.arena.Clone(state.metadata.author),
-                        .description = folder.arena.Clone(state.metadata.description),
-                    },
-                    .used_libraries = ({
-                        decltype(PresetFolder::Preset::used_libraries) used_libraries {};
-
-                        for (auto const& inst_id : state.inst_ids) {
-                            if (auto const& sampled_inst = inst_id.TryGet<sample_lib::InstrumentId>()) {
-                                auto const lib_id = (sample_lib::LibraryIdRef)sampled_inst->library;
-                                if (!Contains(used_libraries, lib_id))
-                                    dyn::Append(used_libraries, lib_id.Clone(folder.arena));
-                            }
-                        }
-
-                        if (state.ir_id) {
-                            auto const lib_id = (sample_lib::LibraryIdRef)state.ir_id->library;
-                            if (!Contains(used_libraries, lib_id))
-                                dyn::Append(used_libraries, lib_id.Clone(folder.arena));
-                        }
-
-                        used_libraries;
-                    }),
-                    .file_hash = file_hash,
-                    .file_extension = file_format == PresetFormat::Mirage
-                                          ? (String)folder.arena.Clone(path::Extension(entry.subpath))
-                                          : ""_s,
-                    .file_format = file_format,
-                });
+    dyn::Append(presets, ClonePreset(preset, folder.arena));
 
     auto const [items, cap] = presets.ToOwnedSpanUnchangedCapacity();
     folder.presets = items;
     folder.preset_array_capacity = cap;
 }
 
-struct FoldersAggregateInfo {
-    FoldersAggregateInfo(ArenaAllocator& arena)
-        : used_tags {arena}
-        , used_libraries {arena}
-        , authors {arena} {}
+static String CloneUsageKey(String key, Allocator& a) { return a.Clone(key); }
+static sample_lib::LibraryIdRef CloneUsageKey(sample_lib::LibraryIdRef const& key, Allocator& a) {
+    return key.Clone(a);
+}
 
-    void AddPreset(PresetFolder::Preset const& preset) {
-        for (auto const& tag : preset.metadata.tags)
-            used_tags.Insert(tag);
-        for (auto const& library_id : preset.used_libraries)
-            used_libraries.Insert(library_id);
-        if (preset.metadata.author.size) authors.Insert(preset.metadata.author);
-        has_preset_type[ToInt(preset.file_format)] = true;
+// Keys are never removed from the usage tables, only their counts go to zero. That way the published sets can
+// point at them without worrying about their lifetime, and they don't accumulate as presets come and go.
+template <typename UsageTable, typename PublishedSet, typename Key>
+static void IncrementUsage(UsageTable& usage, PublishedSet& published, Key const& key, Allocator& a) {
+    auto element = usage.FindElement(key);
+    if (!element) {
+        usage.Insert(CloneUsageKey(key, a), 0);
+        element = usage.FindElement(key);
     }
+    if (element->data++ == 0) published.Insert(element->key);
+}
 
-    void CopyToServer(PresetServer& server) const {
-        server.used_tags.DeleteAll();
-        for (auto const [tag, _] : used_tags)
-            server.used_tags.Insert(tag);
-
-        server.used_libraries.DeleteAll();
-        for (auto const [lib_id, _] : used_libraries)
-            server.used_libraries.Insert(lib_id);
+template <typename UsageTable, typename PublishedSet, typename Key>
+static void DecrementUsage(UsageTable& usage, PublishedSet& published, Key const& key) {
+    auto const element = usage.FindElement(key);
+    ASSERT(element && element->data);
+    if (--element->data == 0) published.Delete(key);
+}
 
-        server.authors.DeleteAll();
-        for (auto const [author, _] : authors)
-            server.authors.Insert(author);
+// Must be called with the mutex locked.
+static void AddPresetUsage(PresetServer& server, PresetFolder::Preset const& preset) {
+    for (auto const& tag : preset.metadata.tags)
+        IncrementUsage(server.tag_usage, server.used_tags, tag, server.arena);
+    for (auto const& library_id : preset.used_libraries)
+        IncrementUsage(server.library_usage, server.used_libraries, library_id, server.arena);
+    if (preset.metadata.author.size)
+        IncrementUsage(server.author_usage, server.authors, preset.metadata.author, server.arena);
+    ++server.preset_type_usage[ToInt(preset.file_format)];
+    server.has_preset_type[ToInt(preset.file_format)] = true;
+}
 
-        server.has_preset_type = has_preset_type;
-    }
+// Must be called with the mutex locked.
+static void RemovePresetUsage(PresetServer& server, PresetFolder::Preset const& preset) {
+    for (auto const& tag : preset.metadata.tags)
+        DecrementUsage(server.tag_usage, server.used_tags, tag);
+    for (auto const& library_id : preset.used_libraries)
+        DecrementUsage(server.library_usage, server.used_libraries, library_id);
+    if (preset.metadata.author.size)
+        DecrementUsage(server.author_usage, server.authors, preset.metadata.author);
+    auto& type_usage = server.preset_type_usage[ToInt(preset.file_format)];
+    ASSERT(type_usage);
+    if (--type_usage == 0) server.has_preset_type[ToInt(preset.file_format)] = false;
+}
 
-    DynamicSet<String> used_tags;
-    DynamicSet<sample_lib::LibraryIdRef, sample_lib::Hash> used_libraries;
-    DynamicSet<String> authors;
-    Array<bool, ToInt(PresetFormat::Count)> has_preset_type {};
-};
+static PresetFolder* NewPresetFolder(PresetServer& server, String scan_folder, String folder) {
+    auto preset_folder = server.folder_pool.PrependUninitialised();
+    PLACEMENT_NEW(preset_folder) PresetFolder();
+    preset_folder->scan_folder = preset_folder->arena.Clone(scan_folder);
+    preset_folder->folder = preset_folder->arena.Clone(folder);
+    return preset_folder;
+}
 
-static void
-AppendFolderAndPublish(PresetServer& server, PresetFolder* new_preset_folder, ArenaAllocator& scratch_arena) {
-    // Tags and libraries point to memory within each folder, so they share the same versioning as the
-    // folders.
-
-    FoldersAggregateInfo info {scratch_arena};
-    for (auto const& folder_set :
-         Array {server.folders.Items(), Span<PresetFolder*> {&new_preset_folder, 1}}) {
-        for (auto const folder : folder_set)
-            for (auto const& preset : folder->presets)
-                info.AddPreset(preset);
-    }
+static void SortFolders(PresetServer& server) {
+    Sort(server.folders, [](PresetFolder const* a, PresetFolder const* b) { return a->folder < b->folder; });
+}
 
+static void AppendFolderAndPublish(PresetServer& server, PresetFolder* new_preset_folder) {
     server.mutex.Lock();
     DEFER { server.mutex.Unlock(); };
 
     dyn::Append(server.folders, new_preset_folder);
-    Sort(server.folders, [](PresetFolder const* a, PresetFolder const* b) { return a->folder < b->folder; });
+    SortFolders(server);
 
-    info.CopyToServer(server);
+    for (auto const& preset : new_preset_folder->presets)
+        AddPresetUsage(server, preset);
 
     server.published_version.FetchAdd(1, RmwMemoryOrder::AcquireRelease);
 }
 
-static void RemoveFolderAndPublish(PresetServer& server, usize index, ArenaAllocator& scratch_arena) {
+static void RemoveFolderAndPublish(PresetServer& server, usize index) {
     auto& folder = *server.folders[index];
     folder.delete_after_version = server.published_version.Load(LoadMemoryOrder::Relaxed);
     for (auto const& preset : folder.presets)
         server.preset_file_hashes.Delete(preset.file_hash);
 
-    FoldersAggregateInfo info {scratch_arena};
-    for (auto const& existing_folder : server.folders) {
-        if (existing_folder == &folder) continue;
+    server.mutex.Lock();
+    DEFER { server.mutex.Unlock(); };
+
+    dyn::Remove(server.folders, index);
+
+    for (auto const& preset : folder.presets)
+        RemovePresetUsage(server, preset);
+
+    server.published_version.FetchAdd(1, RmwMemoryOrder::AcquireRelease);
+}
+
+// Adds, replaces or removes (new_preset is null) a single preset file. The reader might be using the
+// published folder so we can't modify it in place; instead we publish a copy with the change applied and
+// retire the old one. The copy is built in order so the folder doesn't need re-sorting.
+static void ReplacePresetAndPublish(PresetServer& server,
+                                    PresetServer::ScanFolder const& scan_folder,
+                                    String subfolder_of_scan_folder,
+                                    String filename,
+                                    PresetFolder::Preset const* new_preset) {
+    ASSERT(CurrentThreadId() == server.server_thread_id);
+
+    Optional<usize> folder_index {};
+    for (auto const [i, folder] : Enumerate(server.folders)) {
+        if (folder->scan_folder == scan_folder.path &&
+            path::Equal(folder->folder, subfolder_of_scan_folder)) {
+            folder_index = i;
+            break;
+        }
+    }
+    auto const old_folder = folder_index ? server.folders[*folder_index] : nullptr;
+
+    PresetFolder::Preset const* old_preset {};
+    if (old_folder) {
+        auto const name = path::FilenameWithoutExtension(filename);
+        auto const ext = path::Extension(filename);
+        for (auto const& preset : old_folder->presets) {
+            if (preset.name == name && ExtensionForPreset(preset) == ext) {
+                old_preset = &preset;
+                break;
+            }
+        }
+    }
+
+    if (new_preset) {
+        // Saved with the same content, nothing to do.
+        if (old_preset && old_preset->file_hash == new_preset->file_hash) return;
 
-        for (auto const& preset : existing_folder->presets)
-            info.AddPreset(preset);
+        // Same as we do when scanning: identical presets are only listed once.
+        if (server.preset_file_hashes.Contains(new_preset->file_hash)) new_preset = nullptr;
+    }
+    if (!old_preset && !new_preset) return;
+
+    auto const num_presets =
+        (old_folder ? old_folder->presets.size : 0) - (old_preset ? 1 : 0) + (new_preset ? 1 : 0);
+    PresetFolder* new_folder {};
+    if (num_presets) {
+        new_folder = NewPresetFolder(server, scan_folder.path, subfolder_of_scan_folder);
+        bool inserted = !new_preset;
+        if (old_folder) {
+            for (auto const& preset : old_folder->presets) {
+                if (&preset == old_preset) continue;
+                if (!inserted && new_preset->name < preset.name) {
+                    AddPresetToFolder(*new_folder, *new_preset);
+                    inserted = true;
+                }
+                AddPresetToFolder(*new_folder, preset);
+            }
+        }
+        if (!inserted) AddPresetToFolder(*new_folder, *new_preset);
     }
 
+    if (old_preset) server.preset_file_hashes.Delete(old_preset->file_hash);
+    if (new_preset) server.preset_file_hashes.Insert(new_preset->file_hash);
+
     server.mutex.Lock();
     DEFER { server.mutex.Unlock(); };
 
-    dyn::Remove(server.folders, index);
+    if (old_folder) {
+        old_folder->delete_after_version = server.published_version.Load(LoadMemoryOrder::Relaxed);
+        if (new_folder)
+            server.folders[*folder_index] = new_folder;
+        else
+            dyn::Remove(server.folders, *folder_index);
+    } else if (new_folder) {
+        dyn::Append(server.folders, new_folder);
+        SortFolders(server);
+    }
 
-    info.CopyToServer(server);
+    if (old_preset) RemovePresetUsage(server, *old_preset);
+    if (new_preset) AddPresetUsage(server, *new_preset);
 
     server.published_version.FetchAdd(1, RmwMemoryOrder::AcquireRelease);
 }
 
-static bool EntryIsPreset(dir_iterator::Entry const& entry) {
-    auto const ext = path::Extension(entry.subpath);
+// The index is only a cache: if it's missing, malformed or from a different version we just read every
+// preset again.
+struct PresetIndexHeader {
+    static constexpr u32 k_magic = 0x49505046; // "FPPI"
+    static constexpr u32 k_version = 1;
+
+    u32 magic;
+    u32 version;
+    u64 num_entries;
+};
+
+template <TriviallyCopyable Type>
+static void AppendValue(DynamicArray<u8>& out, Type const& value) {
+    dyn::AppendSpan(out, Span<u8 const> {(u8 const*)&value, sizeof(value)});
+}
+
+static void AppendString(DynamicArray<u8>& out, String str) {
+    AppendValue(out, (u32)str.size);
+    dyn::AppendSpan(out, Span<u8 const> {(u8 const*)str.data, str.size});
+}
+
+struct PresetIndexReader {
+    template <TriviallyCopyable Type>
+    bool Read(Type& value) {
+        if (cursor + sizeof(Type) > data.size) return false;
+        CopyMemory(&value, data.data + cursor, sizeof(Type));
+        cursor += sizeof(Type);
+        return true;
+    }
+
+    bool ReadString(String& str, Allocator& a) {
+        u32 size;
+        if (!Read(size) || size > data.size - cursor) return false;
+        String const result {(char const*)data.data + cursor, size};
+        if (!IsValidUtf8(result)) return false;
+        str = a.Clone(result);
+        cursor += size;
+        return true;
+    }
+
+    Span<u8 const> data;
+    usize cursor {};
+};
+
+static bool ReadPresetIndexEntries(PresetIndex& index, Span<u8 const> file_data) {
+    PresetIndexReader reader {.data = file_data};
+
+    PresetIndexHeader header;
+    if (!reader.Read(header) || header.magic != PresetIndexHeader::k_magic ||
+        header.version != PresetIndexHeader::k_version)
+        return false;
+
+    for (auto _ : Range(header.num_entries)) {
+        String path;
+        auto& entry = *index.arena.New<PresetIndex::Entry>();
+        auto& preset = entry.preset;
+        u32 num_tags;
+        u8 num_libraries;
+        if (!reader.ReadString(path, index.arena) || !reader.Read(entry.file_size) ||
+            !reader.Read(entry.modified_time_ns_since_epoch) || !reader.Read(preset.file_hash) ||
+            !reader.Read(preset.file_format) || preset.file_format >= PresetFormat::Count ||
+            !reader.ReadString(preset.name, index.arena) ||
+            !reader.ReadString(preset.file_extension, index.arena) ||
+            !reader.ReadString(preset.metadata.author, index.arena) ||
+            !reader.ReadString(preset.metadata.description, index.arena) || !reader.Read(num_tags) ||
+            num_tags > reader.data.size)
+            return false;
+
+        preset.metadata.tags = index.arena.AllocateExactSizeUninitialised<String>(num_tags);
+        for (auto& tag : preset.metadata.tags)
+            if (!reader.ReadString(tag, index.arena)) return false;
+
+        if (!reader.Read(num_libraries) || num_libraries > preset.used_libraries.Capacity()) return false;
+        for (u8 i = 0; i < num_libraries; ++i) {
+            sample_lib::LibraryIdRef lib_id;
+            if (!reader.ReadString(lib_id.author, index.arena) ||
+                !reader.ReadString(lib_id.name, index.arena))
+                return false;
+            dyn::Append(preset.used_libraries, lib_id);
+        }
+
+        index.entries.Insert(path, &entry);
+    }
+
+    return reader.cursor == reader.data.size;
+}
+
+static void ReadPresetIndex(PresetIndex& index, ArenaAllocator& scratch_arena) {
+    index.read = true;
+    if (!index.file_path.size) return;
+
+    auto const file_data = TRY_OR(ReadEntireFile(index.file_path, scratch_arena), {
+        if (error != FilesystemError::PathDoesNotExist)
+            LogDebug(ModuleName::PresetServer, "Failed to read preset index: {}", error);
+        return;
+    });
+
+    if (!ReadPresetIndexEntries(index, file_data.ToByteSpan())) {
+        LogDebug(ModuleName::PresetServer, "Preset index is invalid, ignoring it");
+        index.entries.DeleteAll();
+    }
+}
+
+// An entry that a scan didn't find is only forgotten if its folder was scanned successfully; otherwise the
+// file might still be there.
+static bool KeepIndexEntry(String path,
+                           PresetIndex::Entry const& entry,
+                           Span<PresetServer::ScanFolder const> scan_folders) {
+    if (entry.seen) return true;
+    for (auto const& f : scan_folders)
+        if (f.scan_succeeded && path::IsWithinDirectory(path, f.path)) return false;
+    return true;
+}
+
+struct KeptIndexEntry {
+    String path;
+    PresetIndex::Entry const* entry;
+};
+
+// Entries that are replaced or forgotten can't be freed individually from the arena, so we copy the kept
+// entries into a new arena and free the old one.
+static void RebuildPresetIndexArena(PresetIndex& index, Span<KeptIndexEntry const> kept) {
+    ArenaAllocator arena {PageAllocator::Instance()};
+    DynamicHashTable<String, PresetIndex::Entry*> entries {arena, kept.size};
+    for (auto const& k : kept) {
+        entries.Insert(arena.Clone(k.path),
+                       arena.New<PresetIndex::Entry>(PresetIndex::Entry {
+                           .file_size = k.entry->file_size,
+                           .modified_time_ns_since_epoch = k.entry->modified_time_ns_since_epoch,
+                           .preset = ClonePreset(k.entry->preset, arena),
+                           .seen = k.entry->seen,
+                       }));
+    }
+    auto const file_path = arena.Clone(index.file_path);
+
+    auto const table = entries.ToOwnedTable();
+    auto _ = index.entries.ToOwnedTable(); // freed along with the old arena
+    index.arena = Move(arena);
+    index.entries = DynamicHashTable<String, PresetIndex::Entry*>::FromOwnedTable(table, index.arena);
+    index.file_path = file_path;
+}
+
+static ErrorCodeOr<void> WritePresetIndex(PresetIndex& index,
+                                          Span<PresetServer::ScanFolder const> scan_folders,
+                                          ArenaAllocator& scratch_arena) {
+    index.needs_write = false;
+    if (!index.file_path.size) return k_success;
+
+    DynamicArray<KeptIndexEntry> kept {scratch_arena};
+    for (auto const [path, entry] : index.entries)
+        if (KeepIndexEntry(path, **entry, scan_folders)) dyn::Append(kept, {path, *entry});
+
+    DynamicArray<u8> data {scratch_arena};
+    AppendValue(data,
+                PresetIndexHeader {
+                    .magic = PresetIndexHeader::k_magic,
+                    .version = PresetIndexHeader::k_version,
+                    .num_entries = kept.size,
+                });
+    for (auto const& [path, entry_ptr] : kept) {
+        auto const& entry = *entry_ptr;
+        auto const& preset = entry.preset;
+        AppendString(data, path);
+        AppendValue(data, entry.file_size);
+        AppendValue(data, entry.modified_time_ns_since_epoch);
+        AppendValue(data, preset.file_hash);
+        AppendValue(data, preset.file_format);
+        AppendString(data, preset.name);
+        AppendString(data, preset.file_extension);
+        AppendString(data, preset.metadata.author);
+        AppendString(data, preset.metadata.description);
+        AppendValue(data, (u32)preset.metadata.tags.size);
+        for (auto const& tag : preset.metadata.tags)
+            AppendString(data, tag);
+        AppendValue(data, (u8)preset.used_libraries.size);
+        for (auto const& lib_id : preset.used_libraries) {
+            AppendString(data, lib_id.author);
+            AppendString(data, lib_id.name);
+        }
+    }
+
+    RebuildPresetIndexArena(index, kept);
+
+    // We write to a temporary file and then rename it so that the index is never partially written.
+    auto const folder = *path::Directory(index.file_path);
+    TRY(CreateDirectory(folder, {.create_intermediate_directories = true}));
+    auto seed = RandomSeed();
+    auto const temp_path =
+        path::Join(scratch_arena, Array {folder, (String)UniqueFilename(".tmp-", ".preset-index", seed)});
+    auto const outcome = [&]() -> ErrorCodeOr<void> {
+        TRY(WriteFile(temp_path, data.Items()));
+        return Rename(temp_path, index.file_path);
+    }();
+    if (outcome.HasError())
+        auto _ = Delete(temp_path, {.type = DeleteOptions::Type::File, .fail_if_not_exists = false});
+    return outcome;
+}
+
+static bool PathIsPreset(String path) {
+    auto const ext = path::Extension(path);
     return ext == FLOE_PRESET_FILE_EXTENSION || StartsWithSpan(ext, ".mirage"_s);
 }
 
+static Optional<PresetFolder::Preset> ReadPresetFile(String path, String filename, ArenaAllocator& arena) {
+    auto const file_data = TRY_OR(ReadEntireFile(path, arena), return k_nullopt);
+    auto const file_hash = XXH3_64bits(file_data.data, file_data.size) + Hash(filename);
+
+    auto const preset_format = PresetFormatFromPath(filename);
+
+    auto reader = Reader::FromMemory(file_data);
+    auto const snapshot = TRY_OR(LoadPresetFile(preset_format, reader, arena, true), return k_nullopt);
+
+    return PresetFromState(filename, snapshot, file_hash, preset_format, arena);
+}
+
+// Returns null if the file isn't in the index or has changed since it was indexed.
+static PresetIndex::Entry*
+FindUnchangedIndexEntry(PresetIndex& index, String path, u64 file_size, s128 modified_time_ns_since_epoch) {
+    auto const indexed = index.entries.Find(path);
+    if (!indexed) return nullptr;
+    auto const entry = *indexed;
+    if (entry->file_size != file_size || entry->modified_time_ns_since_epoch != modified_time_ns_since_epoch)
+        return nullptr;
+    return entry;
+}
+
+// The old preset's strings stay in the arena until the index is next written.
+static void UpdateIndexEntry(PresetIndex& index,
+                             String path,
+                             u64 file_size,
+                             s128 modified_time_ns_since_epoch,
+                             PresetFolder::Preset const& preset) {
+    PresetIndex::Entry const new_entry {
+        .file_size = file_size,
+        .modified_time_ns_since_epoch = modified_time_ns_since_epoch,
+        .preset = ClonePreset(preset, index.arena),
+        .seen = true,
+    };
+    if (auto const existing = index.entries.Find(path))
+        **existing = new_entry;
+    else
+        index.entries.Insert(index.arena.Clone(path), index.arena.New<PresetIndex::Entry>(new_entry));
+    index.needs_write = true;
+}
+
 ErrorCodeOr<void> ScanFolder(PresetServer& server,
                              String subfolder_of_scan_folder,
                              ArenaAllocator& scratch_arena,
@@ -281,50 +623,95 @@ ErrorCodeOr<void> ScanFolder(PresetServer& server,
                                                      .options =
                                                          {
                                                              .wildcard = "*",
-                                                             .get_file_size = false,
+                                                             .get_file_size = true,
+                                                             .get_modified_time = true,
                                                              .skip_dot_files = true,
                                                          },
                                                      .recursive = false,
                                                      .only_file_type = k_nullopt,
                                                  }));
 
-    PresetFolder* preset_folder {};
+    struct PresetFile {
+        dir_iterator::Entry const* entry;
+        String path;
+        PresetFolder::Preset const* preset; // Null if it needs reading or couldn't be read.
+        bool from_index;
+    };
+    DynamicArray<PresetFile> preset_files {scratch_arena};
+    DynamicArray<u32> files_to_read {scratch_arena};
 
     for (auto const& entry : entries) {
-        if (!EntryIsPreset(entry)) continue;
+        if (!PathIsPreset(entry.subpath)) continue;
 
         if constexpr (IS_WINDOWS) Replace(entry.subpath, '\\', '/');
 
-        auto const file_data = TRY_OR(
-            ReadEntireFile(path::Join(scratch_arena, Array {absolute_folder, entry.subpath}), scratch_arena),
-            continue);
-        DEFER { scratch_arena.Free(file_data.ToByteSpan()); };
+        PresetFile file {
+            .entry = &entry,
+            .path = path::Join(scratch_arena, Array {absolute_folder, entry.subpath}),
+            .preset = nullptr,
+            .from_index = false,
+        };
+        if (auto const index_entry = FindUnchangedIndexEntry(server.index,
+                                                             file.path,
+                                                             entry.file_size,
+                                                             entry.modified_time_ns_since_epoch)) {
+            index_entry->seen = true;
+            file.preset = &index_entry->preset;
+            file.from_index = true;
+        }
+        if (!file.preset) dyn::Append(files_to_read, (u32)preset_files.size);
+        dyn::Append(preset_files, file);
+    }
 
-        auto const file_hash = XXH3_64bits(file_data.data, file_data.size) + Hash((String)entry.subpath);
+    // Reading and decoding is the slow part so we spread it across the thread pool. Each task handles a
+    // batch of files and has its own arena for the results.
+    constexpr u32 k_files_per_task = 16;
+    auto const num_tasks = (u32)((files_to_read.size + k_files_per_task - 1) / k_files_per_task);
+    auto const task_arenas = scratch_arena.AllocateExactSizeUninitialised<ArenaAllocator>(num_tasks);
+    for (auto& a : task_arenas)
+        PLACEMENT_NEW(&a) ArenaAllocator(PageAllocator::Instance());
+    DEFER {
+        for (auto& a : task_arenas)
+            a.~ArenaAllocator();
+    };
 
-        if (server.preset_file_hashes.Contains(file_hash)) continue;
-        server.preset_file_hashes.Insert(file_hash);
+    server.thread_pool.ParallelFor(num_tasks, [&](u32 task_index) {
+        auto& arena = task_arenas[task_index];
+        auto const first = task_index * k_files_per_task;
+        for (auto const i : Range(first, Min(first + k_files_per_task, (u32)files_to_read.size))) {
+            auto& file = preset_files[files_to_read[i]];
+            if (auto const preset = ReadPresetFile(file.path, file.entry->subpath, arena))
+                file.preset = arena.New<PresetFolder::Preset>(*preset);
+        }
+    });
 
-        auto const preset_format = PresetFormatFromPath(entry.subpath);
+    PresetFolder* preset_folder {};
 
-        auto reader = Reader::FromMemory(file_data);
-        auto const snapshot = TRY_OR(LoadPresetFile(preset_format, reader, scratch_arena, true), continue);
+    for (auto const& file : preset_files) {
+        if (!file.preset) continue;
 
-        if (!preset_folder) {
-            preset_folder = server.folder_pool.PrependUninitialised();
-            PLACEMENT_NEW(preset_folder) PresetFolder();
-            preset_folder->scan_folder = preset_folder->arena.Clone(scan_folder.path);
-            preset_folder->folder = preset_folder->arena.Clone(subfolder_of_scan_folder);
+        if (!file.from_index) {
+            UpdateIndexEntry(server.index,
+                             file.path,
+                             file.entry->file_size,
+                             file.entry->modified_time_ns_since_epoch,
+                             *file.preset);
         }
 
-        AddPresetToFolder(*preset_folder, entry, snapshot, file_hash, preset_format);
+        if (server.preset_file_hashes.Contains(file.preset->file_hash)) continue;
+        server.preset_file_hashes.Insert(file.preset->file_hash);
+
+        if (!preset_folder)
+            preset_folder = NewPresetFolder(server, scan_folder.path, subfolder_of_scan_folder);
+
+        AddPresetToFolder(*preset_folder, *file.preset);
     }
 
     if (preset_folder) {
         Sort(preset_folder->presets,
              [](PresetFolder::Preset const& a, PresetFolder::Preset const& b) { return a.name < b.name; });
 
-        AppendFolderAndPublish(server, preset_folder, scratch_arena);
+        AppendFolderAndPublish(server, preset_folder);
     }
 
     if (recursive) {
@@ -346,10 +733,41 @@ static ErrorCodeOr<void>
 ScanFolder(PresetServer& server, ArenaAllocator& scratch_arena, PresetServer::ScanFolder& scan_folder) {
     if (scan_folder.scanned) return k_success;
     scan_folder.scanned = true;
+    scan_folder.scan_succeeded = false;
     TRY(ScanFolder(server, "", scratch_arena, scan_folder, true));
+    scan_folder.scan_succeeded = true;
     return k_success;
 }
 
+// Rather than interpreting the change flags we look at the file as it is now: if it can't be read as a
+// preset then it's not listed.
+static void ApplyPresetFileChange(PresetServer& server,
+                                  PresetServer::ScanFolder const& scan_folder,
+                                  String subpath,
+                                  ArenaAllocator& scratch_arena) {
+    auto const path = (String)path::Join(scratch_arena, Array {(String)scan_folder.path, subpath});
+    auto const filename = path::Filename(subpath);
+
+    auto const preset = ReadPresetFile(path, filename, scratch_arena);
+
+    auto& index = server.index;
+    if (preset) {
+        auto const file_size = FileSize(path);
+        auto const modified_time = LastModifiedTimeNsSinceEpoch(path);
+        if (file_size.HasValue() && modified_time.HasValue())
+            UpdateIndexEntry(index, path, file_size.Value(), modified_time.Value(), *preset);
+    } else if (auto const existing = index.entries.Find(path)) {
+        (*existing)->seen = false;
+        index.needs_write = true;
+    }
+
+    ReplacePresetAndPublish(server,
+                            scan_folder,
+                            path::Directory(subpath).ValueOr({}),
+                            filename,
+                            preset ? &*preset : nullptr);
+}
+
 static void ServerThread(PresetServer& server) {
     server.server_thread_id = CurrentThreadId();
 
@@ -373,6 +791,8 @@ static void ServerThread(PresetServer& server) {
 
         if (!server.enable_scanning.Load(LoadMemoryOrder::Relaxed)) continue;
 
+        if (!server.index.read) ReadPresetIndex(server.index, scratch_arena);
+
         // Consume scan folder request
         {
             server.scan_folders_request_mutex.Lock();
@@ -393,7 +813,7 @@ static void ServerThread(PresetServer& server) {
                         for (usize i = 0; i < server.folders.size;) {
                             auto& preset_folder = *server.folders[i];
                             if (preset_folder.scan_folder == scan_folder.path)
-                                RemoveFolderAndPublish(server, i, scratch_arena);
+                                RemoveFolderAndPublish(server, i);
                             else
                                 ++i;
                         }
@@ -442,6 +862,11 @@ static void ServerThread(PresetServer& server) {
 
             // Batch up changes.
             DynamicArray<PresetServer::ScanFolder*> rescan_folders {scratch_arena};
+            struct PresetFileChange {
+                PresetServer::ScanFolder* scan_folder;
+                String subpath;
+            };
+            DynamicArray<PresetFileChange> preset_file_changes {scratch_arena};
 
             if (auto const outcome = PollDirectoryChanges(*watcher,
                                                           {
@@ -483,9 +908,25 @@ static void ServerThread(PresetServer& server) {
                         // Changes to the watched directory itself.
                         if (subpath_changeset.subpath.size == 0) continue;
 
-                        // For now, we ignore the granularity of the changes and just rescan the whole folder.
-                        // IMPROVE: handle changes more granularly
-                        dyn::AppendIfNotAlreadyThere(rescan_folders, &scan_folder);
+                        using ChangeType = DirectoryWatcher::ChangeType;
+                        auto const& file_type = subpath_changeset.file_type;
+                        bool const manual_rescan_needed =
+                            subpath_changeset.changes & ChangeType::ManualRescanNeeded;
+
+                        // Changes to individual preset files are applied directly, which is the common case
+                        // of a preset being saved.
+                        if (!manual_rescan_needed && file_type != FileType::Directory &&
+                            PathIsPreset(subpath_changeset.subpath)) {
+                            dyn::Append(preset_file_changes, {&scan_folder, subpath_changeset.subpath});
+                            continue;
+                        }
+
+                        // Folders coming and going is rarer and could involve any number of presets, so we
+                        // rescan. If we don't know the file type it could be a folder.
+                        if (manual_rescan_needed || !file_type || *file_type == FileType::Directory)
+                            dyn::AppendIfNotAlreadyThere(rescan_folders, &scan_folder);
+
+                        // Any other files don't affect the listing.
                     }
                 }
             }
@@ -494,13 +935,19 @@ static void ServerThread(PresetServer& server) {
                 for (usize i = 0; i < server.folders.size;) {
                     auto& preset_folder = *server.folders[i];
                     if (preset_folder.scan_folder == scan_folder->path)
-                        RemoveFolderAndPublish(server, i, scratch_arena);
+                        RemoveFolderAndPublish(server, i);
                     else
                         ++i;
                 }
 
                 scan_folder->scanned = false; // force a rescan
             }
+
+            for (auto const& change : preset_file_changes) {
+                // A full scan will pick up the change anyway.
+                if (!change.scan_folder->scanned) continue;
+                ApplyPresetFileChange(server, *change.scan_folder, change.subpath, scratch_arena);
+            }
         }
 
         for (auto& scan_folder : server.scan_folders) {
@@ -519,6 +966,12 @@ static void ServerThread(PresetServer& server) {
             }
         }
 
+        if (server.index.needs_write) {
+            if (auto const o = WritePresetIndex(server.index, server.scan_folders, scratch_arena);
+                o.HasError())
+                LogDebug(ModuleName::PresetServer, "Failed to write preset index: {}", o.Error());
+        }
+
         DeleteUnusedFolders(server);
     }
 
@@ -534,12 +987,16 @@ void SetExtraScanFolders(PresetServer& server, Span<String const> folders) {
 }
 
 void InitPresetServer(PresetServer& server, String always_scanned_folder) {
+    // We can use the server arenas directly because the server thread isn't running yet.
     dyn::Append(server.scan_folders,
                 {
                     .always_scanned_folder = true,
-                    // We can use the server arena directly because the server thread isn't running yet.
                     .path = {server.arena.Clone(always_scanned_folder)},
                 });
+    server.index.file_path = FloeKnownDirectory(server.index.arena,
+                                                FloeKnownDirectoryType::Cache,
+                                                "preset-index"_s,
+                                                {.create = false});
 
     server.thread.Start([&server]() { ServerThread(server); }, "presets");
 }
@@ -549,3 +1006,322 @@ void ShutdownPresetServer(PresetServer& server) {
     server.work_signaller.Signal();
     server.thread.Join();
 }
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+static PresetFolder::Preset TestIndexPreset(String name, u64 file_hash, Allocator& a) {
+    PresetFolder::Preset preset {
+        .name = name,
+        .metadata =
+            {
+                .tags = a.Clone(Array {"pad"_s, "warm"_s}),
+                .author = "author"_s,
+                .description = "description"_s,
+            },
+        .file_hash = file_hash,
+        .file_format = PresetFormat::Floe,
+    };
+    dyn::Append(preset.used_libraries, {.author = "lib-author"_s, .name = "lib-name"_s});
+    return preset;
+}
+
+static void
+CheckPresetsEqual(tests::Tester& tester, PresetFolder::Preset const& a, PresetFolder::Preset const& b) {
+    CHECK_EQ(a.name, b.name);
+    CHECK_EQ(a.metadata.author, b.metadata.author);
+    CHECK_EQ(a.metadata.description, b.metadata.description);
+    REQUIRE_EQ(a.metadata.tags.size, b.metadata.tags.size);
+    for (auto const i : Range(a.metadata.tags.size))
+        CHECK_EQ(a.metadata.tags[i], b.metadata.tags[i]);
+    REQUIRE_EQ(a.used_libraries.size, b.used_libraries.size);
+    for (auto const i : Range(a.used_libraries.size))
+        CHECK(a.used_libraries[i] == b.used_libraries[i]);
+    CHECK_EQ(a.file_hash, b.file_hash);
+    CHECK_EQ(a.file_extension, b.file_extension);
+    CHECK(a.file_format == b.file_format);
+}
+
+TEST_CASE(TestPresetIndex) {
+    auto& a = tester.scratch_arena;
+    auto const folder = tests::TempFolder(tester);
+    auto const path_a = (String)path::Join(a, Array {folder, "a.floe-preset"_s});
+    auto const path_b = (String)path::Join(a, Array {folder, "b.floe-preset"_s});
+    auto const preset_a = TestIndexPreset("a", 1, a);
+    auto const preset_b = TestIndexPreset("b", 2, a);
+
+    PresetIndex index {};
+    index.file_path = index.arena.Clone(tests::TempFilename(tester));
+    UpdateIndexEntry(index, path_a, 100, 1000, preset_a);
+    UpdateIndexEntry(index, path_b, 200, 2000, preset_b);
+    CHECK(index.needs_write);
+
+    SUBCASE("write then read") {
+        TRY(WritePresetIndex(index, {}, a));
+        CHECK(!index.needs_write);
+
+        PresetIndex read_index {};
+        read_index.file_path = index.file_path;
+        ReadPresetIndex(read_index, a);
+        CHECK(read_index.read);
+        REQUIRE_EQ(read_index.entries.size, 2u);
+
+        auto const entry_a = FindUnchangedIndexEntry(read_index, path_a, 100, 1000);
+        REQUIRE(entry_a);
+        CheckPresetsEqual(tester, entry_a->preset, preset_a);
+        auto const entry_b = FindUnchangedIndexEntry(read_index, path_b, 200, 2000);
+        REQUIRE(entry_b);
+        CheckPresetsEqual(tester, entry_b->preset, preset_b);
+    }
+
+    SUBCASE("entry is stale when the file changes") {
+        CHECK(FindUnchangedIndexEntry(index, path_a, 100, 1000));
+        CHECK(!FindUnchangedIndexEntry(index, path_a, 101, 1000));
+        CHECK(!FindUnchangedIndexEntry(index, path_a, 100, 1001));
+        CHECK(!FindUnchangedIndexEntry(index, path::Join(a, Array {folder, "c.floe-preset"_s}), 100, 1000));
+    }
+
+    SUBCASE("updating an entry reuses it") {
+        auto const entry = FindUnchangedIndexEntry(index, path_a, 100, 1000);
+        REQUIRE(entry);
+        UpdateIndexEntry(index, path_a, 101, 1001, preset_b);
+        CHECK_EQ(index.entries.size, 2u);
+        CHECK(FindUnchangedIndexEntry(index, path_a, 101, 1001) == entry);
+        CheckPresetsEqual(tester, entry->preset, preset_b);
+    }
+
+    SUBCASE("invalid files are rejected") {
+        TRY(WritePresetIndex(index, {}, a));
+        auto const file_data = TRY(ReadEntireFile(index.file_path, a)).ToByteSpan();
+
+        PresetIndex read_index {};
+        for (auto const size : Range(file_data.size)) {
+            CAPTURE(size);
+            CHECK(!ReadPresetIndexEntries(read_index, file_data.SubSpan(0, size)));
+            read_index.entries.DeleteAll();
+        }
+
+        DynamicArray<u8> trailing_data {a};
+        dyn::Assign(trailing_data, file_data);
+        dyn::Append(trailing_data, 0);
+        CHECK(!ReadPresetIndexEntries(read_index, trailing_data.Items()));
+        read_index.entries.DeleteAll();
+
+        auto corrupt = a.Clone(file_data);
+        SUBCASE("bad magic") { corrupt[0] ^= 0xff; }
+        SUBCASE("bad version") { corrupt[offsetof(PresetIndexHeader, version)] ^= 0xff; }
+        SUBCASE("bad string size") { corrupt[sizeof(PresetIndexHeader) + sizeof(u32) - 1] = 0xff; }
+
+        TRY(WriteFile(index.file_path, corrupt));
+        read_index.file_path = index.file_path;
+        ReadPresetIndex(read_index, a);
+        CHECK(read_index.read);
+        CHECK_EQ(read_index.entries.size, 0u);
+    }
+
+    SUBCASE("unseen entries are only forgotten if their folder was scanned") {
+        auto const scanned_folder = (String)path::Join(a, Array {folder, "scanned"_s});
+        auto const failed_folder = (String)path::Join(a, Array {folder, "failed"_s});
+        auto const scanned_path = (String)path::Join(a, Array {scanned_folder, "c.floe-preset"_s});
+        auto const failed_path = (String)path::Join(a, Array {failed_folder, "d.floe-preset"_s});
+        UpdateIndexEntry(index, scanned_path, 300, 3000, preset_a);
+        UpdateIndexEntry(index, failed_path, 400, 4000, preset_b);
+        for (auto const [_, entry] : index.entries)
+            (*entry)->seen = false;
+
+        auto const scan_folders = Array {
+            PresetServer::ScanFolder {.path = scanned_folder, .scanned = true, .scan_succeeded = true},
+            PresetServer::ScanFolder {.path = failed_folder, .scanned = true, .scan_succeeded = false},
+        };
+        TRY(WritePresetIndex(index, scan_folders, a));
+
+        auto const check_entries = [&](PresetIndex& i) {
+            CHECK_EQ(i.entries.size, 3u);
+            CHECK(i.entries.Find(path_a));
+            CHECK(i.entries.Find(path_b));
+            CHECK(!i.entries.Find(scanned_path));
+            CHECK(i.entries.Find(failed_path));
+        };
+        check_entries(index);
+
+        PresetIndex read_index {};
+        read_index.file_path = index.file_path;
+        ReadPresetIndex(read_index, a);
+        check_entries(read_index);
+    }
+
+    return k_success;
+}
+
+struct TestPresetFile {
+    String subpath;
+    Span<String const> tags;
+    String author;
+    String library_name; // Empty for no library
+};
+
+static ErrorCodeOr<void> WriteTestPresetFile(String folder, TestPresetFile const& file, ArenaAllocator& a) {
+    StateSnapshot state {};
+    for (auto [index, param] : Enumerate(state.param_values))
+        param = k_param_descriptors[index].default_linear_value;
+    for (auto [i, type] : Enumerate(state.fx_order))
+        type = (EffectType)i;
+    for (auto const tag : file.tags)
+        dyn::Append(state.metadata.tags, tag);
+    state.metadata.author = file.author;
+    if (file.library_name.size) {
+        state.inst_ids[0] = sample_lib::InstrumentId {
+            .library = {{.author = "lib-author"_s, .name = file.library_name}},
+            .inst_name = "inst"_s,
+        };
+    }
+    return SavePresetFile(path::Join(a, Array {folder, file.subpath}), state);
+}
+
+// Incremental changes must leave the server exactly as if the folder had been scanned from scratch.
+static ErrorCodeOr<void> CheckPresetServerMatchesRescan(tests::Tester& tester, PresetServer const& server) {
+    ThreadsafeErrorNotifications error_notifications {};
+    ThreadPool thread_pool {};
+    PresetServer rescanned {.error_notifications = error_notifications, .thread_pool = thread_pool};
+    DEFER { rescanned.folder_pool.Clear(); };
+    rescanned.server_thread_id = CurrentThreadId();
+    dyn::Append(rescanned.scan_folders, {.path = server.scan_folders[0].path});
+    TRY(ScanFolder(rescanned, tester.scratch_arena, rescanned.scan_folders[0]));
+
+    REQUIRE_EQ(server.folders.size, rescanned.folders.size);
+    for (auto const i : Range(server.folders.size)) {
+        auto const& folder = *server.folders[i];
+        auto const& expected = *rescanned.folders[i];
+        CAPTURE(folder.folder);
+        CHECK_EQ(folder.folder, expected.folder);
+        if (i) CHECK(server.folders[i - 1]->folder < folder.folder);
+
+        REQUIRE_EQ(folder.presets.size, expected.presets.size);
+        for (auto const j : Range(folder.presets.size)) {
+            CheckPresetsEqual(tester, folder.presets[j], expected.presets[j]);
+            if (j) CHECK(folder.presets[j - 1].name < folder.presets[j].name);
+        }
+    }
+
+    CHECK_EQ(server.used_tags.size, rescanned.used_tags.size);
+    for (auto const [tag, _] : server.used_tags)
+        CHECK(rescanned.used_tags.Contains(tag));
+    CHECK_EQ(server.authors.size, rescanned.authors.size);
+    for (auto const [author, _] : server.authors)
+        CHECK(rescanned.authors.Contains(author));
+    CHECK_EQ(server.used_libraries.size, rescanned.used_libraries.size);
+    for (auto const [lib_id, _] : server.used_libraries)
+        CHECK(rescanned.used_libraries.Contains(lib_id));
+    for (auto const i : Range(ToInt(PresetFormat::Count)))
+        CHECK_EQ(server.has_preset_type[i], rescanned.has_preset_type[i]);
+
+    return k_success;
+}
+
+TEST_CASE(TestPresetFileChanges) {
+    auto& a = tester.scratch_arena;
+    auto const folder = (String)path::Join(a, Array {tests::TempFolder(tester), "preset-file-changes"_s});
+    auto const subfolder_preset =
+        (String)path::Join(a, Array {"sub"_s, String {"f" FLOE_PRESET_FILE_EXTENSION}});
+    TRY(CreateDirectory(path::Join(a, Array {folder, "sub"_s}), {.create_intermediate_directories = true}));
+
+    ThreadsafeErrorNotifications error_notifications {};
+    ThreadPool thread_pool {};
+    PresetServer server {.error_notifications = error_notifications, .thread_pool = thread_pool};
+    DEFER { server.folder_pool.Clear(); };
+    server.server_thread_id = CurrentThreadId();
+    dyn::Append(server.scan_folders, {.path = folder});
+    auto& scan_folder = server.scan_folders[0];
+
+    // Applied the same way as a change reported by the directory watcher.
+    auto const write_and_apply = [&](TestPresetFile const& file) -> ErrorCodeOr<void> {
+        TRY(WriteTestPresetFile(folder, file, a));
+        ApplyPresetFileChange(server, scan_folder, file.subpath, a);
+        return k_success;
+    };
+    auto const delete_and_apply = [&](String subpath) -> ErrorCodeOr<void> {
+        TRY(Delete(path::Join(a, Array {folder, subpath}), {.type = DeleteOptions::Type::File}));
+        ApplyPresetFileChange(server, scan_folder, subpath, a);
+        return k_success;
+    };
+
+    TRY(WriteTestPresetFile(folder,
+                            {
+                                .subpath = "b" FLOE_PRESET_FILE_EXTENSION,
+                                .tags = Array {"pad"_s, "warm"_s},
+                                .author = "Alice",
+                                .library_name = "L1",
+                            },
+                            a));
+    TRY(WriteTestPresetFile(folder,
+                            {
+                                .subpath = "d" FLOE_PRESET_FILE_EXTENSION,
+                                .tags = Array {"pad"_s},
+                                .author = "Bob",
+                                .library_name = "L2",
+                            },
+                            a));
+    TRY(ScanFolder(server, a, scan_folder));
+    TRY(CheckPresetServerMatchesRescan(tester, server));
+
+    // Added at the start, middle and end of the folder, and in a folder that isn't listed yet.
+    TRY(write_and_apply({
+        .subpath = "a" FLOE_PRESET_FILE_EXTENSION,
+        .tags = Array {"bright"_s},
+        .author = "Bob",
+        .library_name = {},
+    }));
+    TRY(write_and_apply({
+        .subpath = "c" FLOE_PRESET_FILE_EXTENSION,
+        .tags = Array {"warm"_s},
+        .author = "Carol",
+        .library_name = "L1",
+    }));
+    TRY(write_and_apply({
+        .subpath = "e" FLOE_PRESET_FILE_EXTENSION,
+        .tags = {},
+        .author = {},
+        .library_name = {},
+    }));
+    TRY(write_and_apply({
+        .subpath = subfolder_preset,
+        .tags = Array {"pad"_s},
+        .author = "Dave",
+        .library_name = "L3",
+    }));
+    REQUIRE_EQ(server.folders.size, 2u);
+    CHECK_EQ(server.folders[0]->presets.size, 4u);
+    TRY(CheckPresetServerMatchesRescan(tester, server));
+
+    // Updated, leaving its old author and one of its old tags unused.
+    TRY(write_and_apply({
+        .subpath = "b" FLOE_PRESET_FILE_EXTENSION,
+        .tags = Array {"dark"_s, "warm"_s},
+        .author = "Eve",
+        .library_name = "L2",
+    }));
+    CHECK(!server.authors.Contains("Alice"_s));
+    CHECK(server.used_tags.Contains("dark"_s));
+    TRY(CheckPresetServerMatchesRescan(tester, server));
+
+    // Removed, including the only preset in a folder.
+    TRY(delete_and_apply("d" FLOE_PRESET_FILE_EXTENSION));
+    TRY(delete_and_apply(subfolder_preset));
+    REQUIRE_EQ(server.folders.size, 1u);
+    CHECK(!server.used_libraries.Contains({.author = "lib-author"_s, .name = "L3"_s}));
+    TRY(CheckPresetServerMatchesRescan(tester, server));
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterPresetServerTests) {
+    REGISTER_TEST(TestPresetIndex);
+    REGISTER_TEST(TestPresetFileChanges);
+}
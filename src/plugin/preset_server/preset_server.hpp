@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include "utils/thread_extra/thread_pool.hpp"
+
 #include "state/state_coding.hpp"
 #include "state/state_snapshot.hpp"
 
@@ -32,16 +34,35 @@ struct PresetFolder {
 
 u64 NoHash(u64 const&);
 
+// Presets that we've already read, keyed by absolute path. It's persisted between sessions so that presets
+// whose size and modified time haven't changed can be listed without opening them.
+struct PresetIndex {
+    struct Entry {
+        u64 file_size {};
+        s128 modified_time_ns_since_epoch {};
+        PresetFolder::Preset preset {};
+        bool seen {}; // Found by a scan this session.
+    };
+
+    ArenaAllocator arena {PageAllocator::Instance()};
+    DynamicHashTable<String, Entry*> entries {arena};
+    String file_path {};
+    bool read {};
+    bool needs_write {};
+};
+
 struct PresetServer {
     struct ScanFolder {
         bool always_scanned_folder {};
         String path {};
         bool scanned {};
+        bool scan_succeeded {}; // the index forgets presets in this folder that the scan didn't find
     };
 
     static constexpr u64 k_no_version = (u64)-1;
 
     ThreadsafeErrorNotifications& error_notifications;
+    ThreadPool& thread_pool; // Preset files are read and decoded on this
 
     // The reader thread can send the server an array of folder that it should scan.
     Mutex scan_folders_request_mutex;
@@ -59,17 +80,27 @@ struct PresetServer {
     Atomic<u64> published_version {};
     Atomic<u64> version_in_use = k_no_version;
 
-    // The next 3 fields are versioned and mutex protected
+    // The next 5 fields are versioned and mutex protected
     DynamicArray<PresetFolder*> folders {arena};
     DynamicSet<String> used_tags {arena};
     DynamicSet<sample_lib::LibraryIdRef, sample_lib::Hash> used_libraries {arena};
     DynamicSet<String> authors {arena};
+    Array<bool, ToInt(PresetFormat::Count)> has_preset_type {};
+
+    // Preset thread. How many listed presets use each tag, library, author and format. This lets us update
+    // the sets above as presets are added or removed rather than rebuilding them from every folder. The keys
+    // are owned by the server arena rather than any folder, so the sets don't depend on folder lifetimes.
+    DynamicHashTable<String, u32> tag_usage {arena};
+    DynamicHashTable<sample_lib::LibraryIdRef, u32, sample_lib::Hash> library_usage {arena};
+    DynamicHashTable<String, u32> author_usage {arena};
+    Array<u32, ToInt(PresetFormat::Count)> preset_type_usage {};
 
     DynamicSet<u64, NoHash> preset_file_hashes {arena};
-    Array<bool, ToInt(PresetFormat::Count)> has_preset_type {};
 
     DynamicArray<ScanFolder> scan_folders {arena};
 
+    PresetIndex index {}; // Preset thread
+
     Thread thread;
     WorkSignaller work_signaller;
     u64 server_thread_id {};
@@ -84,6 +115,7 @@ void ShutdownPresetServer(PresetServer& server);
 void SetExtraScanFolders(PresetServer& server, Span<String const> folders);
 
 struct PresetsSnapshot {
+    u64 version; // Changes whenever anything in the snapshot changes
     Span<PresetFolder const*> folders; // Sorted
 
     // Additional convenience data
@@ -114,4 +114,70 @@ struct Processor {
     State state = State::Idle;
 };
 
+// Runs 4 envelopes in lockstep, one per SIMD lane, each with its own Params. Each lane gives exactly the same
+// output as Processor::Process. Lanes that aren't in the active mask don't change state.
+struct ProcessorX4 {
+    void LoadLane(u32 lane, Processor const& processor, Params const& params) {
+        prev_output[lane] = processor.prev_output;
+        output[lane] = processor.output;
+        state[lane] = (s32)processor.state;
+        attack_coef[lane] = params.attack_coef;
+        attack_base[lane] = params.attack_base;
+        decay_coef[lane] = params.decay_coef;
+        decay_base[lane] = params.decay_base;
+        release_coef[lane] = params.release_coef;
+        release_base[lane] = params.release_base;
+        sustain_amount[lane] = params.sustain_amount;
+    }
+
+    void StoreLane(u32 lane, Processor& processor) const {
+        processor.prev_output = prev_output[lane];
+        processor.output = output[lane];
+        processor.state = (State)state[lane];
+    }
+
+    ALWAYS_INLINE f32x4 Process(s32x4 active) {
+        auto const attacking = active & (state == (s32)State::Attack);
+        auto const decaying = active & (state == (s32)State::Decay);
+        auto const sustaining = active & (state == (s32)State::Sustain);
+        auto const releasing = active & (state == (s32)State::Release);
+
+        // Every state is 'output = base + output * coef'. Idle and inactive lanes keep their output.
+        auto coef = Select(attacking, attack_coef, Select(decaying, decay_coef, f32x4(1)));
+        coef = Select(releasing, release_coef, Select(sustaining, f32x4(0), coef));
+        auto base = Select(attacking, attack_base, Select(decaying, decay_base, f32x4(0)));
+        base = Select(releasing, release_base, Select(sustaining, sustain_amount, base));
+        output = base + output * coef;
+
+        auto const attack_done = attacking & (output >= 1.0f);
+        output = Select(attack_done, f32x4(1), output);
+        prev_output = Select(attack_done, f32x4(1), prev_output);
+        state = Select(attack_done, s32x4((s32)State::Decay), state);
+
+        auto const decay_done = decaying & (output <= sustain_amount);
+        output = Select(decay_done, sustain_amount, output);
+        state = Select(decay_done, s32x4((s32)State::Sustain), state);
+
+        auto const release_done = releasing & (output <= 0.0f);
+        output = Select(release_done, f32x4(0), output);
+        prev_output = Select(release_done, f32x4(0), prev_output);
+        state = Select(release_done, s32x4((s32)State::Idle), state);
+
+        static constexpr f32 k_smoothing_amount = 0.10f;
+        prev_output = Select(active, prev_output + k_smoothing_amount * (output - prev_output), prev_output);
+        return Clamp(prev_output, f32x4(0), f32x4(1));
+    }
+
+    f32x4 prev_output {};
+    f32x4 output {};
+    s32x4 state {};
+    f32x4 attack_coef {};
+    f32x4 attack_base {};
+    f32x4 decay_coef {};
+    f32x4 decay_base {};
+    f32x4 release_coef {};
+    f32x4 release_base {};
+    f32x4 sustain_amount {};
+};
+
 } // namespace adsr
@@ -9,13 +9,12 @@
 
 struct OnePoleLowPassFilter {
     f32 LowPass(f32 const input, f32 const cutoff01) {
-        f32 const output = m_prev_output + cutoff01 * (input - m_prev_output);
-        m_prev_output = output;
+        f32 const output = prev_output + cutoff01 * (input - prev_output);
+        prev_output = output;
         return output;
     }
 
-  private:
-    f32 m_prev_output {};
+    f32 prev_output {};
 };
 
 // ===============================================================================
@@ -87,6 +86,27 @@ inline StereoAudioFrame Process(StereoData& d, Coeffs const& c, StereoAudioFrame
     return out;
 }
 
+// The same as calling Process for each frame, but the state stays in registers for the whole block.
+inline void ProcessBlock(StereoData& d, Coeffs const& c, Span<StereoAudioFrame> frames) {
+    f32x2 in1 {d.in1.l, d.in1.r};
+    f32x2 in2 {d.in2.l, d.in2.r};
+    f32x2 out1 {d.out1.l, d.out1.r};
+    f32x2 out2 {d.out2.l, d.out2.r};
+    for (auto& frame : frames) {
+        f32x2 const in {frame.l, frame.r};
+        auto const out = c.b0 * in + c.b1 * in1 + c.b2 * in2 - c.a1 * out1 - c.a2 * out2;
+        in2 = in1;
+        in1 = in;
+        out2 = out1;
+        out1 = out;
+        frame = {out[0], out[1]};
+    }
+    d.in1 = {in1[0], in1[1]};
+    d.in2 = {in2[0], in2[1]};
+    d.out1 = {out1[0], out1[1]};
+    d.out2 = {out2[0], out2[1]};
+}
+
 inline f32 Process(Filter& f, f32 in) { return Process(f.data, f.coeffs, in); }
 
 static Coeffs Coefficients(Params const& p) {
@@ -68,3 +68,40 @@ struct LFO {
     u32 phase_increment_per_tick = 0;
     f32 table[257] = {}; // table[0] == table[256] to avoid edge case
 };
+
+// Ticks 4 LFOs in lockstep, one per SIMD lane. Each lane gives exactly the same output as LFO::Tick. Lanes
+// that aren't in the active mask don't advance.
+struct LfoX4 {
+    void LoadLane(u32 lane, LFO const& lfo) {
+        phase[lane] = lfo.phase;
+        phase_increment_per_tick[lane] = lfo.phase_increment_per_tick;
+        tables[lane] = lfo.table;
+    }
+
+    void StoreLane(u32 lane, LFO& lfo) const { lfo.phase = phase[lane]; }
+
+    ALWAYS_INLINE f32x4 Tick(s32x4 active) {
+        auto const index = phase >> 24;
+        auto const frac = ConvertVector(phase & 0x00FFFFFF, f32x4) * (1.0f / (f32)(1 << 24));
+
+        phase += phase_increment_per_tick & __builtin_bit_cast(u32x4, active);
+
+        // The tables are different for each lane so this part can't be vectorised.
+        f32x4 a;
+        f32x4 b;
+        for (auto const lane : Range(4u)) {
+            a[lane] = tables[lane][index[lane]];
+            b[lane] = tables[lane][index[lane] + 1];
+        }
+
+        auto const output = LinearInterpolate(frac, a, b);
+        return (output + 1.0f) - 1.0f;
+    }
+
+    // Unused lanes still read a table, so they read this.
+    static constexpr f32 k_silent_table[257] {};
+
+    u32x4 phase {};
+    u32x4 phase_increment_per_tick {};
+    Array<f32 const*, 4> tables {k_silent_table, k_silent_table, k_silent_table, k_silent_table};
+};
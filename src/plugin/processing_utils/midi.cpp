@@ -3,6 +3,10 @@
 
 #include "midi.hpp"
 
+#include "tests/framework.hpp"
+
+#include "common_infrastructure/common_errors.hpp"
+
 Optional<RpnDetector::Rpn> RpnDetector::DetectRpnFromCcMessage(MidiMessage msg) {
     ASSERT_EQ(msg.Type(), MidiMessageType::ControlChange);
 
@@ -67,3 +71,222 @@ Optional<RpnDetector::Rpn> RpnDetector::DetectRpnFromCcMessage(MidiMessage msg)
 
     return k_nullopt;
 }
+
+struct MidiFileCursor {
+    Span<u8 const> data;
+    usize pos;
+};
+
+static ErrorCodeOr<u32> ReadBigEndian(MidiFileCursor& cursor, usize num_bytes) {
+    ASSERT(num_bytes <= 4);
+    if (cursor.pos + num_bytes > cursor.data.size) return ErrorCode {CommonError::InvalidFileFormat};
+    u32 result = 0;
+    for (auto const _ : Range(num_bytes))
+        result = (result << 8) | cursor.data[cursor.pos++];
+    return result;
+}
+
+static ErrorCodeOr<u32> ReadVariableLength(MidiFileCursor& cursor) {
+    u32 result = 0;
+    for (auto const _ : Range(4)) {
+        auto const byte = TRY(ReadBigEndian(cursor, 1));
+        result = (result << 7) | (byte & 0x7f);
+        if (!(byte & 0x80)) return result;
+    }
+    return ErrorCode {CommonError::InvalidFileFormat};
+}
+
+static ErrorCodeOr<void> Skip(MidiFileCursor& cursor, usize num_bytes) {
+    if (cursor.pos + num_bytes > cursor.data.size) return ErrorCode {CommonError::InvalidFileFormat};
+    cursor.pos += num_bytes;
+    return k_success;
+}
+
+ErrorCodeOr<Span<TimedMidiMessage>> ParseMidiFile(Span<u8 const> file_data,
+                                                  f64 sample_rate,
+                                                  ArenaAllocator& arena,
+                                                  ArenaAllocator& scratch_arena) {
+    struct Event {
+        u64 tick;
+        u32 order; // Sort isn't stable, events on the same tick must stay in file order.
+        u32 microseconds_per_quarter; // 0 if this is a MidiMessage
+        MidiMessage message;
+    };
+
+    MidiFileCursor cursor {.data = file_data, .pos = 0};
+
+    if (TRY(ReadBigEndian(cursor, 4)) != 0x4d546864) // "MThd"
+        return ErrorCode {CommonError::InvalidFileFormat};
+    auto const header_size = TRY(ReadBigEndian(cursor, 4));
+    if (header_size < 6) return ErrorCode {CommonError::InvalidFileFormat};
+    auto const format = TRY(ReadBigEndian(cursor, 2));
+    TRY(ReadBigEndian(cursor, 2)); // number of tracks, we just read until the end of the file
+    auto const ticks_per_quarter = TRY(ReadBigEndian(cursor, 2));
+    TRY(Skip(cursor, header_size - 6));
+
+    // Format 2 files are independent sequences rather than simultaneous tracks. SMPTE time division is
+    // rare enough that we don't support it.
+    if (format > 1 || (ticks_per_quarter & 0x8000) || ticks_per_quarter == 0)
+        return ErrorCode {CommonError::InvalidFileFormat};
+
+    DynamicArray<Event> events {scratch_arena};
+    while (cursor.pos + 8 <= cursor.data.size) {
+        auto const chunk_id = TRY(ReadBigEndian(cursor, 4));
+        auto const chunk_size = TRY(ReadBigEndian(cursor, 4));
+        if (cursor.pos + chunk_size > cursor.data.size) return ErrorCode {CommonError::InvalidFileFormat};
+        auto const chunk_end = cursor.pos + chunk_size;
+
+        if (chunk_id != 0x4d54726b) { // "MTrk"
+            cursor.pos = chunk_end;
+            continue;
+        }
+
+        u64 tick = 0;
+        u8 running_status = 0;
+        while (cursor.pos < chunk_end) {
+            tick += TRY(ReadVariableLength(cursor));
+            auto status = (u8)TRY(ReadBigEndian(cursor, 1));
+
+            if (status == 0xff) {
+                auto const meta_type = TRY(ReadBigEndian(cursor, 1));
+                auto const size = TRY(ReadVariableLength(cursor));
+                if (meta_type == 0x2f) break; // end of track
+                if (meta_type == 0x51 && size == 3) {
+                    auto const tempo = TRY(ReadBigEndian(cursor, 3));
+                    if (tempo)
+                        dyn::Append(events,
+                                    {
+                                        .tick = tick,
+                                        .order = (u32)events.size,
+                                        .microseconds_per_quarter = tempo,
+                                    });
+                } else {
+                    TRY(Skip(cursor, size));
+                }
+                continue;
+            }
+
+            if (status == 0xf0 || status == 0xf7) {
+                TRY(Skip(cursor, TRY(ReadVariableLength(cursor))));
+                running_status = 0;
+                continue;
+            }
+
+            u8 data1;
+            if (status < 0x80) {
+                if (!running_status) return ErrorCode {CommonError::InvalidFileFormat};
+                data1 = status;
+                status = running_status;
+            } else if (status < 0xf0) {
+                running_status = status;
+                data1 = (u8)TRY(ReadBigEndian(cursor, 1));
+            } else {
+                return ErrorCode {CommonError::InvalidFileFormat};
+            }
+
+            u8 data2 = 0;
+            auto const type = (MidiMessageType)(status >> 4);
+            if (type != MidiMessageType::ProgramChange && type != MidiMessageType::ChannelAftertouch)
+                data2 = (u8)TRY(ReadBigEndian(cursor, 1));
+
+            dyn::Append(events,
+                        {
+                            .tick = tick,
+                            .order = (u32)events.size,
+                            .microseconds_per_quarter = 0,
+                            .message = {.status = status, .data1 = data1, .data2 = data2},
+                        });
+        }
+        cursor.pos = chunk_end;
+    }
+
+    Sort(events, [](Event const& a, Event const& b) {
+        if (a.tick != b.tick) return a.tick < b.tick;
+        return a.order < b.order;
+    });
+
+    DynamicArray<TimedMidiMessage> result {arena};
+    f64 seconds = 0;
+    f64 seconds_per_tick = 0.5 / ticks_per_quarter; // 120 BPM until told otherwise
+    u64 prev_tick = 0;
+    for (auto const& e : events) {
+        seconds += (f64)(e.tick - prev_tick) * seconds_per_tick;
+        prev_tick = e.tick;
+        if (e.microseconds_per_quarter)
+            seconds_per_tick = e.microseconds_per_quarter / 1'000'000.0 / ticks_per_quarter;
+        else
+            dyn::Append(result, {.frame = (u64)(seconds * sample_rate + 0.5), .message = e.message});
+    }
+
+    return result.ToOwnedSpan();
+}
+
+TEST_CASE(TestParseMidiFile) {
+    auto& a = tester.scratch_arena;
+
+    // Format 1: a tempo track and a note track. 96 ticks per quarter note.
+    constexpr auto k_file = Array<u8, 71> {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0, 96,
+        // tempo track: 120 BPM, then 240 BPM from tick 96
+        'M', 'T', 'r', 'k', 0, 0, 0, 18,
+        0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20, //
+        0x60, 0xff, 0x51, 0x03, 0x03, 0xd0, 0x90, //
+        0x00, 0xff, 0x2f, 0x00,
+        // note track
+        'M', 'T', 'r', 'k', 0, 0, 0, 23,
+        0x00, 0x90, 60, 100, // note on
+        0x60, 60, 0, // running status note on with 0 velocity
+        0x60, 0x80, 62, 0, // note off
+        0x00, 0xf0, 0x02, 0x01, 0xf7, // sysex, ignored
+        0x00, 0xc0, 5, // program change, only 1 data byte
+        0x00, 0xff, 0x2f, 0x00,
+    };
+
+    SUBCASE("messages and frames") {
+        auto const messages = TRY(ParseMidiFile(k_file, 1000, a, a));
+        REQUIRE_EQ(messages.size, 4u);
+
+        CHECK_EQ(messages[0].frame, 0u);
+        CHECK_EQ(messages[0].message.status, 0x90);
+        CHECK_EQ(messages[0].message.data1, 60);
+        CHECK_EQ(messages[0].message.data2, 100);
+
+        // 96 ticks at 120 BPM.
+        CHECK_EQ(messages[1].frame, 500u);
+        CHECK_EQ(messages[1].message.status, 0x90);
+        CHECK_EQ(messages[1].message.data1, 60);
+        CHECK_EQ(messages[1].message.data2, 0);
+
+        // Another 96 ticks at 240 BPM.
+        CHECK_EQ(messages[2].frame, 750u);
+        CHECK_EQ(messages[2].message.status, 0x80);
+        CHECK_EQ(messages[2].message.data1, 62);
+
+        CHECK_EQ(messages[3].frame, 750u);
+        CHECK_EQ(messages[3].message.status, 0xc0);
+        CHECK_EQ(messages[3].message.data1, 5);
+    }
+
+    SUBCASE("invalid files") {
+        auto const check_invalid = [&](Span<u8 const> data) {
+            auto const o = ParseMidiFile(data, 1000, a, a);
+            CHECK(o.HasError() && o.Error() == CommonError::InvalidFileFormat);
+        };
+
+        check_invalid({});
+        check_invalid(Span<u8 const> {k_file}.SubSpan(0, 10));
+        check_invalid(Span<u8 const> {k_file}.SubSpan(0, k_file.size - 4));
+
+        auto format_2 = k_file;
+        format_2[9] = 2;
+        check_invalid(format_2);
+
+        auto no_running_status = k_file;
+        no_running_status[49] = 0x60; // replaces the status byte of the first note on
+        check_invalid(no_running_status);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterMidiTests) { REGISTER_TEST(TestParseMidiFile); }
@@ -128,3 +128,18 @@ struct RpnDetector {
     u7 param_val_msb;
     u7 param_val_lsb;
 };
+
+// Standard MIDI File
+// ==========================================================================================================
+
+struct TimedMidiMessage {
+    u64 frame;
+    MidiMessage message;
+};
+
+// Reads the channel messages of a Standard MIDI File (format 0 or 1), converting their times to frames using
+// the file's tempo map. Everything else (sysex, meta events other than tempo) is ignored.
+ErrorCodeOr<Span<TimedMidiMessage>> ParseMidiFile(Span<u8 const> file_data,
+                                                  f64 sample_rate,
+                                                  ArenaAllocator& arena,
+                                                  ArenaAllocator& scratch_arena);
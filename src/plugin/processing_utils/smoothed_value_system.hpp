@@ -7,6 +7,21 @@
 
 #include "filters.hpp"
 
+// How a smoothed value changes over the current block: a linear ramp for the first length frames, then
+// exactly target for the rest. Hot loops can use this directly rather than asking for each frame's value.
+template <typename Type>
+struct SmoothedValueRamp {
+    ALWAYS_INLINE Type At(u32 frame_index) const {
+        return frame_index < length ? start + step * (Type)frame_index : target;
+    }
+    bool IsConstant() const { return length == 0; }
+
+    Type start {};
+    Type step {};
+    Type target {};
+    u32 length {};
+};
+
 template <usize k_max_num_float_smoothers, usize k_max_num_double_smoothers, usize k_max_num_filter_smoothers>
 class SmoothedValueSystem {
   public:
@@ -56,6 +71,9 @@ class SmoothedValueSystem {
         return m_float_smoothers.IsSmoothing(smoother, frame_index);
     }
 
+    // If false, Value() gives the same coefficients and a mix of 1 for every frame of this block.
+    bool IsSmoothing(FilterId smoother) const { return m_processed_filter_this_frame[u16(smoother)]; }
+
     rbj_filter::SmoothedCoefficients::State Value(FilterId smoother, u32 frame_index) const {
         ASSERT(frame_index < m_num_valid_frames);
 
@@ -65,6 +83,11 @@ class SmoothedValueSystem {
             return {m_smoothed_filters[u16(smoother)].Coeffs(), 1};
     }
 
+    SmoothedValueRamp<f32> Ramp(FloatId smoother) const { return m_float_smoothers.Ramp(smoother); }
+    SmoothedValueRamp<f64> Ramp(DoubleId smoother) const { return m_double_smoothers.Ramp(smoother); }
+
+    // Writes every frame's value for this block into a contiguous buffer. Prefer Ramp() if you don't need
+    // the values in memory.
     f32* AllValues(FloatId smoother) { return m_float_smoothers.AllValues(m_num_valid_frames, smoother); }
 
     f32 TargetValue(FloatId smoother) const { return m_float_smoothers.TargetValue(smoother); }
@@ -167,6 +190,7 @@ class SmoothedValueSystem {
             auto const num = (u32)((Type)sample_rate * (transition_ms / (Type)1000.0));
             if (!num) return;
             remaining_smoothing_steps[u16(smoother)] = num;
+            MarkActive(u16(smoother));
         }
 
         void HardSet(IdType smoother, Type value) {
@@ -182,70 +206,127 @@ class SmoothedValueSystem {
             for (auto& r : remaining_smoothing_steps.Items().SubSpan(0, num_smoothers))
                 r = 0;
 
-            for (auto& n : num_frames_smoothed_this_block.Items().SubSpan(0, num_smoothers))
-                n = 0;
+            for (auto& r : ramps.Items().SubSpan(0, num_smoothers))
+                r = {};
+
+            for (auto& a : is_active.Items().SubSpan(0, num_smoothers))
+                a = false;
+            num_active = 0;
         }
 
         Type Value(u32 block_size, IdType smoother, u32 frame_index) const {
             ASSERT(frame_index < block_size);
 
-            if (frame_index < num_frames_smoothed_this_block[u16(smoother)])
-                return result_buffer[u16(smoother) * block_size + frame_index];
+            auto const& ramp = ramps[u16(smoother)];
+            if (frame_index < ramp.length)
+                return ramp.start + ramp.step * (Type)frame_index;
             else
                 return smoothed_values[u16(smoother)].target;
         }
 
         bool IsSmoothing(IdType smoother, u32 frame_index) const {
-            return frame_index < num_frames_smoothed_this_block[u16(smoother)];
+            return frame_index < ramps[u16(smoother)].num_smoothed_frames;
+        }
+
+        SmoothedValueRamp<Type> Ramp(IdType smoother) const {
+            auto const& ramp = ramps[u16(smoother)];
+            return {
+                .start = ramp.start,
+                .step = ramp.step,
+                .target = smoothed_values[u16(smoother)].target,
+                .length = ramp.length,
+            };
         }
 
         Type* AllValues(u32 block_size, IdType smoother) {
-            auto const result_buffer_offset = u16(smoother) * block_size;
-
-            if (num_frames_smoothed_this_block[u16(smoother)] < block_size) {
-                auto const start_index =
-                    result_buffer_offset + Max(num_frames_smoothed_this_block[u16(smoother)], 0u);
-                auto const end_index = result_buffer_offset + block_size;
-                auto const target = smoothed_values[u16(smoother)].target;
-                for (auto i = start_index; i < end_index; ++i)
-                    result_buffer[i] = target;
+            auto const ramp = Ramp(smoother);
+            auto* values = result_buffer.data + (u16(smoother) * block_size);
+
+            u32 frame = 0;
+            if constexpr (Same<Type, f32>) {
+                // Each value is computed from its index rather than accumulated, so there's no drift.
+                auto const offsets = f32x4 {0, 1, 2, 3};
+                for (; frame + 4 <= ramp.length; frame += 4)
+                    StoreToUnaligned(values + frame, ramp.start + ramp.step * (offsets + (f32)frame));
+            }
+            for (; frame < ramp.length; ++frame)
+                values[frame] = ramp.At(frame);
+
+            if constexpr (Same<Type, f32>) {
+                auto const target = f32x4(ramp.target);
+                for (; frame + 4 <= block_size; frame += 4)
+                    StoreToUnaligned(values + frame, target);
             }
+            for (; frame < block_size; ++frame)
+                values[frame] = ramp.target;
 
-            return result_buffer.data + result_buffer_offset;
+            return values;
         }
 
         Type TargetValue(IdType smoother) const { return smoothed_values[u16(smoother)].target; }
 
         void ProcessBlock(u32 block_size) {
-            if (!num_smoothers) return;
-
-            for (auto& n : num_frames_smoothed_this_block.Items().SubSpan(0, num_smoothers))
-                n = 0;
-
-            for (auto const smoother_index : Range(num_smoothers)) {
+            // Only smoothers that were ramping last block or have been Set() since are looked at; most
+            // smoothers are idle most of the time.
+            for (u16 active_index = 0; active_index < num_active;) {
+                auto const smoother_index = active_smoothers[active_index];
+                auto& v = smoothed_values[smoother_index];
                 auto& remaining = remaining_smoothing_steps[smoother_index];
-                if (remaining) {
-                    auto const initial_remaining = remaining;
-                    for (usize i = 0; i < block_size && remaining; ++i) {
-                        auto& v = smoothed_values[smoother_index];
-                        v.current += (v.target - v.current) / (Type)remaining;
-                        --remaining;
-                        result_buffer[smoother_index * (usize)block_size + i] = v.current;
-                    }
-                    num_frames_smoothed_this_block[smoother_index] = initial_remaining - remaining;
+                auto& ramp = ramps[smoother_index];
+
+                if (!remaining) {
+                    // Finished (or HardSet) since last block.
+                    ramp = {};
+                    is_active[smoother_index] = false;
+                    active_smoothers[active_index] = active_smoothers[--num_active];
+                    continue;
+                }
+
+                // Each step moves 1/remaining of the distance to the target, which is a straight line.
+                auto const step = (v.target - v.current) / (Type)remaining;
+                ramp.start = v.current + step;
+                ramp.step = step;
+                if (remaining <= block_size) {
+                    // The last frame of the ramp is exactly the target, so that frame can be left to the
+                    // non-ramping path.
+                    ramp.length = remaining - 1;
+                    ramp.num_smoothed_frames = remaining;
+                    v.current = v.target;
+                    remaining = 0;
+                } else {
+                    ramp.length = block_size;
+                    ramp.num_smoothed_frames = block_size;
+                    v.current += step * (Type)block_size;
+                    remaining -= block_size;
                 }
+                ++active_index;
             }
         }
 
-        Span<Type> result_buffer {};
+        void MarkActive(u16 smoother_index) {
+            if (is_active[smoother_index]) return;
+            is_active[smoother_index] = true;
+            active_smoothers[num_active++] = smoother_index;
+        }
+
+        Span<Type> result_buffer {}; // only written by AllValues()
 
         struct SmoothedValue {
             Type current {}, target {};
         };
+        struct BlockRamp {
+            Type start {}, step {};
+            u32 length {};
+            u32 num_smoothed_frames {}; // length plus the frame that lands on the target, if any
+        };
         u16 num_smoothers {};
         Array<SmoothedValue, k_max_num_smoothers> smoothed_values {};
         Array<u32, k_max_num_smoothers> remaining_smoothing_steps {};
-        Array<u32, k_max_num_smoothers> num_frames_smoothed_this_block {};
+        Array<BlockRamp, k_max_num_smoothers> ramps {}; // for the current block
+
+        u16 num_active {};
+        Array<u16, k_max_num_smoothers> active_smoothers {};
+        Array<bool, k_max_num_smoothers> is_active {};
     };
 
     u32 m_num_valid_frames {};
@@ -5,6 +5,8 @@
 
 #include "tests/framework.hpp"
 
+#include "smoothed_value_system.hpp"
+
 //=================================================
 //  _______        _
 // |__   __|      | |
@@ -118,4 +120,121 @@ TEST_CASE(TestDSPVolumefade) {
     return k_success;
 }
 
-TEST_REGISTRATION(RegisterVolumeFadeTests) { REGISTER_TEST(TestDSPVolumefade); }
+TEST_CASE(TestSmoothedValueRamps) {
+    // With this sample rate a transition of n ms takes n frames.
+    constexpr f32 k_sample_rate = 1000;
+    SmoothedValueSystem<2, 1, 1> system;
+    auto const id = system.CreateSmoother();
+    auto const double_id = system.CreateDoubleSmoother();
+
+    constexpr u32 k_max_block_size = 64;
+    system.PrepareToPlay(k_max_block_size, k_sample_rate, tester.scratch_arena);
+    system.ResetAll();
+
+    SUBCASE("matches the per-frame recurrence") {
+        // What the smoother used to do for every frame: move 1/remaining of the way to the target.
+        struct OldSmoother {
+            f64 Next() {
+                if (remaining) {
+                    current += (target - current) / (f64)remaining;
+                    --remaining;
+                }
+                return current;
+            }
+            void Set(f64 value, u32 num_frames) {
+                target = value;
+                remaining = num_frames;
+            }
+            f64 current {}, target {};
+            u32 remaining {};
+        };
+
+        for (auto const block_size : Array {1u, 7u, 64u}) {
+            CAPTURE(block_size);
+            system.HardSet(id, 0);
+            system.HardSet(double_id, 0);
+            OldSmoother old {};
+
+            // Ramps that end mid-block, on a block boundary and span many blocks, including one that's
+            // retargeted while still ramping.
+            struct Change {
+                u32 block;
+                f32 value;
+                u32 num_frames;
+            };
+            constexpr Change k_changes[] {{0, 1, 10}, {5, -3, 100}, {8, 0.5f, 64}, {30, 2, 7}};
+
+            for (auto const block : Range(60u)) {
+                CAPTURE(block);
+                for (auto const& c : k_changes) {
+                    if (c.block != block) continue;
+                    system.Set(id, c.value, (f32)c.num_frames);
+                    system.Set(double_id, (f64)c.value, (f32)c.num_frames);
+                    old.Set((f64)c.value, c.num_frames);
+                }
+                system.ProcessBlock(block_size);
+
+                auto const ramp = system.Ramp(id);
+                auto const values = system.AllValues(id);
+                for (auto const frame : Range(block_size)) {
+                    CAPTURE(frame);
+                    auto const old_is_smoothing = old.remaining != 0;
+                    auto const expected = old.Next();
+                    CHECK_APPROX_EQ((f64)system.Value(id, frame), expected, 0.0001);
+                    CHECK_APPROX_EQ(system.Value(double_id, frame), expected, 0.000000001);
+                    CHECK_APPROX_EQ(values[frame], system.Value(id, frame), 0.000001f);
+                    CHECK_EQ(ramp.At(frame), system.Value(id, frame));
+                    CHECK_EQ(system.IsSmoothing(id, frame), old_is_smoothing);
+                }
+            }
+        }
+    }
+
+    SUBCASE("the last frame of a ramp is exactly the target") {
+        system.HardSet(id, 0);
+        system.Set(id, 1, 10);
+        system.ProcessBlock(k_max_block_size);
+
+        auto const ramp = system.Ramp(id);
+        CHECK_EQ(ramp.length, 9u);
+        CHECK(system.IsSmoothing(id, 9));
+        CHECK(!system.IsSmoothing(id, 10));
+        for (auto const frame : Range(9u))
+            CHECK_LT(system.Value(id, frame), 1.0f);
+        for (auto const frame : Range(9u, k_max_block_size))
+            CHECK_EQ(system.Value(id, frame), 1.0f);
+
+        system.ProcessBlock(k_max_block_size);
+        CHECK(system.Ramp(id).IsConstant());
+        CHECK(!system.IsSmoothing(id, 0));
+    }
+
+    SUBCASE("HardSet stops the ramp") {
+        system.HardSet(id, 0);
+        system.Set(id, 1, 1000);
+        system.ProcessBlock(k_max_block_size);
+        CHECK(!system.Ramp(id).IsConstant());
+
+        system.HardSet(id, 0.25f);
+        system.ProcessBlock(k_max_block_size);
+        CHECK(system.Ramp(id).IsConstant());
+        CHECK(!system.IsSmoothing(id, 0));
+        CHECK_EQ(system.Value(id, 0), 0.25f);
+
+        // Once it has been taken off the active list, setting it again must put it back on.
+        system.ProcessBlock(k_max_block_size);
+        system.Set(id, 0.75f, 100);
+        system.ProcessBlock(k_max_block_size);
+        CHECK(!system.Ramp(id).IsConstant());
+        CHECK(system.IsSmoothing(id, 0));
+        CHECK_GT(system.Value(id, 0), 0.25f);
+        CHECK_LT(system.Value(id, 0), 0.75f);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterVolumeFadeTests) {
+    REGISTER_TEST(TestDSPVolumefade);
+    REGISTER_TEST(TestSmoothedValueRamps);
+}
@@ -0,0 +1,78 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+#include "os/threading.hpp"
+
+#include "FFTConvolver/wrapper.hpp"
+
+// Partitioned, frequency-domain IRs shared by all instances so that loading an IR that has been used recently
+// (very common when browsing IRs) skips all the FFTs. Entries are evicted least-recently-used first once the
+// total size goes over a budget. Convolvers share the spectra of the IR they were initialised with, so
+// evicting an entry never affects a convolver that's in use.
+struct ConvolverIrCache {
+    struct Key {
+        bool operator==(Key const& other) const {
+            return audio_hash == other.audio_hash && block_sizes.head == other.block_sizes.head &&
+                   block_sizes.tail == other.block_sizes.tail;
+        }
+        u64 audio_hash;
+        ConvolverBlockSizes block_sizes;
+    };
+
+    ~ConvolverIrCache() {
+        for (auto& e : entries)
+            ReleaseConvolverIr(*e.ir);
+    }
+
+    // [threadsafe] The result is retained; call ReleaseConvolverIr when done with it.
+    ConvolverIr* Find(Key const& key) {
+        ScopedMutexLock const lock(mutex);
+        for (auto& e : entries) {
+            if (e.key == key) {
+                e.last_used = ++use_counter;
+                RetainConvolverIr(*e.ir);
+                return e.ir;
+            }
+        }
+        return nullptr;
+    }
+
+    // [threadsafe] The cache retains ir. If the key is already present (another thread got there first) the
+    // existing entry is kept.
+    void Insert(Key const& key, ConvolverIr& ir) {
+        ScopedMutexLock const lock(mutex);
+        for (auto const& e : entries)
+            if (e.key == key) return;
+
+        RetainConvolverIr(ir);
+        auto const size = SizeInBytes(ir);
+        dyn::Append(entries, Entry {.key = key, .ir = &ir, .size_bytes = size, .last_used = ++use_counter});
+        total_bytes += size;
+
+        // We always keep the newest entry, even if it's bigger than the budget by itself.
+        while (total_bytes > k_max_bytes && entries.size > 1) {
+            usize oldest = 0;
+            for (auto const i : Range(entries.size))
+                if (entries[i].last_used < entries[oldest].last_used) oldest = i;
+            total_bytes -= entries[oldest].size_bytes;
+            ReleaseConvolverIr(*entries[oldest].ir);
+            dyn::RemoveSwapLast(entries, oldest);
+        }
+    }
+
+    struct Entry {
+        Key key;
+        ConvolverIr* ir;
+        usize size_bytes;
+        u64 last_used;
+    };
+
+    static constexpr usize k_max_bytes = Mb(128);
+
+    Mutex mutex {};
+    DynamicArray<Entry> entries {Malloc::Instance()};
+    usize total_bytes {};
+    u64 use_counter {};
+};
@@ -0,0 +1,612 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "disk_streaming.hpp"
+
+#include "foundation/foundation.hpp"
+#include "tests/framework.hpp"
+#include "utils/logger/logger.hpp"
+
+// We read this many frames at a time so that one stream doesn't hold up the others.
+constexpr u32 k_read_block_frames = 4096;
+
+// Frames behind the playhead that we don't overwrite. The consumer reads a few frames either side of the
+// playhead for interpolation, and the playhead moves during a chunk before it's published again.
+constexpr u32 k_keep_behind_frames = 2048;
+
+// If the playhead is this far beyond the filled part of the window, it's quicker to restart the window than
+// to wait for the streaming thread to catch up.
+constexpr u32 k_restart_window_threshold_frames = k_disk_stream_ring_frames / 4;
+
+static_assert(k_keep_behind_frames < k_disk_stream_ring_frames / 2);
+
+// The consumer reads frames either side of the playhead for interpolation. We always allow for the widest
+// kernel because the quality can change between chunks, and offline renders always use sinc. Frames are
+// relative to the direction of playback.
+using WidestInterpolationKernel = InterpolationKernel<InterpolationQuality::Sinc>;
+constexpr u32 k_interpolation_frames_behind = WidestInterpolationKernel::k_num_taps_behind;
+constexpr u32 k_interpolation_frames_ahead =
+    WidestInterpolationKernel::k_num_taps - WidestInterpolationKernel::k_num_taps_behind - 1;
+
+static_assert(InterpolationKernel<InterpolationQuality::Cubic>::k_num_taps_behind <=
+              k_interpolation_frames_behind);
+static_assert(InterpolationKernel<InterpolationQuality::Cubic>::k_num_taps -
+                  InterpolationKernel<InterpolationQuality::Cubic>::k_num_taps_behind - 1 <=
+              k_interpolation_frames_ahead);
+
+// Pinned segments cover this many frames inside the loop from each loop point, plus the crossfade and the
+// interpolation reach. That's how long the window has to restart after the playhead wraps.
+constexpr u32 k_pinned_frames_into_loop = 1 << 13;
+
+// Bounds the memory of a pinned segment. Crossfades longer than this aren't fully pinned, so reading the
+// start of them can underrun.
+constexpr u32 k_max_pinned_crossfade_frames = 1 << 16;
+
+constexpr usize k_max_channels = 2;
+
+static_assert(k_num_disk_stream_pinned_segments == decltype(StreamedFrames::pinned)::size);
+
+static void FreePinnedSegments(DiskStream& stream) {
+    for (auto& segment : stream.pinned) {
+        if (segment.frames.size) PageAllocator::Instance().Free(segment.frames.ToByteSpan());
+        segment.frames = {};
+        segment.start.Store(0, StoreMemoryOrder::Relaxed);
+        segment.end.Store(0, StoreMemoryOrder::Relaxed);
+        segment.target_end = 0;
+    }
+}
+
+static void CloseStream(DiskStream& stream) {
+    DestroyAudioFileStreamDecoder(stream.decoder);
+    stream.decoder = nullptr;
+    stream.failed = false;
+    FreePinnedSegments(stream);
+}
+
+static void OpenStream(DiskStream& stream) {
+    ZoneScoped;
+    ASSERT(!stream.decoder);
+    auto const& audio_data = *stream.audio_data;
+    ASSERT(audio_data.stream_source);
+    auto const& source = *audio_data.stream_source;
+
+    if (!stream.ring.size) {
+        constexpr usize k_ring_size = k_disk_stream_ring_frames * k_max_channels;
+        stream.ring = PageAllocator::Instance().AllocateExactSizeUninitialised<f32>(k_ring_size);
+    }
+
+    auto const outcome = [&]() -> ErrorCodeOr<AudioFileStreamDecoder*> {
+        auto reader = TRY(source.create_reader(source));
+        return CreateAudioFileStreamDecoder(Move(reader), source.filepath_for_id);
+    }();
+
+    if (outcome.HasError()) {
+        LogError(ModuleName::SampleLibraryServer,
+                 "failed to open {} for streaming: {}",
+                 source.filepath_for_id,
+                 outcome.Error());
+        stream.failed = true;
+        return;
+    }
+
+    stream.decoder = outcome.Value();
+    if (Info(*stream.decoder).channels != audio_data.channels ||
+        Info(*stream.decoder).num_frames != audio_data.num_frames) {
+        LogError(ModuleName::SampleLibraryServer, "{} changed since it was loaded", source.filepath_for_id);
+        stream.failed = true;
+    }
+}
+
+// Decodes frames [first_frame, first_frame + num_frames) into the ring.
+static ErrorCodeOr<void> DecodeIntoRing(DiskStream& stream, u32 first_frame, u32 num_frames) {
+    auto& decoder = *stream.decoder;
+    auto const channels = stream.audio_data->channels;
+    if (CurrentFrame(decoder) != first_frame) TRY(SeekToFrame(decoder, first_frame));
+
+    while (num_frames) {
+        auto const ring_pos = first_frame % k_disk_stream_ring_frames;
+        auto const frames_until_wrap = k_disk_stream_ring_frames - ring_pos;
+        auto const frames_to_read = Min(num_frames, frames_until_wrap);
+        auto const dest = stream.ring.SubSpan((usize)ring_pos * channels, (usize)frames_to_read * channels);
+        auto const num_read = TRY(ReadFrames(decoder, dest));
+        if (num_read != frames_to_read) return ErrorCode {AudioFileError::FileHasInvalidData};
+        first_frame += num_read;
+        num_frames -= num_read;
+    }
+    return k_success;
+}
+
+// The consumer doesn't read the pinned segments while the loop generations differ so we can freely reset
+// them.
+static void ResetPinnedSegments(DiskStream& stream, u32 loop_start, u32 loop_end, u32 loop_crossfade) {
+    auto const& audio_data = *stream.audio_data;
+
+    struct FrameRange {
+        u32 start;
+        u32 end;
+    };
+    Array<FrameRange, k_num_disk_stream_pinned_segments> ranges {};
+    if (loop_end) {
+        // Generous enough for either direction and either loop mode. In a standard loop, the crossfade reads
+        // frames before the loop start. In a ping-pong loop, it reads frames beyond whichever end we bounced
+        // off.
+        constexpr u32 k_reach = Max(k_interpolation_frames_behind, k_interpolation_frames_ahead);
+        auto const crossfade = Min(loop_crossfade, k_max_pinned_crossfade_frames);
+        auto const into_loop = Max(crossfade, k_pinned_frames_into_loop) + k_reach;
+        auto const outside_loop = crossfade + k_reach + 1; // +1 for the fractional part of the position
+        ranges[0] = {loop_start > outside_loop ? loop_start - outside_loop : 0, loop_start + into_loop};
+        ranges[1] = {loop_end > into_loop ? loop_end - into_loop : 0, loop_end + outside_loop};
+
+        // Short loops are pinned entirely.
+        if (ranges[1].start <= ranges[0].end) {
+            ranges[0].end = ranges[1].end;
+            ranges[1] = {};
+        }
+    }
+
+    for (auto const i : Range(k_num_disk_stream_pinned_segments)) {
+        auto& segment = stream.pinned[i];
+
+        // Frames below the resident frames are always read from memory.
+        auto range = ranges[i];
+        range.start = Max(range.start, audio_data.NumResidentFrames());
+        range.end = Min(range.end, audio_data.num_frames);
+        if (range.end <= range.start) range = {};
+
+        auto const num_samples = (usize)(range.end - range.start) * audio_data.channels;
+        if (segment.frames.size < num_samples) {
+            if (segment.frames.size) PageAllocator::Instance().Free(segment.frames.ToByteSpan());
+            segment.frames = PageAllocator::Instance().AllocateExactSizeUninitialised<f32>(num_samples);
+        }
+        segment.start.Store(range.start, StoreMemoryOrder::Relaxed);
+        segment.end.Store(range.start, StoreMemoryOrder::Relaxed);
+        segment.target_end = range.end;
+    }
+}
+
+// Returns true if there's more work to do for the pinned segments.
+static ErrorCodeOr<bool> FillPinnedSegments(DiskStream& stream) {
+    auto& decoder = *stream.decoder;
+    auto const channels = stream.audio_data->channels;
+    for (auto& segment : stream.pinned) {
+        auto const start = segment.start.Load(LoadMemoryOrder::Relaxed);
+        auto const end = segment.end.Load(LoadMemoryOrder::Relaxed);
+        auto const num_frames = Min(segment.target_end - end, k_read_block_frames);
+        if (!num_frames) continue;
+
+        if (CurrentFrame(decoder) != end) TRY(SeekToFrame(decoder, end));
+        auto const dest =
+            segment.frames.SubSpan((usize)(end - start) * channels, (usize)num_frames * channels);
+        auto const num_read = TRY(ReadFrames(decoder, dest));
+        if (num_read != num_frames) return ErrorCode {AudioFileError::FileHasInvalidData};
+        segment.end.Store(end + num_frames, StoreMemoryOrder::Release);
+        return true;
+    }
+    return false;
+}
+
+// Returns true if there's more work to do for this stream.
+static bool FillStream(DiskStream& stream) {
+    ZoneScoped;
+    if (stream.failed) return false;
+
+    auto const& audio_data = *stream.audio_data;
+    auto const resident_frames = audio_data.NumResidentFrames();
+
+    if (auto const gen = stream.requested_loop_generation.Load(LoadMemoryOrder::Acquire);
+        gen != stream.filled_loop_generation.Load(LoadMemoryOrder::Relaxed)) {
+        ResetPinnedSegments(stream,
+                            stream.loop_start.Load(LoadMemoryOrder::Relaxed),
+                            stream.loop_end.Load(LoadMemoryOrder::Relaxed),
+                            stream.loop_crossfade.Load(LoadMemoryOrder::Relaxed));
+        stream.filled_loop_generation.Store(gen, StoreMemoryOrder::Release);
+    }
+
+    auto start = stream.window_start.Load(LoadMemoryOrder::Relaxed);
+    auto end = stream.window_end.Load(LoadMemoryOrder::Relaxed);
+
+    if (auto const gen = stream.requested_generation.Load(LoadMemoryOrder::Acquire);
+        gen != stream.filled_generation.Load(LoadMemoryOrder::Relaxed)) {
+        // The consumer doesn't read the window while the generations differ so we can freely reset it.
+        start = end = Min(stream.request_frame.Load(LoadMemoryOrder::Relaxed), audio_data.num_frames);
+        stream.window_start.Store(start, StoreMemoryOrder::Relaxed);
+        stream.window_end.Store(end, StoreMemoryOrder::Relaxed);
+        stream.filled_generation.Store(gen, StoreMemoryOrder::Release);
+    }
+
+    auto const playhead = stream.playhead_frame.Load(LoadMemoryOrder::Relaxed);
+    auto const reversed = stream.reversed.Load(LoadMemoryOrder::Relaxed);
+
+    ErrorCodeOr<void> outcome = k_success;
+    bool more_to_do = false;
+
+    if (!reversed) {
+        if (playhead > start + k_keep_behind_frames) {
+            start = Min(playhead - k_keep_behind_frames, end);
+            stream.window_start.Store(start, StoreMemoryOrder::Release);
+        }
+
+        auto const space = k_disk_stream_ring_frames - (end - start);
+        auto const num_frames = Min(space, audio_data.num_frames - end, k_read_block_frames);
+        if (num_frames) {
+            outcome = DecodeIntoRing(stream, end, num_frames);
+            if (!outcome.HasError()) {
+                end += num_frames;
+                stream.window_end.Store(end, StoreMemoryOrder::Release);
+                more_to_do = true;
+            }
+        }
+    } else {
+        if (playhead + k_keep_behind_frames < end) {
+            end = Max(playhead + k_keep_behind_frames, start);
+            stream.window_end.Store(end, StoreMemoryOrder::Release);
+        }
+
+        // Frames below resident_frames are read from memory so there's no need to stream them.
+        auto const space = k_disk_stream_ring_frames - (end - start);
+        auto const frames_until_resident = start > resident_frames ? start - resident_frames : 0u;
+        auto const num_frames = Min(space, frames_until_resident, k_read_block_frames);
+        if (num_frames) {
+            outcome = DecodeIntoRing(stream, start - num_frames, num_frames);
+            if (!outcome.HasError()) {
+                start -= num_frames;
+                stream.window_start.Store(start, StoreMemoryOrder::Release);
+                more_to_do = true;
+            }
+        }
+    }
+
+    // The window comes first: the playhead is in it, whereas the pinned frames are usually needed later.
+    if (!outcome.HasError()) {
+        auto const pinned_outcome = FillPinnedSegments(stream);
+        if (pinned_outcome.HasError())
+            outcome = pinned_outcome.Error();
+        else if (pinned_outcome.Value())
+            more_to_do = true;
+    }
+
+    if (outcome.HasError()) {
+        LogError(ModuleName::SampleLibraryServer,
+                 "error streaming {}: {}",
+                 audio_data.stream_source->filepath_for_id,
+                 outcome.Error());
+        stream.failed = true;
+        return false;
+    }
+
+    return more_to_do;
+}
+
+static void StreamingThreadProc(DiskStreamer& streamer) {
+    ZoneScoped;
+    while (!streamer.end_thread.Load(LoadMemoryOrder::Relaxed)) {
+        bool any_streaming = false;
+        bool more_to_do = false;
+
+        for (auto& stream : streamer.streams) {
+            switch (stream.state.Load(LoadMemoryOrder::Acquire)) {
+                case DiskStream::State::Free: break;
+                case DiskStream::State::Requested: {
+                    OpenStream(stream);
+                    auto expected = DiskStream::State::Requested;
+                    if (!stream.state.CompareExchangeStrong(expected,
+                                                            DiskStream::State::Streaming,
+                                                            RmwMemoryOrder::AcquireRelease,
+                                                            LoadMemoryOrder::Acquire)) {
+                        ASSERT_EQ(expected, DiskStream::State::ReleaseRequested);
+                        CloseStream(stream);
+                        stream.state.Store(DiskStream::State::Free, StoreMemoryOrder::Release);
+                        break;
+                    }
+                    any_streaming = true;
+                    more_to_do = true;
+                    break;
+                }
+                case DiskStream::State::Streaming: {
+                    any_streaming = true;
+                    if (FillStream(stream)) more_to_do = true;
+                    break;
+                }
+                case DiskStream::State::ReleaseRequested: {
+                    CloseStream(stream);
+                    stream.state.Store(DiskStream::State::Free, StoreMemoryOrder::Release);
+                    break;
+                }
+            }
+        }
+
+        if (more_to_do) continue;
+
+        // While streams are playing we poll so that the consumers never have to signal us in the normal
+        // case.
+        streamer.work_signaller.WaitUntilSignalledOrSpurious(any_streaming ? 2u : 250u);
+    }
+
+    for (auto& stream : streamer.streams)
+        CloseStream(stream);
+}
+
+DiskStreamer::~DiskStreamer() {
+    if (thread.Joinable()) {
+        end_thread.Store(true, StoreMemoryOrder::Relaxed);
+        work_signaller.Signal();
+        thread.Join();
+    }
+    for (auto& stream : streams) {
+        if (stream.ring.size) PageAllocator::Instance().Free(stream.ring.ToByteSpan());
+        FreePinnedSegments(stream);
+    }
+}
+
+void StartDiskStreamingThreadIfNeeded(DiskStreamer& streamer) {
+    if (streamer.thread.Joinable()) return;
+    streamer.thread.Start(
+        [&streamer]() {
+            try {
+                StreamingThreadProc(streamer);
+            } catch (PanicException) {
+                // Pass. We're an audio plugin, we don't want to crash the host.
+            }
+        },
+        "streaming");
+}
+
+DiskStream*
+AcquireDiskStream(DiskStreamer& streamer, AudioData const& audio_data, f64 start_pos, bool reversed) {
+    ASSERT(audio_data.IsStreamed());
+    if (!streamer.thread.Joinable()) return nullptr;
+
+    for (auto& stream : streamer.streams) {
+        if (stream.state.Load(LoadMemoryOrder::Acquire) != DiskStream::State::Free) continue;
+
+        auto const pos = (u32)Max(start_pos, 0.0);
+        auto const resident_frames = audio_data.NumResidentFrames();
+
+        stream.audio_data = &audio_data;
+        stream.playhead_frame.Store(pos, StoreMemoryOrder::Relaxed);
+        stream.reversed.Store(reversed, StoreMemoryOrder::Relaxed);
+        stream.request_frame.Store(
+            reversed ? Min(pos + k_interpolation_frames_behind + 1, audio_data.num_frames)
+                     : Max(pos >= k_interpolation_frames_behind ? pos - k_interpolation_frames_behind : 0,
+                           resident_frames),
+            StoreMemoryOrder::Relaxed);
+        stream.requested_generation.Store(stream.filled_generation.Load(LoadMemoryOrder::Relaxed) + 1,
+                                          StoreMemoryOrder::Relaxed);
+        stream.loop_start.Store(0, StoreMemoryOrder::Relaxed);
+        stream.loop_end.Store(0, StoreMemoryOrder::Relaxed);
+        stream.loop_crossfade.Store(0, StoreMemoryOrder::Relaxed);
+        stream.requested_loop_generation.Store(
+            stream.filled_loop_generation.Load(LoadMemoryOrder::Relaxed) + 1,
+            StoreMemoryOrder::Relaxed);
+        stream.state.Store(DiskStream::State::Requested, StoreMemoryOrder::Release);
+        streamer.work_signaller.Signal();
+        return &stream;
+    }
+
+    return nullptr;
+}
+
+void ReleaseDiskStream(DiskStreamer& streamer, DiskStream*& stream) {
+    if (!stream) return;
+    auto const prev =
+        stream->state.Exchange(DiskStream::State::ReleaseRequested, RmwMemoryOrder::AcquireRelease);
+    ASSERT(prev == DiskStream::State::Requested || prev == DiskStream::State::Streaming);
+    stream = nullptr;
+    streamer.work_signaller.Signal();
+}
+
+void SetDiskStreamLoop(DiskStreamer& streamer, DiskStream& stream, Optional<BoundsCheckedLoop> const& loop) {
+    // This is called whenever any loop parameter changes, so avoid needlessly re-decoding the pinned frames.
+    auto const start = loop ? loop->start : 0;
+    auto const end = loop ? loop->end : 0;
+    auto const crossfade = loop ? loop->crossfade : 0;
+    if (start == stream.loop_start.Load(LoadMemoryOrder::Relaxed) &&
+        end == stream.loop_end.Load(LoadMemoryOrder::Relaxed) &&
+        crossfade == stream.loop_crossfade.Load(LoadMemoryOrder::Relaxed))
+        return;
+
+    stream.loop_start.Store(start, StoreMemoryOrder::Relaxed);
+    stream.loop_end.Store(end, StoreMemoryOrder::Relaxed);
+    stream.loop_crossfade.Store(crossfade, StoreMemoryOrder::Relaxed);
+    stream.requested_loop_generation.FetchAdd(1, RmwMemoryOrder::Release);
+    streamer.work_signaller.Signal();
+}
+
+using PinnedFramesArray = Array<StreamedFrames::Pinned, k_num_disk_stream_pinned_segments>;
+
+static PinnedFramesArray PinnedFrames(DiskStream const& stream) {
+    // We're the only writer of requested_loop_generation so it doesn't need to be synchronised.
+    if (stream.filled_loop_generation.Load(LoadMemoryOrder::Acquire) !=
+        stream.requested_loop_generation.Load(LoadMemoryOrder::Relaxed))
+        return {};
+
+    PinnedFramesArray result {};
+    for (auto const i : Range(k_num_disk_stream_pinned_segments)) {
+        auto const& segment = stream.pinned[i];
+        result[i] = {
+            .frames = segment.frames.data,
+            .start = segment.start.Load(LoadMemoryOrder::Relaxed),
+            .end = segment.end.Load(LoadMemoryOrder::Acquire),
+        };
+    }
+    return result;
+}
+
+StreamedFrames StreamedFramesForChunk(DiskStream const& stream) {
+    StreamedFrames result {
+        .pinned = PinnedFrames(stream),
+    };
+
+    // We're the only writer of requested_generation so it doesn't need to be synchronised.
+    if (stream.filled_generation.Load(LoadMemoryOrder::Acquire) ==
+        stream.requested_generation.Load(LoadMemoryOrder::Relaxed)) {
+        result.ring = stream.ring.data;
+        result.capacity = k_disk_stream_ring_frames;
+        result.start = stream.window_start.Load(LoadMemoryOrder::Acquire);
+        result.end = stream.window_end.Load(LoadMemoryOrder::Acquire);
+    }
+    return result;
+}
+
+void UpdateDiskStreamPlayhead(DiskStreamer& streamer, DiskStream& stream, f64 pos, bool reversed) {
+    auto const& audio_data = *stream.audio_data;
+    auto const frame = (u32)Max(pos, 0.0);
+    auto const resident_frames = audio_data.NumResidentFrames();
+
+    stream.playhead_frame.Store(frame, StoreMemoryOrder::Relaxed);
+    stream.reversed.Store(reversed, StoreMemoryOrder::Relaxed);
+
+    if (stream.filled_generation.Load(LoadMemoryOrder::Acquire) !=
+        stream.requested_generation.Load(LoadMemoryOrder::Relaxed))
+        return; // a restart is already pending
+
+    auto const start = stream.window_start.Load(LoadMemoryOrder::Acquire);
+    auto const end = stream.window_end.Load(LoadMemoryOrder::Acquire);
+
+    // The consumer reads k_interpolation_frames_behind frames behind the playhead and
+    // k_interpolation_frames_ahead frames ahead of it, in the direction of playback. Frames below
+    // resident_frames are always read from memory, and pinned frames don't need the window either: if the
+    // playhead is in a pinned segment, the window should be waiting just past it.
+    constexpr u32 k_behind = k_interpolation_frames_behind;
+    constexpr u32 k_ahead = k_interpolation_frames_ahead;
+    auto const pinned = PinnedFrames(stream);
+    Optional<u32> restart_frame {};
+    if (!reversed) {
+        auto needed = Max(frame >= k_behind ? frame - k_behind : 0, resident_frames);
+        for (auto const& p : pinned)
+            if (needed >= p.start && needed < p.end) needed = p.end;
+
+        auto const outside_window = needed < start || needed > end + k_restart_window_threshold_frames;
+        if (needed < audio_data.num_frames && outside_window) restart_frame = needed;
+    } else {
+        // Exclusive, like the window end.
+        auto needed_end = Min(frame + k_behind + 1, audio_data.num_frames);
+        for (auto const& p : pinned)
+            if (needed_end > p.start && needed_end <= p.end) needed_end = p.start;
+
+        if (needed_end > resident_frames) {
+            auto const lowest_needed = Max(needed_end > k_ahead + k_behind + 1
+                                               ? needed_end - (k_ahead + k_behind + 1)
+                                               : 0,
+                                           resident_frames);
+            if (needed_end > end || lowest_needed + k_restart_window_threshold_frames < start)
+                restart_frame = needed_end;
+        }
+    }
+
+    if (restart_frame) {
+        stream.request_frame.Store(*restart_frame, StoreMemoryOrder::Relaxed);
+        stream.requested_generation.FetchAdd(1, RmwMemoryOrder::Release);
+        streamer.work_signaller.Signal();
+    }
+}
+
+TEST_CASE(TestDiskStreamLoopWrap) {
+    auto& a = tester.scratch_arena;
+    auto const filepath =
+        String(path::Join(a, Array {TestFilesFolder(tester), "audio"_s, "24bit-stereo.wav"_s}));
+
+    auto full_reader = TRY(Reader::FromFile(filepath));
+    auto const full = TRY(DecodeAudioFile(full_reader, filepath, a));
+    REQUIRE_EQ(full.channels, 2);
+    REQUIRE(full.num_frames > 22000);
+
+    AudioDataStreamSource const source {
+        .create_reader = [](AudioDataStreamSource const& s) { return Reader::FromFile(s.filepath_for_id); },
+        .filepath_for_id = filepath,
+    };
+    auto head = TRY(DecodeAudioFileHead(TRY(Reader::FromFile(filepath)), filepath, 32, a));
+    head.stream_source = &source;
+
+    // Loops much longer than the pinned segments so that the playhead has to go back to the window after a
+    // wrap. The window never contains the frames at the other end of the loop when it wraps.
+    struct LoopCase {
+        String name;
+        BoundsCheckedLoop loop;
+    };
+    for (auto const& [name, loop] : Array {
+             LoopCase {"standard", {1000, 21000, 0, sample_lib::LoopMode::Standard}},
+             LoopCase {"standard with crossfade", {1000, 21000, 500, sample_lib::LoopMode::Standard}},
+             LoopCase {"ping-pong with crossfade", {1000, 21000, 500, sample_lib::LoopMode::PingPong}},
+         }) {
+        CAPTURE(name);
+        Optional<BoundsCheckedLoop> const opt_loop {loop};
+
+        DiskStreamer streamer;
+        StartDiskStreamingThreadIfNeeded(streamer);
+
+        f64 pos = loop.end - 1000.0;
+        auto flags = loop_and_reverse_flags::CorrectLoopFlagsIfNeeded(0, loop, pos);
+        auto stream = AcquireDiskStream(streamer, head, pos, false);
+        REQUIRE(stream);
+        DEFER { ReleaseDiskStream(streamer, stream); };
+        SetDiskStreamLoop(streamer, *stream, opt_loop);
+
+        // In real use the consumer never waits. Here we wait for the frames around the playhead so that the
+        // result doesn't depend on how quickly the streaming thread runs, but we don't wait for the frames
+        // after a wrap: they have to be pinned already.
+        auto const wait_for_frames = [&](s64 first, s64 last) {
+            first = Max<s64>(first, head.NumResidentFrames());
+            last = Min<s64>(last, full.num_frames - 1);
+            for (auto _ : Range(5000)) {
+                auto const streamed = StreamedFramesForChunk(*stream);
+                auto all_available = true;
+                for (auto frame = first; frame <= last && all_available; ++frame)
+                    if (!streamed.Frame<2>(frame)) all_available = false;
+                if (all_available) return true;
+                SleepThisThread(1);
+            }
+            return false;
+        };
+        REQUIRE(wait_for_frames(loop.start - loop.crossfade - 8, loop.start + 4096));
+
+        constexpr f64 k_pitch_ratio = 1.37;
+        constexpr u32 k_chunk_frames = 64;
+        constexpr s64 k_chunk_reach = (s64)(k_chunk_frames * k_pitch_ratio) + 16;
+        u32 num_unavailable = 0;
+        u32 num_different = 0;
+        for (u32 num_frames_read = 0; num_frames_read < 22000; num_frames_read += k_chunk_frames) {
+            auto const reversed = (flags & loop_and_reverse_flags::CurrentlyReversed) != 0;
+            auto const playhead = (s64)pos;
+            REQUIRE(reversed ? wait_for_frames(playhead - k_chunk_reach, playhead + 8)
+                             : wait_for_frames(playhead - 8, playhead + k_chunk_reach));
+
+            auto const streamed = StreamedFramesForChunk(*stream);
+            auto const get_frame = [&](AudioData const& data, StreamedFrames const& frames, f32& l, f32& r) {
+                return SampleGetData<2, InterpolationQuality::Sinc, true>(data,
+                                                                          frames,
+                                                                          opt_loop,
+                                                                          flags,
+                                                                          pos,
+                                                                          l,
+                                                                          r);
+            };
+            for (auto _ : Range(k_chunk_frames)) {
+                f32 l;
+                f32 r;
+                if (!get_frame(head, streamed, l, r)) {
+                    ++num_unavailable;
+                } else {
+                    f32 expected_l;
+                    f32 expected_r;
+                    get_frame(full, {}, expected_l, expected_r);
+                    if (l != expected_l || r != expected_r) ++num_different;
+                }
+                REQUIRE(
+                    IncrementSamplePlaybackPos(opt_loop, flags, pos, k_pitch_ratio, (f64)full.num_frames));
+            }
+
+            UpdateDiskStreamPlayhead(streamer,
+                                     *stream,
+                                     pos,
+                                     flags & loop_and_reverse_flags::CurrentlyReversed);
+        }
+
+        CHECK_EQ(num_unavailable, 0u);
+        CHECK_EQ(num_different, 0u);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterDiskStreamingTests) { REGISTER_TEST(TestDiskStreamLoopWrap); }
@@ -0,0 +1,104 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+#include "os/threading.hpp"
+
+#include "common_infrastructure/audio_data.hpp"
+#include "common_infrastructure/sample_library/audio_file.hpp"
+
+#include "sample_processing.hpp"
+
+// Disk-streaming
+// Audio files can be loaded with only their first frames resident in memory (see AudioData::IsStreamed). When
+// a voice plays one of these it acquires a DiskStream: a window of decoded frames that the streaming thread
+// keeps filled ahead of the playhead, in whichever direction the voice is playing.
+//
+// Each stream has a single producer (the streaming thread) and a single consumer (whichever thread is
+// rendering the voice). The consumer never waits; if the frames it needs aren't ready it outputs silence and
+// we count an underrun.
+//
+// Loops make the playhead jump, and loop crossfades read from the other end of the loop. So the frames around
+// the loop points are also decoded into pinned segments which stay put while the window moves. When the
+// playhead wraps it reads from a pinned segment while the window restarts just past it.
+
+constexpr u32 k_max_num_disk_streams = 128;
+constexpr u32 k_disk_stream_ring_frames = 1 << 15;
+constexpr u32 k_num_disk_stream_pinned_segments = 2; // one around each loop point
+
+struct DiskStream {
+    enum class State : u32 { Free, Requested, Streaming, ReleaseRequested };
+
+    Atomic<State> state {State::Free};
+
+    // Written by the consumer before the state is set to Requested.
+    AudioData const* audio_data {};
+
+    // Consumer -> streaming thread. When the playhead jumps outside of the window the consumer asks for the
+    // window to be restarted at request_frame by incrementing requested_generation.
+    Atomic<u32> requested_generation {};
+    Atomic<u32> request_frame {};
+    Atomic<u32> playhead_frame {};
+    Atomic<bool> reversed {};
+
+    // Streaming thread -> consumer. Frames [window_start, window_end) are valid in the ring when
+    // filled_generation matches requested_generation.
+    Atomic<u32> filled_generation {};
+    Atomic<u32> window_start {};
+    Atomic<u32> window_end {};
+    Span<f32> ring {};
+
+    // Consumer -> streaming thread. The voice's loop; loop_end is 0 if there isn't one. Changed by
+    // incrementing requested_loop_generation.
+    Atomic<u32> requested_loop_generation {};
+    Atomic<u32> loop_start {};
+    Atomic<u32> loop_end {};
+    Atomic<u32> loop_crossfade {};
+
+    // Streaming thread -> consumer. Frames [start, end) of each segment are valid when filled_loop_generation
+    // matches requested_loop_generation. The segments only grow until the loop changes.
+    struct PinnedSegment {
+        Atomic<u32> start {};
+        Atomic<u32> end {};
+        Span<f32> frames {}; // the start frame is at index 0
+        u32 target_end {}; // streaming thread only
+    };
+    Atomic<u32> filled_loop_generation {};
+    Array<PinnedSegment, k_num_disk_stream_pinned_segments> pinned {};
+
+    // Streaming thread only.
+    AudioFileStreamDecoder* decoder {};
+    bool failed {};
+};
+
+struct DiskStreamer {
+    ~DiskStreamer();
+
+    Atomic<u64> num_underruns {};
+
+    // private
+    Array<DiskStream, k_max_num_disk_streams> streams {};
+    WorkSignaller work_signaller {};
+    Atomic<bool> end_thread {};
+    Thread thread {};
+};
+
+// [main-thread]
+void StartDiskStreamingThreadIfNeeded(DiskStreamer& streamer);
+
+// [audio-thread] Returns null if all of the streams are in use.
+DiskStream*
+AcquireDiskStream(DiskStreamer& streamer, AudioData const& audio_data, f64 start_pos, bool reversed);
+
+// [audio-thread or voice-thread] Sets stream to null.
+void ReleaseDiskStream(DiskStreamer& streamer, DiskStream*& stream);
+
+// [audio-thread or voice-thread] Call whenever the voice's loop changes, including to no loop.
+void SetDiskStreamLoop(DiskStreamer& streamer, DiskStream& stream, Optional<BoundsCheckedLoop> const& loop);
+
+// [audio-thread or voice-thread] Call before reading frames for a chunk of processing.
+StreamedFrames StreamedFramesForChunk(DiskStream const& stream);
+
+// [audio-thread or voice-thread] Call after a chunk of processing with the new playback position.
+void UpdateDiskStreamPlayhead(DiskStreamer& streamer, DiskStream& stream, f64 pos, bool reversed);
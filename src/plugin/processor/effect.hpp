@@ -24,6 +24,26 @@ inline void UpdateSilentSeconds(f32& silent_seconds, Span<StereoAudioFrame const
         silent_seconds = 0;
 }
 
+// wet_io = wet_io * wet_gain(frame) + dry * dry_gain(frame), for every frame. Frames are processed 2 at a
+// time as one f32x4: {l0, r0, l1, r1}.
+template <typename WetGainFunction, typename DryGainFunction>
+ALWAYS_INLINE inline void MixStereoFrames(Span<StereoAudioFrame> wet_io,
+                                          Span<StereoAudioFrame const> dry,
+                                          WetGainFunction&& wet_gain,
+                                          DryGainFunction&& dry_gain) {
+    ASSERT_HOT(wet_io.size == dry.size);
+    auto const num_frames = (u32)wet_io.size;
+    u32 frame = 0;
+    for (; frame + 2 <= num_frames; frame += 2) {
+        f32x4 const w {wet_gain(frame), wet_gain(frame), wet_gain(frame + 1), wet_gain(frame + 1)};
+        f32x4 const d {dry_gain(frame), dry_gain(frame), dry_gain(frame + 1), dry_gain(frame + 1)};
+        auto const wet_samples = LoadUnalignedToType<f32x4>(&wet_io[frame].l);
+        auto const dry_samples = LoadUnalignedToType<f32x4>(&dry[frame].l);
+        StoreToUnaligned(&wet_io[frame].l, wet_samples * w + dry_samples * d);
+    }
+    if (frame != num_frames) wet_io[frame] = wet_io[frame] * wet_gain(frame) + dry[frame] * dry_gain(frame);
+}
+
 struct EffectWetDryHelper {
     EffectWetDryHelper(FloeSmoothedValueSystem& s)
         : m_wet_smoother_id(s.CreateSmoother())
@@ -45,6 +65,23 @@ struct EffectWetDryHelper {
         return wet * s.Value(m_wet_smoother_id, frame_index) + dry * s.Value(m_dry_smoother_id, frame_index);
     }
 
+    // Block version of MixStereo: the result is written into wet_io.
+    void
+    MixStereo(FloeSmoothedValueSystem& s, Span<StereoAudioFrame> wet_io, Span<StereoAudioFrame const> dry) {
+        auto const wet_ramp = s.Ramp(m_wet_smoother_id);
+        auto const dry_ramp = s.Ramp(m_dry_smoother_id);
+        if (wet_ramp.IsConstant() && dry_ramp.IsConstant()) {
+            auto const w = wet_ramp.target;
+            auto const d = dry_ramp.target;
+            MixStereoFrames(wet_io, dry, [w](u32) { return w; }, [d](u32) { return d; });
+        } else {
+            MixStereoFrames(wet_io,
+                            dry,
+                            [&wet_ramp](u32 i) { return wet_ramp.At(i); },
+                            [&dry_ramp](u32 i) { return dry_ramp.At(i); });
+        }
+    }
+
   private:
     FloeSmoothedValueSystem::FloatId const m_wet_smoother_id;
     FloeSmoothedValueSystem::FloatId const m_dry_smoother_id;
@@ -74,7 +111,8 @@ enum class EffectProcessResult {
 };
 
 // Base class for effects.
-// The subclass can either override ProcessFrame or ProcessBlock
+// Subclasses process whole blocks at a time. Typically they write their wet signal into a scratch buffer and
+// then use the block versions of EffectWetDryHelper::MixStereo and MixOnOffSmoothing to mix it back in.
 class Effect {
   public:
     Effect(FloeSmoothedValueSystem& s, EffectType type)
@@ -98,12 +136,9 @@ class Effect {
     virtual void SetTempo(f64) {}
 
     // audio-thread
-    virtual EffectProcessResult ProcessBlock(Span<StereoAudioFrame> frames,
-                                             [[maybe_unused]] ScratchBuffers scratch_buffers,
-                                             AudioProcessingContext const& context) {
-        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
-        for (auto [i, frame] : Enumerate<u32>(frames))
-            frame = MixOnOffSmoothing(ProcessFrame(context, frame, i), frame, i);
+    virtual EffectProcessResult
+    ProcessBlock(Span<StereoAudioFrame>, ScratchBuffers, AudioProcessingContext const&) {
+        PanicIfReached();
         return EffectProcessResult::Done;
     }
 
@@ -127,14 +162,31 @@ class Effect {
         return LinearInterpolate(smoothed_value_system.Value(mix_smoother_id, frame_index), dry, wet);
     }
 
-    // Internals
-    virtual StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const&, StereoAudioFrame in, u32 frame_index) {
-        PanicIfReached();
-        (void)frame_index;
-        return in;
+    // audio-thread
+    // Block version of MixOnOffSmoothing: the result is written into io_frames.
+    void MixOnOffSmoothing(Span<StereoAudioFrame> io_frames, Span<StereoAudioFrame const> wet) {
+        ASSERT_HOT(io_frames.size == wet.size);
+        if (!smoothed_value_system.IsSmoothing(mix_smoother_id, 0)) {
+            // We're fully on, otherwise ShouldProcessBlock would have returned false.
+            CopyMemory(io_frames.data, wet.data, wet.size * sizeof(StereoAudioFrame));
+            return;
+        }
+
+        auto const mix = smoothed_value_system.AllValues(mix_smoother_id);
+        auto const num_frames = (u32)io_frames.size;
+        u32 frame = 0;
+        for (; frame + 2 <= num_frames; frame += 2) {
+            f32x4 const t {mix[frame], mix[frame], mix[frame + 1], mix[frame + 1]};
+            auto const dry_samples = LoadUnalignedToType<f32x4>(&io_frames[frame].l);
+            auto const wet_samples = LoadUnalignedToType<f32x4>(&wet[frame].l);
+            StoreToUnaligned(&io_frames[frame].l, LinearInterpolate(t, dry_samples, wet_samples));
+        }
+        if (frame != num_frames)
+            io_frames[frame] = LinearInterpolate(mix[frame], io_frames[frame], wet[frame]);
     }
 
+    // Internals
+
     virtual void OnParamChangeInternal(ChangedParams changed_params,
                                        AudioProcessingContext const& context) = 0;
 
@@ -15,13 +15,24 @@ struct BitCrushProcessor {
         return i;
     }
 
-    f32x2 BitCrush(f32x2 input, f32 sample_rate, int bit_depth, int bit_rate) {
-        auto const resolution = IntegerPowerBase2(bit_depth) - 1;
+    // The values that only depend on the parameters are calculated once per block rather than every frame.
+    void BitCrushBlock(Span<StereoAudioFrame const> in,
+                       Span<StereoAudioFrame> out,
+                       f32 sample_rate,
+                       int bit_depth,
+                       int bit_rate) {
+        auto const resolution = (f32)(IntegerPowerBase2(bit_depth) - 1);
         auto const step = (int)(sample_rate / (f32)bit_rate);
+        for (auto const i : Range(in.size)) {
+            auto const v = BitCrush({in[i].l, in[i].r}, bit_depth, bit_rate, resolution, step);
+            out[i] = {v[0], v[1]};
+        }
+    }
 
+    ALWAYS_INLINE f32x2 BitCrush(f32x2 input, int bit_depth, int bit_rate, f32 resolution, int step) {
         if (pos % step == 0) {
             if (bit_depth < 32)
-                held_sample = Round((input + 1.0f) * (f32)resolution) / (f32)resolution - 1.0f;
+                held_sample = Round((input + 1.0f) * resolution) / resolution - 1.0f;
             else
                 held_sample = input;
         }
@@ -42,11 +53,19 @@ class BitCrush final : public Effect {
     BitCrush(FloeSmoothedValueSystem& s) : Effect(s, EffectType::BitCrush), m_wet_dry(s) {}
 
   private:
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const& context, StereoAudioFrame in, u32 frame_index) override {
-        auto const v = m_bit_crusher.BitCrush({in.l, in.r}, context.sample_rate, m_bit_depth, m_bit_rate);
-        StereoAudioFrame const wet {v[0], v[1]};
-        return m_wet_dry.MixStereo(smoothed_value_system, frame_index, wet, in);
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const& context) override {
+        ZoneNamedN(process_block, "BitCrush ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+        m_bit_crusher.BitCrushBlock(io_frames, wet, context.sample_rate, m_bit_depth, m_bit_rate);
+        m_wet_dry.MixStereo(smoothed_value_system, wet, io_frames);
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
     }
 
     void OnParamChangeInternal(ChangedParams changed_params, AudioProcessingContext const&) override {
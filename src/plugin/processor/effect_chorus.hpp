@@ -36,10 +36,10 @@ struct ChorusProcessor {
         Reset();
     }
 
-    StereoAudioFrame Process(StereoAudioFrame in,
-                             f32 depth01,
-                             rbj_filter::Coeffs const& lowpass_coeffs,
-                             rbj_filter::Coeffs const& highpass_coeffs) {
+    ALWAYS_INLINE StereoAudioFrame Process(StereoAudioFrame in,
+                                           f32 depth01,
+                                           rbj_filter::Coeffs const& lowpass_coeffs,
+                                           rbj_filter::Coeffs const& highpass_coeffs) {
         ASSERT_HOT(depth01 >= 0.0f && depth01 <= 1.0f);
 
         constexpr auto k_min_time_multiplier = 0.04f;
@@ -150,24 +150,50 @@ class Chorus final : public Effect {
             m_wet_dry.SetDry(smoothed_value_system, p->ProjectedValue());
     }
 
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const&, StereoAudioFrame in, u32 frame_index) override {
-        auto const depth = smoothed_value_system.Value(m_depth_01_smoother_id, frame_index);
-        auto [highpass_coeffs, filter_mix] =
-            smoothed_value_system.Value(m_highpass_filter_coeffs_smoother_id, frame_index);
-        auto chorus_in = in * filter_mix;
-
-        auto out = chorus_in;
-        out = m_c[ToInt(ChorusIndexes::First)].Process(chorus_in,
-                                                       depth,
-                                                       m_lowpass_filter_coeffs,
-                                                       highpass_coeffs);
-        out += m_c[ToInt(ChorusIndexes::Second)].Process(chorus_in,
-                                                         depth,
-                                                         m_lowpass_filter_coeffs,
-                                                         highpass_coeffs) /
-               2;
-        return m_wet_dry.MixStereo(smoothed_value_system, frame_index, out, in);
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const&) override {
+        ZoneNamedN(process_block, "Chorus ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+
+        auto process = [&](auto&& depth_for_frame, auto&& highpass_for_frame) {
+            for (auto const i : Range((u32)io_frames.size)) {
+                auto const depth = depth_for_frame(i);
+                auto const [highpass_coeffs, filter_mix] = highpass_for_frame(i);
+                auto const chorus_in = io_frames[i] * filter_mix;
+
+                auto out = m_c[ToInt(ChorusIndexes::First)].Process(chorus_in,
+                                                                    depth,
+                                                                    m_lowpass_filter_coeffs,
+                                                                    highpass_coeffs);
+                out += m_c[ToInt(ChorusIndexes::Second)].Process(chorus_in,
+                                                                 depth,
+                                                                 m_lowpass_filter_coeffs,
+                                                                 highpass_coeffs) /
+                       2;
+                wet[i] = out;
+            }
+        };
+
+        if (!smoothed_value_system.IsSmoothing(m_depth_01_smoother_id, 0) &&
+            !smoothed_value_system.IsSmoothing(m_highpass_filter_coeffs_smoother_id)) {
+            auto const depth = smoothed_value_system.TargetValue(m_depth_01_smoother_id);
+            auto const highpass = smoothed_value_system.Value(m_highpass_filter_coeffs_smoother_id, 0);
+            process([depth](u32) { return depth; }, [highpass](u32) { return highpass; });
+        } else {
+            auto const depths = smoothed_value_system.AllValues(m_depth_01_smoother_id);
+            auto const highpass_id = m_highpass_filter_coeffs_smoother_id;
+            process([depths](u32 i) { return depths[i]; },
+                    [this, highpass_id](u32 i) { return smoothed_value_system.Value(highpass_id, i); });
+        }
+
+        m_wet_dry.MixStereo(smoothed_value_system, wet, io_frames);
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
     }
 
     void ResetInternal() override {
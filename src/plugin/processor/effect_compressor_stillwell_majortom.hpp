@@ -14,12 +14,21 @@ class Compressor final : public Effect {
     Compressor(FloeSmoothedValueSystem& s) : Effect(s, EffectType::Compressor) {}
 
   private:
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const& context, StereoAudioFrame in, u32 frame_index) override {
-        (void)frame_index;
-        StereoAudioFrame out;
-        m_compressor.Process(context.sample_rate, in.l, in.r, out.l, out.r);
-        return out;
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const& context) override {
+        ZoneNamedN(process_block, "Compressor ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        // The compressor's gain depends on the previous frame so there's nothing to vectorise here, but we
+        // avoid a virtual call and the on/off mix per frame.
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+        for (auto const i : Range(io_frames.size))
+            m_compressor.Process(context.sample_rate, io_frames[i].l, io_frames[i].r, wet[i].l, wet[i].r);
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
     }
 
     void OnParamChangeInternal(ChangedParams changed_params, AudioProcessingContext const& context) override {
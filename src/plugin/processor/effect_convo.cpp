@@ -0,0 +1,248 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "effect_convo.hpp"
+
+#include "tests/framework.hpp"
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+TEST_CASE(TestConvolverFftBackends) {
+    constexpr u32 k_sample_rate = 44100;
+    constexpr u32 k_block_size = 512;
+    constexpr u32 k_input_frames = k_sample_rate;
+    u64 seed = 0x1234;
+
+    auto input = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+    for (auto& s : input)
+        s = RandomFloatInRange<f32>(seed, -1, 1);
+    auto const input_l = input.SubSpan(0, k_input_frames);
+    auto const input_r = input.SubSpan(k_input_frames);
+
+    // Short enough to keep the test quick, but the longest still spans the convolver's tail partitions. The
+    // speed of each backend is compared by floe-bench --fft-backends.
+    for (auto const ir_seconds : Array {0.05f, 0.5f, 1.5f}) {
+        auto const ir_frames = (u32)(ir_seconds * k_sample_rate);
+        auto ir = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(ir_frames * 2);
+        auto const decay = Pow(0.001f, 1.0f / (f32)ir_frames);
+        f32 gain = 1;
+        for (auto const frame : Range(ir_frames)) {
+            ir[frame * 2 + 0] = RandomFloatInRange<f32>(seed, -1, 1) * gain;
+            ir[frame * 2 + 1] = RandomFloatInRange<f32>(seed, -1, 1) * gain;
+            gain *= decay;
+        }
+
+        Array<Span<f32>, 2> outputs {};
+        for (auto const backend_index : Range(2u)) {
+            auto const backend =
+                backend_index == 0 ? ConvolverFftBackend::Default : ConvolverFftBackend::Ooura;
+            auto& output = outputs[backend_index];
+            output = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+
+            auto convolver = CreateStereoConvolver();
+            DEFER { DestroyStereoConvolver(convolver); };
+            Init(*convolver, ir.data, (int)ir_frames, 2, backend);
+
+            for (u32 pos = 0; pos < k_input_frames; pos += k_block_size) {
+                auto const num_frames = (int)Min(k_block_size, k_input_frames - pos);
+                Process(*convolver,
+                        input_l.data + pos,
+                        input_r.data + pos,
+                        output.data + pos,
+                        output.data + k_input_frames + pos,
+                        num_frames,
+                        0.01);
+            }
+        }
+
+        // Both backends compute the same convolution so they should only differ by rounding.
+        f32 max_output = 0;
+        f32 max_difference = 0;
+        for (auto const i : Range(outputs[0].size)) {
+            max_output = Max(max_output, Abs(outputs[1][i]));
+            max_difference = Max(max_difference, Abs(outputs[0][i] - outputs[1][i]));
+        }
+        CHECK_GT(max_output, 0.0f);
+        CHECK_LT(max_difference, max_output * 0.0001f);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestConvolverBackgroundTail) {
+    constexpr u32 k_sample_rate = 44100;
+    constexpr u32 k_input_frames = k_sample_rate * 2;
+    constexpr u32 k_ir_frames = k_sample_rate; // spans several tail partitions
+    u64 seed = 0x5678;
+
+    auto input = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+    for (auto& s : input)
+        s = RandomFloatInRange<f32>(seed, -1, 1);
+    auto ir = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_ir_frames * 2);
+    for (auto& s : ir)
+        s = RandomFloatInRange<f32>(seed, -1, 1) * 0.1f;
+
+    // The tail job is split into steps that can be handed between threads at any point, so however the work
+    // ends up divided between the worker and the audio thread, the result should be bit-for-bit the same as
+    // doing it all inline. The head partitions round differently depending on the block size, so each block
+    // size is compared against an inline run of its own.
+    auto const process = [&](bool background_tail, f64 max_wait_seconds, u32 block_size) {
+        auto output = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+        auto convolver = CreateStereoConvolver();
+        DEFER { DestroyStereoConvolver(convolver); };
+        Init(*convolver, ir.data, (int)k_ir_frames, 2, ConvolverFftBackend::Default, background_tail);
+        for (u32 pos = 0; pos < k_input_frames; pos += block_size) {
+            auto const num_frames = (int)Min(block_size, k_input_frames - pos);
+            Process(*convolver,
+                    input.data + pos,
+                    input.data + k_input_frames + pos,
+                    output.data + pos,
+                    output.data + k_input_frames + pos,
+                    num_frames,
+                    max_wait_seconds);
+        }
+        return output;
+    };
+
+    for (auto const block_size : Array {512u, 97u}) {
+        CAPTURE(block_size);
+        auto const inline_output = process(false, 0, block_size);
+
+        // The worker always has time to finish.
+        auto const background_output = process(true, 1, block_size);
+        CHECK(MemoryIsEqual(inline_output.data, background_output.data, inline_output.size * sizeof(f32)));
+
+        // The audio thread takes the job back from wherever the worker got to.
+        auto const handed_back_output = process(true, 0, block_size);
+        CHECK(MemoryIsEqual(inline_output.data, handed_back_output.data, inline_output.size * sizeof(f32)));
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestConvolverIrCache) {
+    constexpr u32 k_ir_frames = 2000;
+    u64 seed = 0x9abc;
+
+    auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_ir_frames);
+    for (auto& s : samples)
+        s = RandomFloatInRange<f32>(seed, -1, 1);
+    f32 const* channels[] {samples.data};
+
+    ConvolverIrCache cache;
+    ConvolverBlockSizes const other_block_sizes {256, 4096};
+    ConvolverIrCache::Key const key {.audio_hash = 1, .block_sizes = k_convolver_block_sizes};
+
+    auto ir = CreateConvolverIr(channels, 1, (int)k_ir_frames, key.block_sizes);
+    cache.Insert(key, *ir);
+    ReleaseConvolverIr(*ir); // the cache keeps it alive
+
+    SUBCASE("same hash and block sizes is a hit") {
+        auto found = cache.Find(key);
+        REQUIRE(found);
+        CHECK(found == ir);
+        ReleaseConvolverIr(*found);
+    }
+
+    SUBCASE("different hash is a miss") {
+        CHECK(!cache.Find({.audio_hash = 2, .block_sizes = key.block_sizes}));
+    }
+
+    SUBCASE("different block sizes is a miss") {
+        ConvolverIrCache::Key const other_key {
+            .audio_hash = key.audio_hash,
+            .block_sizes = other_block_sizes,
+        };
+        CHECK(!cache.Find(other_key));
+
+        // The same audio partitioned differently is a separate entry.
+        auto other_ir = CreateConvolverIr(channels, 1, (int)k_ir_frames, other_block_sizes);
+        cache.Insert(other_key, *other_ir);
+        ReleaseConvolverIr(*other_ir);
+        CHECK_EQ(cache.entries.size, 2u);
+
+        auto found = cache.Find(other_key);
+        CHECK(found == other_ir);
+        if (found) ReleaseConvolverIr(*found);
+
+        found = cache.Find(key);
+        CHECK(found == ir);
+        if (found) ReleaseConvolverIr(*found);
+    }
+
+    SUBCASE("inserting an existing key keeps the first") {
+        auto duplicate = CreateConvolverIr(channels, 1, (int)k_ir_frames, key.block_sizes);
+        cache.Insert(key, *duplicate);
+        ReleaseConvolverIr(*duplicate);
+        CHECK_EQ(cache.entries.size, 1u);
+
+        auto found = cache.Find(key);
+        CHECK(found == ir);
+        if (found) ReleaseConvolverIr(*found);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestConvolverMonoIr) {
+    constexpr u32 k_input_frames = 44100;
+    constexpr u32 k_ir_frames = 20000; // spans more than one tail partition
+    constexpr u32 k_block_size = 512;
+    u64 seed = 0xdef0;
+
+    auto input = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+    for (auto& s : input)
+        s = RandomFloatInRange<f32>(seed, -1, 1);
+    auto mono_ir = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_ir_frames);
+    for (auto& s : mono_ir)
+        s = RandomFloatInRange<f32>(seed, -1, 1) * 0.1f;
+
+    auto const process = [&](u32 num_ir_channels) {
+        // A mono IR is partitioned once and shared by both sides, so it should behave exactly like a
+        // stereo IR with the same samples in each channel.
+        f32 const* channels[] {mono_ir.data, mono_ir.data};
+        auto ir = CreateConvolverIr(channels, (int)num_ir_channels, (int)k_ir_frames);
+        DEFER { ReleaseConvolverIr(*ir); };
+        CHECK_EQ(NumFrames(*ir), (int)k_ir_frames);
+
+        auto output = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_input_frames * 2);
+        auto convolver = CreateStereoConvolver();
+        DEFER { DestroyStereoConvolver(convolver); };
+        Init(*convolver, *ir, false);
+        for (u32 pos = 0; pos < k_input_frames; pos += k_block_size) {
+            auto const num_frames = (int)Min(k_block_size, k_input_frames - pos);
+            Process(*convolver,
+                    input.data + pos,
+                    input.data + k_input_frames + pos,
+                    output.data + pos,
+                    output.data + k_input_frames + pos,
+                    num_frames,
+                    0);
+        }
+        return output;
+    };
+
+    auto const mono_output = process(1);
+    auto const stereo_output = process(2);
+    CHECK(MemoryIsEqual(mono_output.data, stereo_output.data, mono_output.size * sizeof(f32)));
+
+    // Each side still convolves its own input.
+    CHECK(!MemoryIsEqual(mono_output.data, mono_output.data + k_input_frames, k_input_frames * sizeof(f32)));
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterEffectConvoTests) {
+    REGISTER_TEST(TestConvolverFftBackends);
+    REGISTER_TEST(TestConvolverBackgroundTail);
+    REGISTER_TEST(TestConvolverIrCache);
+    REGISTER_TEST(TestConvolverMonoIr);
+}
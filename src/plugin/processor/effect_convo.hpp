@@ -4,17 +4,21 @@
 #pragma once
 #include "foundation/foundation.hpp"
 #include "os/misc.hpp"
+#include "os/threading.hpp"
 #include "utils/thread_extra/atomic_queue.hpp"
+#include "utils/thread_extra/thread_pool.hpp"
 
 #include "common_infrastructure/audio_data.hpp"
 #include "common_infrastructure/descriptors/param_descriptors.hpp"
 #include "common_infrastructure/sample_library/sample_library.hpp"
 
 #include "FFTConvolver/wrapper.hpp"
+#include "convolver_ir_cache.hpp"
 #include "effect.hpp"
 #include "processing_utils/audio_processing_context.hpp"
 #include "processing_utils/filters.hpp"
 #include "processing_utils/smoothed_value_system.hpp"
+#include "sample_lib_server/sample_library_server.hpp"
 
 class ConvolutionReverb final : public Effect {
   public:
@@ -23,8 +27,12 @@ class ConvolutionReverb final : public Effect {
         , m_filter_coeffs_smoother_id(s.CreateFilterSmoother())
         , m_wet_dry(s) {}
     ~ConvolutionReverb() {
+        m_num_build_jobs.WaitUntilZero();
         DeletedUnusedConvolvers();
         if (m_convolver) DestroyStereoConvolver(m_convolver);
+        if (m_outgoing_convolver) DestroyStereoConvolver(m_outgoing_convolver);
+        auto const desired = m_desired_convolver.Load(LoadMemoryOrder::Acquire);
+        if (desired && (uintptr)desired != k_desired_convolver_consumed) DestroyStereoConvolver(desired);
     }
 
     struct ConvoProcessResult {
@@ -35,8 +43,7 @@ class ConvolutionReverb final : public Effect {
     // audio-thread, instead of the virtual function
     ConvoProcessResult ProcessBlockConvolution(AudioProcessingContext const& context,
                                                Span<StereoAudioFrame> io_frames,
-                                               ScratchBuffers scratch_buffers,
-                                               bool start_fade_out) {
+                                               ScratchBuffers scratch_buffers) {
         ZoneScoped;
         ConvoProcessResult result {
             .effect_process_state = EffectProcessResult::Done,
@@ -47,43 +54,48 @@ class ConvolutionReverb final : public Effect {
             return result;
         }
 
+        // The current convolver keeps running while a new one is built. Once the new one is ready, we run
+        // both for a moment and crossfade between them.
+        if (!m_fade.IsFadingIn()) result.changed_ir = StartCrossfadeIfNeeded(context.sample_rate);
+        bool const crossfading = m_fade.IsFadingIn();
+
         auto input_channels = scratch_buffers.buf1.Channels();
         CopyFramesToSeparateChannels(input_channels, io_frames);
 
-        if (start_fade_out) m_fade.SetAsFadeOut(context.sample_rate, 20);
+        auto const num_frames = (u32)io_frames.size;
+        auto const max_tail_wait_seconds = k_max_tail_wait_fraction * (f64)num_frames / context.sample_rate;
 
         auto wet_channels = scratch_buffers.buf2.Channels();
-        if (m_convolver) {
-            Process(*m_convolver,
-                    input_channels[0],
-                    input_channels[1],
-                    wet_channels[0],
-                    wet_channels[1],
-                    (int)io_frames.size);
-        } else {
-            SimdZeroAlignedBuffer(wet_channels[0], io_frames.size * 2);
+        ProcessConvolver(m_convolver, input_channels, wet_channels, num_frames, max_tail_wait_seconds);
+
+        Array<f32*, 2> outgoing_wet_channels {};
+        if (crossfading) {
+            ASSERT(m_outgoing_wet.size >= num_frames * 2);
+            outgoing_wet_channels = {m_outgoing_wet.data, m_outgoing_wet.data + num_frames};
+            ProcessConvolver(m_outgoing_convolver,
+                             input_channels,
+                             outgoing_wet_channels,
+                             num_frames,
+                             max_tail_wait_seconds);
         }
 
         for (auto [frame_index, frame] : Enumerate<u32>(io_frames)) {
             StereoAudioFrame wet(wet_channels, frame_index);
+            if (crossfading)
+                if (auto f = m_fade.GetFade(); f != 1)
+                    wet = LinearInterpolate(f, StereoAudioFrame(outgoing_wet_channels, frame_index), wet);
+
             auto [filter_coeffs, mix] = smoothed_value_system.Value(m_filter_coeffs_smoother_id, frame_index);
             wet = Process(m_filter, filter_coeffs, wet * mix);
             wet = m_wet_dry.MixStereo(smoothed_value_system, frame_index, wet, frame);
-
-            if (auto f = m_fade.GetFade(); f != 1) wet = LinearInterpolate(f, frame, wet);
-
-            if (m_fade.IsSilent()) {
-                m_remaining_tail_length = 0;
-                result.changed_ir = SwapConvolversIfNeeded();
-                break;
-            } else {
-                UpdateRemainingTailLength(wet);
-            }
+            UpdateRemainingTailLength(wet);
 
             wet = MixOnOffSmoothing(wet, frame, frame_index);
             frame = wet;
         }
 
+        if (crossfading && m_fade.IsFullVolume()) FinishCrossfade();
+
         result.effect_process_state =
             IsSilent() ? EffectProcessResult::Done : EffectProcessResult::ProcessingTail;
         return result;
@@ -92,11 +104,13 @@ class ConvolutionReverb final : public Effect {
     // audio-thread
     bool IsSilent() const { return m_remaining_tail_length == 0; }
 
-    // [audio-thread]
+    // [audio-thread] Switches to the desired convolver immediately, without a crossfade. For when the
+    // output is silent anyway.
     bool SwapConvolversIfNeeded() {
         ZoneScoped;
-        auto new_convolver = m_desired_convolver.Exchange((StereoConvolver*)k_desired_convolver_consumed,
-                                                          RmwMemoryOrder::Acquire);
+        if (m_fade.IsFadingIn()) FinishCrossfade();
+
+        auto new_convolver = TakeDesiredConvolver();
         if ((uintptr)new_convolver == k_desired_convolver_consumed) return false;
 
         auto old_convolver = Exchange(m_convolver, new_convolver);
@@ -106,24 +120,56 @@ class ConvolutionReverb final : public Effect {
 
         m_remaining_tail_length = 0;
         m_filter = {};
-        if (m_convolver)
-            m_max_tail_length = (u32)NumFrames(*m_convolver);
-        else
-            m_max_tail_length = 0;
-
-        m_fade.ForceSetFullVolume();
+        m_max_tail_length = m_convolver ? (u32)NumFrames(*m_convolver) : 0;
         return true;
     }
 
-    // [main-thread]
-    void ConvolutionIrDataLoaded(AudioData const* audio_data) {
+    void PrepareToPlay(AudioProcessingContext const& context) override {
+        dyn::Resize(m_outgoing_wet, (usize)context.process_block_size_max * 2);
+    }
+
+    // [main-thread] Building a convolver means FFTing every partition of the IR, which takes a while for
+    // long IRs, so it's done on the thread pool. The audio thread keeps using the old convolver until the
+    // new one is ready. Only the most recent call's convolver is ever used.
+    void ConvolutionIrDataLoaded(sample_lib_server::RefCounted<sample_lib::LoadedIr> ir,
+                                 ThreadPool& thread_pool,
+                                 ConvolverIrCache& ir_cache) {
         DeletedUnusedConvolvers();
-        if (audio_data)
-            m_desired_convolver.Store(CreateConvolver(*audio_data), StoreMemoryOrder::Relaxed);
-        else
-            m_desired_convolver.Store(nullptr, StoreMemoryOrder::Relaxed);
+
+        u32 generation;
+        {
+            ScopedMutexLock const lock(m_desired_convolver_mutex);
+            generation = ++m_desired_convolver_generation;
+            if (!ir || !ir->audio_data) {
+                SetDesiredConvolver(nullptr);
+                return;
+            }
+        }
+
+        ir.Retain();
+        m_num_build_jobs.Increase();
+        thread_pool.AddJob([this, ir, &ir_cache, generation]() {
+            ZoneNamedN(build, "Build convolver", true);
+            DEFER {
+                ir.Release();
+                m_num_build_jobs.CountDown();
+            };
+
+            auto convolver = CreateConvolver(*ir->audio_data, ir_cache);
+
+            ScopedMutexLock const lock(m_desired_convolver_mutex);
+            if (generation != m_desired_convolver_generation) {
+                // A newer IR was requested while we were building.
+                DestroyStereoConvolver(convolver);
+                return;
+            }
+            SetDesiredConvolver(convolver);
+        });
     }
 
+    // [main-thread] True while a convolver is being built on the thread pool.
+    bool ConvolverBuildIsPending() const { return !m_num_build_jobs.TryWait(); }
+
     // [main-thread]. Call this periodically
     void DeletedUnusedConvolvers() {
         for (auto c : m_convolvers_to_delete.PopAll())
@@ -134,16 +180,99 @@ class ConvolutionReverb final : public Effect {
     Optional<sample_lib::IrId> ir_id = k_nullopt; // May temporarily differ to what is actually loaded
 
   private:
-    static StereoConvolver* CreateConvolver(AudioData const& audio_data) {
-        auto num_channels = audio_data.channels;
-        auto num_frames = audio_data.num_frames;
+    // [thread-pool]
+    static StereoConvolver* CreateConvolver(AudioData const& audio_data, ConvolverIrCache& ir_cache) {
+        ConvolverIrCache::Key const key {
+            .audio_hash = audio_data.hash,
+            .block_sizes = k_convolver_block_sizes,
+        };
+        auto ir = ir_cache.Find(key);
+        if (!ir) {
+            ir = PartitionIr(audio_data);
+            ir_cache.Insert(key, *ir);
+        }
+        DEFER { ReleaseConvolverIr(*ir); };
+
+        auto result = CreateStereoConvolver();
+        Init(*result, *ir);
+        return result;
+    }
+
+    // [thread-pool]
+    static ConvolverIr* PartitionIr(AudioData const& audio_data) {
+        auto const num_channels = audio_data.channels;
+        auto const num_frames = audio_data.num_frames;
 
         ASSERT(num_frames);
+        ASSERT(num_channels == 1 || num_channels == 2);
+
+        // The partitioning needs separate f32 channels. It doesn't keep them so we only need these
+        // temporarily.
+        DynamicArray<f32> samples {Malloc::Instance()};
+        dyn::Resize(samples, (usize)num_frames * num_channels);
+        f32 const* channels[2] {};
+        for (auto const chan : Range(num_channels)) {
+            auto channel = samples.data + ((usize)chan * num_frames);
+            for (auto const frame : Range(num_frames))
+                channel[frame] = SampleAsF32(audio_data, ((usize)frame * num_channels) + chan);
+            channels[chan] = channel;
+        }
 
-        auto result = CreateStereoConvolver();
-        Init(*result, audio_data.interleaved_samples.data, (int)num_frames, (int)num_channels);
+        return CreateConvolverIr(channels, num_channels, (int)num_frames);
+    }
 
-        return result;
+    // [audio-thread] Returns k_desired_convolver_consumed if there's nothing new.
+    StereoConvolver* TakeDesiredConvolver() {
+        return m_desired_convolver.Exchange((StereoConvolver*)k_desired_convolver_consumed,
+                                            RmwMemoryOrder::Acquire);
+    }
+
+    // [audio-thread]
+    bool StartCrossfadeIfNeeded(f32 sample_rate) {
+        auto new_convolver = TakeDesiredConvolver();
+        if ((uintptr)new_convolver == k_desired_convolver_consumed) return false;
+
+        // Either convolver can be null, in which case we're fading from or to silence.
+        m_outgoing_convolver = Exchange(m_convolver, new_convolver);
+        m_max_tail_length = Max(m_convolver ? (u32)NumFrames(*m_convolver) : 0u,
+                                m_outgoing_convolver ? (u32)NumFrames(*m_outgoing_convolver) : 0u);
+        m_fade.ForceSetAsFadeIn(sample_rate, k_crossfade_ms);
+        return true;
+    }
+
+    // [audio-thread]
+    void FinishCrossfade() {
+        // Let another thread do the deleting.
+        if (auto c = Exchange(m_outgoing_convolver, nullptr)) m_convolvers_to_delete.Push(c);
+        m_max_tail_length = m_convolver ? (u32)NumFrames(*m_convolver) : 0;
+        m_fade.ForceSetFullVolume();
+    }
+
+    // [audio-thread]
+    static void ProcessConvolver(StereoConvolver* convolver,
+                                 Array<f32*, 2> input_channels,
+                                 Array<f32*, 2> output_channels,
+                                 u32 num_frames,
+                                 f64 max_tail_wait_seconds) {
+        if (convolver) {
+            Process(*convolver,
+                    input_channels[0],
+                    input_channels[1],
+                    output_channels[0],
+                    output_channels[1],
+                    (int)num_frames,
+                    max_tail_wait_seconds);
+        } else {
+            ZeroMemory(output_channels[0], num_frames * sizeof(f32));
+            ZeroMemory(output_channels[1], num_frames * sizeof(f32));
+        }
+    }
+
+    // Must hold m_desired_convolver_mutex.
+    void SetDesiredConvolver(StereoConvolver* convolver) {
+        auto const previous = m_desired_convolver.Exchange(convolver, RmwMemoryOrder::AcquireRelease);
+        // The audio thread never took it so nothing else has a reference to it.
+        if (previous && (uintptr)previous != k_desired_convolver_consumed) DestroyStereoConvolver(previous);
     }
 
     void UpdateRemainingTailLength(StereoAudioFrame frame) {
@@ -170,6 +299,7 @@ class ConvolutionReverb final : public Effect {
     void ResetInternal() override {
         m_filter = {};
 
+        if (m_fade.IsFadingIn()) FinishCrossfade();
         if (m_convolver) Zero(*m_convolver);
 
         m_remaining_tail_length = 0;
@@ -178,14 +308,29 @@ class ConvolutionReverb final : public Effect {
     u32 m_remaining_tail_length {};
     u32 m_max_tail_length {};
 
+    // Fades in m_convolver, and out m_outgoing_convolver. Full volume when not crossfading.
     VolumeFade m_fade {VolumeFade::State::FullVolume};
+    static constexpr f32 k_crossfade_ms = 20;
 
     StereoConvolver* m_convolver {}; // audio-thread only
+    StereoConvolver* m_outgoing_convolver {}; // audio-thread only
+    DynamicArray<f32> m_outgoing_wet {Malloc::Instance()}; // 2 channels of process_block_size_max
+
+    // The worker has a whole tail block to do the convolver's tail job, so it's only late if it has been
+    // starved. Rather than waiting on it for most of this block, we give up after a fraction of the block's
+    // duration and finish the job on the audio thread.
+    static constexpr f64 k_max_tail_wait_fraction = 0.25;
 
     static constexpr uintptr k_desired_convolver_consumed =
         1; // must be an invalid m_desired_convolver pointer
     Atomic<StereoConvolver*> m_desired_convolver {};
 
+    // Serialises setting m_desired_convolver between the main thread and build jobs; the audio thread only
+    // ever does an atomic exchange on it.
+    Mutex m_desired_convolver_mutex {};
+    u32 m_desired_convolver_generation {};
+    AtomicCountdown m_num_build_jobs {0};
+
     static constexpr usize k_max_num_convolvers = 8;
     AtomicQueue<StereoConvolver*, k_max_num_convolvers, NumProducers::One, NumConsumers::One>
         m_convolvers_to_delete;
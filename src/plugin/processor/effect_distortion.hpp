@@ -21,13 +21,15 @@ enum DistFunction {
 };
 
 struct DistortionProcessor {
-    f32 Saturate(f32 input, DistFunction type, f32 amount_fraction) {
+    // The type is a template parameter so that the switch disappears from loops over whole blocks.
+    template <DistFunction k_type>
+    ALWAYS_INLINE f32 Saturate(f32 input, f32 amount_fraction) {
         f32 output = 0;
 
         auto const input_gain = amount_fraction * 59 + 1;
         input *= input_gain;
 
-        switch (type) {
+        switch (k_type) {
             case DistFunctionTubeLog: {
                 output = Copysign(Log(1 + Fabs(input)), input);
                 break;
@@ -107,12 +109,48 @@ class Distortion final : public Effect {
         , m_amount_smoother_id(s.CreateSmoother()) {}
 
   private:
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const&, StereoAudioFrame in, u32 frame_index) override {
-        auto const amt = smoothed_value_system.Value(m_amount_smoother_id, frame_index);
-        StereoAudioFrame out {m_processor_l.Saturate(in.l, m_type, amt),
-                              m_processor_r.Saturate(in.r, m_type, amt)};
-        return out;
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const&) override {
+        ZoneNamedN(process_block, "Distortion ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+
+        switch (m_type) {
+            case DistFunctionTubeLog: SaturateBlock<DistFunctionTubeLog>(io_frames, wet); break;
+            case DistFunctionTubeAsym3: SaturateBlock<DistFunctionTubeAsym3>(io_frames, wet); break;
+            case DistFunctionSinFunc: SaturateBlock<DistFunctionSinFunc>(io_frames, wet); break;
+            case DistFunctionRaph1: SaturateBlock<DistFunctionRaph1>(io_frames, wet); break;
+            case DistFunctionDecimate: SaturateBlock<DistFunctionDecimate>(io_frames, wet); break;
+            case DistFunctionAtan: SaturateBlock<DistFunctionAtan>(io_frames, wet); break;
+            case DistFunctionClip: SaturateBlock<DistFunctionClip>(io_frames, wet); break;
+            case DistFunctionCount: PanicIfReached(); break;
+        }
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
+    }
+
+    template <DistFunction k_type>
+    void SaturateBlock(Span<StereoAudioFrame const> in, Span<StereoAudioFrame> out) {
+        auto process = [&](auto&& amount) {
+            for (auto const i : Range((u32)in.size)) {
+                auto const amt = amount(i);
+                out[i] = {m_processor_l.Saturate<k_type>(in[i].l, amt),
+                          m_processor_r.Saturate<k_type>(in[i].r, amt)};
+            }
+        };
+
+        // When the amount isn't changing, everything that only depends on it is hoisted out of the loop.
+        if (!smoothed_value_system.IsSmoothing(m_amount_smoother_id, 0)) {
+            auto const amount = smoothed_value_system.TargetValue(m_amount_smoother_id);
+            process([amount](u32) { return amount; });
+        } else {
+            auto const amounts = smoothed_value_system.AllValues(m_amount_smoother_id);
+            process([amounts](u32 i) { return amounts[i]; });
+        }
     }
 
     void OnParamChangeInternal(ChangedParams changed_params, AudioProcessingContext const&) override {
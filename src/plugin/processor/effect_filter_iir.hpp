@@ -69,10 +69,30 @@ class FilterEffect final : public Effect {
         if (set_params) smoothed_value_system.Set(m_filter_coeff_smoother_id, m_filter_params);
     }
 
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const&, StereoAudioFrame in, u32 frame_index) override {
-        auto [coeffs, filter_mix] = smoothed_value_system.Value(m_filter_coeff_smoother_id, frame_index);
-        return Process(m_filter2, coeffs, Process(m_filter1, coeffs, in * filter_mix));
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const&) override {
+        ZoneNamedN(process_block, "FilterEffect ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+
+        if (!smoothed_value_system.IsSmoothing(m_filter_coeff_smoother_id)) {
+            // The coefficients are the same for the whole block, and the mix is 1.
+            auto const coeffs = smoothed_value_system.Value(m_filter_coeff_smoother_id, 0).coeffs;
+            CopyMemory(wet.data, io_frames.data, io_frames.size * sizeof(StereoAudioFrame));
+            rbj_filter::ProcessBlock(m_filter1, coeffs, wet);
+            rbj_filter::ProcessBlock(m_filter2, coeffs, wet);
+        } else {
+            for (auto const i : Range((u32)io_frames.size)) {
+                auto [coeffs, filter_mix] = smoothed_value_system.Value(m_filter_coeff_smoother_id, i);
+                wet[i] = Process(m_filter2, coeffs, Process(m_filter1, coeffs, io_frames[i] * filter_mix));
+            }
+        }
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
     }
 
     void ResetInternal() override {
@@ -33,9 +33,42 @@ class StereoWiden final : public Effect {
         : Effect(s, EffectType::StereoWiden)
         , m_width_smoother_id(s.CreateSmoother()) {}
 
-    StereoAudioFrame
-    ProcessFrame(AudioProcessingContext const&, StereoAudioFrame in, u32 frame_index) override {
-        return DoStereoWiden(smoothed_value_system.Value(m_width_smoother_id, frame_index), in);
+    EffectProcessResult ProcessBlock(Span<StereoAudioFrame> io_frames,
+                                     ScratchBuffers scratch_buffers,
+                                     AudioProcessingContext const&) override {
+        ZoneNamedN(process_block, "StereoWiden ProcessBlock", true);
+        if (!ShouldProcessBlock()) return EffectProcessResult::Done;
+
+        auto wet = scratch_buffers.buf1.Interleaved();
+        wet.size = io_frames.size;
+
+        if (!smoothed_value_system.IsSmoothing(m_width_smoother_id, 0)) {
+            auto const width = smoothed_value_system.TargetValue(m_width_smoother_id);
+            WidenFrames(io_frames, wet, [width](u32) { return width; });
+        } else {
+            auto const widths = smoothed_value_system.AllValues(m_width_smoother_id);
+            WidenFrames(io_frames, wet, [widths](u32 i) { return widths[i]; });
+        }
+
+        MixOnOffSmoothing(io_frames, wet);
+        return EffectProcessResult::Done;
+    }
+
+    // The same as DoStereoWiden but 2 frames at a time: {l0, r0, l1, r1}.
+    template <typename WidthFunction>
+    static ALWAYS_INLINE void
+    WidenFrames(Span<StereoAudioFrame const> in, Span<StereoAudioFrame> out, WidthFunction&& width) {
+        auto const num_frames = (u32)in.size;
+        u32 frame = 0;
+        for (; frame + 2 <= num_frames; frame += 2) {
+            f32x4 const coef_s {width(frame), width(frame), width(frame + 1), width(frame + 1)};
+            auto const v = LoadUnalignedToType<f32x4>(&in[frame].l);
+            auto const swapped = __builtin_shufflevector(v, v, 1, 0, 3, 2);
+            auto const m = (v + swapped) * 0.5f; // (l + r) / 2 in every element
+            auto const s = (swapped - v) * (coef_s * 0.5f); // {r - l, l - r, ...} * width / 2
+            StoreToUnaligned(&out[frame].l, m - s);
+        }
+        if (frame != num_frames) out[frame] = DoStereoWiden(width(frame), in[frame]);
     }
     void OnParamChangeInternal(ChangedParams changed_params, AudioProcessingContext const&) override {
         if (auto p = changed_params.Param(ParamIndex::StereoWidenWidth)) {
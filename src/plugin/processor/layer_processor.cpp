@@ -438,13 +438,12 @@ static void TriggerVoicesIfNeeded(LayerProcessor& layer,
         });
         DEFER { layer_rr->Store(rr_pos + 1, StoreMemoryOrder::Relaxed); };
 
-        for (auto i : Range(inst.instrument.regions.size)) {
+        // The lookup table already filters by key and trigger event.
+        for (auto const i : inst.region_lookup.RegionsForKey(trigger_event, note_for_samples)) {
             auto const& region = inst.instrument.regions[i];
             auto const& audio_data = inst.audio_datas[i];
-            if (region.trigger.key_range.Contains(note_for_samples) &&
-                region.trigger.velocity_range.Contains(note_vel) &&
-                (!region.trigger.round_robin_index || *region.trigger.round_robin_index == rr_pos) &&
-                region.trigger.trigger_event == trigger_event) {
+            if (region.trigger.velocity_range.Contains(note_vel) &&
+                (!region.trigger.round_robin_index || *region.trigger.round_robin_index == rr_pos)) {
                 dyn::Append(sampler_params.voice_sample_params,
                             VoiceStartParams::SamplerParams::Region {
                                 .region = region,
@@ -610,12 +609,14 @@ LayerProcessResult ProcessLayer(LayerProcessor& layer,
         return result;
     }
 
+    auto const vol = layer.smoothed_value_system.Ramp(layer.vol_smoother_id);
+    auto const mute_solo_mix = layer.smoothed_value_system.Ramp(layer.mute_solo_mix_smoother_id);
+
     for (auto const i : Range(num_frames)) {
         StereoAudioFrame frame(buffer.data, i);
         frame = layer.eq_bands.Process(layer.smoothed_value_system, frame, i);
 
-        frame *= layer.smoothed_value_system.Value(layer.vol_smoother_id, i) *
-                 layer.smoothed_value_system.Value(layer.mute_solo_mix_smoother_id, i);
+        frame *= vol.At(i) * mute_solo_mix.At(i);
 
         if (!result.instrument_swapped) {
             auto const fade = layer.inst_change_fade.GetFadeAndStateChange();
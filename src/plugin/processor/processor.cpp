@@ -84,9 +84,71 @@ prefs::Descriptor SettingDescriptor(ProcessorSetting s) {
 
             };
         }
+        case ProcessorSetting::VoiceWorkerThreads: {
+            return {
+                .key = "voice-worker-threads"_s,
+                .value_requirements =
+                    prefs::Descriptor::IntRequirements {
+                        .validator =
+                            [](s64& value) {
+                                value = Clamp<s64>(value, 0, 16);
+                                return true;
+                            },
+                    },
+                .default_value = (s64)0,
+                .gui_label = "Voice rendering threads"_s,
+                .long_description =
+                    "Number of extra threads each instance uses to render voices when the host doesn't "
+                    "provide a thread pool. 0 (the default) renders all voices on the audio thread. Off by "
+                    "default because every instance gets its own threads, so with several instances they "
+                    "compete with each other and the host for cores. Applies when audio next starts."_s,
+            };
+        }
+        case ProcessorSetting::InterpolationQuality: {
+            return {
+                .key = "interpolation-quality"_s,
+                .value_requirements =
+                    prefs::Descriptor::IntRequirements {
+                        .validator =
+                            [](s64& value) {
+                                value = Clamp<s64>(value, 0, ToInt(InterpolationQuality::Count) - 1);
+                                return true;
+                            },
+                    },
+                .default_value = (s64)ToInt(InterpolationQuality::Cubic),
+                .gui_label = "Sample interpolation quality"_s,
+                .long_description =
+                    "How samples are resampled when playing them at a different pitch: 0 is linear (lowest "
+                    "CPU), 1 is cubic and 2 is windowed sinc (highest quality). Offline renders always use "
+                    "windowed sinc."_s,
+            };
+        }
+    }
+}
+
+static void UpdateInterpolationQuality(AudioProcessor& processor) {
+    processor.voice_pool.interpolation_quality.Store(
+        processor.rendering_offline ? InterpolationQuality::Sinc : processor.realtime_interpolation_quality,
+        StoreMemoryOrder::Relaxed);
+}
+
+void OnPreferenceChanged(AudioProcessor& processor, prefs::Key const& key, prefs::Value const* value) {
+    ASSERT(IsMainThread(processor.host));
+    if (auto const v = prefs::MatchInt(key, value, SettingDescriptor(ProcessorSetting::VoiceWorkerThreads)))
+        processor.num_voice_worker_threads = (u32)*v;
+    if (auto const v =
+            prefs::MatchInt(key, value, SettingDescriptor(ProcessorSetting::InterpolationQuality))) {
+        processor.realtime_interpolation_quality = (InterpolationQuality)*v;
+        UpdateInterpolationQuality(processor);
     }
 }
 
+void SetRenderingOffline(AudioProcessor& processor, bool offline) {
+    ASSERT(IsMainThread(processor.host));
+    processor.rendering_offline = offline;
+    UpdateInterpolationQuality(processor);
+}
+
 bool EffectIsOn(Parameters const& params, Effect* effect) {
     return params[ToInt(k_effect_info[ToInt(effect->type)].on_param_index)].ValueAsBool();
 }
@@ -683,9 +745,9 @@ void SetInstrument(AudioProcessor& processor, u32 layer_index, Instrument const&
     processor.host.request_process(&processor.host);
 }
 
-void SetConvolutionIrAudioData(AudioProcessor& processor, AudioData const* audio_data) {
+void SetConvolutionIr(AudioProcessor& processor, sample_lib_server::RefCounted<sample_lib::LoadedIr> ir) {
     ASSERT(IsMainThread(processor.host));
-    processor.convo.ConvolutionIrDataLoaded(audio_data);
+    processor.convo.ConvolutionIrDataLoaded(ir, processor.thread_pool, processor.convolver_ir_cache);
     processor.events_for_audio_thread.Push(EventForAudioThreadType::ConvolutionIRChanged);
     processor.host.request_process(&processor.host);
 }
@@ -778,6 +840,12 @@ static bool Activate(AudioProcessor& processor, PluginActivateArgs args) {
     for (auto& fx : processor.effects_ordered_by_type)
         fx->PrepareToPlay(processor.audio_processing_context);
 
+    if (auto& workers = processor.voice_pool.worker_pool;
+        workers.NumThreads() != processor.num_voice_worker_threads) {
+        workers.Stop();
+        if (processor.num_voice_worker_threads) workers.Start("voices", processor.num_voice_worker_threads);
+    }
+
     if (Exchange(processor.previous_block_size, processor.audio_processing_context.process_block_size_max) <
         processor.audio_processing_context.process_block_size_max) {
 
@@ -809,13 +877,16 @@ static bool Activate(AudioProcessor& processor, PluginActivateArgs args) {
     return true;
 }
 
+// frame_offset is the position of the current sub-block within the host's block.
 static void ProcessClapNoteOrMidi(AudioProcessor& processor,
                                   clap_event_header const& event,
+                                  u32 frame_offset,
                                   clap_output_events const& out,
                                   ProcessorListener::ChangeFlags& change_flags) {
     // IMPROVE: support per-param modulation and automation - each param can opt in to it individually
 
     Bitset<k_num_parameters> changed_params {};
+    auto const event_offset = event.time > frame_offset ? event.time - frame_offset : 0;
 
     switch (event.type) {
         case CLAP_EVENT_NOTE_ON: {
@@ -826,7 +897,7 @@ static void ProcessClapNoteOrMidi(AudioProcessor& processor,
             MidiChannelNote const chan_note {.note = (u7)note.key, .channel = (u4)note.channel};
 
             processor.audio_processing_context.midi_note_state.NoteOn(chan_note, (f32)note.velocity);
-            HandleNoteOn(processor, chan_note, (f32)note.velocity, note.header.time);
+            HandleNoteOn(processor, chan_note, (f32)note.velocity, event_offset);
             break;
         }
         case CLAP_EVENT_NOTE_OFF: {
@@ -902,7 +973,7 @@ static void ProcessClapNoteOrMidi(AudioProcessor& processor,
                 case MidiMessageType::NoteOn: {
                     processor.audio_processing_context.midi_note_state.NoteOn(message.ChannelNote(),
                                                                               message.Velocity() / 127.0f);
-                    HandleNoteOn(processor, message.ChannelNote(), message.Velocity() / 127.0f, event.time);
+                    HandleNoteOn(processor, message.ChannelNote(), message.Velocity() / 127.0f, event_offset);
                     break;
                 }
                 case MidiMessageType::NoteOff: {
@@ -1016,12 +1087,14 @@ static void ProcessClapNoteOrMidi(AudioProcessor& processor,
     if (changed_params.AnyValuesSet()) ProcessorOnParamChange(processor, {processor.params, changed_params});
 }
 
+// Consumes events [first_event, end_event).
 static void ConsumeParamEventsFromHost(Parameters& params,
                                        clap_input_events const& events,
+                                       u32 first_event,
+                                       u32 end_event,
                                        Bitset<k_num_parameters>& params_changed) {
     ZoneScoped;
-    // IMPROVE: support sample-accurate value changes
-    for (auto const event_index : Range(events.size(&events))) {
+    for (auto const event_index : Range(first_event, end_event)) {
         auto e = events.get(&events, event_index);
         if (e->space_id != CLAP_CORE_EVENT_SPACE_ID) continue;
 
@@ -1101,7 +1174,7 @@ static void ConsumeParamEventsFromGui(AudioProcessor& processor,
 static void
 FlushParameterEvents(AudioProcessor& processor, clap_input_events const& in, clap_output_events const& out) {
     Bitset<k_num_parameters> params_changed {};
-    ConsumeParamEventsFromHost(processor.params, in, params_changed);
+    ConsumeParamEventsFromHost(processor.params, in, 0, in.size(&in), params_changed);
     ConsumeParamEventsFromGui(processor, out, params_changed);
 
     if (processor.activated) {
@@ -1113,61 +1186,83 @@ FlushParameterEvents(AudioProcessor& processor, clap_input_events const& in, cla
     }
 }
 
-clap_process_status Process(AudioProcessor& processor, clap_process const& process) {
-    ZoneScoped;
-    ASSERT_EQ(process.audio_outputs_count, 1u);
+static void UpdateTempo(AudioProcessor& processor, clap_event_transport const* transport) {
+    bool tempo_changed = false;
+    if (transport && (transport->flags & CLAP_TRANSPORT_HAS_TEMPO) &&
+        transport->tempo != processor.audio_processing_context.tempo && transport->tempo > 0) {
+        processor.audio_processing_context.tempo = transport->tempo;
+        tempo_changed = true;
+    }
+    if (processor.audio_processing_context.tempo <= 0) {
+        processor.audio_processing_context.tempo = 120;
+        tempo_changed = true;
+    }
 
-    if (process.audio_outputs->channel_count != 2) return CLAP_PROCESS_ERROR;
+    if (tempo_changed) {
+        // IMPROVE: only recalculate changes if the effect is actually on and is currently using
+        // tempo-synced processing
+        for (auto fx : processor.effects_ordered_by_type)
+            fx->SetTempo(processor.audio_processing_context.tempo);
+        for (auto& layer : processor.layer_processors)
+            SetTempo(layer, processor.voice_pool, processor.audio_processing_context);
+    }
+}
 
+// A section of the host's block that starts at an event's time. The host's events are sorted by time so each
+// sub-block owns a contiguous run of them: [first_event, end_event).
+struct SubBlock {
+    u32 frame_offset;
+    u32 num_frames;
+    u32 first_event;
+    u32 end_event;
+};
+
+// Adds the time since the previous lap to a stage's total. Does nothing unless stage timings are enabled.
+struct StageTimer {
+    explicit StageTimer(bool enabled) : enabled(enabled) {
+        if (enabled) last = TimePoint::Now();
+    }
+    void Lap(f64& stage_seconds) {
+        if (!enabled) return;
+        auto const now = TimePoint::Now();
+        stage_seconds += now - last;
+        last = now;
+    }
+    bool const enabled;
+    TimePoint last {};
+};
+
+static clap_process_status ProcessSubBlock(AudioProcessor& processor,
+                                           clap_process const& process,
+                                           SubBlock sub_block,
+                                           Span<EventForAudioThread const> internal_events,
+                                           ProcessorListener::ChangeFlags& change_flags) {
+    ZoneScoped;
     clap_process_status result = CLAP_PROCESS_CONTINUE;
-    auto const num_sample_frames = process.frames_count;
-    auto outputs = process.audio_outputs->data32;
+    auto const num_sample_frames = sub_block.num_frames;
+    auto const& in_events = *process.in_events;
+    bool const is_first_sub_block = sub_block.frame_offset == 0;
 
     // Handle transport changes
-    {
-        // IMPROVE: support per-sample tempo changes by processing CLAP_EVENT_TRANSPORT events
-
-        bool tempo_changed = false;
-        if (process.transport && (process.transport->flags & CLAP_TRANSPORT_HAS_TEMPO) &&
-            process.transport->tempo != processor.audio_processing_context.tempo &&
-            process.transport->tempo > 0) {
-            processor.audio_processing_context.tempo = process.transport->tempo;
-            tempo_changed = true;
-        }
-        if (processor.audio_processing_context.tempo <= 0) {
-            processor.audio_processing_context.tempo = 120;
-            tempo_changed = true;
-        }
-
-        if (tempo_changed) {
-            // IMPROVE: only recalculate changes if the effect is actually on and is currently using
-            // tempo-synced processing
-            for (auto fx : processor.effects_ordered_by_type)
-                fx->SetTempo(processor.audio_processing_context.tempo);
-            for (auto& layer : processor.layer_processors)
-                SetTempo(layer, processor.voice_pool, processor.audio_processing_context);
-        }
+    if (is_first_sub_block) UpdateTempo(processor, process.transport);
+    for (auto const i : Range(sub_block.first_event, sub_block.end_event)) {
+        auto e = in_events.get(&in_events, i);
+        if (e->space_id == CLAP_CORE_EVENT_SPACE_ID && e->type == CLAP_EVENT_TRANSPORT)
+            UpdateTempo(processor, CheckedPointerCast<clap_event_transport const*>(e));
     }
 
     constexpr f32 k_fade_out_ms = 30;
     constexpr f32 k_fade_in_ms = 10;
 
-    auto internal_events = processor.events_for_audio_thread.PopAll();
     Bitset<k_num_parameters> params_changed {};
     Array<bool, k_num_layers> layers_changed {};
-    bool mark_convolution_for_fade_out = false;
-    ProcessorListener::ChangeFlags change_flags = {};
 
-    DEFER {
-        if (processor.previous_process_status != result) change_flags |= ProcessorListener::StatusChanged;
-        processor.previous_process_status = result;
-        processor.notes_currently_held.AssignBlockwise(
-            processor.audio_processing_context.midi_note_state.NotesCurrentlyHeldAllChannels());
-        if (change_flags) processor.listener.OnProcessorChange(change_flags);
-    };
-
-    ConsumeParamEventsFromGui(processor, *process.out_events, params_changed);
-    ConsumeParamEventsFromHost(processor.params, *process.in_events, params_changed);
+    if (is_first_sub_block) ConsumeParamEventsFromGui(processor, *process.out_events, params_changed);
+    ConsumeParamEventsFromHost(processor.params,
+                               in_events,
+                               sub_block.first_event,
+                               sub_block.end_event,
+                               params_changed);
 
     Optional<AudioProcessor::FadeType> new_fade_type {};
     for (auto const& e : internal_events) {
@@ -1189,7 +1284,8 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                 break;
             }
             case EventForAudioThreadType::ConvolutionIRChanged: {
-                mark_convolution_for_fade_out = true;
+                // The convolver crossfades to the new IR itself once it's built. This event is just to
+                // make sure we're processing.
                 break;
             }
             case EventForAudioThreadType::RemoveMidiLearn: {
@@ -1283,9 +1379,9 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
     }
 
     {
-        for (auto const i : Range(process.in_events->size(process.in_events))) {
-            auto e = process.in_events->get(process.in_events, i);
-            ProcessClapNoteOrMidi(processor, *e, *process.out_events, change_flags);
+        for (auto const i : Range(sub_block.first_event, sub_block.end_event)) {
+            auto e = in_events.get(&in_events, i);
+            ProcessClapNoteOrMidi(processor, *e, sub_block.frame_offset, *process.out_events, change_flags);
         }
         for (auto& e : internal_events) {
             switch (e.tag) {
@@ -1297,7 +1393,7 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                     note.key = start.key;
                     note.velocity = (f64)start.velocity;
                     note.note_id = -1;
-                    ProcessClapNoteOrMidi(processor, note.header, *process.out_events, change_flags);
+                    ProcessClapNoteOrMidi(processor, note.header, 0, *process.out_events, change_flags);
                     break;
                 }
                 case EventForAudioThreadType::EndNote: {
@@ -1307,7 +1403,7 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                     note.header.size = sizeof(note);
                     note.key = end.key;
                     note.note_id = -1;
-                    ProcessClapNoteOrMidi(processor, note.header, *process.out_events, change_flags);
+                    ProcessClapNoteOrMidi(processor, note.header, 0, *process.out_events, change_flags);
                     break;
                 }
                 default: break;
@@ -1318,8 +1414,10 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
     // Voices and layers
     // ======================================================================================================
     // IMPROVE: support sending the host CLAP_EVENT_NOTE_END events when voices end
+    StageTimer stage_timer {processor.measure_stage_timings};
     auto const layer_buffers =
         ProcessVoices(processor.voice_pool, num_sample_frames, processor.audio_processing_context);
+    stage_timer.Lap(processor.stage_timings.voices_seconds);
 
     Span<f32> interleaved_outputs {};
     bool audio_was_generated_by_voices = false;
@@ -1349,6 +1447,7 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
             processor.restart_voices_for_layer_bitset |= 1 << i;
         }
     }
+    stage_timer.Lap(processor.stage_timings.layers_seconds);
 
     if (interleaved_outputs.size == 0) {
         interleaved_outputs = processor.voice_pool.buffer_pool[0];
@@ -1394,16 +1493,17 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                 auto const r = ((ConvolutionReverb*)fx)
                                    ->ProcessBlockConvolution(processor.audio_processing_context,
                                                              interleaved_stereo_samples,
-                                                             scratch_buffers,
-                                                             mark_convolution_for_fade_out);
+                                                             scratch_buffers);
                 if (r.effect_process_state == EffectProcessResult::ProcessingTail)
                     fx_need_another_frame_of_processing = true;
                 if (r.changed_ir) change_flags |= ProcessorListener::IrChanged;
+                stage_timer.Lap(processor.stage_timings.convolution_seconds);
             } else {
                 auto const r = fx->ProcessBlock(interleaved_stereo_samples,
                                                 scratch_buffers,
                                                 processor.audio_processing_context);
                 if (r == EffectProcessResult::ProcessingTail) fx_need_another_frame_of_processing = true;
+                stage_timer.Lap(processor.stage_timings.effects_seconds);
             }
         }
         processor.fx_need_another_frame_of_processing = fx_need_another_frame_of_processing;
@@ -1411,8 +1511,9 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
         // Master
         // ==================================================================================================
 
+        auto const master_vol = processor.smoothed_value_system.Ramp(processor.master_vol_smoother_id);
         for (auto [frame_index, frame] : Enumerate<u32>(interleaved_stereo_samples)) {
-            frame *= processor.smoothed_value_system.Value(processor.master_vol_smoother_id, frame_index);
+            frame *= master_vol.At(frame_index);
 
             // frame = Clamp(frame, {-1, -1}, {1, 1}); // hard limit
             frame *= processor.whole_engine_volume_fade.GetFade();
@@ -1427,8 +1528,12 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
 
     //
     // ======================================================================================================
-    if (outputs)
-        CopyInterleavedToSeparateChannels(outputs[0], outputs[1], interleaved_outputs, num_sample_frames);
+    if (auto const outputs = process.audio_outputs->data32) {
+        CopyInterleavedToSeparateChannels(outputs[0] + sub_block.frame_offset,
+                                          outputs[1] + sub_block.frame_offset,
+                                          interleaved_outputs,
+                                          num_sample_frames);
+    }
 
     // Mark gui dirty
     {
@@ -1440,6 +1545,68 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
     return result;
 }
 
+clap_process_status Process(AudioProcessor& processor, clap_process const& process) {
+    ZoneScoped;
+    ASSERT_EQ(process.audio_outputs_count, 1u);
+
+    if (process.audio_outputs->channel_count != 2) return CLAP_PROCESS_ERROR;
+
+    // We split the block at the time of each of the host's events so that automation, note-offs and tempo
+    // changes land on the right frame rather than at the start of the block. Events closer together than
+    // this are applied at the same frame so that a dense stream of automation doesn't leave us processing
+    // tiny sub-blocks.
+    constexpr u32 k_min_sub_block_frames = 32;
+
+    clap_process_status result = CLAP_PROCESS_SLEEP;
+    ProcessorListener::ChangeFlags change_flags = {};
+
+    DEFER {
+        if (processor.previous_process_status != result) change_flags |= ProcessorListener::StatusChanged;
+        processor.previous_process_status = result;
+        processor.notes_currently_held.AssignBlockwise(
+            processor.audio_processing_context.midi_note_state.NotesCurrentlyHeldAllChannels());
+        if (processor.measure_stage_timings)
+            processor.stage_timings.num_active_voices =
+                processor.voice_pool.num_active_voices.Load(LoadMemoryOrder::Relaxed);
+        if (change_flags) processor.listener.OnProcessorChange(change_flags);
+    };
+
+    if (processor.measure_stage_timings) processor.stage_timings = {};
+
+    // Our own events are all applied in the first sub-block.
+    auto const internal_events = processor.events_for_audio_thread.PopAll();
+
+    auto const& in_events = *process.in_events;
+    auto const num_events = in_events.size(&in_events);
+    u32 event_index = 0;
+    u32 frame = 0;
+    do {
+        SubBlock sub_block {
+            .frame_offset = frame,
+            .num_frames = process.frames_count - frame,
+            .first_event = event_index,
+            .end_event = num_events,
+        };
+        for (; event_index != num_events; ++event_index) {
+            auto const time = in_events.get(&in_events, event_index)->time;
+            if (time >= frame + k_min_sub_block_frames && time < process.frames_count) {
+                sub_block.num_frames = time - frame;
+                sub_block.end_event = event_index;
+                break;
+            }
+        }
+
+        Span<EventForAudioThread const> sub_block_internal_events {};
+        if (frame == 0) sub_block_internal_events = internal_events.Items();
+        auto const sub_block_result =
+            ProcessSubBlock(processor, process, sub_block, sub_block_internal_events, change_flags);
+        if (sub_block_result == CLAP_PROCESS_CONTINUE) result = CLAP_PROCESS_CONTINUE;
+        frame += sub_block.num_frames;
+    } while (frame < process.frames_count);
+
+    return result;
+}
+
 static void Reset(AudioProcessor&) {
     // TODO(1.0):
     // - Clears all buffers, performs a full reset of the processing state (filters, oscillators,
@@ -1476,8 +1643,12 @@ static void OnThreadPoolExec(AudioProcessor& processor, u32 index) {
 
 AudioProcessor::AudioProcessor(clap_host const& host,
                                ProcessorListener& listener,
-                               prefs::PreferencesTable const& prefs)
+                               prefs::PreferencesTable const& prefs,
+                               ThreadPool& thread_pool,
+                               ConvolverIrCache& convolver_ir_cache)
     : host(host)
+    , thread_pool(thread_pool)
+    , convolver_ir_cache(convolver_ir_cache)
     , audio_processing_context {.host = host}
     , listener(listener)
     , distortion(smoothed_value_system)
@@ -1516,6 +1687,12 @@ AudioProcessor::AudioProcessor(clap_host const& host,
     ProcessorOnParamChange(*this, {params.data, changed});
     smoothed_value_system.ResetAll();
 
+    num_voice_worker_threads =
+        (u32)prefs::GetInt(prefs, SettingDescriptor(ProcessorSetting::VoiceWorkerThreads));
+    realtime_interpolation_quality =
+        (InterpolationQuality)prefs::GetInt(prefs, SettingDescriptor(ProcessorSetting::InterpolationQuality));
+    UpdateInterpolationQuality(*this);
+
     if (prefs::GetBool(prefs, SettingDescriptor(ProcessorSetting::DefaultCcParamMappings)))
         for (auto const mapping : k_default_cc_to_param_mapping)
             param_learned_ccs[ToInt(mapping.param)].Set(mapping.cc);
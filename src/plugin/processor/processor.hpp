@@ -188,10 +188,14 @@ struct ProcessorListener {
 struct AudioProcessor {
     AudioProcessor(clap_host const& host,
                    ProcessorListener& listener,
-                   prefs::PreferencesTable const& preferences);
+                   prefs::PreferencesTable const& preferences,
+                   ThreadPool& thread_pool,
+                   ConvolverIrCache& convolver_ir_cache);
     ~AudioProcessor();
 
     clap_host const& host;
+    ThreadPool& thread_pool;
+    ConvolverIrCache& convolver_ir_cache;
 
     FloeSmoothedValueSystem smoothed_value_system;
     ArenaAllocator audio_data_allocator {PageAllocator::Instance()};
@@ -266,17 +270,38 @@ struct AudioProcessor {
 
     bool activated = false;
 
+    // [main-thread & !activated] Only benchmarking tools set this.
+    bool measure_stage_timings = false;
+    // [audio-thread] Valid after process() if measure_stage_timings is set.
+    ProcessStageTimings stage_timings {};
+
+    // [main-thread] Applied when the processor is next activated.
+    u32 num_voice_worker_threads {};
+
+    // [main-thread] Offline renders always use the highest quality.
+    InterpolationQuality realtime_interpolation_quality = InterpolationQuality::Cubic;
+    bool rendering_offline = false;
+
     PluginCallbacks<AudioProcessor> processor_callbacks;
 };
 
 enum class ProcessorSetting {
     DefaultCcParamMappings,
+    VoiceWorkerThreads,
+    InterpolationQuality,
 };
 
 prefs::Descriptor SettingDescriptor(ProcessorSetting);
 
+// [main-thread]
+void OnPreferenceChanged(AudioProcessor& processor, prefs::Key const& key, prefs::Value const* value);
+
+// [main-thread] The host tells us when it's bouncing rather than playing live.
+void SetRenderingOffline(AudioProcessor& processor, bool offline);
+
 void SetInstrument(AudioProcessor& processor, u32 layer_index, Instrument const& instrument);
-void SetConvolutionIrAudioData(AudioProcessor& processor, AudioData const* audio_data);
+// [main-thread] The convolver is built asynchronously. Pass an empty ir to remove the convolution.
+void SetConvolutionIr(AudioProcessor& processor, sample_lib_server::RefCounted<sample_lib::LoadedIr> ir);
 
 // doesn't set instruments or convolution because they require loaded audio data which is often available at a
 // later time
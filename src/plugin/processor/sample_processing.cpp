@@ -0,0 +1,195 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "sample_processing.hpp"
+
+#include "tests/framework.hpp"
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+TEST_CASE(TestCubicInterpolationKernel) {
+    // The interpolation that we used before the kernels were generalised. The cubic kernel should give the
+    // same results.
+    auto const old_mono_cubic = [](f32 fm1, f32 f0, f32 f1, f32 f2, f32 x) {
+        return f0 + (((f2 - fm1 - 3 * f1 + 3 * f0) * x + 3 * (f1 + fm1 - 2 * f0)) * x -
+                     (f2 + 2 * fm1 - 6 * f1 + 3 * f0)) *
+                        x / 6.0f;
+    };
+    auto const old_stereo_lagrange = [](f32 fm1, f32 f0, f32 f1, f32 f2, f32 x) {
+        auto const xf = x + 1;
+        auto const xfm1 = x;
+        auto const xfm2 = xf - 2;
+        auto const xfm3 = xf - 3;
+        f32 const t0 = (xfm1 / -1) * (xfm2 / -2) * (xfm3 / -3);
+        f32 const t1 = (xf / 1) * (xfm2 / -1) * (xfm3 / -2);
+        f32 const t2 = (xf / 2) * (xfm1 / 1) * (xfm3 / -1);
+        f32 const t3 = (xf / 3) * (xfm1 / 2) * (xfm2 / 1);
+        return fm1 * t0 + f0 * t1 + f1 * t2 + f2 * t3;
+    };
+
+    using Kernel = InterpolationKernel<InterpolationQuality::Cubic>;
+    static_assert(Kernel::k_num_taps == 4 && Kernel::k_num_taps_behind == 1);
+
+    u64 seed = 0x9abc;
+    for (auto _ : Range(1000)) {
+        Array<f32, 4> frames;
+        for (auto& f : frames)
+            f = RandomFloatInRange<f32>(seed, -1, 1);
+        auto const x = RandomFloatInRange<f32>(seed, 0, 1);
+
+        Array<f32, Kernel::k_num_taps> weights;
+        Kernel::Weights(x, weights);
+        f32 result = 0;
+        for (auto const tap : Range(Kernel::k_num_taps))
+            result += frames[tap] * weights[tap];
+
+        CHECK_APPROX_EQ(result, old_mono_cubic(frames[0], frames[1], frames[2], frames[3], x), 0.00001f);
+        CHECK_APPROX_EQ(result, old_stereo_lagrange(frames[0], frames[1], frames[2], frames[3], x), 0.00001f);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestSincInterpolationKernel) {
+    using namespace sinc_interpolation;
+    using Kernel = InterpolationKernel<InterpolationQuality::Sinc>;
+
+    SUBCASE("every phase sums to 1") {
+        for (auto const phase : Range(k_num_phases + 1)) {
+            CAPTURE(phase);
+            f32 sum = 0;
+            for (auto const w : k_table[phase])
+                sum += w;
+            CHECK_APPROX_EQ(sum, 1.0f, 0.00001f);
+        }
+    }
+
+    SUBCASE("weights between phases sum to 1") {
+        u64 seed = 0xdef0;
+        for (auto _ : Range(1000)) {
+            Array<f32, Kernel::k_num_taps> weights;
+            Kernel::Weights(RandomFloatInRange<f32>(seed, 0, 1), weights);
+            f32 sum = 0;
+            for (auto const w : weights)
+                sum += w;
+            CHECK_APPROX_EQ(sum, 1.0f, 0.00001f);
+        }
+    }
+
+    SUBCASE("whole frames are passed through unchanged") {
+        Array<f32, Kernel::k_num_taps> weights;
+        Kernel::Weights(0, weights);
+        for (auto const tap : Range(Kernel::k_num_taps))
+            CHECK_APPROX_EQ(weights[tap], tap == k_num_taps_behind ? 1.0f : 0.0f, 0.00001f);
+        Kernel::Weights(1, weights);
+        for (auto const tap : Range(Kernel::k_num_taps))
+            CHECK_APPROX_EQ(weights[tap], tap == k_num_taps_behind + 1 ? 1.0f : 0.0f, 0.00001f);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestLoopedTapFrame) {
+    using namespace loop_and_reverse_flags;
+    constexpr s64 k_frames_in_sample = 1000;
+
+    SUBCASE("no loop clamps to the sample") {
+        CHECK_EQ(LoopedTapFrame<true>(-2, 0, nullptr, 0, k_frames_in_sample), 0);
+        CHECK_EQ(LoopedTapFrame<true>(1001, 999, nullptr, 0, k_frames_in_sample), 999);
+        CHECK_EQ(LoopedTapFrame<false>(1002, 999, nullptr, CurrentlyReversed, k_frames_in_sample), 999);
+        CHECK_EQ(LoopedTapFrame<false>(-1, 1, nullptr, CurrentlyReversed, k_frames_in_sample), 0);
+    }
+
+    SUBCASE("standard loop wraps") {
+        BoundsCheckedLoop const loop {
+            .start = 100,
+            .end = 200,
+            .crossfade = 0,
+            .mode = sample_lib::LoopMode::Standard,
+        };
+        auto const forward = [&](s64 frame, s64 frame_index, u32 flags) {
+            return LoopedTapFrame<true>(frame, frame_index, &loop, flags, k_frames_in_sample);
+        };
+        auto const backward = [&](s64 frame, s64 frame_index, u32 flags) {
+            return LoopedTapFrame<false>(frame,
+                                         frame_index,
+                                         &loop,
+                                         flags | CurrentlyReversed,
+                                         k_frames_in_sample);
+        };
+
+        // Taps past the end continue from the start.
+        CHECK_EQ(forward(199, 198, InFirstLoop), 199);
+        CHECK_EQ(forward(200, 198, InFirstLoop), 100);
+        CHECK_EQ(forward(202, 198, InFirstLoop), 102);
+        // Frames behind the start are only from the loop end once we've wrapped.
+        CHECK_EQ(forward(98, 101, InFirstLoop), 98);
+        CHECK_EQ(forward(98, 101, LoopedManyTimes), 198);
+
+        // Reversed, taps before the start continue from the end.
+        CHECK_EQ(backward(100, 101, InFirstLoop), 100);
+        CHECK_EQ(backward(99, 101, InFirstLoop), 199);
+        CHECK_EQ(backward(97, 101, InFirstLoop), 197);
+        CHECK_EQ(backward(201, 198, InFirstLoop), 201);
+        CHECK_EQ(backward(201, 198, LoopedManyTimes), 101);
+
+        // Outside of the looping region nothing wraps.
+        CHECK_EQ(forward(200, 198, 0), 200);
+
+        // With a crossfade, the crossfade handles the boundary instead.
+        auto crossfade_loop = loop;
+        crossfade_loop.crossfade = 10;
+        CHECK_EQ(LoopedTapFrame<true>(201, 198, &crossfade_loop, InFirstLoop, k_frames_in_sample), 201);
+    }
+
+    SUBCASE("ping-pong loop mirrors") {
+        BoundsCheckedLoop const loop {
+            .start = 100,
+            .end = 200,
+            .crossfade = 0,
+            .mode = sample_lib::LoopMode::PingPong,
+        };
+        auto const forward = [&](s64 frame, s64 frame_index, u32 flags) {
+            return LoopedTapFrame<true>(frame, frame_index, &loop, flags, k_frames_in_sample);
+        };
+        auto const backward = [&](s64 frame, s64 frame_index, u32 flags) {
+            return LoopedTapFrame<false>(frame,
+                                         frame_index,
+                                         &loop,
+                                         flags | CurrentlyReversed,
+                                         k_frames_in_sample);
+        };
+
+        // Taps past the end come back on themselves.
+        CHECK_EQ(forward(199, 198, InFirstLoop), 199);
+        CHECK_EQ(forward(200, 198, InFirstLoop), 199);
+        CHECK_EQ(forward(202, 198, InFirstLoop), 197);
+        // Frames behind the start are held at the start once we've bounced off it.
+        CHECK_EQ(forward(98, 101, InFirstLoop), 98);
+        CHECK_EQ(forward(98, 101, LoopedManyTimes), 100);
+
+        // Reversed, taps before the start come back on themselves.
+        CHECK_EQ(backward(100, 101, LoopedManyTimes), 100);
+        CHECK_EQ(backward(99, 101, LoopedManyTimes), 100);
+        CHECK_EQ(backward(97, 101, LoopedManyTimes), 102);
+        // Frames behind the end are held at the end once we've bounced off it.
+        CHECK_EQ(backward(201, 198, InFirstLoop), 201);
+        CHECK_EQ(backward(201, 198, LoopedManyTimes), 199);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterSampleProcessingTests) {
+    REGISTER_TEST(TestCubicInterpolationKernel);
+    REGISTER_TEST(TestLoopedTapFrame);
+    REGISTER_TEST(TestSincInterpolationKernel);
+}
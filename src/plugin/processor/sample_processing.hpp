@@ -10,48 +10,115 @@
 
 #include "processing_utils/filters.hpp"
 
-inline void
-DoMonoCubicInterp(f32 const* f0, f32 const* f1, f32 const* f2, f32 const* fm1, f32 const x, f32& out) {
-    out = f0[0] + (((f2[0] - fm1[0] - 3 * f1[0] + 3 * f0[0]) * x + 3 * (f1[0] + fm1[0] - 2 * f0[0])) * x -
-                   (f2[0] + 2 * fm1[0] - 6 * f1[0] + 3 * f0[0])) *
-                      x / 6.0f;
-}
+enum class InterpolationQuality : u8 {
+    Linear,
+    Cubic,
+    Sinc,
+    Count,
+};
+
+// Each kernel reads k_num_taps frames starting k_num_taps_behind frames behind the playhead (in the direction
+// of playback) and weights them by the fractional position x, which is in the range 0 to 1.
+template <InterpolationQuality k_quality>
+struct InterpolationKernel;
+
+template <>
+struct InterpolationKernel<InterpolationQuality::Linear> {
+    static constexpr u32 k_num_taps = 2;
+    static constexpr u32 k_num_taps_behind = 0;
 
-inline void DoStereoLagrangeInterp(f32 const* f0,
-                                   f32 const* f1,
-                                   f32 const* f2,
-                                   f32 const* fm1,
-                                   f32 const x,
-                                   f32& l,
-                                   f32& r) {
-    auto xf =
-        x + 1; // x is given in the range 0 to 1 but we want the value between f0 and f1, therefore add 1
-    auto xfm1 = x;
-    auto xfm2 = xf - 2;
-    auto xfm3 = xf - 3;
-
-    // IMPROVE: use shuffle instructions instead of manually setting up the vectors
-
-    f32x4 const v0 {xfm1, xf, xf, xf};
-    f32x4 const v1 {-1, 1, 2, 3};
-    f32x4 const v2 {xfm2, xfm2, xfm1, xfm1};
-    f32x4 const v3 {-2, -1, 1, 2};
-    f32x4 const v4 {xfm3, xfm3, xfm3, xfm2};
-    f32x4 const v5 {-3, -2, -1, 1};
-
-    f32x4 const vd0 = v0 / v1;
-    f32x4 const vd1 = v2 / v3;
-    f32x4 const vd2 = v4 / v5;
-
-    auto vt = (vd0 * vd1) * vd2;
-
-    alignas(16) f32 t[4];
-    StoreToAligned(t, vt);
-
-    l = fm1[0] * t[0] + f0[0] * t[1] + f1[0] * t[2] + f2[0] * t[3];
-    r = fm1[1] * t[0] + f0[1] * t[1] + f1[1] * t[2] + f2[1] * t[3];
+    ALWAYS_INLINE static void Weights(f32 x, Array<f32, k_num_taps>& w) {
+        w[0] = 1 - x;
+        w[1] = x;
+    }
+};
+
+// 4-point, 3rd-order Lagrange.
+template <>
+struct InterpolationKernel<InterpolationQuality::Cubic> {
+    static constexpr u32 k_num_taps = 4;
+    static constexpr u32 k_num_taps_behind = 1;
+
+    ALWAYS_INLINE static void Weights(f32 x, Array<f32, k_num_taps>& w) {
+        auto const xp1 = x + 1;
+        auto const xm1 = x - 1;
+        auto const xm2 = x - 2;
+        auto const a = xp1 * x;
+        auto const b = xm1 * xm2;
+        w[0] = x * b * (-1.0f / 6);
+        w[1] = xp1 * b * (1.0f / 2);
+        w[2] = a * xm2 * (-1.0f / 2);
+        w[3] = a * xm1 * (1.0f / 6);
+    }
+};
+
+namespace sinc_interpolation {
+
+constexpr u32 k_num_taps = 8;
+constexpr u32 k_num_taps_behind = 3;
+constexpr u32 k_num_phases = 256;
+
+constexpr f64 Sinc(f64 t) {
+    if (t == 0) return 1;
+    auto const pi_t = k_pi<f64> * t;
+    // Taylor series, after wrapping into [-pi, pi] where it converges quickly.
+    auto x = pi_t;
+    while (x > k_pi<f64>)
+        x -= k_tau<f64>;
+    while (x < -k_pi<f64>)
+        x += k_tau<f64>;
+    f64 term = x;
+    f64 sin = x;
+    for (int n = 1; n < 14; ++n) {
+        term *= -x * x / (f64)((2 * n) * (2 * n + 1));
+        sin += term;
+    }
+    return sin / pi_t;
 }
 
+using Table = Array<Array<f32, k_num_taps>, k_num_phases + 1>;
+
+// Lanczos-windowed sinc weights for evenly spaced fractional positions from 0 to 1 inclusive.
+constexpr Table k_table = []() {
+    constexpr f64 k_half_width = k_num_taps / 2;
+    Table table {};
+    for (u32 phase = 0; phase <= k_num_phases; ++phase) {
+        auto const x = (f64)phase / k_num_phases;
+        f64 weights[k_num_taps] {};
+        f64 sum = 0;
+        for (u32 tap = 0; tap < k_num_taps; ++tap) {
+            auto const t = x - ((f64)tap - k_num_taps_behind);
+            if (t > -k_half_width && t < k_half_width) weights[tap] = Sinc(t) * Sinc(t / k_half_width);
+            sum += weights[tap];
+        }
+        // Normalised so that DC passes at unity gain at every phase.
+        for (u32 tap = 0; tap < k_num_taps; ++tap)
+            table[phase][tap] = (f32)(weights[tap] / sum);
+    }
+    return table;
+}();
+
+} // namespace sinc_interpolation
+
+// 8-point Lanczos-windowed sinc. The weights are looked up from a table of phases rather than evaluating sin
+// per sample.
+template <>
+struct InterpolationKernel<InterpolationQuality::Sinc> {
+    static constexpr u32 k_num_taps = sinc_interpolation::k_num_taps;
+    static constexpr u32 k_num_taps_behind = sinc_interpolation::k_num_taps_behind;
+
+    ALWAYS_INLINE static void Weights(f32 x, Array<f32, k_num_taps>& w) {
+        using namespace sinc_interpolation;
+        auto const table_pos = x * k_num_phases;
+        auto const phase = Min((u32)table_pos, k_num_phases - 1);
+        auto const t = table_pos - (f32)phase;
+        auto const& w0 = k_table[phase];
+        auto const& w1 = k_table[phase + 1];
+        for (u32 tap = 0; tap < k_num_taps; ++tap)
+            w[tap] = w0[tap] + (w1[tap] - w0[tap]) * t;
+    }
+};
+
 struct BoundsCheckedLoop {
     u32 start {};
     u32 end {};
@@ -143,11 +210,13 @@ enum Bits : u32 {
 
 } // namespace loop_and_reverse_flags
 
-inline bool IncrementSamplePlaybackPos(Optional<BoundsCheckedLoop> const& loop,
-                                       u32& playback_mode,
-                                       f64& frame_pos,
-                                       f64 pitch_ratio,
-                                       f64 num_frames) {
+// k_has_loop lets the compiler remove the loop handling for samples that don't loop.
+template <bool k_has_loop = true>
+ALWAYS_INLINE inline bool IncrementSamplePlaybackPos(Optional<BoundsCheckedLoop> const& loop,
+                                                     u32& playback_mode,
+                                                     f64& frame_pos,
+                                                     f64 pitch_ratio,
+                                                     f64 num_frames) {
     using namespace loop_and_reverse_flags;
 
     bool const going_forward = !(playback_mode & CurrentlyReversed);
@@ -157,7 +226,7 @@ inline bool IncrementSamplePlaybackPos(Optional<BoundsCheckedLoop> const& loop,
     else
         frame_pos -= pitch_ratio;
 
-    if (loop) {
+    if (k_has_loop && loop) {
         auto const end = (f64)loop->end;
         auto const start = (f64)loop->start;
 
@@ -206,21 +275,96 @@ inline bool IncrementSamplePlaybackPos(Optional<BoundsCheckedLoop> const& loop,
     return true;
 }
 
-inline void SampleGetData(AudioData const& s,
-                          Optional<BoundsCheckedLoop> const opt_loop,
-                          u32 loop_and_reverse_flags,
-                          f64 frame_pos,
-                          f32& l,
-                          f32& r,
-                          bool recurse = false) {
-    using namespace loop_and_reverse_flags;
-    auto const loop = opt_loop.NullableValue();
+// Frames of a disk-streamed AudioData that are beyond its resident frames. They're stored in a ring buffer
+// indexed by frame modulo capacity. Only frames in [start, end) are valid. Frames around the loop points can
+// also be in pinned segments.
+struct StreamedFrames {
+    struct Pinned {
+        f32 const* frames {}; // the start frame is at index 0
+        u32 start {};
+        u32 end {};
+    };
 
-    auto const frames_in_sample = s.num_frames;
-    ASSERT(s.num_frames != 0);
+    // Returns null if the frame isn't available.
+    template <u32 k_channels>
+    f32 const* Frame(s64 frame) const {
+        if (frame >= start && frame < end) return ring + (frame % capacity) * k_channels;
+        for (auto const& p : pinned)
+            if (frame >= p.start && frame < p.end) return p.frames + (frame - p.start) * k_channels;
+        return nullptr;
+    }
+
+    f32 const* ring {};
+    u32 capacity {};
+    u32 start {};
+    u32 end {};
+    Array<Pinned, 2> pinned {};
+};
+
+// Maps the frame that a kernel tap wants to read onto the frame that should actually be read, following the
+// loop. Taps behind the playhead (in the direction of playback) are clamped; taps ahead of it follow the loop
+// so that we interpolate across the loop boundary.
+template <bool k_forward>
+ALWAYS_INLINE inline s64 LoopedTapFrame(s64 frame,
+                                        s64 frame_index,
+                                        BoundsCheckedLoop const* loop,
+                                        u32 loop_and_reverse_flags,
+                                        s64 frames_in_sample) {
+    using namespace loop_and_reverse_flags;
     auto const last_frame = frames_in_sample - 1;
+    s64 const start = loop ? loop->start : 0;
+    s64 const end = loop ? loop->end : 0;
+
+    if (loop && loop->mode == sample_lib::LoopMode::PingPong && (loop_and_reverse_flags & InLoopingRegion)) {
+        if constexpr (k_forward) {
+            if (frame < frame_index) {
+                if (loop_and_reverse_flags & LoopedManyTimes && frame < start) frame = start;
+            } else if (frame >= end) {
+                frame = (end - 1) - (frame - end);
+            }
+        } else {
+            if (frame > frame_index) {
+                if (loop_and_reverse_flags & LoopedManyTimes && frame >= end) frame = end - 1;
+            } else if (frame < start) {
+                frame = start + ((start - frame) - 1);
+            }
+        }
+    } else if (loop && loop->mode == sample_lib::LoopMode::Standard &&
+               (loop_and_reverse_flags & InLoopingRegion) && loop->crossfade == 0) {
+        // Once we've wrapped, the frames behind the playhead are from the other end of the loop too.
+        auto const wrapped = (loop_and_reverse_flags & LoopedManyTimes) != 0;
+        if constexpr (k_forward) {
+            if (frame >= end)
+                frame = start + (frame - end);
+            else if (frame < start && wrapped)
+                frame = end - (start - frame);
+        } else {
+            if (frame < start)
+                frame = end - (start - frame);
+            else if (frame >= end && wrapped)
+                frame = start + (frame - end);
+        }
+    }
 
-    auto const forward = !(loop_and_reverse_flags & CurrentlyReversed);
+    // Wide kernels can still reach past either end of a short sample or loop.
+    return Clamp<s64>(frame, 0, last_frame);
+}
+
+// Interpolates the frame at frame_pos, ignoring any loop crossfade. Returns false if any of the frames needed
+// are not available.
+template <bool k_forward, u32 k_channels, InterpolationQuality k_quality>
+ALWAYS_INLINE inline bool SampleGetInterpolatedFrameInDirection(AudioData const& s,
+                                                                StreamedFrames const& streamed_frames,
+                                                                BoundsCheckedLoop const* loop,
+                                                                u32 loop_and_reverse_flags,
+                                                                f64 frame_pos,
+                                                                Array<f32, 2>& outs) {
+    using Kernel = InterpolationKernel<k_quality>;
+    static_assert(k_channels == 1 || k_channels == 2);
+    ASSERT_HOT(s.channels == k_channels);
+
+    auto const frames_in_sample = (s64)s.num_frames;
+    ASSERT(s.num_frames != 0);
 
     if (loop) {
         ASSERT(loop->end <= frames_in_sample);
@@ -229,86 +373,145 @@ inline void SampleGetData(AudioData const& s,
     }
     ASSERT(frame_pos < frames_in_sample);
 
-    auto const frame_index = (int)frame_pos;
+    auto const frame_index = (s64)frame_pos;
     auto x = (f32)frame_pos - (f32)frame_index;
+    if constexpr (!k_forward) x = 1 - x;
+    ASSERT(frame_index >= 0 && frame_index < frames_in_sample);
 
-    s64 xm1;
-    s64 x0;
-    s64 x1;
-    s64 x2;
-
-    if (forward) {
-        xm1 = frame_index - 1;
-        x0 = frame_index;
-        x1 = frame_index + 1;
-        x2 = frame_index + 2;
-
-        if (loop && loop->mode == sample_lib::LoopMode::PingPong &&
-            (loop_and_reverse_flags & InLoopingRegion)) {
-            if (loop_and_reverse_flags & LoopedManyTimes && xm1 < loop->start)
-                xm1 = loop->start;
-            else if (xm1 < 0)
-                xm1 = 0;
-            if (x1 >= loop->end) x1 = loop->end - 1;
-            if (x2 >= loop->end) x2 = (loop->end - 1) - (x2 - loop->end);
-        } else if (loop && loop->mode == sample_lib::LoopMode::Standard &&
-                   (loop_and_reverse_flags & InLoopingRegion) && loop->crossfade == 0) {
-            if (xm1 < 0) xm1 = loop->end + xm1;
-            if (x1 >= loop->end) x1 = loop->start + (x1 - loop->end);
-            if (x2 >= loop->end) x2 = loop->start + (x2 - loop->end);
+    Array<f32, Kernel::k_num_taps> weights;
+    Kernel::Weights(x, weights);
+
+    Array<s64, Kernel::k_num_taps> tap_frames;
+    s64 max_tap_frame = 0;
+    {
+        using namespace loop_and_reverse_flags;
+        constexpr auto k_taps_behind = (s64)Kernel::k_num_taps_behind;
+        constexpr auto k_taps_ahead = (s64)Kernel::k_num_taps - 1 - k_taps_behind;
+        auto const lowest_tap_frame = frame_index - (k_forward ? k_taps_behind : k_taps_ahead);
+        auto const highest_tap_frame = frame_index + (k_forward ? k_taps_ahead : k_taps_behind);
+
+        // Taps only need mapping onto other frames when the kernel straddles the edge of the loop or sample.
+        auto const in_loop = loop && (loop_and_reverse_flags & InLoopingRegion);
+        s64 const region_start = in_loop ? loop->start : 0;
+        s64 const region_end = in_loop ? loop->end : frames_in_sample;
+        if (lowest_tap_frame >= region_start && highest_tap_frame < region_end) {
+            for (u32 tap = 0; tap < Kernel::k_num_taps; ++tap) {
+                auto const offset = (s64)tap - k_taps_behind;
+                tap_frames[tap] = k_forward ? frame_index + offset : frame_index - offset;
+            }
+            max_tap_frame = highest_tap_frame;
         } else {
-            if (xm1 < 0) xm1 = 0;
-            if (x1 >= frames_in_sample) x1 = last_frame;
-            if (x2 >= frames_in_sample) x2 = last_frame;
+            for (u32 tap = 0; tap < Kernel::k_num_taps; ++tap) {
+                auto const offset = (s64)tap - k_taps_behind;
+                tap_frames[tap] =
+                    LoopedTapFrame<k_forward>(k_forward ? frame_index + offset : frame_index - offset,
+                                              frame_index,
+                                              loop,
+                                              loop_and_reverse_flags,
+                                              frames_in_sample);
+                max_tap_frame = Max(max_tap_frame, tap_frames[tap]);
+            }
         }
+    }
+
+    Array<f32 const*, Kernel::k_num_taps> frames;
+    Array<Array<f32, 2>, Kernel::k_num_taps> converted; // integer frames are converted to f32 into here
+    if (s.sample_format == AudioSampleFormat::Float32 &&
+        (usize)(max_tap_frame + 1) * k_channels <= s.interleaved_samples.size / sizeof(f32)) {
+        // The common case: every tap is in memory and already f32, so there's nothing to decide per tap.
+        auto const samples = (f32 const*)s.interleaved_samples.data;
+        for (u32 tap = 0; tap < Kernel::k_num_taps; ++tap)
+            frames[tap] = samples + tap_frames[tap] * k_channels;
     } else {
-        x = 1 - x;
-        xm1 = frame_index + 1;
-        x0 = frame_index;
-        x1 = frame_index - 1;
-        x2 = frame_index - 2;
-
-        if (loop && loop->mode == sample_lib::LoopMode::PingPong &&
-            (loop_and_reverse_flags & InLoopingRegion)) {
-            if (loop_and_reverse_flags & LoopedManyTimes) {
-                if (xm1 >= loop->end) xm1 = loop->end - 1;
+        auto const num_resident_frames = (s64)s.NumResidentFrames();
+        for (u32 tap = 0; tap < Kernel::k_num_taps; ++tap) {
+            auto const frame = tap_frames[tap];
+            if (frame < num_resident_frames) {
+                if (s.sample_format == AudioSampleFormat::Float32) {
+                    frames[tap] = (f32 const*)s.interleaved_samples.data + frame * k_channels;
+                } else {
+                    FrameAsF32(s, (usize)frame, converted[tap].data);
+                    frames[tap] = converted[tap].data;
+                }
+            } else if (auto const streamed = streamed_frames.Frame<k_channels>(frame)) {
+                // Streamed frames are always f32.
+                frames[tap] = streamed;
+            } else {
+                outs = {};
+                return false;
             }
-            if (x1 < loop->start) x1 = loop->start;
-            if (x2 < loop->start) x2 = loop->start + ((loop->start - x2) - 1);
-        } else if (loop && loop->mode == sample_lib::LoopMode::Standard &&
-                   (loop_and_reverse_flags & InLoopingRegion) && loop->crossfade == 0) {
-            if (xm1 >= loop->end) xm1 = loop->start;
-            if (x1 < 0) x1 = loop->end + x1;
-            if (x2 < 0) x2 = loop->end + x2;
-        } else {
-            if (xm1 >= frames_in_sample) xm1 = last_frame;
-            if (x1 < 0) x1 = 0;
-            if (x2 < 0) x2 = 0;
         }
     }
 
-    ASSERT(x0 >= 0 && x0 < frames_in_sample);
-
-    f32 const* sample_data = s.interleaved_samples.data;
-    auto* f0 = sample_data + x0 * s.channels;
-    auto* f1 = sample_data + x1 * s.channels;
-    auto* f2 = sample_data + x2 * s.channels;
-    auto* fm1 = sample_data + xm1 * s.channels;
-    Array<f32, 2> outs = {};
-    if (s.channels == 1) {
-        DoMonoCubicInterp(f0, f1, f2, fm1, x, outs[0]);
-        outs[1] = outs[0];
-    } else if (s.channels == 2) {
-        DoStereoLagrangeInterp(f0, f1, f2, fm1, x, outs[0], outs[1]);
-    } else {
-        PanicIfReached();
+    for (u32 chan = 0; chan < k_channels; ++chan) {
+        f32 out = 0;
+        for (u32 tap = 0; tap < Kernel::k_num_taps; ++tap)
+            out += frames[tap][chan] * weights[tap];
+        outs[chan] = out;
+    }
+    if constexpr (k_channels == 1) outs[1] = outs[0];
+    return true;
+}
+
+template <u32 k_channels, InterpolationQuality k_quality>
+ALWAYS_INLINE inline bool SampleGetInterpolatedFrame(AudioData const& s,
+                                                     StreamedFrames const& streamed_frames,
+                                                     BoundsCheckedLoop const* loop,
+                                                     u32 loop_and_reverse_flags,
+                                                     f64 frame_pos,
+                                                     Array<f32, 2>& outs) {
+    // Ping-pong loops change direction mid-block so this is decided per frame.
+    if (loop_and_reverse_flags & loop_and_reverse_flags::CurrentlyReversed)
+        return SampleGetInterpolatedFrameInDirection<false, k_channels, k_quality>(s,
+                                                                                   streamed_frames,
+                                                                                   loop,
+                                                                                   loop_and_reverse_flags,
+                                                                                   frame_pos,
+                                                                                   outs);
+    return SampleGetInterpolatedFrameInDirection<true, k_channels, k_quality>(s,
+                                                                              streamed_frames,
+                                                                              loop,
+                                                                              loop_and_reverse_flags,
+                                                                              frame_pos,
+                                                                              outs);
+}
+
+// Returns false if any of the frames needed are not available, in which case the output is silent.
+//
+// This is always inlined so that it's compiled for the instruction set of the voice rendering loop that calls
+// it (see TARGET_AVX2_FMA). It's specialised for each channel count, quality and whether there's a loop so
+// that the caller can pick the kernel once per block rather than per frame.
+template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+ALWAYS_INLINE inline bool SampleGetData(AudioData const& s,
+                                        StreamedFrames const& streamed_frames,
+                                        Optional<BoundsCheckedLoop> const& opt_loop,
+                                        u32 loop_and_reverse_flags,
+                                        f64 frame_pos,
+                                        f32& l,
+                                        f32& r) {
+    using namespace loop_and_reverse_flags;
+    BoundsCheckedLoop const* loop = k_has_loop ? opt_loop.NullableValue() : nullptr;
+    auto const forward = !(loop_and_reverse_flags & CurrentlyReversed);
+
+    Array<f32, 2> outs;
+    if (!SampleGetInterpolatedFrame<k_channels, k_quality>(s,
+                                                           streamed_frames,
+                                                           loop,
+                                                           loop_and_reverse_flags,
+                                                           frame_pos,
+                                                           outs)) {
+        l = 0;
+        r = 0;
+        return false;
     }
 
+    // The crossfade reads from the other end of the loop. That read is never itself in a crossfade region
+    // because the crossfade is clamped to the loop size, so we don't need to recurse.
+    bool available = true;
     if (loop && loop->crossfade) {
         f32 crossfade_pos = 0;
         bool is_crossfading = false;
-        f32 xfade_r = 0;
-        f32 xfade_l = 0;
+        Array<f32, 2> xfade {};
         if (loop->mode == sample_lib::LoopMode::Standard) {
             auto const xfade_fade_out_start =
                 loop->end - loop->crossfade; // the bit before the loop end point
@@ -319,13 +522,13 @@ inline void SampleGetData(AudioData const& s,
                 if (forward || (!forward && (loop_and_reverse_flags & LoopedManyTimes))) {
                     auto frames_info_fade = frame_pos - xfade_fade_out_start;
 
-                    SampleGetData(s,
-                                  opt_loop,
-                                  loop_and_reverse_flags & CurrentlyReversed,
-                                  xfade_fade_in_start + frames_info_fade,
-                                  xfade_l,
-                                  xfade_r,
-                                  true);
+                    available = SampleGetInterpolatedFrame<k_channels, k_quality>(
+                        s,
+                        streamed_frames,
+                        loop,
+                        loop_and_reverse_flags & CurrentlyReversed,
+                        xfade_fade_in_start + frames_info_fade,
+                        xfade);
                     crossfade_pos = (f32)frames_info_fade / (f32)loop->crossfade;
                     ASSERT(crossfade_pos >= 0 && crossfade_pos <= 1);
 
@@ -333,13 +536,17 @@ inline void SampleGetData(AudioData const& s,
                 }
             }
         } else if (loop_and_reverse_flags & LoopedManyTimes) { // Ping-pong
-            ASSERT(!recurse);
             ASSERT(loop->mode == sample_lib::LoopMode::PingPong);
 
             if (forward && (frame_pos <= (loop->start + loop->crossfade)) && frame_pos >= loop->start) {
                 auto frames_into_fade = frame_pos - loop->start;
                 auto fade_pos = (f64)loop->start - frames_into_fade;
-                SampleGetData(s, opt_loop, CurrentlyReversed, fade_pos, xfade_l, xfade_r, true);
+                available = SampleGetInterpolatedFrame<k_channels, k_quality>(s,
+                                                                              streamed_frames,
+                                                                              loop,
+                                                                              CurrentlyReversed,
+                                                                              fade_pos,
+                                                                              xfade);
                 crossfade_pos = 1.0f - ((f32)frames_into_fade / (f32)loop->crossfade);
                 ASSERT(crossfade_pos >= 0 && crossfade_pos <= 1);
 
@@ -347,7 +554,12 @@ inline void SampleGetData(AudioData const& s,
             } else if (!forward && frame_pos >= (loop->end - loop->crossfade) && frame_pos < loop->end) {
                 auto frames_into_fade = loop->end - frame_pos;
                 auto fade_pos = loop->end + frames_into_fade;
-                SampleGetData(s, opt_loop, 0, fade_pos, xfade_l, xfade_r, true);
+                available = SampleGetInterpolatedFrame<k_channels, k_quality>(s,
+                                                                              streamed_frames,
+                                                                              loop,
+                                                                              0,
+                                                                              fade_pos,
+                                                                              xfade);
                 crossfade_pos = 1.0f - ((f32)frames_into_fade / (f32)loop->crossfade);
                 ASSERT(crossfade_pos >= 0 && crossfade_pos <= 1);
 
@@ -359,18 +571,14 @@ inline void SampleGetData(AudioData const& s,
             f32x4 t {1 - crossfade_pos, crossfade_pos, 1, 1};
             t = Sqrt(t);
 
-            outs[0] *= t[0];
-            outs[1] *= t[0];
-            xfade_l *= t[1];
-            xfade_r *= t[1];
-
-            outs[0] += xfade_l;
-            outs[1] += xfade_r;
+            outs[0] = (outs[0] * t[0]) + (xfade[0] * t[1]);
+            outs[1] = (outs[1] * t[0]) + (xfade[1] * t[1]);
         }
     }
 
     l = outs[0];
     r = outs[1];
+    return available;
 }
 
 struct IntRange {
@@ -411,6 +619,9 @@ PUBLIC Span<u8> CreateWaveformImage(WaveformAudioSource source,
         filter_cache.Update(44100, 2000, 0.5f);
         auto const num_frames =
             source.Is<AudioData const*>() ? source.Get<AudioData const*>()->num_frames : 0;
+        // Only the resident frames are drawn; the rest of a disk-streamed file is drawn as silence.
+        auto const num_resident_frames =
+            source.Is<AudioData const*>() ? source.Get<AudioData const*>()->NumResidentFrames() : 0;
         auto const samples_per_pixel = (f32)num_frames / ((f32)scaled_width);
         f32 first_sample = 0;
 
@@ -423,7 +634,8 @@ PUBLIC Span<u8> CreateWaveformImage(WaveformAudioSource source,
                 case WaveformAudioSourceType::AudioData: {
                     f32 const end_sample = first_sample + samples_per_pixel;
                     int const first_sample_x = RoundPositiveFloat(first_sample);
-                    int const end_sample_x = Min((int)num_frames - 1, RoundPositiveFloat(end_sample));
+                    int const end_sample_x =
+                        Min((int)num_resident_frames - 1, RoundPositiveFloat(end_sample));
                     first_sample = end_sample;
                     int const window_size = (end_sample_x + 1) - first_sample_x;
 
@@ -433,10 +645,10 @@ PUBLIC Span<u8> CreateWaveformImage(WaveformAudioSource source,
 
                     for (int i = first_sample_x; i <= end_sample_x; i += step) {
                         auto const& audio_data = *source.Get<AudioData const*>();
-                        auto const frame_ptr =
-                            audio_data.interleaved_samples.data + (i * audio_data.channels);
-                        auto const audio = audio_data.channels == 2 ? LoadUnalignedToType<f32x2>(frame_ptr)
-                                                                    : f32x2(frame_ptr[0]);
+                        Array<f32, 2> frame;
+                        FrameAsF32(audio_data, (usize)i, frame.data);
+                        auto const audio =
+                            audio_data.channels == 2 ? f32x2 {frame[0], frame[1]} : f32x2(frame[0]);
                         levels += Abs(audio);
 
                         num_sampled++;
@@ -4,6 +4,7 @@
 #include "voices.hpp"
 
 #include "foundation/foundation.hpp"
+#include "tests/framework.hpp"
 
 #include "common_infrastructure/constants.hpp"
 #include "common_infrastructure/descriptors/param_descriptors.hpp"
@@ -13,46 +14,94 @@
 #include "processor/effect_stereo_widen.hpp"
 
 static constexpr u32 k_num_frames_in_voice_processing_chunk = 64;
+static constexpr u32 k_num_voice_lanes = 4; // matches the width of adsr::ProcessorX4 and LfoX4
+
+VoicePool::VoicePool() {
+    for (auto& v : voices)
+        SinglyLinkedListPrepend(free_voices, &v);
+}
+
+VoiceListIterable<&Voice::next_in_layer>
+VoicePool::EnumerateActiveLayerVoices(VoiceProcessingController const& controller) {
+    return {active_layer_voices[controller.layer_index].first};
+}
+
+// Only touches the voice itself and atomics so that it can be called while voices are being processed on
+// worker threads. The voice stays in the pool's lists until ReturnVoiceToFreeList.
+static void MarkVoiceEnded(Voice& voice) {
+    ASSERT(voice.is_active);
+    voice.pool.num_active_voices.FetchSub(1, RmwMemoryOrder::Relaxed);
+    voice.pool.voices_per_midi_note_for_gui[voice.note_num].FetchSub(1, RmwMemoryOrder::Relaxed);
+    for (auto& s : voice.voice_samples)
+        ReleaseDiskStream(voice.pool.disk_streamer, s.sampler.disk_stream);
+    voice.is_active = false;
+}
+
+static void ReturnVoiceToFreeList(VoicePool& pool, Voice& voice) {
+    ASSERT(!voice.is_active);
+    DoublyLinkedListRemove(pool.active_voices, &voice);
+
+    auto& layer_voices = pool.active_layer_voices[voice.controller->layer_index];
+    if (voice.prev_in_layer)
+        voice.prev_in_layer->next_in_layer = voice.next_in_layer;
+    else
+        layer_voices.first = voice.next_in_layer;
+    if (voice.next_in_layer)
+        voice.next_in_layer->prev_in_layer = voice.prev_in_layer;
+    else
+        layer_voices.last = voice.prev_in_layer;
+
+    SinglyLinkedListPrepend(pool.free_voices, &voice);
+}
+
+static void AddVoiceToActiveLists(VoicePool& pool, Voice& voice) {
+    DoublyLinkedListAppend(pool.active_voices, &voice);
+
+    auto& layer_voices = pool.active_layer_voices[voice.controller->layer_index];
+    voice.prev_in_layer = layer_voices.last;
+    voice.next_in_layer = nullptr;
+    if (layer_voices.last)
+        layer_voices.last->next_in_layer = &voice;
+    else
+        layer_voices.first = &voice;
+    layer_voices.last = &voice;
+}
+
+void EndVoiceInstantly(Voice& voice) {
+    MarkVoiceEnded(voice);
+    ReturnVoiceToFreeList(voice.pool, voice);
+}
 
 static void FadeOutVoicesToEnsureMaxActive(VoicePool& pool, AudioProcessingContext const& context) {
     if (pool.num_active_voices.Load(LoadMemoryOrder::Relaxed) > k_max_num_active_voices) {
-        auto oldest = LargestRepresentableValue<u64>();
-        Voice* oldest_voice = nullptr;
         for (auto& v : pool.EnumerateActiveVoices()) {
-            if (v.age < oldest && !v.volume_fade.IsFadingOut()) {
-                oldest = v.age;
-                oldest_voice = &v;
+            if (!v.volume_fade.IsFadingOut()) {
+                v.volume_fade.SetAsFadeOut(context.sample_rate);
+                break;
             }
         }
-        if (oldest_voice) oldest_voice->volume_fade.SetAsFadeOut(context.sample_rate);
     }
 }
 
 static Voice& FindVoice(VoicePool& pool, AudioProcessingContext const& context) {
     FadeOutVoicesToEnsureMaxActive(pool, context);
 
-    for (auto& v : pool.voices)
-        if (!v.is_active) return v;
-
-    DynamicArrayBounded<u16, k_num_voices> voice_indexes {};
-    for (auto [i, index] : Enumerate<u16>(voice_indexes))
-        index = i;
-    Sort(voice_indexes, [&voices = pool.voices](u16 a, u16 b) { return voices[a].age < voices[b].age; });
-
-    auto quietest_gain = 1.0f;
-    auto quietest_voice_index = (u16)-1;
-    for (auto const i : Range(k_num_voices / 4)) {
-        auto& v = pool.voices[i];
-        if (v.current_gain < quietest_gain) {
-            quietest_gain = v.current_gain;
-            quietest_voice_index = (u16)i;
+    if (!pool.free_voices) {
+        // Every voice is in use, even after fading out voices over the max. We steal the quietest of the
+        // oldest few voices since cutting it off is the least likely to be noticed.
+        constexpr u32 k_num_steal_candidates = 8;
+        Voice* quietest = nullptr;
+        u32 num_candidates = 0;
+        for (auto& v : pool.EnumerateActiveVoices()) {
+            if (!quietest || v.current_gain < quietest->current_gain) quietest = &v;
+            if (++num_candidates == k_num_steal_candidates) break;
         }
+        ASSERT(quietest);
+        EndVoiceInstantly(*quietest);
     }
 
-    auto& result = pool.voices[quietest_voice_index];
-    ASSERT(result.is_active);
-
-    EndVoiceInstantly(result);
+    auto& result = *pool.free_voices;
+    pool.free_voices = result.next;
     return result;
 }
 
@@ -259,6 +308,7 @@ void UpdateLoopInfo(Voice& v) {
                                                                 sampler.data->num_frames,
                                                                 v.controller->loop)
                                                 : k_nullopt;
+        if (sampler.disk_stream) SetDiskStreamLoop(v.pool.disk_streamer, *sampler.disk_stream, sampler.loop);
 
         sampler.loop_and_reverse_flags = 0;
         if (v.controller->reverse) sampler.loop_and_reverse_flags = loop_and_reverse_flags::CurrentlyReversed;
@@ -308,7 +358,6 @@ void StartVoice(VoicePool& pool,
     voice.vol_env.Gate(true);
     voice.fil_env.Reset();
     voice.fil_env.Gate(true);
-    voice.age = voice.pool.voice_age_counter++;
     voice.id = voice.pool.voice_id_counter++;
     voice.midi_key_trigger = params.midi_key_trigger;
     voice.note_num = params.note_num;
@@ -353,6 +402,13 @@ void StartVoice(VoicePool& pool,
                     (f64)(sampler.initial_sample_offset_01 * ((f32)s.sampler.data->num_frames - 1));
                 s.pos = offs;
                 if (voice.controller->reverse) s.pos = (f64)(s.sampler.data->num_frames - Max(offs, 1.0));
+
+                ASSERT(!s.sampler.disk_stream);
+                if (s.sampler.data->IsStreamed())
+                    s.sampler.disk_stream = AcquireDiskStream(pool.disk_streamer,
+                                                              *s.sampler.data,
+                                                              s.pos,
+                                                              voice.controller->reverse);
             }
             for (u32 i = voice.num_active_voice_samples; i < k_max_num_voice_samples; ++i)
                 voice.voice_samples[i].is_active = false;
@@ -382,6 +438,7 @@ void StartVoice(VoicePool& pool,
     }
 
     voice.is_active = true;
+    AddVoiceToActiveLists(pool, voice);
     voice.pool.num_active_voices.FetchAdd(1, RmwMemoryOrder::Relaxed);
     voice.pool.voices_per_midi_note_for_gui[voice.note_num].FetchAdd(1, RmwMemoryOrder::Relaxed);
 }
@@ -413,104 +470,195 @@ void VoicePool::PrepareToPlay(ArenaAllocator& arena, AudioProcessingContext cons
         v.index = index++;
         v.smoothing_system.PrepareToPlay(k_num_frames_in_voice_processing_chunk, context.sample_rate, arena);
     }
+
+    StartDiskStreamingThreadIfNeeded(disk_streamer);
 }
 
 void NoteOff(VoicePool& pool, VoiceProcessingController& controller, MidiChannelNote note) {
-    for (auto& v : pool.voices)
-        if (v.is_active && v.midi_key_trigger == note && &controller == v.controller) EndVoice(v);
+    for (auto& v : pool.EnumerateActiveLayerVoices(controller))
+        if (v.midi_key_trigger == note) EndVoice(v);
 }
 
+// The envelopes and LFOs of a group of voices are advanced together with one voice per SIMD lane, rather than
+// each voice doing its own scalar work. The results are written into a row per voice for the
+// ChunkwiseVoiceProcessor of that voice to read.
+struct VoiceControlLanes {
+    void LoadLane(u32 lane, Voice const& voice) {
+        vol_env.LoadLane(lane, voice.vol_env, voice.controller->vol_env);
+        fil_env.LoadLane(lane, voice.fil_env, voice.controller->fil_env);
+        lfo.LoadLane(lane, voice.lfo);
+        lfo_smoother[lane] = voice.lfo_smoother.prev_output;
+        vol_env_on[lane] = voice.controller->vol_env_on ? ~0 : 0;
+    }
+
+    void StoreLane(u32 lane, Voice& voice) const {
+        vol_env.StoreLane(lane, voice.vol_env);
+        fil_env.StoreLane(lane, voice.fil_env);
+        lfo.StoreLane(lane, voice.lfo);
+        voice.lfo_smoother.prev_output = lfo_smoother[lane];
+    }
+
+    // Fills the rows with the next num_frames[lane] frames of each lane.
+    void Process(Array<u32, k_num_voice_lanes> const& num_frames) {
+        ZoneScoped;
+        s32x4 const lane_frames = {(s32)num_frames[0],
+                                   (s32)num_frames[1],
+                                   (s32)num_frames[2],
+                                   (s32)num_frames[3]};
+        auto const max_frames = Max(num_frames[0], num_frames[1], num_frames[2], num_frames[3]);
+        ASSERT_HOT(max_frames <= k_num_frames_in_voice_processing_chunk);
+
+        auto vol_env_valid = lane_frames;
+        auto fil_env_not_sustaining = lane_frames;
+        for (u32 frame = 0; frame != max_frames; ++frame) {
+            auto const active = s32x4((s32)frame) < lane_frames;
+
+            auto const vol = Select(vol_env_on, vol_env.Process(active), f32x4(1));
+            auto const fil = fil_env.Process(active);
+
+            constexpr f32 k_lfo_lowpass_smoothing = 0.9f;
+            auto const lfo_value = lfo.Tick(active);
+            auto const smoothed = lfo_smoother + k_lfo_lowpass_smoothing * (lfo_value - lfo_smoother);
+            lfo_smoother = Select(active, smoothed, lfo_smoother);
+
+            // The same as the per-voice code did: the envelope is checked after every pair of frames and the
+            // pair that it ended in is discarded.
+            auto const vol_env_ended = active & vol_env_on & (vol_env.state == (s32)adsr::State::Idle) &
+                                       (vol_env_valid == lane_frames);
+            vol_env_valid = Select(vol_env_ended, s32x4((s32)(frame & ~1u)), vol_env_valid);
+
+            // Within a chunk, once an envelope is in its sustain state it stays there.
+            auto const fil_env_reached_sustain = active & (fil_env.state == (s32)adsr::State::Sustain) &
+                                                 (fil_env_not_sustaining == lane_frames);
+            fil_env_not_sustaining =
+                Select(fil_env_reached_sustain, s32x4((s32)frame), fil_env_not_sustaining);
+
+            for (auto const lane : Range(k_num_voice_lanes)) {
+                vol_env_gains[lane][frame] = vol[lane];
+                fil_env_values[lane][frame] = fil[lane];
+                lfo_amounts[lane][frame] = -lfo_smoother[lane];
+            }
+        }
+
+        for (auto const lane : Range(k_num_voice_lanes)) {
+            vol_env_valid_frames[lane] = (u32)vol_env_valid[lane];
+            fil_env_frames_before_sustain[lane] = (u32)fil_env_not_sustaining[lane];
+        }
+    }
+
+    adsr::ProcessorX4 vol_env {};
+    adsr::ProcessorX4 fil_env {};
+    LfoX4 lfo {};
+    f32x4 lfo_smoother {};
+    s32x4 vol_env_on {};
+
+    // Outputs of Process.
+    Array<u32, k_num_voice_lanes> vol_env_valid_frames; // frames before the volume envelope ended
+    Array<u32, k_num_voice_lanes> fil_env_frames_before_sustain;
+    Array<Array<f32, k_num_frames_in_voice_processing_chunk + 1>, k_num_voice_lanes> vol_env_gains;
+    Array<Array<f32, k_num_frames_in_voice_processing_chunk + 1>, k_num_voice_lanes> fil_env_values;
+    Array<Array<f32, k_num_frames_in_voice_processing_chunk + 1>, k_num_voice_lanes> lfo_amounts;
+};
+
 class ChunkwiseVoiceProcessor {
   public:
-    ChunkwiseVoiceProcessor(Voice& voice, AudioProcessingContext const& audio_context)
+    ChunkwiseVoiceProcessor(Voice& voice,
+                            AudioProcessingContext const& audio_context,
+                            VoiceControlLanes const& control,
+                            u32 lane)
         : m_filter_coeffs(voice.filter_coeffs)
         , m_filters(voice.filters)
         , m_audio_context(audio_context)
-        , m_voice(voice) {}
+        , m_voice(voice)
+        , m_control(control)
+        , m_lane(lane)
+        , m_lfo_amounts(control.lfo_amounts[lane]) {}
 
     ~ChunkwiseVoiceProcessor() {
         m_voice.filter_coeffs = m_filter_coeffs;
         m_voice.filters = m_filters;
     }
 
-    bool Process(u32 num_frames) {
-        ZoneNamedN(process, "Voice Process", true);
-        u32 samples_written = 0;
-        Span<f32> write_buffer = m_voice.pool.buffer_pool[m_voice.index];
+    // Zeroes any frames before the voice starts. Returns the number of frames that are left to process.
+    u32 Begin(u32 num_frames) {
+        m_write_buffer = m_voice.pool.buffer_pool[m_voice.index];
 
         if (m_voice.frames_before_starting != 0) {
             auto const num_frames_to_remove = Min(num_frames, m_voice.frames_before_starting);
             auto const num_samples_to_remove = num_frames_to_remove * 2;
-            ZeroMemory(write_buffer.SubSpan(0, num_samples_to_remove).ToByteSpan());
-            write_buffer = write_buffer.SubSpan(num_samples_to_remove);
-            samples_written = num_samples_to_remove;
+            ZeroMemory(m_write_buffer.SubSpan(0, num_samples_to_remove).ToByteSpan());
+            m_write_buffer = m_write_buffer.SubSpan(num_samples_to_remove);
+            m_samples_written = num_samples_to_remove;
             num_frames -= num_frames_to_remove;
             m_voice.frames_before_starting -= num_frames_to_remove;
         }
 
-        m_frame_index = samples_written / 2;
-
-        while (num_frames) {
-            u32 const chunk_size = Min(num_frames, k_num_frames_in_voice_processing_chunk);
-            ZoneNamedN(chunk, "Voice Chunk", true);
-            ZoneValueV(chunk, chunk_size);
-
-            m_voice.smoothing_system.ProcessBlock(chunk_size);
-
-            FillLFOBuffer(chunk_size);
-            FillBufferWithSampleData(chunk_size);
-
-            auto num_valid_frames = ApplyVolumeEnvelope(chunk_size);
-            num_valid_frames = ApplyGain(num_valid_frames);
-            ApplyVolumeLFO(num_valid_frames);
-            ApplyPan(num_valid_frames);
-            ApplyFilter(num_valid_frames);
-
-            auto const samples_to_write = num_valid_frames * 2;
-            CheckSamplesAreValid(0, samples_to_write);
-            // We can't do aligned copy because of frames_before_starting
-            CopyMemory(write_buffer.data, m_buffer.data, (usize)samples_to_write * sizeof(f32));
-            samples_written += samples_to_write;
-            write_buffer = write_buffer.SubSpan((usize)samples_to_write);
-
-            if (num_valid_frames != chunk_size || !m_voice.num_active_voice_samples) {
-                // We can't do aligned zero because of frames_before_starting
-                ZeroMemory(write_buffer.ToByteSpan());
-                EndVoiceInstantly(m_voice);
-                break;
-            }
+        m_frame_index = m_samples_written / 2;
+        return num_frames;
+    }
 
-            num_frames -= chunk_size;
-            m_frame_index += chunk_size;
-
-            m_voice.pool.voice_waveform_markers_for_gui.Write()[m_voice.index] = {
-                .layer_index = (u8)m_voice.controller->layer_index,
-                .position = (u16)(Clamp01(m_position_for_gui) * (f32)UINT16_MAX),
-                .intensity = (u16)(Clamp01(m_voice.current_gain) * (f32)UINT16_MAX),
-            };
-            m_voice.pool.voice_vol_env_markers_for_gui.Write()[m_voice.index] = {
-                .on = m_voice.controller->vol_env_on && !m_voice.vol_env.IsIdle(),
-                .layer_index = (u8)m_voice.controller->layer_index,
-                .state = (u8)m_voice.vol_env.state,
-                .pos = (u16)(Clamp01(m_voice.vol_env.output) * (f32)UINT16_MAX),
-                .sustain_level = (u16)(Clamp01(m_voice.controller->vol_env.sustain_amount) * (f32)UINT16_MAX),
-                .id = m_voice.id,
-            };
-            m_voice.pool.voice_fil_env_markers_for_gui.Write()[m_voice.index] = {
-                .on = m_voice.controller->fil_env_amount != 0 && !m_voice.fil_env.IsIdle(),
-                .layer_index = (u8)m_voice.controller->layer_index,
-                .state = (u8)m_voice.fil_env.state,
-                .pos = (u16)(Clamp01(m_voice.fil_env.output) * (f32)UINT16_MAX),
-                .sustain_level = (u16)(Clamp01(m_voice.controller->fil_env.sustain_amount) * (f32)UINT16_MAX),
-                .id = m_voice.id,
-            };
-
-            m_voice.current_gain = 1;
+    // The control lanes must have been processed for this chunk. Returns false if the voice ended.
+    bool ProcessChunk(u32 chunk_size) {
+        ZoneNamedN(chunk, "Voice Chunk", true);
+        ZoneValueV(chunk, chunk_size);
+
+        m_voice.smoothing_system.ProcessBlock(chunk_size);
+
+        FillBufferWithSampleData(chunk_size);
+
+        // The gain stages just calculate a gain per frame; we apply them all to the buffer in one pass.
+        auto num_valid_frames = CalculateVolumeEnvelopeGains(chunk_size);
+        num_valid_frames = MultiplyGainsByFade(num_valid_frames);
+        MultiplyGainsByVolumeLFO(num_valid_frames);
+        SimdMultiplyStereoFramesByGains(m_buffer.data, m_frame_gains.data, num_valid_frames);
+        ApplyPan(num_valid_frames);
+        ApplyFilter(num_valid_frames);
+
+        auto const samples_to_write = num_valid_frames * 2;
+        CheckSamplesAreValid(0, samples_to_write);
+        // We can't do aligned copy because of frames_before_starting
+        CopyMemory(m_write_buffer.data, m_buffer.data, (usize)samples_to_write * sizeof(f32));
+        m_samples_written += samples_to_write;
+        m_write_buffer = m_write_buffer.SubSpan((usize)samples_to_write);
+
+        if (num_valid_frames != chunk_size || !m_voice.num_active_voice_samples) {
+            // We can't do aligned zero because of frames_before_starting
+            ZeroMemory(m_write_buffer.ToByteSpan());
+            MarkVoiceEnded(m_voice);
+            return false;
         }
 
-        return samples_written != 0;
+        m_frame_index += chunk_size;
+
+        m_voice.pool.voice_waveform_markers_for_gui.Write()[m_voice.index] = {
+            .layer_index = (u8)m_voice.controller->layer_index,
+            .position = (u16)(Clamp01(m_position_for_gui) * (f32)UINT16_MAX),
+            .intensity = (u16)(Clamp01(m_voice.current_gain) * (f32)UINT16_MAX),
+        };
+        m_voice.pool.voice_vol_env_markers_for_gui.Write()[m_voice.index] = {
+            .on = m_voice.controller->vol_env_on && !m_voice.vol_env.IsIdle(),
+            .layer_index = (u8)m_voice.controller->layer_index,
+            .state = (u8)m_voice.vol_env.state,
+            .pos = (u16)(Clamp01(m_voice.vol_env.output) * (f32)UINT16_MAX),
+            .sustain_level = (u16)(Clamp01(m_voice.controller->vol_env.sustain_amount) * (f32)UINT16_MAX),
+            .id = m_voice.id,
+        };
+        m_voice.pool.voice_fil_env_markers_for_gui.Write()[m_voice.index] = {
+            .on = m_voice.controller->fil_env_amount != 0 && !m_voice.fil_env.IsIdle(),
+            .layer_index = (u8)m_voice.controller->layer_index,
+            .state = (u8)m_voice.fil_env.state,
+            .pos = (u16)(Clamp01(m_voice.fil_env.output) * (f32)UINT16_MAX),
+            .sustain_level = (u16)(Clamp01(m_voice.controller->fil_env.sustain_amount) * (f32)UINT16_MAX),
+            .id = m_voice.id,
+        };
+
+        m_voice.current_gain = 1;
+
+        return true;
     }
 
+    bool WroteToBuffer() const { return m_samples_written != 0; }
+
   private:
     void CheckSamplesAreValid(usize buffer_pos, usize num) {
         ASSERT_HOT(buffer_pos + num <= m_buffer.size);
@@ -545,15 +693,7 @@ class ChunkwiseVoiceProcessor {
         return ((num_frames % 2) != 0) ? (num_frames - 1) : UINT32_MAX;
     }
 
-    void MultiplyVectorToBufferAtPos(usize const pos, f32x4 const& gain) {
-        ASSERT_HOT(pos + 4 <= m_buffer.size);
-        auto p = LoadUnalignedToType<f32x4>(&m_buffer[pos]);
-        p *= gain;
-        CheckSamplesAreValid(p);
-        StoreToUnaligned(&m_buffer[pos], p);
-    }
-
-    void AddVectorToBufferAtPos(usize const pos, f32x4 const& addition) {
+    ALWAYS_INLINE void AddVectorToBufferAtPos(usize const pos, f32x4 const& addition) {
         ASSERT_HOT(pos + 4 <= m_buffer.size);
         f32x4 p;
         p = LoadUnalignedToType<f32x4>(&m_buffer[pos]);
@@ -568,7 +708,7 @@ class ChunkwiseVoiceProcessor {
         StoreToUnaligned(&m_buffer[pos], data);
     }
 
-    f64 GetPitchRatio(VoiceSample& w, u32 frame) {
+    ALWAYS_INLINE f64 GetPitchRatio(VoiceSample& w, u32 frame) {
         auto pitch_ratio = m_voice.smoothing_system.Value(w.pitch_ratio_smoother_id, frame);
         if (HasPitchLfo()) {
             static constexpr f64 k_max_semitones = 1;
@@ -580,39 +720,112 @@ class ChunkwiseVoiceProcessor {
         return pitch_ratio;
     }
 
-    bool SampleGetAndInc(VoiceSample& w, u32 frame, f32& out_l, f32& out_r) {
-        SampleGetData(*w.sampler.data, w.sampler.loop, w.sampler.loop_and_reverse_flags, w.pos, out_l, out_r);
+    template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+    ALWAYS_INLINE bool SampleGetAndInc(VoiceSample& w, u32 frame, f32& out_l, f32& out_r) {
+        if (!SampleGetData<k_channels, k_quality, k_has_loop>(*w.sampler.data,
+                                                              m_streamed_frames,
+                                                              w.sampler.loop,
+                                                              w.sampler.loop_and_reverse_flags,
+                                                              w.pos,
+                                                              out_l,
+                                                              out_r))
+            m_stream_underrun = true;
         auto const pitch_ratio = GetPitchRatio(w, frame);
-        return IncrementSamplePlaybackPos(w.sampler.loop,
-                                          w.sampler.loop_and_reverse_flags,
-                                          w.pos,
-                                          pitch_ratio,
-                                          (f64)w.sampler.data->num_frames);
+        return IncrementSamplePlaybackPos<k_has_loop>(w.sampler.loop,
+                                                      w.sampler.loop_and_reverse_flags,
+                                                      w.pos,
+                                                      pitch_ratio,
+                                                      (f64)w.sampler.data->num_frames);
     }
 
-    bool SampleGetAndIncWithXFade(VoiceSample& w, u32 frame, f32& out_l, f32& out_r) {
+    template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+    ALWAYS_INLINE bool SampleGetAndIncWithXFade(VoiceSample& w, u32 frame, f32& out_l, f32& out_r) {
         bool sample_still_going = false;
         if (w.sampler.region->timbre_layering.layer_range) {
             if (auto const v = m_voice.smoothing_system.Value(w.sampler.xfade_vol_smoother_id, frame);
                 v != 0) {
-                sample_still_going = SampleGetAndInc(w, frame, out_l, out_r);
+                sample_still_going =
+                    SampleGetAndInc<k_channels, k_quality, k_has_loop>(w, frame, out_l, out_r);
                 out_l *= v;
                 out_r *= v;
             } else {
                 auto const pitch_ratio1 = GetPitchRatio(w, frame);
-                sample_still_going = IncrementSamplePlaybackPos(w.sampler.loop,
-                                                                w.sampler.loop_and_reverse_flags,
-                                                                w.pos,
-                                                                pitch_ratio1,
-                                                                (f64)w.sampler.data->num_frames);
+                sample_still_going = IncrementSamplePlaybackPos<k_has_loop>(w.sampler.loop,
+                                                                            w.sampler.loop_and_reverse_flags,
+                                                                            w.pos,
+                                                                            pitch_ratio1,
+                                                                            (f64)w.sampler.data->num_frames);
             }
         } else {
-            sample_still_going = SampleGetAndInc(w, frame, out_l, out_r);
+            sample_still_going = SampleGetAndInc<k_channels, k_quality, k_has_loop>(w, frame, out_l, out_r);
         }
         return sample_still_going;
     }
 
     bool AddSampleDataOntoBuffer(VoiceSample& w, u32 num_frames) {
+        m_streamed_frames = {};
+        m_stream_underrun = false;
+        if (w.sampler.disk_stream) m_streamed_frames = StreamedFramesForChunk(*w.sampler.disk_stream);
+        DEFER {
+            if (w.sampler.disk_stream) {
+                auto& streamer = m_voice.pool.disk_streamer;
+                if (m_stream_underrun) streamer.num_underruns.FetchAdd(1, RmwMemoryOrder::Relaxed);
+                UpdateDiskStreamPlayhead(
+                    streamer,
+                    *w.sampler.disk_stream,
+                    w.pos,
+                    w.sampler.loop_and_reverse_flags & loop_and_reverse_flags::CurrentlyReversed);
+            }
+        };
+
+        // Pick the specialised kernel once for the whole chunk.
+        auto const quality = m_voice.pool.interpolation_quality.Load(LoadMemoryOrder::Relaxed);
+        switch (w.sampler.data->channels) {
+            case 1: return AddSampleFramesForQuality<1>(w, num_frames, quality);
+            case 2: return AddSampleFramesForQuality<2>(w, num_frames, quality);
+            default: PanicIfReached();
+        }
+        return false;
+    }
+
+    template <u32 k_channels>
+    bool AddSampleFramesForQuality(VoiceSample& w, u32 num_frames, InterpolationQuality quality) {
+        switch (quality) {
+            case InterpolationQuality::Linear:
+                return AddSampleFramesForLoop<k_channels, InterpolationQuality::Linear>(w, num_frames);
+            case InterpolationQuality::Cubic:
+                return AddSampleFramesForLoop<k_channels, InterpolationQuality::Cubic>(w, num_frames);
+            case InterpolationQuality::Sinc:
+                return AddSampleFramesForLoop<k_channels, InterpolationQuality::Sinc>(w, num_frames);
+            case InterpolationQuality::Count: PanicIfReached();
+        }
+        return false;
+    }
+
+    template <u32 k_channels, InterpolationQuality k_quality>
+    bool AddSampleFramesForLoop(VoiceSample& w, u32 num_frames) {
+        if (w.sampler.loop) return AddSampleFramesForCpu<k_channels, k_quality, true>(w, num_frames);
+        return AddSampleFramesForCpu<k_channels, k_quality, false>(w, num_frames);
+    }
+
+    template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+    bool AddSampleFramesForCpu(VoiceSample& w, u32 num_frames) {
+#if defined(__x86_64__)
+        if (CpuSupportsAvx2Fma())
+            return AddSampleFramesOntoBufferAvx2<k_channels, k_quality, k_has_loop>(w, num_frames);
+#endif
+        return AddSampleFramesOntoBuffer<k_channels, k_quality, k_has_loop>(w, num_frames);
+    }
+
+    // Interpolating the sample data is the bulk of a voice's work. This is the same code compiled for AVX2
+    // and FMA; everything that it calls per frame is ALWAYS_INLINE so that it's compiled that way too.
+    template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+    TARGET_AVX2_FMA bool AddSampleFramesOntoBufferAvx2(VoiceSample& w, u32 num_frames) {
+        return AddSampleFramesOntoBuffer<k_channels, k_quality, k_has_loop>(w, num_frames);
+    }
+
+    template <u32 k_channels, InterpolationQuality k_quality, bool k_has_loop>
+    ALWAYS_INLINE bool AddSampleFramesOntoBuffer(VoiceSample& w, u32 num_frames) {
         usize sample_pos = 0;
         for (u32 frame = 0; frame < num_frames; frame += 2) {
             f32 sl1 {};
@@ -620,11 +833,13 @@ class ChunkwiseVoiceProcessor {
             f32 sl2 {};
             f32 sr2 {};
 
-            bool sample_still_going = SampleGetAndIncWithXFade(w, frame, sl1, sr1);
+            bool sample_still_going =
+                SampleGetAndIncWithXFade<k_channels, k_quality, k_has_loop>(w, frame, sl1, sr1);
 
             auto const frame_p1 = frame + 1;
             if (sample_still_going && frame_p1 != num_frames)
-                sample_still_going = SampleGetAndIncWithXFade(w, frame_p1, sl2, sr2);
+                sample_still_going =
+                    SampleGetAndIncWithXFade<k_channels, k_quality, k_has_loop>(w, frame_p1, sl2, sr2);
 
             // sl2 and sl2 will be 0 if the second sample was not fetched so there is no harm in
             // adding that too
@@ -692,6 +907,7 @@ class ChunkwiseVoiceProcessor {
                     if (!AddSampleDataOntoBuffer(s, num_frames)) {
                         s.is_active = false;
                         m_voice.num_active_voice_samples--;
+                        ReleaseDiskStream(m_voice.pool.disk_streamer, s.sampler.disk_stream);
                     }
                     m_position_for_gui = (f32)s.pos / (f32)s.sampler.data->num_frames;
                     break;
@@ -748,74 +964,47 @@ class ChunkwiseVoiceProcessor {
         }
     }
 
-    void ApplyVolumeLFO(u32 num_frames) {
+    void MultiplyGainsByVolumeLFO(u32 num_frames) {
         ZoneScoped;
-        usize sample_pos = 0;
-        f32 v1 = 1;
+        f32 v = 1;
         if (HasVolumeLfo()) {
-            for (usize frame = 0; frame < num_frames; frame += 2) {
-                static constexpr f32 k_base = 1;
-                auto const lfo_amp = m_voice.controller->lfo.amount;
-
-                // - (lfo_amp/2) because that sounds better
-                auto const b = k_base - (Fabs(lfo_amp) / 2);
-                auto const half_amp = lfo_amp / 2;
-                v1 = b + m_lfo_amounts[frame] * half_amp;
-                auto const frame_p1 = frame + 1;
-                auto const v2 = (frame_p1 != num_frames) ? b + m_lfo_amounts[frame_p1] * half_amp : 0.0f;
-                f32x4 v {v1, v1, v2, v2};
-                v = Min<f32x4>(v, 1.0f);
-                v = Max<f32x4>(v, 0.0f);
-
-                MultiplyVectorToBufferAtPos(sample_pos, v);
-                sample_pos += 4;
+            static constexpr f32 k_base = 1;
+            auto const lfo_amp = m_voice.controller->lfo.amount;
+
+            // - (lfo_amp/2) because that sounds better
+            auto const b = k_base - (Fabs(lfo_amp) / 2);
+            auto const half_amp = lfo_amp / 2;
+            for (auto const frame : Range(num_frames)) {
+                v = Clamp01(b + m_lfo_amounts[frame] * half_amp);
+                m_frame_gains[frame] *= v;
             }
         }
 
-        m_voice.current_gain *= v1;
+        m_voice.current_gain *= v;
     }
 
-    u32 ApplyVolumeEnvelope(u32 num_frames) {
+    // Returns the number of frames before the envelope finished.
+    u32 CalculateVolumeEnvelopeGains(u32 num_frames) {
         ZoneScoped;
-        auto vol_env = m_voice.vol_env;
-        auto env_on = m_voice.controller->vol_env_on;
-        auto vol_env_params = m_voice.controller->vol_env;
-        DEFER { m_voice.vol_env = vol_env; };
-
-        usize sample_pos = 0;
-        f32 env1 = 0;
-        for (u32 frame = 0; frame < num_frames; frame += 2) {
-            env1 = vol_env.Process(vol_env_params);
-            f32 env2 = 1;
-            auto const frame_p1 = frame + 1;
-            if (frame_p1 != num_frames) env2 = vol_env.Process(vol_env_params);
-            if (env_on) {
-                f32x4 const gain {env1, env1, env2, env2};
-                MultiplyVectorToBufferAtPos(sample_pos, gain);
-            }
-            sample_pos += 4;
+        CopyMemory(m_frame_gains.data, m_control.vol_env_gains[m_lane].data, num_frames * sizeof(f32));
 
-            if (env_on && vol_env.IsIdle()) return frame;
-        }
+        auto const num_valid_frames = m_control.vol_env_valid_frames[m_lane];
+        if (num_valid_frames != num_frames) return num_valid_frames;
 
-        m_voice.current_gain *= env_on ? env1 : 1;
+        m_voice.current_gain *= m_frame_gains[(num_frames - 1) & ~1u];
 
         return num_frames;
     }
 
-    u32 ApplyGain(u32 num_frames) {
+    // Returns the number of frames before the fade became silent.
+    u32 MultiplyGainsByFade(u32 num_frames) {
         ZoneScoped;
-        usize sample_pos = 0;
         f32 fade1 {};
         for (u32 frame = 0; frame < num_frames; frame += 2) {
             fade1 = m_voice.volume_fade.GetFade() * m_voice.aftertouch_multiplier;
-            f32 fade2 = 1;
+            m_frame_gains[frame] *= fade1;
             if (frame + 1 != num_frames)
-                fade2 = m_voice.volume_fade.GetFade() * m_voice.aftertouch_multiplier;
-
-            f32x4 const gain {fade1, fade1, fade2, fade2};
-            MultiplyVectorToBufferAtPos(sample_pos, gain);
-            sample_pos += 4;
+                m_frame_gains[frame + 1] *= m_voice.volume_fade.GetFade() * m_voice.aftertouch_multiplier;
 
             if (m_voice.volume_fade.IsSilent()) return frame;
         }
@@ -850,14 +1039,12 @@ class ChunkwiseVoiceProcessor {
     void ApplyFilter(u32 num_frames) {
         ZoneScoped;
         auto const filter_type = m_voice.controller->filter_type;
-
-        auto fil_env = m_voice.fil_env;
-        auto fil_env_params = m_voice.controller->fil_env;
-        DEFER { m_voice.fil_env = fil_env; };
+        auto const& fil_env = m_control.fil_env_values[m_lane];
+        auto const fil_env_frames_before_sustain = m_control.fil_env_frames_before_sustain[m_lane];
 
         usize sample_pos = 0;
         for (u32 frame = 0; frame < num_frames; frame++) {
-            auto env = fil_env.Process(fil_env_params);
+            auto const env = fil_env[frame];
             if (auto filter_mix = m_voice.smoothing_system.Value(m_voice.filter_mix_smoother_id, frame);
                 filter_mix != 0) {
                 m_voice.filter_changed |=
@@ -877,7 +1064,7 @@ class ChunkwiseVoiceProcessor {
                     cut += (m_lfo_amounts[(usize)frame] * lfo_amp) / 2;
                 }
 
-                if (fil_env.state != adsr::State::Sustain && m_voice.controller->fil_env_amount != 0)
+                if (frame < fil_env_frames_before_sustain && m_voice.controller->fil_env_amount != 0)
                     m_voice.filter_changed = true;
 
                 if (m_voice.filter_changed) {
@@ -910,16 +1097,6 @@ class ChunkwiseVoiceProcessor {
         }
     }
 
-    void FillLFOBuffer(u32 num_frames) {
-        ZoneScoped;
-        for (auto const i : Range(num_frames)) {
-            auto v = m_voice.lfo.Tick();
-            constexpr f32 k_lfo_lowpass_smoothing = 0.9f;
-            v = m_voice.lfo_smoother.LowPass(v, k_lfo_lowpass_smoothing);
-            m_lfo_amounts[i] = -v;
-        }
-    }
-
     void ZeroChunkBuffer(u32 num_frames) {
         auto num_samples = num_frames * 2;
         num_samples += num_samples % 2;
@@ -931,25 +1108,87 @@ class ChunkwiseVoiceProcessor {
 
     AudioProcessingContext const& m_audio_context;
     Voice& m_voice;
+    VoiceControlLanes const& m_control;
+    u32 const m_lane;
+    Array<f32, k_num_frames_in_voice_processing_chunk + 1> const& m_lfo_amounts;
 
+    Span<f32> m_write_buffer {};
+    u32 m_samples_written = 0;
     u32 m_frame_index = 0;
     f32 m_position_for_gui = 0;
 
-    alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk + 1> m_lfo_amounts;
+    StreamedFrames m_streamed_frames {};
+    bool m_stream_underrun {};
+
+    alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk + 1> m_frame_gains;
     alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk * 2 + 2> m_buffer;
 };
 
-inline void ProcessBuffer(Voice& voice, u32 num_frames, AudioProcessingContext const& context) {
-    if (!voice.is_active) return;
+// Renders up to k_num_voice_lanes voices. They're processed chunk by chunk in lockstep so that the control
+// values of each chunk can be calculated for all of them at once.
+static void ProcessVoiceGroup(VoicePool& pool,
+                              Span<u16 const> voice_indices,
+                              u32 num_frames,
+                              AudioProcessingContext const& context) {
+    ZoneScoped;
+    ASSERT_HOT(voice_indices.size <= k_num_voice_lanes);
+
+    VoiceControlLanes control;
+    Array<Optional<ChunkwiseVoiceProcessor>, k_num_voice_lanes> processors;
+    Array<u32, k_num_voice_lanes> frames_remaining {};
+    for (auto const [lane, voice_index] : Enumerate<u32>(voice_indices)) {
+        auto& voice = pool.voices[voice_index];
+        if (!voice.is_active) continue;
+        control.LoadLane(lane, voice);
+        processors[lane].Emplace(voice, context, control, lane);
+        frames_remaining[lane] = processors[lane]->Begin(num_frames);
+    }
 
-    ChunkwiseVoiceProcessor processor(voice, context);
-    voice.written_to_buffer_this_block = processor.Process(num_frames);
+    while (true) {
+        Array<u32, k_num_voice_lanes> chunk_sizes;
+        bool any_frames = false;
+        for (auto const lane : Range(k_num_voice_lanes)) {
+            chunk_sizes[lane] = Min(frames_remaining[lane], k_num_frames_in_voice_processing_chunk);
+            any_frames |= chunk_sizes[lane] != 0;
+        }
+        if (!any_frames) break;
+
+        control.Process(chunk_sizes);
+
+        for (auto const lane : Range(k_num_voice_lanes)) {
+            if (!chunk_sizes[lane]) continue;
+            control.StoreLane(lane, pool.voices[voice_indices[lane]]);
+            if (processors[lane]->ProcessChunk(chunk_sizes[lane]))
+                frames_remaining[lane] -= chunk_sizes[lane];
+            else
+                frames_remaining[lane] = 0;
+        }
+    }
+
+    for (auto const [lane, voice_index] : Enumerate<u32>(voice_indices))
+        if (processors[lane])
+            pool.voices[voice_index].written_to_buffer_this_block = processors[lane]->WroteToBuffer();
+}
+
+static void ProcessVoiceGroups(VoicePool& pool,
+                               Span<u16 const> voice_indices,
+                               u32 num_frames,
+                               AudioProcessingContext const& context) {
+    for (usize i = 0; i < voice_indices.size; i += k_num_voice_lanes)
+        ProcessVoiceGroup(pool,
+                          voice_indices.SubSpan(i, Min<usize>(k_num_voice_lanes, voice_indices.size - i)),
+                          num_frames,
+                          context);
 }
 
 void OnThreadPoolExec(VoicePool& pool, u32 task_index) {
-    auto& voice = pool.voices[task_index];
-    if (voice.is_active)
-        ProcessBuffer(voice, voice.pool.multithread_processing.num_frames, *pool.audio_processing_context);
+    auto const& mt = pool.multithread_processing;
+    auto const first = task_index * mt.num_voices_per_task;
+    auto const end = Min(first + mt.num_voices_per_task, (u32)mt.active_voice_indices.size);
+    ProcessVoiceGroups(pool,
+                       mt.active_voice_indices.Items().SubSpan(first, end - first),
+                       mt.num_frames,
+                       *pool.audio_processing_context);
 }
 
 void Reset(VoicePool& pool) {
@@ -971,33 +1210,59 @@ ProcessVoices(VoicePool& pool, u32 num_frames, AudioProcessingContext const& con
     ZoneScoped;
     if (pool.num_active_voices.Load(LoadMemoryOrder::Relaxed) == 0) return {};
 
-    auto const thread_pool =
-        (clap_host_thread_pool const*)context.host.get_extension(&context.host, CLAP_EXT_THREAD_POOL);
+    // Voices write their GUI markers as they're processed. Clearing them all up front is much cheaper than
+    // visiting every voice afterwards to clear the ones that weren't written.
+    pool.voice_waveform_markers_for_gui.Write() = {};
+    pool.voice_vol_env_markers_for_gui.Write() = {};
+    pool.voice_fil_env_markers_for_gui.Write() = {};
 
+    auto& mt = pool.multithread_processing;
     {
-
-        bool failed_multithreaded_process = false;
-        if (thread_pool && thread_pool->request_exec) {
-            pool.multithread_processing.num_frames = num_frames;
-            for (auto& v : pool.voices)
-                v.written_to_buffer_this_block = false;
-
+        dyn::Clear(mt.active_voice_indices);
+        for (auto& v : pool.EnumerateActiveVoices())
+            dyn::Append(mt.active_voice_indices, v.index);
+
+        // Each task processes a group of voices so that the work in a task is worth the cost of dispatching
+        // it. With small blocks we group more voices together. If it all fits in one task we don't use the
+        // thread pool at all.
+        constexpr u32 k_min_voice_frames_per_task = 1024;
+        mt.num_voices_per_task = Max(1u, (k_min_voice_frames_per_task + num_frames - 1) / num_frames);
+        // Keep the groups of voices whose control values are processed together intact, even with big
+        // blocks: a task with a single voice leaves the other lanes empty.
+        if (mt.active_voice_indices.size > 1)
+            mt.num_voices_per_task = (u32)AlignForward(mt.num_voices_per_task, k_num_voice_lanes);
+        auto const num_tasks =
+            ((u32)mt.active_voice_indices.size + mt.num_voices_per_task - 1) / mt.num_voices_per_task;
+
+        bool processed = false;
+        if (num_tasks > 1) {
+            mt.num_frames = num_frames;
             pool.audio_processing_context = &context;
-            failed_multithreaded_process = !thread_pool->request_exec(&context.host, k_num_voices);
-        }
 
-        if (!thread_pool || failed_multithreaded_process) {
-            for (auto& v : pool.voices) {
-                v.written_to_buffer_this_block = false;
-                if (v.is_active) ProcessBuffer(v, num_frames, context);
+            auto const thread_pool =
+                (clap_host_thread_pool const*)context.host.get_extension(&context.host, CLAP_EXT_THREAD_POOL);
+            if (thread_pool && thread_pool->request_exec)
+                processed = thread_pool->request_exec(&context.host, num_tasks);
+
+            if (!processed && pool.worker_pool.NumThreads()) {
+                pool.worker_pool.Execute(num_tasks,
+                                         [&pool](u32 task_index) { OnThreadPoolExec(pool, task_index); });
+                processed = true;
             }
         }
+
+        if (!processed) ProcessVoiceGroups(pool, mt.active_voice_indices.Items(), num_frames, context);
     }
 
+    for (auto& v : pool.EnumerateActiveVoices())
+        if (!v.is_active) ReturnVoiceToFreeList(pool, v);
+
     Array<Span<f32>, k_num_layers> layer_buffers {};
 
-    for (auto& v : pool.voices) {
-        if (v.written_to_buffer_this_block) {
+    // Only voices that were active at the start of the block can have written anything.
+    for (auto const voice_index : mt.active_voice_indices) {
+        auto& v = pool.voices[voice_index];
+        if (Exchange(v.written_to_buffer_this_block, false)) {
             if constexpr (RUNTIME_SAFETY_CHECKS_ON && PRODUCTION_BUILD) {
                 for (auto const frame : Range(num_frames)) {
                     auto const& l = pool.buffer_pool[v.index][frame * 2 + 0];
@@ -1015,10 +1280,6 @@ ProcessVoices(VoicePool& pool, u32 num_frames, AudioProcessingContext const& con
                                      pool.buffer_pool[v.index].data,
                                      (usize)num_frames * 2);
             }
-        } else {
-            pool.voice_waveform_markers_for_gui.Write()[v.index] = {};
-            pool.voice_vol_env_markers_for_gui.Write()[v.index] = {};
-            pool.voice_fil_env_markers_for_gui.Write()[v.index] = {};
         }
     }
 
@@ -1028,3 +1289,92 @@ ProcessVoices(VoicePool& pool, u32 num_frames, AudioProcessingContext const& con
 
     return layer_buffers;
 }
+
+// Voices process their envelopes and LFOs 4 at a time. Each lane must match the scalar version exactly,
+// including when lanes sit out some of the frames.
+TEST_CASE(TestVoiceControlLanes) {
+    constexpr u32 k_num_lanes = 4;
+    constexpr u32 k_chunk_size = 64;
+    constexpr u32 k_num_chunks = 100;
+
+    // The last lane sits out every other chunk.
+    auto const active_lanes = [](u32 chunk) { return s32x4 {-1, -1, -1, (chunk % 2) ? -1 : 0}; };
+
+    SUBCASE("adsr") {
+        Array<adsr::Params, k_num_lanes> params {};
+        for (auto const lane : Range(k_num_lanes)) {
+            auto const scale = (f32)(lane + 1);
+            params[lane].SetSustainAmp(0.2f * scale);
+            params[lane].SetAttackSamples(100 * scale, 0.3f);
+            params[lane].SetDecaySamples(300 * scale, 0.0001f);
+            params[lane].SetReleaseSamples(500 * scale, 0.0001f);
+        }
+
+        Array<adsr::Processor, k_num_lanes> scalar {};
+        Array<adsr::Processor, k_num_lanes> lanes {};
+        for (auto const chunk : Range(k_num_chunks)) {
+            CAPTURE(chunk);
+
+            // Start each envelope at a different time, and release them part way through.
+            for (auto const lane : Range(k_num_lanes)) {
+                if (chunk == lane * 3) {
+                    scalar[lane].Gate(true);
+                    lanes[lane].Gate(true);
+                }
+                if (chunk == 40 + (lane * 7)) {
+                    scalar[lane].Gate(false);
+                    lanes[lane].Gate(false);
+                }
+            }
+
+            auto const active = active_lanes(chunk);
+            adsr::ProcessorX4 x4;
+            for (auto const lane : Range(k_num_lanes))
+                x4.LoadLane(lane, lanes[lane], params[lane]);
+            for (auto const _ : Range(k_chunk_size)) {
+                auto const output = x4.Process(active);
+                for (auto const lane : Range(k_num_lanes))
+                    if (active[lane]) REQUIRE_EQ(output[lane], scalar[lane].Process(params[lane]));
+            }
+            for (auto const lane : Range(k_num_lanes)) {
+                x4.StoreLane(lane, lanes[lane]);
+                REQUIRE(lanes[lane].state == scalar[lane].state);
+                REQUIRE_EQ(lanes[lane].output, scalar[lane].output);
+                REQUIRE_EQ(lanes[lane].prev_output, scalar[lane].prev_output);
+            }
+        }
+
+        // Every stage was covered.
+        CHECK(scalar[0].IsIdle());
+    }
+
+    SUBCASE("lfo") {
+        Array<LFO, k_num_lanes> scalar {};
+        for (auto const lane : Range(k_num_lanes)) {
+            scalar[lane].SetWaveform((LFO::Waveform)(ToInt(LFO::Waveform::Sine) + lane));
+            scalar[lane].SetRate(44100, 1.5f + ((f32)lane * 3));
+        }
+        auto lanes = scalar;
+
+        for (auto const chunk : Range(k_num_chunks)) {
+            CAPTURE(chunk);
+            auto const active = active_lanes(chunk);
+            LfoX4 x4;
+            for (auto const lane : Range(k_num_lanes))
+                x4.LoadLane(lane, lanes[lane]);
+            for (auto const _ : Range(k_chunk_size)) {
+                auto const output = x4.Tick(active);
+                for (auto const lane : Range(k_num_lanes))
+                    if (active[lane]) REQUIRE_EQ(output[lane], scalar[lane].Tick());
+            }
+            for (auto const lane : Range(k_num_lanes)) {
+                x4.StoreLane(lane, lanes[lane]);
+                REQUIRE_EQ(lanes[lane].phase, scalar[lane].phase);
+            }
+        }
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterVoicesTests) { REGISTER_TEST(TestVoiceControlLanes); }
@@ -5,6 +5,7 @@
 #include "foundation/foundation.hpp"
 #include "os/threading.hpp"
 #include "utils/thread_extra/atomic_swap_buffer.hpp"
+#include "utils/thread_extra/realtime_worker_pool.hpp"
 
 #include "common_infrastructure/constants.hpp"
 
@@ -16,6 +17,7 @@
 #include "processing_utils/midi.hpp"
 #include "processing_utils/smoothed_value_system.hpp"
 #include "processing_utils/volume_fade.hpp"
+#include "disk_streaming.hpp"
 #include "sample_processing.hpp"
 #include "state/instrument.hpp"
 
@@ -61,6 +63,7 @@ struct VoiceSample {
         VoiceSmoothedValueSystem::FloatId const xfade_vol_smoother_id;
         u32 loop_and_reverse_flags {};
         Optional<BoundsCheckedLoop> loop {};
+        DiskStream* disk_stream {}; // non-null if data is streamed from disk
     } sampler;
 
     // if generator == SoundGenerator::WaveformSynth
@@ -82,7 +85,6 @@ struct Voice {
     VoiceSmoothedValueSystem smoothing_system;
 
     VoiceProcessingController* controller = {};
-    u64 age = ~(u64)0;
     u16 id {};
     u32 frames_before_starting {};
     f32 current_gain {};
@@ -119,6 +121,39 @@ struct Voice {
     adsr::Processor fil_env = {};
     f32 amp_l = 1, amp_r = 1;
     f32 aftertouch_multiplier = 1;
+
+    // An inactive voice is in the pool's free list (via next). An active voice is in the pool's list of
+    // active voices (via prev/next), which is ordered oldest first, and in its layer's list (via *_in_layer).
+    Voice* prev {};
+    Voice* next {};
+    Voice* prev_in_layer {};
+    Voice* next_in_layer {};
+};
+
+struct VoiceList {
+    Voice* first {};
+    Voice* last {};
+};
+
+// Iterates one of the VoicePool's lists. The current voice can be ended during iteration.
+template <Voice* Voice::* k_next>
+struct VoiceListIterable {
+    struct Iterator {
+        bool operator!=(Iterator const& other) const { return voice != other.voice; }
+        void operator++() {
+            voice = next;
+            if (voice) next = voice->*k_next;
+        }
+        Voice& operator*() const { return *voice; }
+
+        Voice* voice;
+        Voice* next;
+    };
+
+    Iterator begin() const { return {first, first ? first->*k_next : nullptr}; }
+    static Iterator end() { return {nullptr, nullptr}; }
+
+    Voice* first;
 };
 
 struct VoiceEnvelopeMarkerForGui {
@@ -136,73 +171,36 @@ struct VoiceWaveformMarkerForGui {
     u16 intensity {};
 };
 
-template <typename Type>
-concept ShouldSkipVoiceFunction = requires(Type function, Voice const& v) {
-    { function(v) } -> Same<bool>;
-};
-
 struct VoicePool {
-    template <bool k_early_out_if_none_active, ShouldSkipVoiceFunction Function>
-    auto EnumerateVoices(Function&& should_skip_voice) {
-        struct IterableWrapper {
-            struct Iterator {
-                constexpr bool operator!=(Iterator const& other) const { return index != other.index; }
-                constexpr void operator++() {
-                    ++index;
-                    while (index < k_num_voices && wrapper.should_skip_voice(wrapper.pool.voices[index]))
-                        ++index;
-                }
-                constexpr Voice& operator*() const { return wrapper.pool.voices[index]; }
-
-                IterableWrapper const& wrapper;
-                usize index;
-            };
-
-            constexpr Iterator begin() {
-                if (k_early_out_if_none_active && pool.num_active_voices.Load(LoadMemoryOrder::Relaxed) == 0)
-                    return end();
-
-                usize i = 0;
-                for (; i < k_num_voices; ++i)
-                    if (!should_skip_voice(pool.voices[i])) break;
-                return {*this, i};
-            }
-
-            constexpr Iterator end() { return {*this, k_num_voices}; }
-
-            VoicePool& pool;
-            Function should_skip_voice;
-        };
-
-        return IterableWrapper {*this, Forward<Function>(should_skip_voice)};
-    }
+    VoicePool();
 
-    auto EnumerateActiveVoices() {
-        return EnumerateVoices<true>([](Voice const& v) { return !v.is_active; });
-    }
+    // [audio-thread] Oldest first.
+    VoiceListIterable<&Voice::next> EnumerateActiveVoices() { return {active_voices.first}; }
 
-    auto EnumerateActiveLayerVoices(VoiceProcessingController const& controller) {
-        return EnumerateVoices<true>(
-            [&controller](Voice const& v) { return !v.is_active || v.controller != &controller; });
-    }
+    // [audio-thread]
+    VoiceListIterable<&Voice::next_in_layer>
+    EnumerateActiveLayerVoices(VoiceProcessingController const& controller);
 
     template <typename Function>
     void ForActiveSamplesInActiveVoices(Function&& f) {
-        for (auto& v : voices) {
-            if (v.is_active) {
-                for (auto& s : v.voice_samples)
-                    if (s.is_active) f(v, s);
-            }
-        }
+        for (auto& v : EnumerateActiveVoices())
+            for (auto& s : v.voice_samples)
+                if (s.is_active) f(v, s);
     }
 
     void PrepareToPlay(ArenaAllocator& arena, AudioProcessingContext const& context);
     void EndAllVoicesInstantly();
 
-    u64 voice_age_counter = 0;
     u16 voice_id_counter = 0;
     Atomic<u32> num_active_voices = 0;
     Array<Voice, k_num_voices> voices {MakeInitialisedArray<Voice, k_num_voices>(*this)};
+
+    // Voices that end during ProcessVoices (possibly on a worker thread) stay in these lists until the end of
+    // ProcessVoices. At all other times the lists exactly match is_active.
+    Voice* free_voices {};
+    VoiceList active_voices {};
+    Array<VoiceList, k_num_layers> active_layer_voices {};
+
     Array<Span<f32>, k_num_voices> buffer_pool {};
 
     AtomicSwapBuffer<Array<VoiceWaveformMarkerForGui, k_num_voices>, true> voice_waveform_markers_for_gui {};
@@ -210,21 +208,27 @@ struct VoicePool {
     AtomicSwapBuffer<Array<VoiceEnvelopeMarkerForGui, k_num_voices>, true> voice_fil_env_markers_for_gui {};
     Array<Atomic<s16>, 128> voices_per_midi_note_for_gui {};
 
+    DiskStreamer disk_streamer {};
+
+    // [main-thread writes, audio-thread reads] Read once per chunk of each voice.
+    Atomic<InterpolationQuality> interpolation_quality {InterpolationQuality::Cubic};
+
+    // Used for rendering voices when the host doesn't provide a thread pool.
+    RealTimeWorkerPool worker_pool {};
+
     unsigned int random_seed = (unsigned)NanosecondsSinceEpoch();
 
     AudioProcessingContext const* audio_processing_context = nullptr; // temp for thread pool
 
     struct {
         u32 num_frames = 0;
+        u32 num_voices_per_task = 1;
+        DynamicArrayBounded<u16, k_num_voices> active_voice_indices {};
     } multithread_processing;
 };
 
-inline void EndVoiceInstantly(Voice& voice) {
-    ASSERT(voice.is_active);
-    voice.pool.num_active_voices.FetchSub(1, RmwMemoryOrder::Relaxed);
-    voice.pool.voices_per_midi_note_for_gui[voice.note_num].FetchSub(1, RmwMemoryOrder::Relaxed);
-    voice.is_active = false;
-}
+// [audio-thread]
+void EndVoiceInstantly(Voice& voice);
 void EndVoice(Voice& voice);
 
 void UpdateLFOWaveform(Voice& v);
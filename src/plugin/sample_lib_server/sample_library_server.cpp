@@ -22,6 +22,7 @@ namespace sample_lib_server {
 
 namespace detail {
 u64 HashLibraryRef(sample_lib::LibraryIdRef const& id) { return id.Hash(); }
+u64 HashLibraryPath(sample_lib::LibraryPath const& path) { return sample_lib::Hash(path); }
 } // namespace detail
 
 using namespace detail;
@@ -77,6 +78,7 @@ struct PendingLibraryJobs {
     ThreadPool& thread_pool;
     WorkSignaller& work_signaller;
     Atomic<u32>& num_uncompleted_jobs;
+    String library_cache_folder; // empty if there's no cache
 
     Mutex job_mutex;
     ArenaAllocator job_arena {PageAllocator::Instance()};
@@ -88,7 +90,9 @@ static void ReadLibraryAsync(PendingLibraryJobs& pending_library_jobs,
                              PathOrMemory path_or_memory,
                              sample_lib::FileFormat format);
 
-static void DoReadLibraryJob(PendingLibraryJobs::Job::ReadLibrary& job, ArenaAllocator& scratch_arena) {
+static void DoReadLibraryJob(PendingLibraryJobs::Job::ReadLibrary& job,
+                             String library_cache_folder,
+                             ArenaAllocator& scratch_arena) {
     ZoneScopedN("read library");
 
     auto const& args = job.args;
@@ -113,8 +117,36 @@ static void DoReadLibraryJob(PendingLibraryJobs::Job::ReadLibrary& job, ArenaAll
             }
         }
 
+        // Lua libraries are often unchanged since we last read them. Running the Lua is by far the slowest
+        // part so we try the cache first.
+        auto const use_cache = args.format == sample_lib::FileFormat::Lua &&
+                               args.path_or_memory.Is<String>() && library_cache_folder.size;
+        auto const cache_key = use_cache ? sample_lib::LibraryCacheKey(path, file_hash) : 0;
+        if (use_cache) {
+            auto const cached = sample_lib::ReadLibraryCache(library_cache_folder,
+                                                             cache_key,
+                                                             job.result.arena,
+                                                             scratch_arena);
+            if (cached.HasValue()) return cached.Value();
+            if (cached.Error() != FilesystemError::PathDoesNotExist)
+                LogWarning(ModuleName::SampleLibraryServer,
+                           "failed to read library cache for {}: {}",
+                           path,
+                           cached.Error());
+        }
+
         auto lib = TRY(sample_lib::Read(reader, args.format, path, job.result.arena, scratch_arena));
         lib->file_hash = file_hash;
+
+        if (use_cache) {
+            auto const outcome = sample_lib::WriteLibraryCache(library_cache_folder, cache_key, *lib);
+            if (outcome.HasError())
+                LogWarning(ModuleName::SampleLibraryServer,
+                           "failed to write library cache for {}: {}",
+                           path,
+                           outcome.Error());
+        }
+
         return lib;
     };
 
@@ -180,7 +212,9 @@ static void AddAsyncJob(PendingLibraryJobs& pending_library_jobs,
             ArenaAllocator scratch_arena {PageAllocator::Instance()};
             switch (job.data.tag) {
                 case PendingLibraryJobs::Job::Type::ReadLibrary: {
-                    DoReadLibraryJob(*job.data.Get<PendingLibraryJobs::Job::ReadLibrary*>(), scratch_arena);
+                    DoReadLibraryJob(*job.data.Get<PendingLibraryJobs::Job::ReadLibrary*>(),
+                                     pending_library_jobs.library_cache_folder,
+                                     scratch_arena);
                     break;
                 }
                 case PendingLibraryJobs::Job::Type::ScanFolder: {
@@ -665,12 +699,239 @@ static Optional<DirectoryWatcher> CreateDirectoryWatcher(ThreadsafeErrorNotifica
 
 using AudioDataAllocator = PageAllocator;
 
+// When disk streaming is enabled, only this many frames of an audio file are decoded into memory. The rest is
+// streamed by the voices that play it. This needs to cover the time it takes for the streaming thread to fill
+// the first window.
+constexpr u32 k_disk_streaming_resident_frames = 1 << 16;
+
+// Shared audio memory
+// Decoded audio can be put in memory that's shared between processes. Some hosts run each plugin instance in
+// its own process; this means they don't each need their own copy of the same samples. Each audio file has
+// its own shared memory: a header followed by the samples.
+//
+// The OS lock is only held for brief changes to the header, never while decoding: on Unix the lock gives up
+// waiting after a few seconds and forcibly unlocks, so a long hold would let other processes into the header
+// at the same time. Instead, a process claims the decoding by setting the Decoding state, decodes without
+// the lock, and then publishes the Ready state. Other processes poll the state until it's Ready.
+//
+// Rather than a plain count, the header records the process ID of each reference. A process that crashes
+// never releases its references, so whenever a process takes the lock to add or release a reference, it first
+// removes references from processes that no longer exist. Likewise, a Decoding state claimed by a process
+// that no longer exists is claimed again by the next process.
+//
+// Each shared audio file costs this process OS resources for as long as it's loaded: a mapping plus a
+// named semaphore on Unix (the shm fd is closed once mapped), or a mapping handle plus a mutex handle on
+// Windows. Named semaphores are scarce on macOS (kern.posix.sem.max is 10000 for the whole system) and each
+// mapping counts towards Linux's vm.max_map_count. Libraries can have thousands of files, so past a fixed
+// number per process we just decode into our own memory.
+
+constexpr usize k_max_shared_audio_users = 57;
+constexpr u32 k_max_shared_audio_memories_per_process = 1024;
+
+static Atomic<u32> g_num_shared_audio_memories {};
+
+struct SharedAudioHeader {
+    enum class State : u32 { Empty, Decoding, Ready };
+    Atomic<State> state; // initially 0: Empty
+    s32 decoder_pid; // the process decoding while in the Decoding state
+    u64 hash;
+    f32 sample_rate;
+    u32 num_frames;
+    u8 channels;
+    AudioSampleFormat sample_format;
+    u8 padding[2];
+    Array<s32, k_max_shared_audio_users> user_pids; // 0 for unused, can contain the same pid multiple times
+};
+static_assert(sizeof(SharedAudioHeader) == 256);
+
+static DynamicArrayBounded<char, 32> SharedAudioMemoryName(u64 key) {
+    return fmt::FormatInline<32>("floeaudio{x}", key);
+}
+
+// Must be called with the lock held.
+static void RemoveSharedAudioUsersThatNoLongerExist(SharedAudioHeader& header) {
+    auto const this_pid = CurrentProcessId();
+    for (auto& pid : header.user_pids)
+        if (pid && pid != this_pid && !ProcessIsRunning(pid)) pid = 0;
+}
+
+// Must be called with the lock held. Removes the name if no process uses the memory anymore.
+static void RemoveSharedAudioUser(SharedAudioHeader& header, u64 key) {
+    auto const this_pid = CurrentProcessId();
+    for (auto& pid : header.user_pids) {
+        if (pid == this_pid) {
+            pid = 0;
+            break;
+        }
+    }
+    RemoveSharedAudioUsersThatNoLongerExist(header);
+
+    for (auto const pid : header.user_pids)
+        if (pid) return;
+
+    // A process that has already opened this memory will see the Empty state and fill it again.
+    header.state.Store(SharedAudioHeader::State::Empty, StoreMemoryOrder::Release);
+    RemoveLockableSharedMemoryName(SharedAudioMemoryName(key));
+}
+
+static void CloseSharedAudioMemory(LockableSharedMemory& memory) {
+    CloseLockableSharedMemory(memory);
+    g_num_shared_audio_memories.FetchSub(1, RmwMemoryOrder::Relaxed);
+}
+
+static void ReleaseSharedAudioMemory(LockableSharedMemory& memory, u64 key) {
+    LockSharedMemory(memory);
+    RemoveSharedAudioUser(*(SharedAudioHeader*)memory.data.data, key);
+    UnlockSharedMemory(memory);
+    CloseSharedAudioMemory(memory);
+}
+
+struct SharedAudio {
+    AudioData audio_data;
+    Optional<LockableSharedMemory> memory; // not set if the audio was decoded into our own memory instead
+};
+
+// The decode function is called if no other process has already loaded the audio. info must match what
+// decode returns.
+static ErrorCodeOr<SharedAudio>
+AttachSharedAudioMemory(u64 key, AudioFileInfo const& info, FunctionRef<ErrorCodeOr<AudioData>()> decode) {
+    ZoneScoped;
+    using State = SharedAudioHeader::State;
+
+    if (g_num_shared_audio_memories.FetchAdd(1, RmwMemoryOrder::Relaxed) >=
+        k_max_shared_audio_memories_per_process) {
+        g_num_shared_audio_memories.FetchSub(1, RmwMemoryOrder::Relaxed);
+        return SharedAudio {.audio_data = TRY(decode())};
+    }
+
+    auto const num_sample_bytes =
+        (usize)info.num_frames * info.channels * BytesPerSample(info.sample_format);
+
+    auto const created =
+        CreateLockableSharedMemory(SharedAudioMemoryName(key), sizeof(SharedAudioHeader) + num_sample_bytes);
+    if (created.HasError()) {
+        g_num_shared_audio_memories.FetchSub(1, RmwMemoryOrder::Relaxed);
+        return created.Error();
+    }
+    auto memory = created.Value();
+    auto& header = *(SharedAudioHeader*)memory.data.data;
+    auto const samples = memory.data.SubSpan(sizeof(SharedAudioHeader));
+    auto const this_pid = CurrentProcessId();
+
+    // Add our reference. It stops the name being removed while we wait for or do the decoding.
+    {
+        LockSharedMemory(memory);
+        RemoveSharedAudioUsersThatNoLongerExist(header);
+        auto const slot = Find(header.user_pids, 0);
+        if (slot) header.user_pids[*slot] = this_pid;
+        UnlockSharedMemory(memory);
+
+        if (!slot) {
+            // Too many processes are using it; rare enough that we just use our own memory instead.
+            CloseSharedAudioMemory(memory);
+            return SharedAudio {.audio_data = TRY(decode())};
+        }
+    }
+
+    while (true) {
+        if (header.state.Load(LoadMemoryOrder::Acquire) == State::Ready) break;
+
+        bool claimed = false;
+        LockSharedMemory(memory);
+        switch (header.state.Load(LoadMemoryOrder::Acquire)) {
+            case State::Ready: break;
+            case State::Decoding:
+                if (ProcessIsRunning(header.decoder_pid)) break;
+                [[fallthrough]]; // the decoding process crashed
+            case State::Empty:
+                header.decoder_pid = this_pid;
+                header.state.Store(State::Decoding, StoreMemoryOrder::Release);
+                claimed = true;
+                break;
+        }
+        UnlockSharedMemory(memory);
+
+        if (!claimed) {
+            SleepThisThread(5);
+            continue;
+        }
+
+        // We own the memory until we set the Ready state, so there's no need for the lock.
+        auto decoded = decode();
+        if (decoded.HasValue()) {
+            auto const& d = decoded.Value();
+            if (d.channels != info.channels || d.num_frames != info.num_frames ||
+                d.sample_format != info.sample_format || d.interleaved_samples.size != samples.size) {
+                AudioDataAllocator::Instance().Free(d.interleaved_samples.ToByteSpan());
+                decoded = ErrorCode {AudioFileError::FileHasInvalidData};
+            }
+        }
+        if (decoded.HasError()) {
+            LockSharedMemory(memory);
+            header.decoder_pid = 0;
+            header.state.Store(State::Empty, StoreMemoryOrder::Release);
+            RemoveSharedAudioUser(header, key);
+            UnlockSharedMemory(memory);
+            CloseSharedAudioMemory(memory);
+            return decoded.Error();
+        }
+        DEFER { AudioDataAllocator::Instance().Free(decoded.Value().interleaved_samples.ToByteSpan()); };
+
+        CopyMemory(samples.data, decoded.Value().interleaved_samples.data, samples.size);
+        header.hash = decoded.Value().hash;
+        header.sample_rate = decoded.Value().sample_rate;
+        header.num_frames = decoded.Value().num_frames;
+        header.channels = decoded.Value().channels;
+        header.sample_format = decoded.Value().sample_format;
+
+        LockSharedMemory(memory);
+        header.decoder_pid = 0;
+        header.state.Store(State::Ready, StoreMemoryOrder::Release);
+        UnlockSharedMemory(memory);
+        break;
+    }
+
+    return SharedAudio {
+        .audio_data =
+            {
+                .hash = header.hash,
+                .channels = header.channels,
+                .sample_format = header.sample_format,
+                .sample_rate = header.sample_rate,
+                .num_frames = header.num_frames,
+                .interleaved_samples = samples,
+            },
+        .memory = memory,
+    };
+}
+
+static ErrorCodeOr<AudioData> LoadAudioIntoSharedMemory(ListedAudioData& audio_data,
+                                                        sample_lib::Library const& lib,
+                                                        u64 key,
+                                                        FunctionRef<ErrorCodeOr<AudioData>()> decode) {
+    auto const info = ({
+        auto decoder = TRY(CreateAudioFileStreamDecoder(TRY(lib.create_file_reader(lib, audio_data.path)),
+                                                        audio_data.path.str));
+        DEFER { DestroyAudioFileStreamDecoder(decoder); };
+        Info(*decoder);
+    });
+
+    auto shared = TRY(AttachSharedAudioMemory(key, info, decode));
+    if (shared.memory) {
+        audio_data.shared_audio_memory = shared.memory;
+        audio_data.shared_audio_memory_key = key;
+    }
+    return shared.audio_data;
+}
+
 ListedAudioData::~ListedAudioData() {
     ZoneScoped;
     auto const s = state.Load(LoadMemoryOrder::Relaxed);
     ASSERT(s == FileLoadingState::CompletedCancelled || s == FileLoadingState::CompletedWithError ||
            s == FileLoadingState::CompletedSucessfully);
-    if (audio_data.interleaved_samples.size)
+    if (shared_audio_memory)
+        ReleaseSharedAudioMemory(*shared_audio_memory, shared_audio_memory_key);
+    else if (audio_data.interleaved_samples.size)
         AudioDataAllocator::Instance().Free(audio_data.interleaved_samples.ToByteSpan());
     library_ref_count.FetchSub(1, RmwMemoryOrder::Relaxed);
 }
@@ -685,15 +946,24 @@ ListedImpulseResponse::~ListedImpulseResponse() {
     audio_data->ref_count.FetchSub(1, RmwMemoryOrder::Relaxed);
 }
 
+// Roughly 10 seconds at 48kHz; below this it's not worth the extra decoders.
+constexpr u32 k_parallel_decode_min_frames_per_task = 1 << 19;
+constexpr u32 k_parallel_decode_max_tasks = 8;
+
 // Just a little helper that we pass around when working with the thread pool.
 struct ThreadPoolArgs {
     ThreadPool& pool;
     AtomicCountdown& num_thread_pool_jobs;
     WorkSignaller& completed_signaller;
+    Optional<String> decoded_audio_cache_folder; // set if the cache is enabled
+    Atomic<bool>& decoded_audio_cache_needs_pruning;
+    Atomic<u32>& num_audio_loads_started;
+    bool use_shared_audio_memory;
 };
 
 static void
 LoadAudioAsync(ListedAudioData& audio_data, sample_lib::Library const& lib, ThreadPoolArgs thread_pool_args) {
+    thread_pool_args.num_audio_loads_started.FetchAdd(1, RmwMemoryOrder::Relaxed);
     thread_pool_args.num_thread_pool_jobs.Increase();
     thread_pool_args.pool.AddJob([&, thread_pool_args]() {
         try {
@@ -729,14 +999,86 @@ LoadAudioAsync(ListedAudioData& audio_data, sample_lib::Library const& lib, Thre
             // above, and the Release memory order at the end.
             ASSERT_EQ(audio_data.state.Load(LoadMemoryOrder::Relaxed), FileLoadingState::Loading);
 
-            auto const outcome = [&audio_data, &lib]() -> ErrorCodeOr<AudioData> {
+            auto const outcome = [&audio_data, &lib, &thread_pool_args]() -> ErrorCodeOr<AudioData> {
                 auto reader = TRY(lib.create_file_reader(lib, audio_data.path));
-                return DecodeAudioFile(reader, audio_data.path.str, AudioDataAllocator::Instance());
+                if (audio_data.allow_streaming)
+                    return DecodeAudioFileHead(Move(reader),
+                                               audio_data.path.str,
+                                               k_disk_streaming_resident_frames,
+                                               AudioDataAllocator::Instance());
+
+                auto const& cache_folder = thread_pool_args.decoded_audio_cache_folder;
+
+                // Identifies the file across sessions and processes.
+                Optional<u64> source_key {};
+                if (cache_folder || thread_pool_args.use_shared_audio_memory) {
+                    PathArena arena {Malloc::Instance()};
+                    auto const full_path = path::Join(arena, Array {lib.path, audio_data.path.str});
+                    source_key = DecodedAudioCacheKey(reader, full_path);
+                }
+
+                auto const decode = [&]() -> ErrorCodeOr<AudioData> {
+                    if (cache_folder && source_key) {
+                        auto cached =
+                            ReadDecodedAudioCache(*cache_folder, *source_key, AudioDataAllocator::Instance());
+                        if (cached.HasValue()) return cached.Value();
+                        if (cached.Error() != FilesystemError::PathDoesNotExist)
+                            LogWarning(ModuleName::SampleLibraryServer,
+                                       "failed to read decoded audio cache for {}: {}",
+                                       audio_data.path.str,
+                                       cached.Error());
+                    }
+
+                    // Big files such as long ambiences and IRs are split across the thread pool.
+                    auto decoded = TRY(DecodeAudioFileParallel(
+                        reader,
+                        audio_data.path.str,
+                        {
+                            .create_reader = [&]() { return lib.create_file_reader(lib, audio_data.path); },
+                            .parallel_for =
+                                [&](u32 num_tasks, FunctionRef<void(u32)> task) {
+                                    thread_pool_args.pool.ParallelFor(num_tasks, task);
+                                },
+                            .min_frames_per_task = k_parallel_decode_min_frames_per_task,
+                            .max_tasks = k_parallel_decode_max_tasks,
+                        },
+                        AudioDataAllocator::Instance()));
+
+                    // Written straight away on this thread; it's much quicker than the decoding we just did.
+                    if (cache_folder && source_key) {
+                        if (auto const o = WriteDecodedAudioCache(*cache_folder, *source_key, decoded);
+                            o.HasError())
+                            LogWarning(ModuleName::SampleLibraryServer,
+                                       "failed to write decoded audio cache for {}: {}",
+                                       audio_data.path.str,
+                                       o.Error());
+                        else
+                            thread_pool_args.decoded_audio_cache_needs_pruning.Store(
+                                true,
+                                StoreMemoryOrder::Relaxed);
+                    }
+                    return decoded;
+                };
+
+                if (thread_pool_args.use_shared_audio_memory && source_key)
+                    return LoadAudioIntoSharedMemory(audio_data, lib, *source_key, decode);
+                return decode();
             }();
 
             FileLoadingState result;
             if (outcome.HasValue()) {
                 audio_data.audio_data = outcome.Value();
+                if (audio_data.audio_data.NumResidentFrames() < audio_data.audio_data.num_frames) {
+                    audio_data.stream_source = {
+                        .create_reader = [](AudioDataStreamSource const& source) -> ErrorCodeOr<Reader> {
+                            auto const& lib = *(sample_lib::Library const*)source.user_data;
+                            return lib.create_file_reader(lib, {source.filepath_for_id});
+                        },
+                        .user_data = &lib,
+                        .filepath_for_id = audio_data.path.str,
+                    };
+                    audio_data.audio_data.stream_source = &audio_data.stream_source;
+                }
                 result = FileLoadingState::CompletedSucessfully;
             } else {
                 audio_data.error = outcome.Error();
@@ -783,11 +1125,15 @@ static void TriggerReloadIfAudioIsCancelled(ListedAudioData& audio_data,
 
 static ListedAudioData* FetchOrCreateAudioData(LibrariesList::Node& lib_node,
                                                sample_lib::LibraryPath path,
+                                               bool allow_streaming,
                                                ThreadPoolArgs thread_pool_args,
                                                u32 debug_inst_id) {
     auto const& lib = *lib_node.value.lib;
-    for (auto& d : lib_node.value.audio_datas) {
-        if (d.path == path && !d.file_modified) {
+    auto existing = lib_node.value.audio_datas_by_path.Find(path);
+    if (existing) {
+        auto& d = **existing;
+        // Fully-loaded audio can be used in place of streamed audio, but not the other way around.
+        if (!d.file_modified && (allow_streaming || !d.allow_streaming)) {
             TriggerReloadIfAudioIsCancelled(d, lib, thread_pool_args, debug_inst_id);
             return &d;
         }
@@ -798,6 +1144,8 @@ static ListedAudioData* FetchOrCreateAudioData(LibrariesList::Node& lib_node,
     ListedAudioData {
         .path = path,
         .file_modified = false,
+        .allow_streaming = allow_streaming,
+        .stream_source = {},
         .audio_data = {},
         .ref_count = 0u,
         .library_ref_count = lib_node.reader_uses,
@@ -806,31 +1154,39 @@ static ListedAudioData* FetchOrCreateAudioData(LibrariesList::Node& lib_node,
     };
     lib_node.reader_uses.FetchAdd(1, RmwMemoryOrder::Relaxed);
 
+    if (existing)
+        *existing = audio_data;
+    else
+        lib_node.value.audio_datas_by_path.Insert(path, audio_data);
+
     LoadAudioAsync(*audio_data, lib, thread_pool_args);
     return audio_data;
 }
 
 static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
                                                  sample_lib::Instrument const& inst,
+                                                 bool allow_streaming,
                                                  ThreadPoolArgs thread_pool_args) {
     auto& lib = lib_node.value;
     ASSERT_EQ(&inst.library, lib.lib);
 
-    for (auto& i : lib.instruments)
-        if (i.inst.instrument.name == inst.name) {
-            bool any_modified = false;
-            for (auto d : i.audio_data_set) {
-                if (d->file_modified) {
-                    any_modified = true;
-                    break;
-                }
+    auto existing = lib.instruments_by_name.Find(inst.name);
+    if (existing) {
+        auto& i = **existing;
+        bool any_modified = false;
+        for (auto d : i.audio_data_set) {
+            if (d->file_modified) {
+                any_modified = true;
+                break;
             }
-            if (any_modified) break;
+        }
 
+        if (!any_modified) {
             for (auto d : i.audio_data_set)
                 TriggerReloadIfAudioIsCancelled(*d, *lib.lib, thread_pool_args, i.debug_id);
             return &i;
         }
+    }
 
     static u32 g_inst_debug_id {};
 
@@ -841,6 +1197,10 @@ static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
         .inst = {inst},
         .ref_count = 0u,
     };
+    if (existing)
+        *existing = new_inst;
+    else
+        lib.instruments_by_name.Insert(inst.name, new_inst);
 
     DynamicArray<ListedAudioData*> audio_data_set {new_inst->arena};
 
@@ -850,14 +1210,18 @@ static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
         auto& region_info = inst.regions[region_index];
         auto& audio_data = new_inst->inst.audio_datas[region_index];
 
-        auto ref_audio_data =
-            FetchOrCreateAudioData(lib_node, region_info.path, thread_pool_args, new_inst->debug_id);
+        // The GUI waveform is drawn from the whole file so we don't stream it.
+        auto const is_waveform_file = inst.audio_file_path_for_waveform == region_info.path;
+        auto ref_audio_data = FetchOrCreateAudioData(lib_node,
+                                                     region_info.path,
+                                                     allow_streaming && !is_waveform_file,
+                                                     thread_pool_args,
+                                                     new_inst->debug_id);
         audio_data = &ref_audio_data->audio_data;
 
         dyn::AppendIfNotAlreadyThere(audio_data_set, ref_audio_data);
 
-        if (inst.audio_file_path_for_waveform == region_info.path)
-            new_inst->inst.file_for_gui_waveform = &ref_audio_data->audio_data;
+        if (is_waveform_file) new_inst->inst.file_for_gui_waveform = &ref_audio_data->audio_data;
     }
 
     for (auto d : audio_data_set)
@@ -866,13 +1230,16 @@ static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
     ASSERT(audio_data_set.size);
     new_inst->audio_data_set = audio_data_set.ToOwnedSpan();
 
+    new_inst->inst.region_lookup = sample_lib::BuildRegionLookupTable(inst, new_inst->arena);
+
     return new_inst;
 }
 
 static ListedImpulseResponse* FetchOrCreateImpulseResponse(LibrariesList::Node& lib_node,
                                                            sample_lib::ImpulseResponse const& ir,
                                                            ThreadPoolArgs thread_pool_args) {
-    auto audio_data = FetchOrCreateAudioData(lib_node, ir.path, thread_pool_args, 999999);
+    // Convolution needs the whole IR up-front so we never stream them.
+    auto audio_data = FetchOrCreateAudioData(lib_node, ir.path, false, thread_pool_args, 999999);
     audio_data->ref_count.FetchAdd(1, RmwMemoryOrder::Relaxed);
 
     auto new_ir = lib_node.value.irs.PrependUninitialised();
@@ -1054,7 +1421,14 @@ static bool UpdatePendingResources(PendingResources& pending_resources,
         .pool = server.thread_pool,
         .num_thread_pool_jobs = pending_resources.thread_pool_jobs,
         .completed_signaller = server.work_signaller,
+        .decoded_audio_cache_folder = k_nullopt,
+        .decoded_audio_cache_needs_pruning = server.decoded_audio_cache_needs_pruning,
+        .num_audio_loads_started = server.num_audio_loads_started,
+        .use_shared_audio_memory = server.shared_audio_memory_enabled.Load(LoadMemoryOrder::Relaxed),
     };
+    if (server.decoded_audio_cache_enabled.Load(LoadMemoryOrder::Relaxed) &&
+        server.decoded_audio_cache_folder.size)
+        thread_pool_args.decoded_audio_cache_folder = (String)server.decoded_audio_cache_folder;
 
     // Fill in library
     for (auto& pending_resource : pending_resources.list) {
@@ -1116,7 +1490,11 @@ static bool UpdatePendingResources(PendingResources& pending_resources,
                             .instrument_loading_percents[load_inst.layer_index]
                             .Store(0, StoreMemoryOrder::Relaxed);
 
-                        auto inst = FetchOrCreateInstrument(*lib, **i, thread_pool_args);
+                        auto inst = FetchOrCreateInstrument(
+                            *lib,
+                            **i,
+                            server.disk_streaming_enabled.Load(LoadMemoryOrder::Relaxed),
+                            thread_pool_args);
                         ASSERT(inst);
 
                         pending_resource.request.async_comms_channel.desired_inst[load_inst.layer_index] =
@@ -1397,7 +1775,15 @@ static void ServerThreadUpdateMetrics(Server& server) {
     server.total_bytes_used_by_samples.Store(total_bytes_used, StoreMemoryOrder::Relaxed);
 }
 
-static void RemoveUnreferencedObjects(Server& server) {
+static bool CanRetainUnreferencedAudio(ListedAudioData const& d) {
+    return !d.file_modified &&
+           d.state.Load(LoadMemoryOrder::Relaxed) == FileLoadingState::CompletedSucessfully;
+}
+
+// Unreferenced audio in the current libraries is kept while it fits in the retention budget, least-recently
+// used is removed first. This means that loading an instrument again shortly after it was unloaded (such as
+// when flipping between presets) doesn't need to decode all of its audio again.
+static void RemoveUnreferencedObjects(Server& server, ArenaAllocator& scratch_arena, bool retain_audio) {
     ZoneScoped;
     ASSERT_EQ(CurrentThreadId(), server.server_thread_id);
 
@@ -1405,23 +1791,119 @@ static void RemoveUnreferencedObjects(Server& server) {
         channels.RemoveIf([](AsyncCommsChannel const& h) { return !h.used.Load(LoadMemoryOrder::Relaxed); });
     });
 
-    auto remove_unreferenced_in_lib = [](auto& lib) {
-        auto remove_unreferenced = [](auto& list) {
-            list.RemoveIf([](auto const& n) { return n.ref_count.Load(LoadMemoryOrder::Relaxed) == 0; });
-        };
-        remove_unreferenced(lib.instruments);
-        remove_unreferenced(lib.irs);
-        remove_unreferenced(lib.audio_datas);
+    // The index is only updated if it points to the item being removed; it might point to a newer item with
+    // the same key.
+    auto remove_if = [](auto& list, auto&& should_remove, auto&& remove_from_index) {
+        list.RemoveIf([&](auto const& n) {
+            if (n.ref_count.Load(LoadMemoryOrder::Relaxed) != 0) return false;
+            if (!should_remove(n)) return false;
+            remove_from_index(n);
+            return true;
+        });
     };
+    auto const always = [](auto const&) { return true; };
+
+    // Remove instruments and IRs first because they hold references to audio.
+    auto remove_unreferenced_insts_and_irs = [&](ListedLibrary& lib) {
+        remove_if(lib.instruments, always, [&](ListedInstrument const& i) {
+            auto const& name = i.inst.instrument.name;
+            if (auto e = lib.instruments_by_name.Find(name); e && *e == &i)
+                lib.instruments_by_name.Delete(name);
+        });
+        remove_if(lib.irs, always, [](ListedImpulseResponse const&) {});
+    };
+    for (auto& l : server.libraries)
+        remove_unreferenced_insts_and_irs(l.value);
+    for (auto n = server.libraries.dead_list; n != nullptr; n = n->writer_next)
+        remove_unreferenced_insts_and_irs(n->value);
+
+    auto const pass = server.remove_unreferenced_pass.FetchAdd(1, RmwMemoryOrder::Release) + 1;
+
+    // Decide exactly which unreferenced audio to keep. Audio that was released together (a whole instrument
+    // or preset) shares a last_used_pass, so we can't just remove everything before a given pass: going
+    // slightly over budget would remove the whole of the most recently used preset.
+    if (retain_audio) {
+        auto const budget = server.retained_audio_budget_bytes.Load(LoadMemoryOrder::Relaxed);
+
+        DynamicArray<ListedAudioData*> retainable {scratch_arena};
+        u64 retained_bytes = 0;
+        for (auto& l : server.libraries) {
+            for (auto& d : l.value.audio_datas) {
+                // Anything that's referenced now, even if it's released before we get to removing, is kept
+                // for at least this pass.
+                d.keep_when_unreferenced = d.ref_count.Load(LoadMemoryOrder::Relaxed) != 0;
+                if (d.keep_when_unreferenced)
+                    d.last_used_pass = pass;
+                else if (CanRetainUnreferencedAudio(d)) {
+                    d.keep_when_unreferenced = true;
+                    dyn::Append(retainable, &d);
+                    retained_bytes += d.audio_data.RamUsageBytes();
+                }
+            }
+        }
 
+        // Least-recently used first. Ties are broken by hash so that the choice is deterministic.
+        Sort(retainable, [](ListedAudioData const* a, ListedAudioData const* b) {
+            if (a->last_used_pass != b->last_used_pass) return a->last_used_pass < b->last_used_pass;
+            return a->audio_data.hash < b->audio_data.hash;
+        });
+        for (auto d : retainable) {
+            if (retained_bytes <= budget) break;
+            retained_bytes -= d->audio_data.RamUsageBytes();
+            d->keep_when_unreferenced = false;
+        }
+    }
+
+    auto remove_unreferenced_audio = [&](ListedLibrary& lib, bool is_current_library) {
+        remove_if(
+            lib.audio_datas,
+            [&](ListedAudioData const& d) {
+                return !retain_audio || !is_current_library || !d.keep_when_unreferenced ||
+                       !CanRetainUnreferencedAudio(d);
+            },
+            [&](ListedAudioData const& d) {
+                if (auto e = lib.audio_datas_by_path.Find(d.path); e && *e == &d)
+                    lib.audio_datas_by_path.Delete(d.path);
+            });
+    };
     for (auto& l : server.libraries)
-        remove_unreferenced_in_lib(l.value);
+        remove_unreferenced_audio(l.value, true);
     for (auto n = server.libraries.dead_list; n != nullptr; n = n->writer_next)
-        remove_unreferenced_in_lib(n->value);
+        remove_unreferenced_audio(n->value, false);
 
     server.libraries.DeleteRemovedAndUnreferenced();
 }
 
+// After a scan, every library that has an up-to-date cache entry is in server.libraries. Anything else in
+// the cache is for a library that has since changed or been removed.
+static void PruneLibraryCacheAfterScan(Server& server, ArenaAllocator& scratch_arena) {
+    if (!server.library_cache_folder.size) return;
+    DynamicArray<u64> keys_in_use {scratch_arena};
+    for (auto& node : server.libraries) {
+        auto const& lib = *node.value.lib;
+        if (lib.file_format_specifics.tag != sample_lib::FileFormat::Lua) continue;
+        dyn::Append(keys_in_use, sample_lib::LibraryCacheKey(lib.path, lib.file_hash));
+    }
+    auto const outcome =
+        sample_lib::PruneLibraryCache(server.library_cache_folder, keys_in_use, scratch_arena);
+    if (outcome.HasError())
+        LogWarning(ModuleName::SampleLibraryServer, "failed to prune library cache: {}", outcome.Error());
+}
+
+// We prune after a batch of loading rather than after each write because it has to list the whole folder.
+static void PruneDecodedAudioCacheIfNeeded(Server& server, ArenaAllocator& scratch_arena) {
+    if (!server.decoded_audio_cache_folder.size) return;
+    if (!server.decoded_audio_cache_needs_pruning.Exchange(false, RmwMemoryOrder::Relaxed)) return;
+    auto const outcome =
+        PruneDecodedAudioCache(server.decoded_audio_cache_folder,
+                               server.decoded_audio_cache_budget_bytes.Load(LoadMemoryOrder::Relaxed),
+                               scratch_arena);
+    if (outcome.HasError())
+        LogWarning(ModuleName::SampleLibraryServer,
+                   "failed to prune decoded audio cache: {}",
+                   outcome.Error());
+}
+
 static void ServerThreadProc(Server& server) {
     ZoneScoped;
 
@@ -1443,6 +1925,7 @@ static void ServerThreadProc(Server& server) {
             .thread_pool = server.thread_pool,
             .work_signaller = server.work_signaller,
             .num_uncompleted_jobs = server.num_uncompleted_library_jobs,
+            .library_cache_folder = server.library_cache_folder,
         };
 
         while (true) {
@@ -1485,7 +1968,8 @@ static void ServerThreadProc(Server& server) {
             auto const libraries_are_still_loading =
                 UpdateLibraryJobs(server, pending_library_jobs, scratch_arena, watcher);
             if (!libraries_are_still_loading) {
-                server.is_scanning_libraries.Store(false, StoreMemoryOrder::Relaxed);
+                if (server.is_scanning_libraries.Exchange(false, RmwMemoryOrder::Relaxed))
+                    PruneLibraryCacheAfterScan(server, scratch_arena);
                 WakeWaitingThreads(server.is_scanning_libraries, NumWaitingThreads::All);
             }
 
@@ -1505,13 +1989,14 @@ static void ServerThreadProc(Server& server) {
         // thread pool. We need for them to finish before we potentially delete the memory that they rely on.
         pending_resources.thread_pool_jobs.WaitUntilZero();
 
-        RemoveUnreferencedObjects(server);
+        RemoveUnreferencedObjects(server, scratch_arena, true);
+        PruneDecodedAudioCacheIfNeeded(server, scratch_arena);
         scratch_arena.ResetCursorAndConsolidateRegions();
     }
 
     // It's necessary to do this at the end of this function because it is not guaranteed to be called in the
     // loop; the 'end' boolean can be changed at a point where the loop ends before calling this.
-    RemoveUnreferencedObjects(server);
+    RemoveUnreferencedObjects(server, scratch_arena, false);
 
     server.libraries.RemoveAll();
     server.libraries.DeleteRemovedAndUnreferenced();
@@ -1601,6 +2086,20 @@ Server::Server(ThreadPool& pool,
                ThreadsafeErrorNotifications& error_notifications)
     : error_notifications(error_notifications)
     , thread_pool(pool) {
+    {
+        PathArena path_arena {Malloc::Instance()};
+        dyn::Assign(decoded_audio_cache_folder,
+                    FloeKnownDirectory(path_arena,
+                                       FloeKnownDirectoryType::Cache,
+                                       "decoded-audio"_s,
+                                       {.create = false}));
+        dyn::Assign(library_cache_folder,
+                    FloeKnownDirectory(path_arena,
+                                       FloeKnownDirectoryType::Cache,
+                                       "libraries"_s,
+                                       {.create = false}));
+    }
+
     if (always_scanned_folder.size) {
         ArenaAllocatorWithInlineStorage<1000> scratch_arena {Malloc::Instance()};
         auto node = scan_folders.AllocateUninitialised();
@@ -1735,6 +2234,121 @@ void SetExtraScanFolders(Server& server, Span<String const> extra_folders) {
     }
 }
 
+prefs::Descriptor SettingDescriptor(ServerSetting setting) {
+    ASSERT(CheckThreadName("main"));
+    switch (setting) {
+        case ServerSetting::DiskStreaming:
+            return {
+                .key = "disk-streaming"_s,
+                .value_requirements = prefs::ValueType::Bool,
+                .default_value = false,
+                .gui_label = "Stream long samples from disk",
+                .long_description =
+                    "Only keep the start of long samples in memory and read the rest from disk as they play. "
+                    "Reduces memory usage but needs a fast disk. Applies to instruments loaded afterwards.",
+            };
+        case ServerSetting::RetainedSampleMemoryMb:
+            return {
+                .key = "retained-sample-memory-mb"_s,
+                .value_requirements =
+                    prefs::Descriptor::IntRequirements {
+                        .validator =
+                            [](s64& value) {
+                                value = Clamp<s64>(value, 0, 32 * 1024);
+                                return true;
+                            },
+                    },
+                .default_value = (s64)512,
+                .gui_label = "Memory for recently unloaded samples (MB)",
+                .long_description =
+                    "Keep samples that are no longer used in memory, up to this size, so that loading them "
+                    "again is instant. Useful when switching back and forth between presets. 0 disables it.",
+            };
+        case ServerSetting::DecodedAudioCache:
+            return {
+                .key = "decoded-audio-cache"_s,
+                .value_requirements = prefs::ValueType::Bool,
+                .default_value = false,
+                .gui_label = "Cache decoded samples on disk",
+                .long_description =
+                    "Save samples in a ready-to-use form the first time they're loaded so that loading them "
+                    "again is much faster. Uses more disk space than the original sample library.",
+            };
+        case ServerSetting::DecodedAudioCacheSizeMb:
+            return {
+                .key = "decoded-audio-cache-size-mb"_s,
+                .value_requirements =
+                    prefs::Descriptor::IntRequirements {
+                        .validator =
+                            [](s64& value) {
+                                value = Clamp<s64>(value, 0, 1024 * 1024);
+                                return true;
+                            },
+                    },
+                .default_value = (s64)4096,
+                .gui_label = "Disk space for cached samples (MB)",
+                .long_description =
+                    "The most disk space that cached samples can use. When it's full, the samples that were "
+                    "used least recently are removed from the cache.",
+            };
+        case ServerSetting::SharedAudioMemory:
+            return {
+                .key = "shared-audio-memory"_s,
+                .value_requirements = prefs::ValueType::Bool,
+                .default_value = false,
+                .gui_label = "Share samples between plugin processes",
+                .long_description =
+                    "If your DAW runs each plugin in its own process (sandboxing), load samples into memory "
+                    "that all of the Floe processes can use rather than each process having its own copy.",
+            };
+        case ServerSetting::Count: PanicIfReached();
+    }
+}
+
+static void SetDecodedAudioCacheBudget(Server& server, s64 megabytes) {
+    server.decoded_audio_cache_budget_bytes.Store((u64)megabytes * 1024 * 1024, StoreMemoryOrder::Relaxed);
+    server.decoded_audio_cache_needs_pruning.Store(true, StoreMemoryOrder::Relaxed);
+    server.work_signaller.Signal();
+}
+
+static void SetRetainedAudioBudget(Server& server, s64 megabytes) {
+    server.retained_audio_budget_bytes.Store((u64)megabytes * 1024 * 1024, StoreMemoryOrder::Relaxed);
+    server.work_signaller.Signal();
+}
+
+void ApplyPreferences(Server& server, prefs::PreferencesTable const& prefs) {
+    ASSERT(CheckThreadName("main"));
+    auto const enabled = prefs::GetBool(prefs, SettingDescriptor(ServerSetting::DiskStreaming));
+    server.disk_streaming_enabled.Store(enabled, StoreMemoryOrder::Relaxed);
+    SetRetainedAudioBudget(server,
+                           prefs::GetInt(prefs, SettingDescriptor(ServerSetting::RetainedSampleMemoryMb)));
+    server.decoded_audio_cache_enabled.Store(
+        prefs::GetBool(prefs, SettingDescriptor(ServerSetting::DecodedAudioCache)),
+        StoreMemoryOrder::Relaxed);
+    SetDecodedAudioCacheBudget(
+        server,
+        prefs::GetInt(prefs, SettingDescriptor(ServerSetting::DecodedAudioCacheSizeMb)));
+    server.shared_audio_memory_enabled.Store(
+        prefs::GetBool(prefs, SettingDescriptor(ServerSetting::SharedAudioMemory)),
+        StoreMemoryOrder::Relaxed);
+}
+
+void OnPreferenceChanged(Server& server, prefs::Key const& key, prefs::Value const* value) {
+    ASSERT(CheckThreadName("main"));
+    if (auto const v = prefs::MatchBool(key, value, SettingDescriptor(ServerSetting::DiskStreaming)))
+        server.disk_streaming_enabled.Store(*v, StoreMemoryOrder::Relaxed);
+    else if (auto const v =
+                 prefs::MatchInt(key, value, SettingDescriptor(ServerSetting::RetainedSampleMemoryMb)))
+        SetRetainedAudioBudget(server, *v);
+    else if (auto const v = prefs::MatchBool(key, value, SettingDescriptor(ServerSetting::DecodedAudioCache)))
+        server.decoded_audio_cache_enabled.Store(*v, StoreMemoryOrder::Relaxed);
+    else if (auto const v =
+                 prefs::MatchInt(key, value, SettingDescriptor(ServerSetting::DecodedAudioCacheSizeMb)))
+        SetDecodedAudioCacheBudget(server, *v);
+    else if (auto const v = prefs::MatchBool(key, value, SettingDescriptor(ServerSetting::SharedAudioMemory)))
+        server.shared_audio_memory_enabled.Store(*v, StoreMemoryOrder::Relaxed);
+}
+
 Span<RefCounted<sample_lib::Library>> AllLibrariesRetained(Server& server, ArenaAllocator& arena) {
     // IMPROVE: is this slow to do at every request for a library?
     RequestScanningOfUnscannedFolders(server);
@@ -2215,6 +2829,95 @@ TEST_CASE(TestSampleLibraryLoader) {
         }
     }
 
+    SUBCASE("unreferenced audio is retained up to the budget") {
+        AtomicCountdown countdown {0};
+        auto& channel = OpenAsyncCommsChannel(server,
+                                              {
+                                                  .error_notifications = fixture.error_notif,
+                                                  .result_added_callback = [&]() { countdown.CountDown(); },
+                                                  .library_changed_callback = [](sample_lib::LibraryIdRef) {},
+                                              });
+        DEFER { CloseAsyncCommsChannel(server, channel); };
+
+        LoadRequest const inst_requests[] {
+            LoadRequestInstrumentIdWithLayer {
+                .id = {.library = {{
+                           .author = sample_lib::k_mdata_library_author,
+                           .name = "SharedFilesMdata"_s,
+                       }},
+                       .inst_name = "Single Sample"_s},
+                .layer_index = 0,
+            },
+            LoadRequestInstrumentIdWithLayer {
+                .id = {.library = {{.author = "Tester"_s, .name = "Test Lua"_s}},
+                       .inst_name = "Single Sample"_s},
+                .layer_index = 1,
+            },
+        };
+
+        auto const load_both = [&]() {
+            countdown.Increase(2);
+            RequestId ids[2];
+            for (auto const i : Range(2u))
+                ids[i] = SendAsyncLoadRequest(server, channel, inst_requests[i]);
+            REQUIRE(countdown.WaitUntilZero(15000u) != WaitResult::TimedOut);
+
+            Array<RefCounted<sample_lib::LoadedInstrument>, 2> insts {};
+            while (auto r = channel.results.TryPop()) {
+                DEFER { r->Release(); };
+                for (auto const i : Range(2u)) {
+                    if (r->id != ids[i]) continue;
+                    using Inst = RefCounted<sample_lib::LoadedInstrument>;
+                    insts[i].Assign(ExtractSuccess<Inst>(tester, *r, inst_requests[i]));
+                }
+            }
+            for (auto const& i : insts) {
+                REQUIRE(i);
+                REQUIRE_EQ(i->audio_datas.size, 1u);
+            }
+            return insts;
+        };
+
+        auto first = load_both();
+        AudioData const* first_audio[] {first[0]->audio_datas[0], first[1]->audio_datas[0]};
+
+        // Room for either of them, but not both.
+        server.retained_audio_budget_bytes.Store(
+            Max(first_audio[0]->RamUsageBytes(), first_audio[1]->RamUsageBytes()),
+            StoreMemoryOrder::Relaxed);
+
+        // Released together, so both were last used in the same pass.
+        for (auto const& i : first)
+            i.Release();
+
+        // Wait for a whole removal pass that started after the release. Requests for a library that doesn't
+        // exist keep the server thread looping.
+        auto const target_pass = server.remove_unreferenced_pass.Load(LoadMemoryOrder::Acquire) + 2;
+        while (server.remove_unreferenced_pass.Load(LoadMemoryOrder::Acquire) < target_pass) {
+            countdown.Increase();
+            SendAsyncLoadRequest(server,
+                                 channel,
+                                 LoadRequestInstrumentIdWithLayer {
+                                     .id = {.library = {{.author = "foo"_s, .name = "bar"_s}},
+                                            .inst_name = "bar"_s},
+                                     .layer_index = 0,
+                                 });
+            REQUIRE(countdown.WaitUntilZero(15000u) != WaitResult::TimedOut);
+            while (auto r = channel.results.TryPop())
+                r->Release();
+        }
+
+        // Exactly one was kept, so only the other needs loading again.
+        auto const loads_before = server.num_audio_loads_started.Load(LoadMemoryOrder::Relaxed);
+        auto second = load_both();
+        CHECK_EQ(server.num_audio_loads_started.Load(LoadMemoryOrder::Relaxed) - loads_before, 1u);
+        auto const num_reused = (u32)(second[0]->audio_datas[0] == first_audio[0]) +
+                                (u32)(second[1]->audio_datas[0] == first_audio[1]);
+        CHECK_EQ(num_reused, 1u);
+        for (auto const& i : second)
+            i.Release();
+    }
+
     SUBCASE("randomly send lots of requests") {
         sample_lib::InstrumentId const inst_ids[] {
             {
@@ -2300,8 +3003,139 @@ TEST_CASE(TestSampleLibraryLoader) {
     return k_success;
 }
 
+TEST_CASE(TestSharedAudioMemory) {
+    constexpr AudioFileInfo k_info {
+        .hash = 1234,
+        .channels = 1,
+        .sample_format = AudioSampleFormat::Float32,
+        .sample_rate = 44100,
+        .num_frames = 64,
+    };
+    // Larger than any real process ID.
+    constexpr s32 k_dead_pid = 0x7ffffff0;
+    REQUIRE(!ProcessIsRunning(k_dead_pid));
+
+    // Unique to this process so that concurrent test runs don't share memory.
+    u64 const key = ((u64)CurrentProcessId() << 32) | tester.random_seed % 0xffffffff;
+    auto const name = SharedAudioMemoryName(key);
+    auto const memory_size = sizeof(SharedAudioHeader) + (k_info.num_frames * sizeof(f32));
+    auto const num_memories_before = g_num_shared_audio_memories.Load(LoadMemoryOrder::Relaxed);
+
+    u32 num_decodes = 0;
+    auto const decode = [&]() -> ErrorCodeOr<AudioData> {
+        ++num_decodes;
+        auto const samples = AudioDataAllocator::Instance().AllocateExactSizeUninitialised<u8>(
+            k_info.num_frames * sizeof(f32));
+        for (auto const i : Range(k_info.num_frames))
+            ((f32*)samples.data)[i] = (f32)i;
+        return AudioData {
+            .hash = k_info.hash,
+            .channels = k_info.channels,
+            .sample_format = k_info.sample_format,
+            .sample_rate = k_info.sample_rate,
+            .num_frames = k_info.num_frames,
+            .interleaved_samples = samples,
+        };
+    };
+
+    auto const check_samples = [&](AudioData const& d) {
+        CHECK_EQ(d.hash, k_info.hash);
+        CHECK_EQ(d.num_frames, k_info.num_frames);
+        REQUIRE_EQ(d.interleaved_samples.size, k_info.num_frames * sizeof(f32));
+        auto const last = ((f32 const*)d.interleaved_samples.data)[k_info.num_frames - 1];
+        CHECK_EQ(last, (f32)(k_info.num_frames - 1));
+    };
+
+    // Sets up the header as if another process had got there first.
+    auto const edit_header = [&](auto&& edit) -> ErrorCodeOr<void> {
+        auto memory = TRY(CreateLockableSharedMemory(name, memory_size));
+        LockSharedMemory(memory);
+        edit(*(SharedAudioHeader*)memory.data.data);
+        UnlockSharedMemory(memory);
+        CloseLockableSharedMemory(memory);
+        return k_success;
+    };
+
+    auto const num_users = [](SharedAudioHeader const& header, s32 pid) {
+        u32 n = 0;
+        for (auto const p : header.user_pids)
+            if (p == pid) ++n;
+        return n;
+    };
+
+    SUBCASE("second attach reuses ready memory") {
+        auto a = TRY(AttachSharedAudioMemory(key, k_info, decode));
+        REQUIRE(a.memory);
+        auto b = TRY(AttachSharedAudioMemory(key, k_info, decode));
+        REQUIRE(b.memory);
+        CHECK_EQ(num_decodes, 1u);
+        check_samples(a.audio_data);
+        check_samples(b.audio_data);
+
+        auto const& header = *(SharedAudioHeader const*)b.memory->data.data;
+        CHECK_EQ(header.state.Load(LoadMemoryOrder::Acquire), SharedAudioHeader::State::Ready);
+        CHECK_EQ(num_users(header, CurrentProcessId()), 2u);
+
+        ReleaseSharedAudioMemory(*a.memory, key);
+        ReleaseSharedAudioMemory(*b.memory, key);
+
+        // The last user removed the name, so it starts again from empty.
+        auto c = TRY(AttachSharedAudioMemory(key, k_info, decode));
+        REQUIRE(c.memory);
+        CHECK_EQ(num_decodes, 2u);
+        ReleaseSharedAudioMemory(*c.memory, key);
+    }
+
+    SUBCASE("decoding claimed by a dead process is reclaimed") {
+        TRY(edit_header([&](SharedAudioHeader& header) {
+            header.user_pids[0] = k_dead_pid;
+            header.decoder_pid = k_dead_pid;
+            header.state.Store(SharedAudioHeader::State::Decoding, StoreMemoryOrder::Release);
+        }));
+
+        auto a = TRY(AttachSharedAudioMemory(key, k_info, decode));
+        REQUIRE(a.memory);
+        CHECK_EQ(num_decodes, 1u);
+        check_samples(a.audio_data);
+
+        auto const& header = *(SharedAudioHeader const*)a.memory->data.data;
+        CHECK_EQ(header.state.Load(LoadMemoryOrder::Acquire), SharedAudioHeader::State::Ready);
+        CHECK_EQ(header.decoder_pid, 0);
+        CHECK_EQ(num_users(header, k_dead_pid), 0u);
+        CHECK_EQ(num_users(header, CurrentProcessId()), 1u);
+
+        ReleaseSharedAudioMemory(*a.memory, key);
+    }
+
+    SUBCASE("full user table falls back to our own memory") {
+        auto const this_pid = CurrentProcessId();
+        TRY(edit_header([&](SharedAudioHeader& header) {
+            for (auto& p : header.user_pids)
+                p = this_pid;
+        }));
+        DEFER {
+            auto _ = edit_header([&](SharedAudioHeader& header) {
+                for (auto& p : header.user_pids)
+                    p = 0;
+            });
+            RemoveLockableSharedMemoryName(name);
+        };
+
+        auto a = TRY(AttachSharedAudioMemory(key, k_info, decode));
+        CHECK(!a.memory);
+        CHECK_EQ(num_decodes, 1u);
+        check_samples(a.audio_data);
+        AudioDataAllocator::Instance().Free(a.audio_data.interleaved_samples.ToByteSpan());
+    }
+
+    CHECK_EQ(g_num_shared_audio_memories.Load(LoadMemoryOrder::Relaxed), num_memories_before);
+
+    return k_success;
+}
+
 } // namespace sample_lib_server
 
 TEST_REGISTRATION(RegisterSampleLibraryLoaderTests) {
     REGISTER_TEST(sample_lib_server::TestSampleLibraryLoader);
+    REGISTER_TEST(sample_lib_server::TestSharedAudioMemory);
 }
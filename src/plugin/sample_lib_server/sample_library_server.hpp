@@ -3,6 +3,7 @@
 
 #pragma once
 #include "foundation/foundation.hpp"
+#include "os/misc.hpp"
 #include "os/threading.hpp"
 #include "utils/error_notifications.hpp"
 #include "utils/thread_extra/atomic_ref_list.hpp"
@@ -11,6 +12,7 @@
 
 #include "common_infrastructure/audio_data.hpp"
 #include "common_infrastructure/constants.hpp"
+#include "common_infrastructure/preferences.hpp"
 #include "common_infrastructure/sample_library/sample_library.hpp"
 
 // Sample library server
@@ -165,11 +167,17 @@ struct ListedAudioData {
 
     sample_lib::LibraryPath path;
     bool file_modified {};
+    bool allow_streaming {}; // only the head of the file is decoded if it's large
+    AudioDataStreamSource stream_source {};
     AudioData audio_data;
     Atomic<u32> ref_count {};
     Atomic<u32>& library_ref_count;
     Atomic<FileLoadingState> state {FileLoadingState::PendingLoad};
     Optional<ErrorCode> error {};
+    u64 last_used_pass {}; // server-thread, for deciding what to keep once unreferenced
+    bool keep_when_unreferenced {}; // server-thread, decided each pass
+    Optional<LockableSharedMemory> shared_audio_memory {}; // set if the samples are in shared memory
+    u64 shared_audio_memory_key {};
 };
 
 struct ListedInstrument {
@@ -190,6 +198,8 @@ struct ListedImpulseResponse {
     Atomic<u32> ref_count {};
 };
 
+u64 HashLibraryPath(sample_lib::LibraryPath const& path);
+
 struct ListedLibrary {
     ~ListedLibrary() { ASSERT(instruments.Empty(), "missing instrument dereference"); }
 
@@ -200,6 +210,13 @@ struct ListedLibrary {
     ArenaList<ListedAudioData, false> audio_datas {arena};
     ArenaList<ListedInstrument, false> instruments {arena};
     ArenaList<ListedImpulseResponse, false> irs {arena};
+
+    // Lookups into the lists above. There can be more than one item with the same key, for example when a
+    // file has been modified. The index always points to the most recently created one: older ones are never
+    // reused.
+    DynamicHashTable<sample_lib::LibraryPath, ListedAudioData*, HashLibraryPath> audio_datas_by_path {
+        Malloc::Instance()};
+    DynamicHashTable<String, ListedInstrument*> instruments_by_name {Malloc::Instance()};
 };
 
 using LibrariesList = AtomicRefList<ListedLibrary>;
@@ -237,7 +254,13 @@ struct Server {
     Atomic<u64> total_bytes_used_by_samples {};
     Atomic<u32> num_insts_loaded {};
     Atomic<u32> num_samples_loaded {};
+    Atomic<u32> num_audio_loads_started {};
     Atomic<u32> is_scanning_libraries {}; // you can use WaitIfValueIsExpected
+    Atomic<bool> disk_streaming_enabled {};
+    Atomic<u64> retained_audio_budget_bytes {};
+    Atomic<bool> decoded_audio_cache_enabled {};
+    Atomic<u64> decoded_audio_cache_budget_bytes {};
+    Atomic<bool> shared_audio_memory_enabled {};
 
     // private
     Mutex scan_folders_writer_mutex;
@@ -255,6 +278,10 @@ struct Server {
     MutexProtected<ArenaList<AsyncCommsChannel, true>> channels {Malloc::Instance()};
     Thread thread {};
     u64 server_thread_id {};
+    Atomic<u64> remove_unreferenced_pass {}; // only written by the server-thread
+    DynamicArray<char> decoded_audio_cache_folder {Malloc::Instance()}; // constant after construction
+    Atomic<bool> decoded_audio_cache_needs_pruning {false};
+    DynamicArray<char> library_cache_folder {Malloc::Instance()}; // constant after construction
     Atomic<bool> end_thread {false};
     ThreadsafeQueue<detail::QueuedRequest> request_queue {PageAllocator::Instance()};
     WorkSignaller work_signaller {};
@@ -263,6 +290,22 @@ struct Server {
 
 // IMPROVE: we can set limits: we know there's only going to be k_max_num_floe_instances.
 
+enum class ServerSetting : u8 {
+    DiskStreaming,
+    RetainedSampleMemoryMb,
+    DecodedAudioCache,
+    DecodedAudioCacheSizeMb,
+    SharedAudioMemory,
+    Count,
+};
+
+// Use with prefs::SetValue, prefs::GetValue
+prefs::Descriptor SettingDescriptor(ServerSetting setting);
+
+// [main-thread]
+void ApplyPreferences(Server& server, prefs::PreferencesTable const& prefs);
+void OnPreferenceChanged(Server& server, prefs::Key const& key, prefs::Value const* value);
+
 // The server owns the channel, you just get a reference to it that will be valid until you close it. The
 // callback will be called whenever a request from this channel is completed. If you want to keep any of
 // the resources that are contained in the LoadResult, you must 'retain' them in the callback. You can release
@@ -1177,6 +1177,26 @@ TEST_CASE(TestLockableSharedMemory) {
         UnlockSharedMemory(mem2);
     }
 
+    SUBCASE("Closing and removing the name") {
+        constexpr usize k_size = 1024;
+        auto mem1 = TRY(CreateLockableSharedMemory("test3"_s, k_size));
+        mem1.data[0] = 1;
+        RemoveLockableSharedMemoryName("test3"_s);
+        CloseLockableSharedMemory(mem1);
+        CHECK_EQ(mem1.data.size, 0u);
+
+        auto mem2 = TRY(CreateLockableSharedMemory("test3"_s, k_size));
+        CHECK_EQ(mem2.data[0], 0);
+        RemoveLockableSharedMemoryName("test3"_s);
+        CloseLockableSharedMemory(mem2);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestProcessIsRunning) {
+    CHECK(ProcessIsRunning(CurrentProcessId()));
+    CHECK(!ProcessIsRunning(0));
     return k_success;
 }
 
@@ -1304,6 +1324,7 @@ TEST_REGISTRATION(RegisterOsTests) {
     REGISTER_TEST(TestGetInfo);
     REGISTER_TEST(TestIsRunningUnderDebugger);
     REGISTER_TEST(TestLockableSharedMemory);
+    REGISTER_TEST(TestProcessIsRunning);
     REGISTER_TEST(TestMutex);
     REGISTER_TEST(TestOsRandom);
     REGISTER_TEST(TestThread);
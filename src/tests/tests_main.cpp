@@ -18,21 +18,27 @@
     X(RegisterAudioUtilsTests)                                                                               \
     X(RegisterAutosaveTests)                                                                                 \
     X(RegisterChecksumFileTests)                                                                             \
+    X(RegisterDiskStreamingTests)                                                                            \
+    X(RegisterEffectConvoTests)                                                                              \
     X(RegisterFoundationTests)                                                                               \
     X(RegisterHostingTests)                                                                                  \
     X(RegisterLayoutTests)                                                                                   \
     X(RegisterLibraryLuaTests)                                                                               \
     X(RegisterLibraryMdataTests)                                                                             \
     X(RegisterLogRingBufferTests)                                                                            \
+    X(RegisterMidiTests)                                                                                     \
     X(RegisterOsTests)                                                                                       \
     X(RegisterPackageFormatTests)                                                                            \
     X(RegisterPackageInstallationTests)                                                                      \
     X(RegisterParamDescriptorTests)                                                                          \
     X(RegisterPreferencesTests)                                                                              \
+    X(RegisterPresetServerTests)                                                                             \
     X(RegisterSampleLibraryLoaderTests)                                                                      \
+    X(RegisterSampleProcessingTests)                                                                         \
     X(RegisterSentryTests)                                                                                   \
     X(RegisterStateCodingTests)                                                                              \
     X(RegisterUtilsTests)                                                                                    \
+    X(RegisterVoicesTests)                                                                                   \
     X(RegisterVolumeFadeTests)
 
 #define WINDOWS_FP_TEST_REGISTER_FUNCTIONS X(RegisterWindowsSpecificTests)
@@ -11,6 +11,8 @@
 #include "utils/leak_detecting_allocator.hpp"
 #include "utils/thread_extra/atomic_queue.hpp"
 #include "utils/thread_extra/atomic_swap_buffer.hpp"
+#include "utils/thread_extra/realtime_worker_pool.hpp"
+#include "utils/thread_extra/thread_pool.hpp"
 
 TEST_CASE(TestParseCommandLineArgs) {
     auto& a = tester.scratch_arena;
@@ -539,6 +541,143 @@ TEST_CASE(TestAtomicQueue) {
     return k_success;
 }
 
+TEST_CASE(TestThreadPoolParallelFor) {
+    constexpr u32 k_num_tasks = 200;
+    Array<Atomic<u32>, k_num_tasks> times_run {};
+    auto const check_each_ran_once = [&]() {
+        for (auto [i, t] : Enumerate(times_run)) {
+            CAPTURE(i);
+            CHECK_EQ(t.Load(LoadMemoryOrder::Relaxed), 1u);
+            t.Store(0, StoreMemoryOrder::Relaxed);
+        }
+    };
+    auto const task = [&](u32 i) { times_run[i].FetchAdd(1, RmwMemoryOrder::Relaxed); };
+
+    SUBCASE("every task runs once") {
+        ThreadPool pool;
+        pool.Init("test", 4u);
+        for (auto _ : Range(20)) {
+            pool.ParallelFor(k_num_tasks, task);
+            check_each_ran_once();
+        }
+    }
+
+    SUBCASE("nested calls from inside pool jobs") {
+        // With one worker, the helpers of the inner call are queued behind the job that's waiting on them.
+        for (auto const num_threads : Array {1u, 3u}) {
+            CAPTURE(num_threads);
+            ThreadPool pool;
+            pool.Init("test", num_threads);
+
+            AtomicCountdown jobs_remaining {1};
+            pool.AddJob([&]() {
+                pool.ParallelFor(4, [&](u32 outer) {
+                    pool.ParallelFor(k_num_tasks / 4,
+                                     [&](u32 inner) { task((outer * (k_num_tasks / 4)) + inner); });
+                });
+                jobs_remaining.CountDown();
+            });
+            jobs_remaining.WaitUntilZero();
+            check_each_ran_once();
+        }
+    }
+
+    SUBCASE("helpers that start after the caller has returned") {
+        ThreadPool pool;
+        pool.Init("test", 1u);
+
+        // Keep the only worker busy so that all of the helper jobs are still queued when ParallelFor returns.
+        StartingGun release_worker;
+        pool.AddJob([&]() { release_worker.WaitUntilFired(); });
+        pool.ParallelFor(k_num_tasks, task);
+        check_each_ran_once();
+
+        release_worker.Fire();
+        AtomicCountdown jobs_remaining {1};
+        pool.AddJob([&]() { jobs_remaining.CountDown(); });
+        jobs_remaining.WaitUntilZero();
+
+        // The late helpers must not have run anything.
+        for (auto const& t : times_run)
+            CHECK_EQ(t.Load(LoadMemoryOrder::Relaxed), 0u);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestRealTimeWorkerPool) {
+    constexpr u32 k_max_tasks = 64;
+    Array<Atomic<u32>, k_max_tasks> times_run {};
+    auto const check_each_ran_once = [&](u32 num_tasks) {
+        for (auto [i, t] : Enumerate<u32>(times_run)) {
+            CAPTURE(i);
+            CHECK_EQ(t.Load(LoadMemoryOrder::Relaxed), i < num_tasks ? 1u : 0u);
+            t.Store(0, StoreMemoryOrder::Relaxed);
+        }
+    };
+    auto const task = [&](u32 i) { times_run[i].FetchAdd(1, RmwMemoryOrder::Relaxed); };
+
+    SUBCASE("every task runs once, over many generations") {
+        // Workers can be late to notice that one Execute has finished and the next one has started. They
+        // mustn't run a task twice or skip one because of it.
+        for (auto const num_threads : Array {0u, 1u, 3u}) {
+            CAPTURE(num_threads);
+            RealTimeWorkerPool pool;
+            pool.Start("test", num_threads);
+            CHECK_EQ(pool.NumThreads(), num_threads);
+            for (auto const generation : Range(2000u)) {
+                auto const num_tasks = (generation % k_max_tasks) + 1;
+                pool.Execute(num_tasks, task);
+                check_each_ran_once(num_tasks);
+            }
+        }
+    }
+
+    SUBCASE("zero tasks") {
+        RealTimeWorkerPool pool;
+        pool.Start("test", 2);
+        pool.Execute(0, task);
+        check_each_ran_once(0);
+    }
+
+    SUBCASE("workers share the tasks") {
+        RealTimeWorkerPool pool;
+        pool.Start("test", 3);
+
+        // The tasks are slow enough that the workers wake up and take some of them before the calling thread
+        // could get through them all.
+        constexpr u32 k_num_tasks = 8;
+        Array<u64, k_num_tasks> thread_ids {};
+        pool.Execute(k_num_tasks, [&](u32 i) {
+            thread_ids[i] = CurrentThreadId();
+            SleepThisThread(10);
+        });
+
+        u32 num_threads_used = 0;
+        for (auto const i : Range(k_num_tasks))
+            if (!Contains(Span<u64 const> {thread_ids}.SubSpan(0, i), thread_ids[i])) ++num_threads_used;
+        CHECK_GT(num_threads_used, 1u);
+    }
+
+    SUBCASE("restart with a different number of threads") {
+        RealTimeWorkerPool pool;
+        pool.Start("test", 2);
+        pool.Execute(k_max_tasks, task);
+        check_each_ran_once(k_max_tasks);
+
+        pool.Stop();
+        CHECK_EQ(pool.NumThreads(), 0u);
+        pool.Execute(k_max_tasks, task);
+        check_each_ran_once(k_max_tasks);
+
+        pool.Start("test", 4);
+        pool.Execute(k_max_tasks, task);
+        check_each_ran_once(k_max_tasks);
+    }
+
+    return k_success;
+}
+
 struct MallocedObj {
     MallocedObj(char c) : obj((char*)GpaAlloc(10)) { FillMemory({(u8*)obj, 10}, (u8)c); }
     ~MallocedObj() { GpaFree(obj); }
@@ -1163,5 +1302,7 @@ TEST_REGISTRATION(RegisterUtilsTests) {
     REGISTER_TEST(TestErrorNotifications);
     REGISTER_TEST(TestAtomicRefList);
     REGISTER_TEST(TestAtomicSwapBuffer);
+    REGISTER_TEST(TestThreadPoolParallelFor);
+    REGISTER_TEST(TestRealTimeWorkerPool);
     REGISTER_TEST(TestParseCommandLineArgs);
 }
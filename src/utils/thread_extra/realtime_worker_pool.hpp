@@ -0,0 +1,121 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+#include "os/threading.hpp"
+#include "utils/debug/tracy_wrapped.hpp"
+
+// A small set of pre-spawned, real-time priority threads for splitting audio-thread work across cores. Unlike
+// ThreadPool, there's no locking and no allocation when running work, so it's safe to use from the audio
+// thread.
+//
+// The thread that calls Execute takes part in the work too. Tasks are claimed from a shared atomic counter so
+// a thread that finishes its task early just takes the next unclaimed one; no thread sits idle while there's
+// work left.
+struct RealTimeWorkerPool {
+    using TaskFunction = FunctionRef<void(u32 task_index)>;
+
+    ~RealTimeWorkerPool() { Stop(); }
+
+    // [main-thread] Must not be called while Execute is running.
+    void Start(String pool_name, u32 num_threads) {
+        ZoneScoped;
+        ASSERT_EQ(m_workers.size, 0u);
+        ASSERT(pool_name.size < k_max_thread_name_size - 4u);
+        dyn::Resize(m_workers, num_threads);
+        for (auto [i, w] : Enumerate(m_workers)) {
+            auto const name = fmt::FormatInline<k_max_thread_name_size>("{}:{}", pool_name, i);
+            w.Start([this]() { WorkerProc(*this); }, name, {});
+        }
+    }
+
+    // [main-thread] Must not be called while Execute is running.
+    void Stop() {
+        ZoneScoped;
+        if (!m_workers.size) return;
+        m_stop_requested.Store(true, StoreMemoryOrder::Release);
+        m_generation.FetchAdd(1, RmwMemoryOrder::Release);
+        WakeWaitingThreads(m_generation, NumWaitingThreads::All);
+        for (auto& t : m_workers)
+            if (t.Joinable()) t.Join();
+        dyn::Clear(m_workers);
+        m_stop_requested.Store(false, StoreMemoryOrder::Release);
+    }
+
+    u32 NumThreads() const { return (u32)m_workers.size; }
+
+    // Calls task(i) for every i in [0, num_tasks), spread across the workers and the calling thread. Returns
+    // once all tasks are complete.
+    void Execute(u32 num_tasks, TaskFunction task) {
+        ZoneScoped;
+        if (!num_tasks) return;
+
+        m_task = &task;
+        m_tasks_remaining.Store(num_tasks, StoreMemoryOrder::Relaxed);
+        // The number of tasks and the next task index are packed together so that a worker that is late to
+        // notice the previous Execute finishing can't claim a task from this one with stale information.
+        m_work.Store((u64)num_tasks << 32, StoreMemoryOrder::Release);
+        m_generation.FetchAdd(1, RmwMemoryOrder::Release);
+        WakeWaitingThreads(m_generation, NumWaitingThreads::All);
+
+        RunTasks();
+
+        // Spin briefly because the last tasks are likely to finish very soon, then sleep.
+        for (u32 spins = 0; spins != k_spin_count; ++spins)
+            if (m_tasks_remaining.Load(LoadMemoryOrder::Acquire) == 0) return;
+        while (true) {
+            auto const remaining = m_tasks_remaining.Load(LoadMemoryOrder::Acquire);
+            if (remaining == 0) break;
+            WaitIfValueIsExpected(m_tasks_remaining, remaining);
+        }
+    }
+
+  private:
+    static constexpr u32 k_spin_count = 2000;
+
+    void RunTasks() {
+        while (true) {
+            auto const work = m_work.FetchAdd(1, RmwMemoryOrder::Acquire);
+            auto const task_index = (u32)work;
+            auto const num_tasks = (u32)(work >> 32);
+            if (task_index >= num_tasks) return;
+
+            DEFER {
+                if (m_tasks_remaining.FetchSub(1, RmwMemoryOrder::AcquireRelease) == 1)
+                    WakeWaitingThreads(m_tasks_remaining, NumWaitingThreads::One);
+            };
+            (*m_task)(task_index);
+        }
+    }
+
+    static void WorkerProc(RealTimeWorkerPool& pool) {
+        ZoneScoped;
+        SetCurrentThreadPriorityRealTime();
+        u32 seen_generation = pool.m_generation.Load(LoadMemoryOrder::Acquire);
+        while (true) {
+            u32 generation;
+            u32 spins = 0;
+            while ((generation = pool.m_generation.Load(LoadMemoryOrder::Acquire)) == seen_generation) {
+                if (spins++ < k_spin_count) continue;
+                WaitIfValueIsExpected(pool.m_generation, seen_generation);
+            }
+            seen_generation = generation;
+
+            if (pool.m_stop_requested.Load(LoadMemoryOrder::Acquire)) return;
+
+            try {
+                pool.RunTasks();
+            } catch (PanicException) {
+                // Pass. We're an audio plugin, we don't want to crash the host.
+            }
+        }
+    }
+
+    DynamicArray<Thread> m_workers {PageAllocator::Instance()};
+    Atomic<bool> m_stop_requested {};
+    Atomic<u32> m_generation {};
+    Atomic<u64> m_work {};
+    Atomic<u32> m_tasks_remaining {};
+    TaskFunction const* m_task {};
+};
@@ -46,6 +46,71 @@ struct ThreadPool {
         m_cond_var.WakeOne();
     }
 
+    // Calls task(i) for every i in [0, num_tasks) using any idle workers as well as the calling thread, and
+    // returns once all tasks are complete. It's safe to call this from inside a job: the calling thread keeps
+    // taking tasks itself so it never waits on a job that's stuck in the queue behind it.
+    void ParallelFor(u32 num_tasks, FunctionRef<void(u32 task_index)> task) {
+        ZoneScoped;
+        if (!num_tasks) return;
+        if (num_tasks == 1 || !m_workers.size) {
+            for (auto const i : Range(num_tasks))
+                task(i);
+            return;
+        }
+
+        // Helper jobs can start after we've returned, so the state they touch is reference counted rather
+        // than living on our stack. A helper only calls task after claiming an index, and we don't return
+        // until every claimed index is complete.
+        struct State {
+            State(u32 num_tasks, u32 ref_count, FunctionRef<void(u32)> const& task)
+                : num_tasks(num_tasks)
+                , tasks_remaining(num_tasks)
+                , ref_count(ref_count)
+                , task(&task) {}
+
+            void RunTasks() {
+                while (true) {
+                    auto const task_index = next_task.FetchAdd(1, RmwMemoryOrder::Acquire);
+                    if (task_index >= num_tasks) return;
+                    DEFER { tasks_remaining.CountDown(); };
+                    try {
+                        (*task)(task_index);
+                    } catch (PanicException) {
+                        panicked.Store(true, StoreMemoryOrder::Relaxed);
+                    }
+                }
+            }
+
+            void Release() {
+                if (ref_count.FetchSub(1, RmwMemoryOrder::AcquireRelease) == 1)
+                    Malloc::Instance().Delete(this);
+            }
+
+            u32 const num_tasks;
+            Atomic<u32> next_task {};
+            AtomicCountdown tasks_remaining;
+            Atomic<u32> ref_count;
+            Atomic<bool> panicked {};
+            FunctionRef<void(u32)> const* task;
+        };
+
+        auto const num_helpers = Min(num_tasks - 1, (u32)m_workers.size);
+        auto state = Malloc::Instance().New<State>(num_tasks, num_helpers + 1, task);
+        for (auto _ : Range(num_helpers))
+            AddJob([state]() {
+                state->RunTasks();
+                state->Release();
+            });
+
+        state->RunTasks();
+        state->tasks_remaining.WaitUntilZero();
+        auto const panicked = state->panicked.Load(LoadMemoryOrder::Relaxed);
+        state->Release();
+
+        // Rethrown here so that a panic in a helper is handled by whoever called us.
+        if (panicked) throw PanicException();
+    }
+
   private:
     static void WorkerProc(ThreadPool* thread_pool) {
         ZoneScoped;
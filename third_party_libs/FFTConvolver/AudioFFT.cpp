@@ -23,10 +23,14 @@
   #if !defined(AUDIOFFT_OOURA)
     #define AUDIOFFT_OOURA
   #endif
-  #define AUDIOFFT_OOURA_USED
-  #include <vector>
+  #define AUDIOFFT_OOURA_DEFAULT
 #endif
 
+// Ooura is always compiled, even when it's not the default, so that it can be selected with
+// AudioFFT::Backend::Ooura for comparison.
+#define AUDIOFFT_OOURA_USED
+#include <vector>
+
 
 namespace audiofft
 {
@@ -745,11 +749,13 @@ namespace audiofft
   };
 
 
+#ifdef AUDIOFFT_OOURA_DEFAULT
   /**
    * @internal
    * @brief Concrete FFT implementation
    */
   typedef OouraFFT AudioFFTImplementation;
+#endif
 
 
 #endif // AUDIOFFT_OOURA_USED
@@ -1064,7 +1070,8 @@ typedef PFFFTFFT AudioFFTImplementation;
 
 
   AudioFFT::AudioFFT() :
-    _impl(new AudioFFTImplementation())
+    _impl(new AudioFFTImplementation()),
+    _backend(Backend::Default)
   {
   }
 
@@ -1074,9 +1081,21 @@ typedef PFFFTFFT AudioFFTImplementation;
   }
 
 
-  void AudioFFT::init(size_t size)
+  void AudioFFT::init(size_t size, Backend backend)
   {
     assert(detail::IsPowerOf2(size));
+    if (backend != _backend)
+    {
+      if (backend == Backend::Ooura)
+      {
+        _impl.reset(new OouraFFT());
+      }
+      else
+      {
+        _impl.reset(new AudioFFTImplementation());
+      }
+      _backend = backend;
+    }
     _impl->init(size);
   }
 
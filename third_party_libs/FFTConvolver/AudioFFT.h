@@ -93,6 +93,18 @@ namespace audiofft
   class AudioFFT
   {
   public:
+    /**
+     * @brief Which FFT implementation to use
+     *
+     * Default is whichever backend was selected at compile time. Ooura is always available, mostly so that
+     * other backends can be compared against it.
+     */
+    enum class Backend
+    {
+      Default,
+      Ooura
+    };
+
     /**
      * @brief Constructor
      */
@@ -109,8 +121,9 @@ namespace audiofft
     /**
      * @brief Initializes the FFT object
      * @param size Size of the real input (must be power 2)
+     * @param backend The FFT implementation to use
      */
-    void init(size_t size);
+    void init(size_t size, Backend backend = Backend::Default);
 
     /**
      * @brief Performs the forward FFT
@@ -137,6 +150,7 @@ namespace audiofft
 
   private:
     std::unique_ptr<detail::AudioFFTImpl> _impl;
+    Backend _backend;
   };
 
 
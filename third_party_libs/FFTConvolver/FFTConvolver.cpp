@@ -11,6 +11,10 @@
   #include <xmmintrin.h>
 #endif
 
+#if defined (AUDIOFFT_PFFFT)
+  #include <pffft.h>
+#endif
+
 
 namespace fftconvolver
 {  
@@ -21,7 +25,7 @@ FFTConvolver::FFTConvolver() :
   _segCount(0),
   _fftComplexSize(0),
   _segments(),
-  _segmentsIR(),
+  _ir(),
   _fftBuffer(),
   _fft(),
   _preMultiplied(),
@@ -30,6 +34,15 @@ FFTConvolver::FFTConvolver() :
   _current(0),
   _inputBuffer(),
   _inputBufferFill(0)
+#if defined (AUDIOFFT_PFFFT)
+  ,
+  _pffftSetup(nullptr),
+  _zSegments(),
+  _zPreMultiplied(nullptr),
+  _zConv(nullptr),
+  _zFftBuffer(nullptr),
+  _zWork(nullptr)
+#endif
 {
 }
 
@@ -42,18 +55,38 @@ FFTConvolver::~FFTConvolver()
   
 void FFTConvolver::reset()
 {  
-  for (size_t i=0; i<_segCount; ++i)
+  for (size_t i=0; i<_segments.size(); ++i)
   {
     delete _segments[i];
-    delete _segmentsIR[i];
   }
+
+#if defined (AUDIOFFT_PFFFT)
+  for (size_t i=0; i<_zSegments.size(); ++i)
+  {
+    pffft_aligned_free(_zSegments[i]);
+  }
+  _zSegments.clear();
+  pffft_aligned_free(_zPreMultiplied);
+  pffft_aligned_free(_zConv);
+  pffft_aligned_free(_zFftBuffer);
+  pffft_aligned_free(_zWork);
+  _zPreMultiplied = nullptr;
+  _zConv = nullptr;
+  _zFftBuffer = nullptr;
+  _zWork = nullptr;
+  if (_pffftSetup)
+  {
+    pffft_destroy_setup(_pffftSetup);
+    _pffftSetup = nullptr;
+  }
+#endif
   
   _blockSize = 0;
   _segSize = 0;
   _segCount = 0;
   _fftComplexSize = 0;
   _segments.clear();
-  _segmentsIR.clear();
+  _ir.reset();
   _fftBuffer.clear();
   _fft.init(0);
   _preMultiplied.clear();
@@ -65,14 +98,72 @@ void FFTConvolver::reset()
 }
 
   
-bool FFTConvolver::init(size_t blockSize, const Sample* ir, size_t irLen)
+void FFTConvolver::zero()
 {
-  reset();
+  _inputBuffer.setZero();
+  _preMultiplied.setZero();
+  _conv.setZero();
+  _overlap.setZero();
+  _fftBuffer.setZero();
+  for (auto s : _segments)
+  {
+    s->setZero();
+  }
+
+#if defined (AUDIOFFT_PFFFT)
+  if (_pffftSetup)
+  {
+    for (auto s : _zSegments)
+    {
+      ::memset(s, 0, _segSize * sizeof(float));
+    }
+    ::memset(_zPreMultiplied, 0, _segSize * sizeof(float));
+    ::memset(_zConv, 0, _segSize * sizeof(float));
+    ::memset(_zFftBuffer, 0, _segSize * sizeof(float));
+  }
+#endif
+}
+
 
+PartitionedIR::~PartitionedIR()
+{
+  for (size_t i=0; i<segments.size(); ++i)
+  {
+    delete segments[i];
+  }
+#if defined (AUDIOFFT_PFFFT)
+  for (size_t i=0; i<zSegments.size(); ++i)
+  {
+    pffft_aligned_free(zSegments[i]);
+  }
+#endif
+}
+
+
+size_t PartitionedIR::sizeInBytes() const
+{
+  const size_t segSize = 2 * blockSize;
+  size_t bytes = segments.size() * 2 * audiofft::AudioFFT::ComplexSize(segSize) * sizeof(Sample);
+#if defined (AUDIOFFT_PFFFT)
+  bytes += zSegments.size() * segSize * sizeof(float);
+#endif
+  return bytes;
+}
+
+
+std::shared_ptr<const PartitionedIR> FFTConvolver::partition(size_t blockSize,
+                                                             const Sample* ir,
+                                                             size_t irLen,
+                                                             audiofft::AudioFFT::Backend backend)
+{
   if (blockSize == 0)
   {
-    return false;
+    return nullptr;
   }
+
+  auto result = std::make_shared<PartitionedIR>();
+  result->blockSize = NextPowerOf2(blockSize);
+  result->backend = backend;
   
   // Ignore zeros at the end of the impulse response because they only waste computation time
   while (irLen > 0 && ::fabs(ir[irLen-1]) < 0.000001f)
@@ -81,17 +172,138 @@ bool FFTConvolver::init(size_t blockSize, const Sample* ir, size_t irLen)
   }
 
   if (irLen == 0)
+  {
+    return result;
+  }
+
+  const size_t partitionSize = result->blockSize;
+  const size_t segSize = 2 * partitionSize;
+  result->segCount = static_cast<size_t>(::ceil(static_cast<float>(irLen) / static_cast<float>(partitionSize)));
+
+#if defined (AUDIOFFT_PFFFT)
+  // PFFFT's real transforms need a multiple of 32 points when it's built with SIMD
+  PFFFT_Setup* setup = nullptr;
+  if (backend == audiofft::AudioFFT::Backend::Default && segSize >= 32)
+  {
+    setup = pffft_new_setup(static_cast<int>(segSize), PFFFT_REAL);
+  }
+  if (setup)
+  {
+    const size_t bytes = segSize * sizeof(float);
+    float* buffer = static_cast<float*>(pffft_aligned_malloc(bytes));
+    float* work = static_cast<float*>(pffft_aligned_malloc(bytes));
+
+    // The inverse transform is unscaled so we fold the 1/N into the IR spectra
+    const float scale = 1.0f / static_cast<float>(segSize);
+    for (size_t i=0; i<result->segCount; ++i)
+    {
+      float* segment = static_cast<float*>(pffft_aligned_malloc(bytes));
+      const size_t remaining = irLen - (i * partitionSize);
+      const size_t sizeCopy = (remaining >= partitionSize) ? partitionSize : remaining;
+      ::memset(buffer, 0, bytes);
+      for (size_t j=0; j<sizeCopy; ++j)
+      {
+        buffer[j] = ir[i*partitionSize + j] * scale;
+      }
+      pffft_transform(setup, buffer, segment, work, PFFFT_FORWARD);
+      result->zSegments.push_back(segment);
+    }
+
+    pffft_aligned_free(buffer);
+    pffft_aligned_free(work);
+    pffft_destroy_setup(setup);
+    return result;
+  }
+#endif
+
+  audiofft::AudioFFT fft;
+  fft.init(segSize, backend);
+  SampleBuffer buffer(segSize);
+  const size_t complexSize = audiofft::AudioFFT::ComplexSize(segSize);
+  for (size_t i=0; i<result->segCount; ++i)
+  {
+    SplitComplex* segment = new SplitComplex(complexSize);
+    const size_t remaining = irLen - (i * partitionSize);
+    const size_t sizeCopy = (remaining >= partitionSize) ? partitionSize : remaining;
+    CopyAndPad(buffer, &ir[i*partitionSize], sizeCopy);
+    fft.fft(buffer.data(), segment->re(), segment->im());
+    result->segments.push_back(segment);
+  }
+
+  return result;
+}
+
+
+bool FFTConvolver::init(size_t blockSize, const Sample* ir, size_t irLen, audiofft::AudioFFT::Backend backend)
+{
+  reset();
+
+  auto partitioned = partition(blockSize, ir, irLen, backend);
+  if (!partitioned)
+  {
+    return false;
+  }
+  return init(std::move(partitioned));
+}
+
+
+bool FFTConvolver::init(std::shared_ptr<const PartitionedIR> ir)
+{
+  reset();
+
+  if (!ir || ir->blockSize == 0)
+  {
+    return false;
+  }
+
+  if (ir->segCount == 0)
   {
     return true;
   }
   
-  _blockSize = NextPowerOf2(blockSize);
+  _blockSize = ir->blockSize;
   _segSize = 2 * _blockSize;
-  _segCount = static_cast<size_t>(::ceil(static_cast<float>(irLen) / static_cast<float>(_blockSize)));
+  _segCount = ir->segCount;
   _fftComplexSize = audiofft::AudioFFT::ComplexSize(_segSize);
-  
+  _ir = std::move(ir);
+
+  // Prepare convolution buffers
+  _overlap.resize(_blockSize);
+
+  // Prepare input buffer
+  _inputBuffer.resize(_blockSize);
+  _inputBufferFill = 0;
+
+  // Reset current position
+  _current = 0;
+
+#if defined (AUDIOFFT_PFFFT)
+  if (_ir->zSegments.size())
+  {
+    _pffftSetup = pffft_new_setup(static_cast<int>(_segSize), PFFFT_REAL);
+    if (!_pffftSetup)
+    {
+      reset();
+      return false;
+    }
+
+    const size_t bytes = _segSize * sizeof(float);
+    _zPreMultiplied = static_cast<float*>(pffft_aligned_malloc(bytes));
+    _zConv = static_cast<float*>(pffft_aligned_malloc(bytes));
+    _zFftBuffer = static_cast<float*>(pffft_aligned_malloc(bytes));
+    _zWork = static_cast<float*>(pffft_aligned_malloc(bytes));
+    for (size_t i=0; i<_segCount; ++i)
+    {
+      _zSegments.push_back(static_cast<float*>(pffft_aligned_malloc(bytes)));
+    }
+
+    zero();
+    return true;
+  }
+#endif
+
   // FFT
-  _fft.init(_segSize);
+  _fft.init(_segSize, _ir->backend);
   _fftBuffer.resize(_segSize);
   
   // Prepare segments
@@ -100,28 +312,9 @@ bool FFTConvolver::init(size_t blockSize, const Sample* ir, size_t irLen)
     _segments.push_back(new SplitComplex(_fftComplexSize));    
   }
   
-  // Prepare IR
-  for (size_t i=0; i<_segCount; ++i)
-  {
-    SplitComplex* segment = new SplitComplex(_fftComplexSize);
-    const size_t remaining = irLen - (i * _blockSize);
-    const size_t sizeCopy = (remaining >= _blockSize) ? _blockSize : remaining;
-    CopyAndPad(_fftBuffer, &ir[i*_blockSize], sizeCopy);
-    _fft.fft(_fftBuffer.data(), segment->re(), segment->im());
-    _segmentsIR.push_back(segment);
-  }
-  
   // Prepare convolution buffers  
   _preMultiplied.resize(_fftComplexSize);
   _conv.resize(_fftComplexSize);
-  _overlap.resize(_blockSize);
-  
-  // Prepare input buffer
-  _inputBuffer.resize(_blockSize);
-  _inputBufferFill = 0;
-
-  // Reset current position
-  _current = 0;
   
   return true;
 }
@@ -143,29 +336,66 @@ void FFTConvolver::process(const Sample* input, Sample* output, size_t len)
     const size_t inputBufferPos = _inputBufferFill;
     ::memcpy(_inputBuffer.data()+inputBufferPos, input+processed, processing * sizeof(Sample));
 
-    // Forward FFT
-    CopyAndPad(_fftBuffer, &_inputBuffer[0], _blockSize); 
-    _fft.fft(_fftBuffer.data(), _segments[_current]->re(), _segments[_current]->im());
-
-    // Complex multiplication
-    if (inputBufferWasEmpty)
+    const float* convolved = nullptr;
+#if defined (AUDIOFFT_PFFFT)
+    if (_pffftSetup)
     {
-      _preMultiplied.setZero();
-      for (size_t i=1; i<_segCount; ++i)
+      // Forward FFT
+      const size_t bytes = _segSize * sizeof(float);
+      ::memcpy(_zFftBuffer, _inputBuffer.data(), _blockSize * sizeof(Sample));
+      ::memset(_zFftBuffer + _blockSize, 0, bytes - (_blockSize * sizeof(float)));
+      pffft_transform(_pffftSetup, _zFftBuffer, _zSegments[_current], _zWork, PFFFT_FORWARD);
+
+      // Complex multiplication
+      if (inputBufferWasEmpty)
       {
-        const size_t indexIr = i;
-        const size_t indexAudio = (_current + i) % _segCount;
-        ComplexMultiplyAccumulate(_preMultiplied, *_segmentsIR[indexIr], *_segments[indexAudio]);
+        ::memset(_zPreMultiplied, 0, bytes);
+        for (size_t i=1; i<_segCount; ++i)
+        {
+          const size_t indexIr = i;
+          const size_t indexAudio = (_current + i) % _segCount;
+          pffft_zconvolve_accumulate(_pffftSetup,
+                                     _ir->zSegments[indexIr],
+                                     _zSegments[indexAudio],
+                                     _zPreMultiplied,
+                                     1.0f);
+        }
       }
+      ::memcpy(_zConv, _zPreMultiplied, bytes);
+      pffft_zconvolve_accumulate(_pffftSetup, _zSegments[_current], _ir->zSegments[0], _zConv, 1.0f);
+
+      // Backward FFT
+      pffft_transform(_pffftSetup, _zConv, _zFftBuffer, _zWork, PFFFT_BACKWARD);
+      convolved = _zFftBuffer;
     }
-    _conv.copyFrom(_preMultiplied);
-    ComplexMultiplyAccumulate(_conv, *_segments[_current], *_segmentsIR[0]);
+    else
+#endif
+    {
+      // Forward FFT
+      CopyAndPad(_fftBuffer, &_inputBuffer[0], _blockSize); 
+      _fft.fft(_fftBuffer.data(), _segments[_current]->re(), _segments[_current]->im());
 
-    // Backward FFT
-    _fft.ifft(_fftBuffer.data(), _conv.re(), _conv.im());
+      // Complex multiplication
+      if (inputBufferWasEmpty)
+      {
+        _preMultiplied.setZero();
+        for (size_t i=1; i<_segCount; ++i)
+        {
+          const size_t indexIr = i;
+          const size_t indexAudio = (_current + i) % _segCount;
+          ComplexMultiplyAccumulate(_preMultiplied, *_ir->segments[indexIr], *_segments[indexAudio]);
+        }
+      }
+      _conv.copyFrom(_preMultiplied);
+      ComplexMultiplyAccumulate(_conv, *_segments[_current], *_ir->segments[0]);
+
+      // Backward FFT
+      _fft.ifft(_fftBuffer.data(), _conv.re(), _conv.im());
+      convolved = _fftBuffer.data();
+    }
 
     // Add overlap
-    Sum(output+processed, _fftBuffer.data()+inputBufferPos, _overlap.data()+inputBufferPos, processing);
+    Sum(output+processed, convolved+inputBufferPos, _overlap.data()+inputBufferPos, processing);
 
     // Input buffer full => Next block
     _inputBufferFill += processing;
@@ -176,7 +406,7 @@ void FFTConvolver::process(const Sample* input, Sample* output, size_t len)
       _inputBufferFill = 0;
 
       // Save the overlap
-      ::memcpy(_overlap.data(), _fftBuffer.data()+_blockSize, _blockSize * sizeof(Sample));
+      ::memcpy(_overlap.data(), convolved+_blockSize, _blockSize * sizeof(Sample));
 
       // Update current segment
       _current = (_current > 0) ? (_current - 1) : (_segCount - 1);
@@ -185,5 +415,98 @@ void FFTConvolver::process(const Sample* input, Sample* output, size_t len)
     processed += processing;
   }
 }
+
+
+size_t FFTConvolver::blockStepCount() const
+{
+  // Forward FFT, one step per segment multiplication, then the current segment and backward FFT
+  return (_segCount > 0) ? (_segCount + 1) : 1;
+}
+
+
+void FFTConvolver::processBlockStep(size_t step, const Sample* input, Sample* output)
+{
+  assert(_inputBufferFill == 0);
+  assert(step < blockStepCount());
+
+  if (_segCount == 0)
+  {
+    ::memset(output, 0, _blockSize * sizeof(Sample));
+    return;
+  }
+
+  if (step == 0)
+  {
+    ::memcpy(_inputBuffer.data(), input, _blockSize * sizeof(Sample));
+#if defined (AUDIOFFT_PFFFT)
+    if (_pffftSetup)
+    {
+      // Forward FFT
+      const size_t bytes = _segSize * sizeof(float);
+      ::memcpy(_zFftBuffer, _inputBuffer.data(), _blockSize * sizeof(Sample));
+      ::memset(_zFftBuffer + _blockSize, 0, bytes - (_blockSize * sizeof(float)));
+      pffft_transform(_pffftSetup, _zFftBuffer, _zSegments[_current], _zWork, PFFFT_FORWARD);
+      ::memset(_zPreMultiplied, 0, bytes);
+      return;
+    }
+#endif
+    // Forward FFT
+    CopyAndPad(_fftBuffer, &_inputBuffer[0], _blockSize);
+    _fft.fft(_fftBuffer.data(), _segments[_current]->re(), _segments[_current]->im());
+    _preMultiplied.setZero();
+    return;
+  }
+
+  if (step < _segCount)
+  {
+    // Complex multiplication, the same order as process()
+    const size_t indexIr = step;
+    const size_t indexAudio = (_current + step) % _segCount;
+#if defined (AUDIOFFT_PFFFT)
+    if (_pffftSetup)
+    {
+      pffft_zconvolve_accumulate(_pffftSetup,
+                                 _ir->zSegments[indexIr],
+                                 _zSegments[indexAudio],
+                                 _zPreMultiplied,
+                                 1.0f);
+      return;
+    }
+#endif
+    ComplexMultiplyAccumulate(_preMultiplied, *_ir->segments[indexIr], *_segments[indexAudio]);
+    return;
+  }
+
+  const float* convolved = nullptr;
+#if defined (AUDIOFFT_PFFFT)
+  if (_pffftSetup)
+  {
+    const size_t bytes = _segSize * sizeof(float);
+    ::memcpy(_zConv, _zPreMultiplied, bytes);
+    pffft_zconvolve_accumulate(_pffftSetup, _zSegments[_current], _ir->zSegments[0], _zConv, 1.0f);
+
+    // Backward FFT
+    pffft_transform(_pffftSetup, _zConv, _zFftBuffer, _zWork, PFFFT_BACKWARD);
+    convolved = _zFftBuffer;
+  }
+  else
+#endif
+  {
+    _conv.copyFrom(_preMultiplied);
+    ComplexMultiplyAccumulate(_conv, *_segments[_current], *_ir->segments[0]);
+
+    // Backward FFT
+    _fft.ifft(_fftBuffer.data(), _conv.re(), _conv.im());
+    convolved = _fftBuffer.data();
+  }
+
+  // Add overlap
+  Sum(output, convolved, _overlap.data(), _blockSize);
+
+  // Next block
+  _inputBuffer.setZero();
+  ::memcpy(_overlap.data(), convolved+_blockSize, _blockSize * sizeof(Sample));
+  _current = (_current > 0) ? (_current - 1) : (_segCount - 1);
+}
   
 } // End of namespace fftconvolver
@@ -5,13 +5,47 @@
 #ifndef _FFTCONVOLVER_FFTCONVOLVER_H
 #define _FFTCONVOLVER_FFTCONVOLVER_H
 
+#include <memory>
 #include <vector>
 
 #include "AudioFFT.h"
 #include "Utilities.h"
 
+#if defined(AUDIOFFT_PFFFT)
+struct PFFFT_Setup;
+#endif
+
 namespace fftconvolver {
 
+/**
+ * @brief An impulse response that has been split into partitions and transformed into the frequency domain
+ *
+ * This is the expensive part of initializing a convolver. It's immutable once created so it can be shared
+ * between any number of convolvers, on any thread.
+ */
+struct PartitionedIR {
+    PartitionedIR() = default;
+    ~PartitionedIR();
+
+    size_t sizeInBytes() const;
+
+    size_t blockSize = 0;
+    size_t segCount = 0;
+    audiofft::AudioFFT::Backend backend = audiofft::AudioFFT::Backend::Default;
+
+    // Split-complex spectra, used unless the native PFFFT layout is
+    std::vector<SplitComplex *> segments;
+
+#if defined(AUDIOFFT_PFFFT)
+    // Spectra in PFFFT's native layout, pre-scaled by 1/N. Allocated with pffft_aligned_malloc.
+    std::vector<float *> zSegments;
+#endif
+
+    // Prevent uncontrolled usage
+    PartitionedIR(const PartitionedIR &) = delete;
+    PartitionedIR &operator=(const PartitionedIR &) = delete;
+};
+
 /**
  * @class FFTConvolver
  * @brief Implementation of a partitioned FFT convolution algorithm with uniform block size
@@ -41,9 +75,34 @@ class FFTConvolver {
      * @param blockSize Block size internally used by the convolver (partition size)
      * @param ir The impulse response
      * @param irLen Length of the impulse response
+     * @param backend FFT implementation to use, only something other than Default for benchmarking
      * @return true: Success - false: Failed
      */
-    bool init(size_t blockSize, const Sample *ir, size_t irLen);
+    bool init(size_t blockSize,
+              const Sample *ir,
+              size_t irLen,
+              audiofft::AudioFFT::Backend backend = audiofft::AudioFFT::Backend::Default);
+
+    /**
+     * @brief Initializes the convolver with an impulse response that has already been partitioned
+     * @param ir The result of partition(), possibly shared with other convolvers
+     * @return true: Success - false: Failed
+     */
+    bool init(std::shared_ptr<const PartitionedIR> ir);
+
+    /**
+     * @brief Partitions and transforms an impulse response, ready for init()
+     * @param blockSize Block size internally used by the convolver (partition size)
+     * @param ir The impulse response
+     * @param irLen Length of the impulse response
+     * @param backend FFT implementation to use, only something other than Default for benchmarking
+     * @return The partitioned impulse response, or nullptr if the block size is invalid
+     */
+    static std::shared_ptr<const PartitionedIR>
+    partition(size_t blockSize,
+              const Sample *ir,
+              size_t irLen,
+              audiofft::AudioFFT::Backend backend = audiofft::AudioFFT::Backend::Default);
 
     /**
      * @brief Convolves the the given input samples and immediately outputs the result
@@ -53,21 +112,27 @@ class FFTConvolver {
      */
     void process(const Sample *input, Sample *output, size_t len);
 
+    /**
+     * @brief The number of steps processBlockStep() splits one whole block into
+     */
+    size_t blockStepCount() const;
+
+    /**
+     * @brief Does the same as process() with len == block size, but split into blockStepCount() steps that
+     * must all be called in order with the same input and output. Different threads can run different steps
+     * as long as they synchronise in between. Only valid when every process() call is a whole block.
+     * @param step Index of the step, from 0 to blockStepCount() - 1
+     * @param input The input samples, a whole block
+     * @param output The convolution result, written by the last step
+     */
+    void processBlockStep(size_t step, const Sample *input, Sample *output);
+
     /**
      * @brief Resets the convolver and discards the set impulse response
      */
     void reset();
 
-    void zero() {
-        _inputBuffer.setZero();
-        _preMultiplied.setZero();
-        _conv.setZero();
-        _overlap.setZero();
-        _fftBuffer.setZero();
-        for (auto s : _segments) {
-            s->setZero();
-        }
-    }
+    void zero();
 
   private:
     size_t _blockSize;
@@ -75,7 +140,7 @@ class FFTConvolver {
     size_t _segCount;
     size_t _fftComplexSize;
     std::vector<SplitComplex *> _segments;
-    std::vector<SplitComplex *> _segmentsIR;
+    std::shared_ptr<const PartitionedIR> _ir;
     SampleBuffer _fftBuffer;
     audiofft::AudioFFT _fft;
     SplitComplex _preMultiplied;
@@ -85,6 +150,20 @@ class FFTConvolver {
     SampleBuffer _inputBuffer;
     size_t _inputBufferFill;
 
+#if defined(AUDIOFFT_PFFFT)
+    // When PFFFT is the backend we keep the spectra in its own SIMD-friendly (unordered) layout rather than
+    // split-complex: there's no reordering on every transform and pffft_zconvolve_accumulate does the
+    // complex multiply-accumulate with SIMD. Non-null _pffftSetup means this path is in use, in which case
+    // _segments, _preMultiplied, _conv, _fftBuffer and _fft are unused. All buffers are allocated with
+    // pffft_aligned_malloc.
+    PFFFT_Setup *_pffftSetup;
+    std::vector<float *> _zSegments;
+    float *_zPreMultiplied;
+    float *_zConv;
+    float *_zFftBuffer;
+    float *_zWork;
+#endif
+
     // Prevent uncontrolled usage
     FFTConvolver(const FFTConvolver &);
     FFTConvolver &operator=(const FFTConvolver &);
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <initializer_list>
 
 
 namespace fftconvolver
@@ -54,12 +55,28 @@ void TwoStageFFTConvolver::reset()
 }
 
   
-bool TwoStageFFTConvolver::init(size_t headBlockSize,
-                                size_t tailBlockSize,
-                                const Sample* ir,
-                                size_t irLen)
+size_t TwoStagePartitionedIR::sizeInBytes() const
 {
-  reset();
+  size_t bytes = 0;
+  for (const auto& p : {head, tail0, tail})
+  {
+    if (p)
+    {
+      bytes += p->sizeInBytes();
+    }
+  }
+  return bytes;
+}
+
+
+bool TwoStageFFTConvolver::partition(size_t headBlockSize,
+                                     size_t tailBlockSize,
+                                     const Sample* ir,
+                                     size_t irLen,
+                                     audiofft::AudioFFT::Backend backend,
+                                     TwoStagePartitionedIR& result)
+{
+  result = TwoStagePartitionedIR();
 
   if (headBlockSize == 0 || tailBlockSize == 0)
   {
@@ -84,24 +101,72 @@ bool TwoStageFFTConvolver::init(size_t headBlockSize,
     return true;
   }
   
-  _headBlockSize = NextPowerOf2(headBlockSize);
-  _tailBlockSize = NextPowerOf2(tailBlockSize);
+  result.headBlockSize = NextPowerOf2(headBlockSize);
+  result.tailBlockSize = NextPowerOf2(tailBlockSize);
+
+  const size_t headIrLen = std::min(irLen, result.tailBlockSize);
+  result.head = FFTConvolver::partition(result.headBlockSize, ir, headIrLen, backend);
 
-  const size_t headIrLen = std::min(irLen, _tailBlockSize);
-  _headConvolver.init(_headBlockSize, ir, headIrLen);
+  if (irLen > result.tailBlockSize)
+  {
+    const size_t conv1IrLen = std::min(irLen-result.tailBlockSize, result.tailBlockSize);
+    result.tail0 = FFTConvolver::partition(result.headBlockSize, ir+result.tailBlockSize, conv1IrLen, backend);
+  }
 
-  if (irLen > _tailBlockSize)
+  if (irLen > 2 * result.tailBlockSize)
   {
-    const size_t conv1IrLen = std::min(irLen-_tailBlockSize, _tailBlockSize);
-    _tailConvolver0.init(_headBlockSize, ir+_tailBlockSize, conv1IrLen);
+    const size_t tailIrLen = irLen - (2*result.tailBlockSize);
+    result.tail = FFTConvolver::partition(result.tailBlockSize,
+                                          ir+(2*result.tailBlockSize),
+                                          tailIrLen,
+                                          backend);
+  }
+
+  return true;
+}
+
+
+bool TwoStageFFTConvolver::init(size_t headBlockSize,
+                                size_t tailBlockSize,
+                                const Sample* ir,
+                                size_t irLen,
+                                audiofft::AudioFFT::Backend backend)
+{
+  reset();
+
+  TwoStagePartitionedIR partitioned;
+  if (!partition(headBlockSize, tailBlockSize, ir, irLen, backend, partitioned))
+  {
+    return false;
+  }
+  return init(partitioned);
+}
+
+
+bool TwoStageFFTConvolver::init(const TwoStagePartitionedIR& ir)
+{
+  reset();
+
+  if (!ir.head)
+  {
+    return true;
+  }
+  
+  _headBlockSize = ir.headBlockSize;
+  _tailBlockSize = ir.tailBlockSize;
+
+  _headConvolver.init(ir.head);
+
+  if (ir.tail0)
+  {
+    _tailConvolver0.init(ir.tail0);
     _tailOutput0.resize(_tailBlockSize);
     _tailPrecalculated0.resize(_tailBlockSize);
   }
 
-  if (irLen > 2 * _tailBlockSize)
+  if (ir.tail)
   {
-    const size_t tailIrLen = irLen - (2*_tailBlockSize);
-    _tailConvolver.init(_tailBlockSize, ir+(2*_tailBlockSize), tailIrLen);
+    _tailConvolver.init(ir.tail);
     _tailOutput.resize(_tailBlockSize);
     _tailPrecalculated.resize(_tailBlockSize);
     _backgroundProcessingInput.resize(_tailBlockSize);
@@ -218,5 +283,17 @@ void TwoStageFFTConvolver::doBackgroundProcessing()
 {
   _tailConvolver.process(_backgroundProcessingInput.data(), _tailOutput.data(), _tailBlockSize);
 }
+
+
+size_t TwoStageFFTConvolver::backgroundProcessingStepCount() const
+{
+  return _tailConvolver.blockStepCount();
+}
+
+
+void TwoStageFFTConvolver::doBackgroundProcessingStep(size_t step)
+{
+  _tailConvolver.processBlockStep(step, _backgroundProcessingInput.data(), _tailOutput.data());
+}
     
 } // End of namespace fftconvolver
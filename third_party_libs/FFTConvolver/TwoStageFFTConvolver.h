@@ -10,6 +10,21 @@
 
 namespace fftconvolver {
 
+/**
+ * @brief The partitioned impulse response of each stage of a TwoStageFFTConvolver
+ *
+ * Cheap to copy, the partitions themselves are shared.
+ */
+struct TwoStagePartitionedIR {
+    size_t sizeInBytes() const;
+
+    size_t headBlockSize = 0;
+    size_t tailBlockSize = 0;
+    std::shared_ptr<const PartitionedIR> head;
+    std::shared_ptr<const PartitionedIR> tail0; // null if the IR isn't longer than 1 tail block
+    std::shared_ptr<const PartitionedIR> tail; // null if the IR isn't longer than 2 tail blocks
+};
+
 /**
  * @class TwoStageFFTConvolver
  * @brief FFT convolver using two different block sizes
@@ -44,9 +59,39 @@ class TwoStageFFTConvolver {
      * @param tailBlockSize the tail block size
      * @param ir The impulse response
      * @param irLen Length of the impulse response in samples
+     * @param backend FFT implementation to use, only something other than Default for benchmarking
+     * @return true: Success - false: Failed
+     */
+    bool init(size_t headBlockSize,
+              size_t tailBlockSize,
+              const Sample *ir,
+              size_t irLen,
+              audiofft::AudioFFT::Backend backend = audiofft::AudioFFT::Backend::Default);
+
+    /**
+     * @brief Initialization with an impulse response that has already been partitioned
+     * @param ir The result of partition()
      * @return true: Success - false: Failed
      */
-    bool init(size_t headBlockSize, size_t tailBlockSize, const Sample *ir, size_t irLen);
+    bool init(const TwoStagePartitionedIR &ir);
+
+    /**
+     * @brief Partitions and transforms an impulse response, ready for init(). This is where nearly all the
+     * work of initialization is, and it doesn't touch any convolver so it can be done on any thread.
+     * @param headBlockSize The head block size
+     * @param tailBlockSize the tail block size
+     * @param ir The impulse response
+     * @param irLen Length of the impulse response in samples
+     * @param backend FFT implementation to use, only something other than Default for benchmarking
+     * @param result Receives the partitioned impulse response
+     * @return true: Success - false: Failed
+     */
+    static bool partition(size_t headBlockSize,
+                          size_t tailBlockSize,
+                          const Sample *ir,
+                          size_t irLen,
+                          audiofft::AudioFFT::Backend backend,
+                          TwoStagePartitionedIR &result);
 
     /**
      * @brief Convolves the the given input samples and immediately outputs the result
@@ -99,6 +144,17 @@ class TwoStageFFTConvolver {
      */
     void doBackgroundProcessing();
 
+    /**
+     * @brief The number of steps doBackgroundProcessingStep() splits the background processing into
+     */
+    size_t backgroundProcessingStepCount() const;
+
+    /**
+     * @brief Performs one step of the background processing work. Calling every step in order does the same
+     * as doBackgroundProcessing(), but lets the job be handed between threads part way through.
+     */
+    void doBackgroundProcessingStep(size_t step);
+
   private:
     size_t _headBlockSize;
     size_t _tailBlockSize;
@@ -1,11 +1,234 @@
 // Copyright 2018-2024 Sam Windell
 // SPDX-License-Identifier: MIT
 
+#include "wrapper.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
 #include "TwoStageFFTConvolver.h"
 
+struct TailWorker;
+
+// Same as SpinLoopPause() in os/threading.hpp: tells the CPU we're spinning without giving up the thread.
+static inline void SpinPause() {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__ARM_ARCH)
+    __builtin_arm_isb(0xf);
+#endif
+}
+
+// The 2nd-Nth tail partitions are a whole k_tail_block_size FFT convolution that TwoStageFFTConvolver
+// otherwise runs inline every k_tail_block_size frames. That's a big periodic spike on the audio thread which
+// is what causes dropouts at small buffer sizes rather than the average load. Instead we hand it to a
+// TailWorker which has until the next tail block boundary to finish it.
+//
+// The job is split into steps (one per partition) and ownership of it is passed around with a single atomic.
+// When the audio thread needs the result it waits for no longer than its budget; if the job still isn't done
+// it takes it back - straight away if the worker never started it, otherwise after the worker's current step
+// - and finishes the remaining steps itself. The audio thread never waits on the worker for more than its
+// budget plus one step.
+class BackgroundTailConvolver : public fftconvolver::TwoStageFFTConvolver {
+  public:
+    // [worker-thread]
+    void RunPendingJob() {
+        auto expected = k_pending;
+        if (!m_owner.compare_exchange_strong(expected, k_worker, std::memory_order_acquire)) return;
+        while (m_next_step != m_num_steps) {
+            doBackgroundProcessingStep(m_next_step++);
+            if (m_owner.load(std::memory_order_acquire) == k_handing_back) {
+                m_owner.store(k_audio, std::memory_order_release);
+                return;
+            }
+        }
+        m_owner.store(k_idle, std::memory_order_release);
+    }
+
+    // Drops the rest of any job. The convolver's tail state is left part-way through a block so it must be
+    // zeroed or re-initialised afterwards.
+    void CancelBackgroundProcessing() {
+        if (TakeBackJob()) m_owner.store(k_idle, std::memory_order_release);
+    }
+
+    void zero() {
+        CancelBackgroundProcessing();
+        TwoStageFFTConvolver::zero();
+    }
+
+    // [audio-thread] How long waitForBackgroundProcessing() may wait for the worker before doing the rest of
+    // the job itself.
+    void SetMaxWait(std::chrono::nanoseconds max_wait) { m_max_wait = max_wait; }
+
+    TailWorker* worker {};
+
+  protected:
+    void startBackgroundProcessing() override;
+
+    void waitForBackgroundProcessing() override {
+        if (m_owner.load(std::memory_order_acquire) == k_idle) return;
+
+        auto const deadline = std::chrono::steady_clock::now() + m_max_wait;
+        do {
+            if (m_owner.load(std::memory_order_acquire) == k_idle) return;
+            SpinPause();
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        if (!TakeBackJob()) return;
+        while (m_next_step != m_num_steps)
+            doBackgroundProcessingStep(m_next_step++);
+        m_owner.store(k_idle, std::memory_order_release);
+    }
+
+  private:
+    static constexpr uint32_t k_idle = 0;
+    static constexpr uint32_t k_pending = 1; // waiting for the worker
+    static constexpr uint32_t k_worker = 2; // the worker is running steps
+    static constexpr uint32_t k_handing_back = 3; // the worker should stop after its current step
+    static constexpr uint32_t k_audio = 4; // the worker has stopped, the caller of TakeBackJob owns the job
+
+    // Returns true if we now own the unfinished job, false if it's already finished.
+    bool TakeBackJob() {
+        auto state = k_pending;
+        if (m_owner.compare_exchange_strong(state, k_audio, std::memory_order_acquire)) return true;
+        if (state == k_worker &&
+            m_owner.compare_exchange_strong(state, k_handing_back, std::memory_order_acq_rel)) {
+            // The worker checks between every step, so this is a short wait.
+            while ((state = m_owner.load(std::memory_order_acquire)) == k_handing_back)
+                SpinPause();
+        }
+        return state == k_audio;
+    }
+
+    // Only touched by the owner of the job.
+    size_t m_next_step {};
+    size_t m_num_steps {};
+
+    std::chrono::nanoseconds m_max_wait {};
+    std::atomic<uint32_t> m_owner {k_idle};
+};
+
+// A real-time priority thread that runs the tail jobs of both channels of a StereoConvolver. The audio thread
+// hands over work by just marking the job as pending: it doesn't make any system calls to wake the worker.
+// Instead the worker polls. The job isn't due until the next tail block boundary, hundreds of milliseconds
+// away, so a few milliseconds of polling latency doesn't matter.
+struct TailWorker {
+    ~TailWorker() { Stop(); }
+
+    // [main-thread]
+    void Start(BackgroundTailConvolver* convolvers) {
+        m_convolvers = convolvers;
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    // [main-thread] The convolvers must not be processed while this is running.
+    void Stop() {
+        if (!m_thread.joinable()) return;
+        m_stop_requested.store(true, std::memory_order_release);
+        m_thread.join();
+        m_stop_requested.store(false, std::memory_order_release);
+    }
+
+    // [audio-thread] Cheap: no system calls.
+    void NoteAudioThread() {
+#if defined(__APPLE__)
+        m_audio_thread.store(pthread_mach_thread_np(pthread_self()), std::memory_order_relaxed);
+#endif
+    }
+
+  private:
+    static constexpr auto k_poll_interval = std::chrono::milliseconds(2);
+
+    // The worker must not be preempted by the audio thread that's waiting for it, so it needs to be at least
+    // the audio thread's priority. On Windows and Linux the maximum real-time priority is that. It's fine if
+    // this fails.
+    static void SetCurrentThreadPriorityRealTime() {
+#if defined(_WIN32)
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+        sched_param params {};
+        params.sched_priority = sched_get_priority_max(SCHED_RR);
+        pthread_setschedparam(pthread_self(), SCHED_RR, &params);
+#endif
+    }
+
+#if defined(__APPLE__)
+    // macOS audio threads use the time-constraint policy, which is above any pthread priority, so we copy
+    // whatever the audio thread has.
+    void MatchAudioThreadPriority() {
+        auto const audio_thread = m_audio_thread.load(std::memory_order_relaxed);
+        if (audio_thread == MACH_PORT_NULL || audio_thread == m_matched_audio_thread) return;
+        m_matched_audio_thread = audio_thread;
+
+        thread_time_constraint_policy_data_t policy {};
+        mach_msg_type_number_t count = THREAD_TIME_CONSTRAINT_POLICY_COUNT;
+        boolean_t get_default = false;
+        if (thread_policy_get(audio_thread,
+                              THREAD_TIME_CONSTRAINT_POLICY,
+                              (thread_policy_t)&policy,
+                              &count,
+                              &get_default) != KERN_SUCCESS ||
+            get_default)
+            return;
+        thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                          THREAD_TIME_CONSTRAINT_POLICY,
+                          (thread_policy_t)&policy,
+                          THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+    }
+#endif
+
+    void Run() {
+        SetCurrentThreadPriorityRealTime();
+        while (!m_stop_requested.load(std::memory_order_acquire)) {
+#if defined(__APPLE__)
+            MatchAudioThreadPriority();
+#endif
+            m_convolvers[0].RunPendingJob();
+            m_convolvers[1].RunPendingJob();
+            std::this_thread::sleep_for(k_poll_interval);
+        }
+    }
+
+    std::thread m_thread {};
+    std::atomic<bool> m_stop_requested {};
+#if defined(__APPLE__)
+    std::atomic<mach_port_t> m_audio_thread {MACH_PORT_NULL};
+    mach_port_t m_matched_audio_thread {MACH_PORT_NULL};
+#endif
+    BackgroundTailConvolver* m_convolvers {};
+};
+
+void BackgroundTailConvolver::startBackgroundProcessing() {
+    if (!worker) {
+        doBackgroundProcessing();
+        return;
+    }
+    m_next_step = 0;
+    m_num_steps = backgroundProcessingStepCount();
+    worker->NoteAudioThread();
+    m_owner.store(k_pending, std::memory_order_release);
+}
+
 struct StereoConvolver {
     int num_frames;
-    fftconvolver::TwoStageFFTConvolver convolvers[2];
+    BackgroundTailConvolver convolvers[2];
+    TailWorker worker; // declared last so that it's stopped before the convolvers are destroyed
 };
 
 StereoConvolver* CreateStereoConvolver() { return new StereoConvolver(); }
@@ -14,28 +237,87 @@ int NumFrames(StereoConvolver& convolver) { return convolver.num_frames; }
 
 void DestroyStereoConvolver(StereoConvolver* convolver) { delete convolver; }
 
-void Init(StereoConvolver& convolver, float const* samples, int num_frames, int num_channels) {
-    convolver.num_frames = num_frames;
-
-    auto channel_samples = new float[(unsigned)num_frames];
+struct ConvolverIr {
+    std::atomic<int> ref_count;
+    int num_frames;
+    int num_channels;
+    fftconvolver::TwoStagePartitionedIR channels[2]; // both the same for mono
+};
 
+ConvolverIr* CreateConvolverIr(float const* const* channels,
+                               int num_channels,
+                               int num_frames,
+                               ConvolverBlockSizes block_sizes,
+                               ConvolverFftBackend backend) {
     assert(num_channels == 1 || num_channels == 2);
+    auto ir = new ConvolverIr {1, num_frames, num_channels, {}};
+    for (int chan = 0; chan < num_channels; ++chan)
+        fftconvolver::TwoStageFFTConvolver::partition((size_t)block_sizes.head,
+                                                      (size_t)block_sizes.tail,
+                                                      channels[chan],
+                                                      (size_t)num_frames,
+                                                      backend == ConvolverFftBackend::Ooura
+                                                          ? audiofft::AudioFFT::Backend::Ooura
+                                                          : audiofft::AudioFFT::Backend::Default,
+                                                      ir->channels[chan]);
+    if (num_channels == 1) ir->channels[1] = ir->channels[0];
+    return ir;
+}
+
+void RetainConvolverIr(ConvolverIr& ir) { ir.ref_count.fetch_add(1, std::memory_order_relaxed); }
+
+void ReleaseConvolverIr(ConvolverIr& ir) {
+    if (ir.ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) delete &ir;
+}
 
-    // IMPROVE: probably more efficent ways to handle mono audio
+int NumFrames(ConvolverIr const& ir) { return ir.num_frames; }
 
+size_t SizeInBytes(ConvolverIr const& ir) {
+    size_t bytes = sizeof(ConvolverIr);
+    for (int chan = 0; chan < ir.num_channels; ++chan)
+        bytes += ir.channels[chan].sizeInBytes();
+    return bytes;
+}
+
+void Init(StereoConvolver& convolver, ConvolverIr const& ir, bool background_tail) {
+    convolver.worker.Stop();
+    convolver.num_frames = ir.num_frames;
+
+    bool has_background_tail = false;
     for (int chan = 0; chan < 2; ++chan) {
-        if (!(chan == 2 && num_channels == 1))
-            for (int frame = 0; frame < num_frames; ++frame)
-                channel_samples[frame] = samples[frame * num_channels + chan];
+        convolver.convolvers[chan].CancelBackgroundProcessing();
+        convolver.convolvers[chan].init(ir.channels[chan]);
+        if (background_tail && ir.channels[chan].tail) has_background_tail = true;
+    }
 
-        // Just trial and error with these values; these seem to be most efficient
-        constexpr size_t k_head_block_size = 512;
-        constexpr size_t k_tail_block_size = 16384;
+    for (auto& c : convolver.convolvers)
+        c.worker = has_background_tail ? &convolver.worker : nullptr;
+    if (has_background_tail) convolver.worker.Start(convolver.convolvers);
+}
+
+void Init(StereoConvolver& convolver,
+          float const* samples,
+          int num_frames,
+          int num_channels,
+          ConvolverFftBackend backend,
+          bool background_tail) {
+    assert(num_channels == 1 || num_channels == 2);
 
-        convolver.convolvers[chan].init(k_head_block_size, k_tail_block_size, channel_samples, num_frames);
+    std::vector<float> deinterleaved;
+    float const* channels[2] {samples, nullptr};
+    if (num_channels == 2) {
+        deinterleaved.resize((size_t)num_frames * 2);
+        for (int frame = 0; frame < num_frames; ++frame) {
+            deinterleaved[(size_t)frame] = samples[frame * 2 + 0];
+            deinterleaved[(size_t)(num_frames + frame)] = samples[frame * 2 + 1];
+        }
+        channels[0] = deinterleaved.data();
+        channels[1] = deinterleaved.data() + num_frames;
     }
 
-    delete[] channel_samples;
+    auto ir = CreateConvolverIr(channels, num_channels, num_frames, k_convolver_block_sizes, backend);
+    Init(convolver, *ir, background_tail);
+    ReleaseConvolverIr(*ir);
 }
 
 void Process(StereoConvolver& convolver,
@@ -43,7 +325,12 @@ void Process(StereoConvolver& convolver,
              float const* input_r,
              float* output_l,
              float* output_r,
-             int num_frames) {
+             int num_frames,
+             double max_wait_seconds) {
+    auto const max_wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(max_wait_seconds));
+    for (auto& c : convolver.convolvers)
+        c.SetMaxWait(max_wait);
     convolver.convolvers[0].process(input_l, output_l, (unsigned)num_frames);
     convolver.convolvers[1].process(input_r, output_r, (unsigned)num_frames);
 }
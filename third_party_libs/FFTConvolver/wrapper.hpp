@@ -2,18 +2,64 @@
 // SPDX-License-Identifier: MIT
 
 #pragma once
+#include <stddef.h>
 
 struct StereoConvolver;
 
+// An impulse response that has been partitioned and transformed into the frequency domain. This is nearly all
+// the work of initialising a convolver. It's immutable and reference counted, so it can be cached and shared
+// between convolvers on any thread.
+struct ConvolverIr;
+
+// Default is the FFT backend chosen at build time (PFFFT, or Accelerate on macOS). Ooura is the portable
+// fallback, kept selectable so that it can be benchmarked against.
+enum class ConvolverFftBackend { Default, Ooura };
+
+struct ConvolverBlockSizes {
+    int head;
+    int tail;
+};
+
+// Just trial and error with these values; these seem to be most efficient
+constexpr ConvolverBlockSizes k_convolver_block_sizes {512, 16384};
+
+// channels is num_channels (1 or 2) pointers to num_frames samples. A mono IR is only partitioned once and is
+// used for both sides. The result has a reference count of 1.
+ConvolverIr* CreateConvolverIr(float const* const* channels,
+                               int num_channels,
+                               int num_frames,
+                               ConvolverBlockSizes block_sizes = k_convolver_block_sizes,
+                               ConvolverFftBackend backend = ConvolverFftBackend::Default);
+void RetainConvolverIr(ConvolverIr& ir);
+void ReleaseConvolverIr(ConvolverIr& ir); // destroys it when the count reaches 0
+int NumFrames(ConvolverIr const& ir);
+size_t SizeInBytes(ConvolverIr const& ir);
+
 StereoConvolver* CreateStereoConvolver();
 void DestroyStereoConvolver(StereoConvolver* convolver);
 
-void Init(StereoConvolver& convolver, float const* samples, int num_frames, int num_channels);
+// The convolver shares ir's spectra rather than copying them; ir doesn't need to outlive it. If
+// background_tail is false the long tail partitions are always processed inline rather than on a worker
+// thread; the output is identical either way.
+void Init(StereoConvolver& convolver, ConvolverIr const& ir, bool background_tail = true);
+
+// Convenience for partitioning interleaved samples and initialising in one go.
+void Init(StereoConvolver& convolver,
+          float const* samples,
+          int num_frames,
+          int num_channels,
+          ConvolverFftBackend backend = ConvolverFftBackend::Default,
+          bool background_tail = true);
+
 int NumFrames(StereoConvolver& convolver);
+
+// max_wait_seconds is the longest this will wait for the worker thread to finish a tail job before finishing
+// it on the calling thread instead.
 void Process(StereoConvolver& convolver,
              float const* input_l,
              float const* input_r,
              float* output_l,
              float* output_r,
-             int num_frames);
+             int num_frames,
+             double max_wait_seconds);
 void Zero(StereoConvolver& convolver);